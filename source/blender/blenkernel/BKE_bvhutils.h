@@ -258,6 +258,9 @@ float bvhtree_sphereray_tri_intersection(const BVHTreeRay *ray,
 bool bvhcache_has_tree(const struct BVHCache *bvh_cache, const BVHTree *tree);
 struct BVHCache *bvhcache_init(void);
 void bvhcache_free(struct BVHCache *bvh_cache);
+void bvhcache_tag_outdated(struct BVHCache *bvh_cache);
+struct BVHCache *bvhcache_release(struct Mesh *mesh);
+void bvhcache_reuse(struct Mesh *mesh, struct BVHCache *bvh_cache);
 
 #ifdef __cplusplus
 }
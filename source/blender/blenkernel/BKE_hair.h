@@ -32,6 +32,10 @@ struct Main;
 struct Object;
 struct Scene;
 
+/* Hair datablock */
+extern const char *HAIR_ATTR_POSITION;
+extern const char *HAIR_ATTR_RADIUS;
+
 void *BKE_hair_add(struct Main *bmain, const char *name);
 
 struct BoundBox *BKE_hair_boundbox_get(struct Object *ob);
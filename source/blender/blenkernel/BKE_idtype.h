@@ -49,6 +49,11 @@ enum {
   IDTYPE_FLAGS_NO_MAKELOCAL = 1 << 2,
   /** Indicates that the given IDType does not have animation data. */
   IDTYPE_FLAGS_NO_ANIMDATA = 1 << 3,
+  /**
+   * Indicates that `blend_read_data` only accesses the ID and the data read through the given
+   * #BlendDataReader, so data-blocks of this type can be read from a file in parallel.
+   */
+  IDTYPE_FLAGS_THREADSAFE_READ_DATA = 1 << 4,
 };
 
 typedef struct IDCacheKey {
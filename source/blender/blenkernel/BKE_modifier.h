@@ -285,6 +285,7 @@ typedef struct ModifierTypeInfo {
    * not free the md variable itself.
    *
    * This function is responsible for freeing the runtime data as well.
+   * Without it, the runtime data is freed with #freeRuntimeData.
    *
    * This function is optional.
    */
@@ -326,6 +327,16 @@ typedef struct ModifierTypeInfo {
    */
   bool (*dependsOnNormals)(struct ModifierData *md);
 
+  /**
+   * Should return true if a constructive modifier only moves vertices with its
+   * current settings. It is then evaluated through deformVerts and deformVertsEM
+   * as part of the deform-only modifiers, which also allows edit-mode cage support.
+   *
+   * This function is optional (assumes false if not present), it is only used for
+   * constructive modifiers that implement deformVerts.
+   */
+  bool (*isDeformOnly)(struct ModifierData *md);
+
   /**
    * Should call the given walk function with a pointer to each ID
    * pointer (i.e. each data-block pointer) that the modifier data
@@ -424,6 +435,7 @@ bool BKE_modifier_supports_cage(struct Scene *scene, struct ModifierData *md);
 bool BKE_modifier_couldbe_cage(struct Scene *scene, struct ModifierData *md);
 bool BKE_modifier_is_correctable_deformed(struct ModifierData *md);
 bool BKE_modifier_is_same_topology(ModifierData *md);
+bool BKE_modifier_is_deform_only(struct ModifierData *md);
 bool BKE_modifier_is_non_geometrical(ModifierData *md);
 bool BKE_modifier_is_enabled(const struct Scene *scene,
                              struct ModifierData *md,
@@ -530,6 +542,10 @@ void BKE_modifier_deform_vertsEM(ModifierData *md,
                                  float (*vertexCos)[3],
                                  int numVerts);
 
+void BKE_modifier_bounds_set(const struct ModifierEvalContext *ctx,
+                             const float min[3],
+                             const float max[3]);
+
 struct Mesh *BKE_modifier_get_evaluated_mesh_from_evaluated_object(struct Object *ob_eval,
                                                                    const bool get_cage_mesh);
 
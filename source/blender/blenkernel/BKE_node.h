@@ -1333,6 +1333,8 @@ int ntreeTexExecTree(struct bNodeTree *ntree,
 #define FN_NODE_COMBINE_STRINGS 1204
 #define FN_NODE_OBJECT_TRANSFORMS 1205
 #define FN_NODE_RANDOM_FLOAT 1206
+#define FN_NODE_SPHERE_INVERSION 1207
+#define FN_NODE_PLANE_REFLECTION 1208
 
 /** \} */
 
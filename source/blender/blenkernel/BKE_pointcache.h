@@ -69,6 +69,8 @@ extern "C" {
 /* high bits reserved for flags that need to be stored in file */
 #define PTCACHE_TYPEFLAG_COMPRESS (1 << 16)
 #define PTCACHE_TYPEFLAG_EXTRADATA (1 << 17)
+/* Data arrays are stored as a whole, in blocks that are compressed independently. */
+#define PTCACHE_TYPEFLAG_BLOCKS (1 << 18)
 
 #define PTCACHE_TYPEFLAG_TYPEMASK 0x0000FFFF
 #define PTCACHE_TYPEFLAG_FLAGMASK 0xFFFF0000
@@ -953,6 +953,8 @@ static void mesh_calc_modifiers(struct Depsgraph *depsgraph,
 
   /* Clear errors before evaluation. */
   BKE_modifiers_clear_errors(ob);
+  /* Set again by the modifiers, see #BKE_modifier_bounds_set. */
+  ob->runtime.use_modifier_bounds = false;
 
   /* Apply all leading deform modifiers. */
   if (useDeform) {
@@ -967,7 +969,7 @@ static void mesh_calc_modifiers(struct Depsgraph *depsgraph,
         continue;
       }
 
-      if (mti->type == eModifierTypeType_OnlyDeform && !sculpt_dyntopo) {
+      if (BKE_modifier_is_deform_only(md) && !sculpt_dyntopo) {
         if (!deformed_verts) {
           deformed_verts = BKE_mesh_vert_coords_alloc(mesh_input, &num_deformed_verts);
         }
@@ -1015,7 +1017,7 @@ static void mesh_calc_modifiers(struct Depsgraph *depsgraph,
       continue;
     }
 
-    if (mti->type == eModifierTypeType_OnlyDeform && !useDeform) {
+    if (BKE_modifier_is_deform_only(md) && !useDeform) {
       continue;
     }
 
@@ -1040,7 +1042,7 @@ static void mesh_calc_modifiers(struct Depsgraph *depsgraph,
       }
 
       if (scene->toolsettings->sculpt->flags & SCULPT_ONLY_DEFORM) {
-        unsupported |= (mti->type != eModifierTypeType_OnlyDeform);
+        unsupported |= !BKE_modifier_is_deform_only(md);
       }
 
       unsupported |= multires_applied;
@@ -1076,7 +1078,7 @@ static void mesh_calc_modifiers(struct Depsgraph *depsgraph,
     /* How to apply modifier depends on (a) what we already have as
      * a result of previous modifiers (could be a Mesh or just
      * deformed vertices) and (b) what type the modifier is. */
-    if (mti->type == eModifierTypeType_OnlyDeform) {
+    if (BKE_modifier_is_deform_only(md)) {
       /* No existing verts to deform, need to build them. */
       if (!deformed_verts) {
         if (mesh_final) {
@@ -1265,7 +1267,7 @@ static void mesh_calc_modifiers(struct Depsgraph *depsgraph,
       mesh_final->runtime.deformed_only = false;
     }
 
-    isPrevDeform = (mti->type == eModifierTypeType_OnlyDeform);
+    isPrevDeform = BKE_modifier_is_deform_only(md);
 
     /* grab modifiers until index i */
     if ((index != -1) && (BLI_findindex(&ob->modifiers, md) >= index)) {
@@ -1521,6 +1523,8 @@ static void editbmesh_calc_modifiers(struct Depsgraph *depsgraph,
 
   /* Clear errors before evaluation. */
   BKE_modifiers_clear_errors(ob);
+  /* Set again by the modifiers, see #BKE_modifier_bounds_set. */
+  ob->runtime.use_modifier_bounds = false;
 
   for (int i = 0; md; i++, md = md->next, md_datamask = md_datamask->next) {
     const ModifierTypeInfo *mti = BKE_modifier_get_info(md->type);
@@ -1541,7 +1545,7 @@ static void editbmesh_calc_modifiers(struct Depsgraph *depsgraph,
     /* How to apply modifier depends on (a) what we already have as
      * a result of previous modifiers (could be a mesh or just
      * deformed vertices) and (b) what type the modifier is. */
-    if (mti->type == eModifierTypeType_OnlyDeform) {
+    if (BKE_modifier_is_deform_only(md)) {
       /* No existing verts to deform, need to build them. */
       if (!deformed_verts) {
         if (mesh_final) {
@@ -1678,7 +1682,7 @@ static void editbmesh_calc_modifiers(struct Depsgraph *depsgraph,
       }
     }
 
-    isPrevDeform = (mti->type == eModifierTypeType_OnlyDeform);
+    isPrevDeform = BKE_modifier_is_deform_only(md);
   }
 
   BLI_linklist_free((LinkNode *)datamasks, NULL);
@@ -1807,6 +1811,17 @@ static void mesh_build_data(struct Depsgraph *depsgraph,
   const bool is_mesh_eval_owned = (mesh_eval != mesh->runtime.mesh_eval);
   BKE_object_eval_assign_data(ob, &mesh_eval->id, is_mesh_eval_owned);
 
+  /* Deforming meshes keep their topology, their BVH trees are refit instead of built again. */
+  if (ob->runtime.bvh_cache_retained != NULL) {
+    if (is_mesh_eval_owned) {
+      bvhcache_reuse(mesh_eval, ob->runtime.bvh_cache_retained);
+    }
+    else {
+      bvhcache_free(ob->runtime.bvh_cache_retained);
+    }
+    ob->runtime.bvh_cache_retained = NULL;
+  }
+
   ob->runtime.mesh_deform_eval = mesh_deform_eval;
   ob->runtime.last_data_mask = *dataMask;
   ob->runtime.last_need_mapping = need_mapping;
@@ -1838,6 +1853,11 @@ static void editbmesh_build_data(struct Depsgraph *depsgraph,
   BLI_assert(obedit->id.tag & LIB_TAG_COPIED_ON_WRITE);
 
   BKE_object_free_derived_caches(obedit);
+  if (obedit->runtime.bvh_cache_retained != NULL) {
+    /* Trees of edit-mode meshes are not reused. */
+    bvhcache_free(obedit->runtime.bvh_cache_retained);
+    obedit->runtime.bvh_cache_retained = NULL;
+  }
   if (DEG_is_active(depsgraph)) {
     BKE_sculpt_update_object_before_eval(obedit);
   }
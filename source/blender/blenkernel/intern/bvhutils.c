@@ -28,6 +28,7 @@
 #include "DNA_mesh_types.h"
 #include "DNA_meshdata_types.h"
 
+#include "BLI_hash_mm2a.h"
 #include "BLI_linklist.h"
 #include "BLI_math.h"
 #include "BLI_threads.h"
@@ -46,12 +47,22 @@
 
 typedef struct BVHCacheItem {
   bool is_filled;
+  /** The positions changed since the tree was built, it's refit before it's used again. */
+  bool is_outdated;
   BVHTree *tree;
 } BVHCacheItem;
 
+/** Element counts and connectivity of a mesh, see #bvhcache_release. */
+typedef struct BVHCacheTopology {
+  int totvert, totedge, totface, totloop, totpoly;
+  uint hash;
+} BVHCacheTopology;
+
 typedef struct BVHCache {
   BVHCacheItem items[BVHTREE_MAX_ITEM];
   ThreadMutex mutex;
+  /** Topology of the mesh the cache was released from. */
+  BVHCacheTopology topology;
 } BVHCache;
 
 /**
@@ -86,7 +97,7 @@ static bool bvhcache_find(BVHCache **bvh_cache_p,
   }
   BVHCache *bvh_cache = *bvh_cache_p;
 
-  if (bvh_cache->items[type].is_filled) {
+  if (bvh_cache->items[type].is_filled && !bvh_cache->items[type].is_outdated) {
     *r_tree = bvh_cache->items[type].tree;
     return true;
   }
@@ -117,7 +128,8 @@ bool bvhcache_has_tree(const BVHCache *bvh_cache, const BVHTree *tree)
 
   for (BVHCacheType i = 0; i < BVHTREE_MAX_ITEM; i++) {
     if (bvh_cache->items[i].tree == tree) {
-      return true;
+      /* Outdated trees have to be requested again, so they get refit. */
+      return !bvh_cache->items[i].is_outdated;
     }
   }
   return false;
@@ -140,7 +152,11 @@ BVHCache *bvhcache_init(void)
 static void bvhcache_insert(BVHCache *bvh_cache, BVHTree *tree, BVHCacheType type)
 {
   BVHCacheItem *item = &bvh_cache->items[type];
-  BLI_assert(!item->is_filled);
+  BLI_assert(!item->is_filled || item->is_outdated);
+  if (item->is_outdated) {
+    BLI_bvhtree_free(item->tree);
+    item->is_outdated = false;
+  }
   item->tree = tree;
   item->is_filled = true;
 }
@@ -159,6 +175,194 @@ void bvhcache_free(BVHCache *bvh_cache)
   MEM_freeN(bvh_cache);
 }
 
+/**
+ * Tag the trees in the cache to be refit to the current positions of the mesh before they are
+ * used again, for when only the positions changed.
+ */
+void bvhcache_tag_outdated(BVHCache *bvh_cache)
+{
+  for (BVHCacheType index = 0; index < BVHTREE_MAX_ITEM; index++) {
+    BVHCacheItem *item = &bvh_cache->items[index];
+    if (item->tree == NULL) {
+      continue;
+    }
+    if (ELEM(index, BVHTREE_FROM_EM_VERTS, BVHTREE_FROM_EM_EDGES, BVHTREE_FROM_EM_LOOPTRI)) {
+      /* Edit-mesh trees can't be refit from the mesh. */
+      BLI_bvhtree_free(item->tree);
+      item->tree = NULL;
+      item->is_filled = false;
+    }
+    else {
+      item->is_outdated = true;
+    }
+  }
+}
+
+/**
+ * Only the element counts decide which elements a tree without a mask contains. The trees of
+ * loose elements and of visible triangles also depend on the connectivity and the hide flags.
+ */
+static void mesh_topology_get(const Mesh *mesh, BVHCacheTopology *r_topology)
+{
+  r_topology->totvert = mesh->totvert;
+  r_topology->totedge = mesh->totedge;
+  r_topology->totface = mesh->totface;
+  r_topology->totloop = mesh->totloop;
+  r_topology->totpoly = mesh->totpoly;
+
+  BLI_HashMurmur2A mm2;
+  BLI_hash_mm2a_init(&mm2, 0);
+  for (int i = 0; i < mesh->totedge; i++) {
+    BLI_hash_mm2a_add_int(&mm2, (int)mesh->medge[i].v1);
+    BLI_hash_mm2a_add_int(&mm2, (int)mesh->medge[i].v2);
+  }
+  for (int i = 0; i < mesh->totface; i++) {
+    BLI_hash_mm2a_add(&mm2, (const uchar *)&mesh->mface[i].v1, sizeof(uint[4]));
+  }
+  /* Both the vertex and edge indices of the loops are topology. */
+  BLI_hash_mm2a_add(&mm2, (const uchar *)mesh->mloop, sizeof(MLoop) * (size_t)mesh->totloop);
+  for (int i = 0; i < mesh->totpoly; i++) {
+    BLI_hash_mm2a_add_int(&mm2, mesh->mpoly[i].loopstart);
+    BLI_hash_mm2a_add_int(&mm2, mesh->mpoly[i].totloop);
+    BLI_hash_mm2a_add_int(&mm2, mesh->mpoly[i].flag & ME_HIDE);
+  }
+  r_topology->hash = BLI_hash_mm2a_end(&mm2);
+}
+
+/**
+ * Take the cache of \a mesh, so it can be given to a new mesh with the same topology by
+ * #bvhcache_reuse. Deforming objects evaluate a new mesh every time, with this their trees only
+ * have to be refit instead of built again.
+ *
+ * \return The cache, or NULL when the mesh had none.
+ */
+BVHCache *bvhcache_release(Mesh *mesh)
+{
+  BVHCache *bvh_cache = mesh->runtime.bvh_cache;
+  if (bvh_cache != NULL) {
+    mesh_topology_get(mesh, &bvh_cache->topology);
+    mesh->runtime.bvh_cache = NULL;
+  }
+  return bvh_cache;
+}
+
+/**
+ * Give a cache taken with #bvhcache_release to \a mesh. When the topology of the mesh is the
+ * same, the trees are refit to its positions the next time they are used. Otherwise the cache is
+ * freed.
+ */
+void bvhcache_reuse(Mesh *mesh, BVHCache *bvh_cache)
+{
+  if (mesh->runtime.bvh_cache != NULL) {
+    bvhcache_free(bvh_cache);
+    return;
+  }
+
+  BVHCacheTopology topology;
+  mesh_topology_get(mesh, &topology);
+  if (memcmp(&topology, &bvh_cache->topology, sizeof(topology)) != 0) {
+    bvhcache_free(bvh_cache);
+    return;
+  }
+
+  bvhcache_tag_outdated(bvh_cache);
+  mesh->runtime.bvh_cache = bvh_cache;
+}
+
+typedef struct BVHCacheRefitData {
+  const Mesh *mesh;
+  const MLoopTri *looptri;
+} BVHCacheRefitData;
+
+static int bvhcache_refit_verts_cb(void *userdata, int index, float r_co[][3])
+{
+  const BVHCacheRefitData *data = userdata;
+  copy_v3_v3(r_co[0], data->mesh->mvert[index].co);
+  return 1;
+}
+
+static int bvhcache_refit_edges_cb(void *userdata, int index, float r_co[][3])
+{
+  const BVHCacheRefitData *data = userdata;
+  const MEdge *edge = &data->mesh->medge[index];
+  copy_v3_v3(r_co[0], data->mesh->mvert[edge->v1].co);
+  copy_v3_v3(r_co[1], data->mesh->mvert[edge->v2].co);
+  return 2;
+}
+
+static int bvhcache_refit_faces_cb(void *userdata, int index, float r_co[][3])
+{
+  const BVHCacheRefitData *data = userdata;
+  const MFace *face = &data->mesh->mface[index];
+  copy_v3_v3(r_co[0], data->mesh->mvert[face->v1].co);
+  copy_v3_v3(r_co[1], data->mesh->mvert[face->v2].co);
+  copy_v3_v3(r_co[2], data->mesh->mvert[face->v3].co);
+  if (face->v4) {
+    copy_v3_v3(r_co[3], data->mesh->mvert[face->v4].co);
+    return 4;
+  }
+  return 3;
+}
+
+static int bvhcache_refit_looptri_cb(void *userdata, int index, float r_co[][3])
+{
+  const BVHCacheRefitData *data = userdata;
+  const MLoopTri *lt = &data->looptri[index];
+  for (int i = 0; i < 3; i++) {
+    copy_v3_v3(r_co[i], data->mesh->mvert[data->mesh->mloop[lt->tri[i]].v].co);
+  }
+  return 3;
+}
+
+/**
+ * Refit the tree of the given type if it's outdated, see #bvhcache_tag_outdated.
+ */
+static void bvhcache_refit(Mesh *mesh, BVHCacheType type)
+{
+  BVHCache *bvh_cache = mesh->runtime.bvh_cache;
+  if (bvh_cache == NULL || !bvh_cache->items[type].is_outdated) {
+    return;
+  }
+
+  BLI_mutex_lock(&bvh_cache->mutex);
+  BVHCacheItem *item = &bvh_cache->items[type];
+  if (item->is_outdated) {
+    BVHCacheRefitData data = {.mesh = mesh};
+    BVHTree_RefitCallback callback = NULL;
+    switch (type) {
+      case BVHTREE_FROM_VERTS:
+      case BVHTREE_FROM_LOOSEVERTS:
+        callback = bvhcache_refit_verts_cb;
+        break;
+      case BVHTREE_FROM_EDGES:
+      case BVHTREE_FROM_LOOSEEDGES:
+        callback = bvhcache_refit_edges_cb;
+        break;
+      case BVHTREE_FROM_FACES:
+        callback = bvhcache_refit_faces_cb;
+        break;
+      case BVHTREE_FROM_LOOPTRI:
+      case BVHTREE_FROM_LOOPTRI_NO_HIDDEN:
+        /* The triangulation of n-gons can change with the positions, but not the polygon every
+         * triangle belongs to. Refitting keeps the tree valid, it may just get less efficient. */
+        data.looptri = BKE_mesh_runtime_looptri_ensure(mesh);
+        callback = bvhcache_refit_looptri_cb;
+        break;
+      case BVHTREE_FROM_EM_VERTS:
+      case BVHTREE_FROM_EM_EDGES:
+      case BVHTREE_FROM_EM_LOOPTRI:
+      case BVHTREE_MAX_ITEM:
+        BLI_assert(false);
+        break;
+    }
+    if (callback) {
+      BLI_bvhtree_refit(item->tree, callback, &data);
+    }
+    item->is_outdated = false;
+  }
+  BLI_mutex_unlock(&bvh_cache->mutex);
+}
+
 /** \} */
 /* -------------------------------------------------------------------- */
 /** \name Local Callbacks
@@ -1418,6 +1622,7 @@ BVHTree *BKE_bvhtree_from_mesh_get(struct BVHTreeFromMesh *data,
   BVHCache **bvh_cache_p = (BVHCache **)&mesh->runtime.bvh_cache;
   ThreadMutex *mesh_eval_mutex = (ThreadMutex *)mesh->runtime.eval_mutex;
 
+  bvhcache_refit(mesh, bvh_cache_type);
   bool is_cached = bvhcache_find(bvh_cache_p, bvh_cache_type, &tree, NULL, NULL);
 
   if (is_cached && tree == NULL) {
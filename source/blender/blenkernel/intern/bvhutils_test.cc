@@ -0,0 +1,302 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "DNA_genfile.h"
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_object_types.h"
+#include "DNA_scene_types.h"
+
+#include "BLI_math.h"
+#include "BLI_rand.hh"
+#include "BLI_threads.h"
+
+#include "BKE_appdir.h"
+#include "BKE_blender.h"
+#include "BKE_bvhutils.h"
+#include "BKE_global.h"
+#include "BKE_idtype.h"
+#include "BKE_image.h"
+#include "BKE_layer.h"
+#include "BKE_lib_id.h"
+#include "BKE_main.h"
+#include "BKE_mesh.h"
+#include "BKE_modifier.h"
+#include "BKE_node.h"
+#include "BKE_object.h"
+#include "BKE_scene.h"
+
+#include "DEG_depsgraph.h"
+#include "DEG_depsgraph_build.h"
+#include "DEG_depsgraph_query.h"
+
+#include "IMB_imbuf.h"
+
+#include "RNA_define.h"
+
+#include "CLG_log.h"
+
+namespace blender::bke::tests {
+
+class BVHCacheTest : public testing::Test {
+ public:
+  static void SetUpTestCase()
+  {
+    BKE_idtype_init();
+  }
+
+  /* Grid of `side * side` vertices, deformed by a wave of height \a wave. */
+  static Mesh *grid_mesh_new(const int side, const float wave)
+  {
+    const int quads_num = (side - 1) * (side - 1);
+    Mesh *mesh = BKE_mesh_new_nomain(side * side, 0, 0, quads_num * 4, quads_num);
+
+    for (int y = 0; y < side; y++) {
+      for (int x = 0; x < side; x++) {
+        float *co = mesh->mvert[y * side + x].co;
+        co[0] = (float)x / (float)(side - 1) * 2.0f - 1.0f;
+        co[1] = (float)y / (float)(side - 1) * 2.0f - 1.0f;
+        co[2] = wave * sinf(co[0] * 4.0f) * cosf(co[1] * 3.0f);
+      }
+    }
+
+    int poly_index = 0;
+    for (int y = 0; y < side - 1; y++) {
+      for (int x = 0; x < side - 1; x++) {
+        const int loopstart = poly_index * 4;
+        mesh->mpoly[poly_index].loopstart = loopstart;
+        mesh->mpoly[poly_index].totloop = 4;
+        mesh->mloop[loopstart + 0].v = y * side + x;
+        mesh->mloop[loopstart + 1].v = y * side + x + 1;
+        mesh->mloop[loopstart + 2].v = (y + 1) * side + x + 1;
+        mesh->mloop[loopstart + 3].v = (y + 1) * side + x;
+        poly_index++;
+      }
+    }
+
+    BKE_mesh_calc_edges(mesh, false, false);
+    return mesh;
+  }
+
+  /* Ray-casts from above and nearest queries must find the same as in a new tree. */
+  static void compare_queries(BVHTreeFromMesh *treedata_a, BVHTreeFromMesh *treedata_b)
+  {
+    RandomNumberGenerator rng(0);
+    const float dir[3] = {0.0f, 0.0f, -1.0f};
+    for (int i = 0; i < 200; i++) {
+      const float co[3] = {
+          rng.get_float() * 2.0f - 1.0f, rng.get_float() * 2.0f - 1.0f, 2.0f * rng.get_float()};
+
+      BVHTreeRayHit hit_a = {-1, BVH_RAYCAST_DIST_MAX};
+      BVHTreeRayHit hit_b = {-1, BVH_RAYCAST_DIST_MAX};
+      BLI_bvhtree_ray_cast(
+          treedata_a->tree, co, dir, 0.0f, &hit_a, treedata_a->raycast_callback, treedata_a);
+      BLI_bvhtree_ray_cast(
+          treedata_b->tree, co, dir, 0.0f, &hit_b, treedata_b->raycast_callback, treedata_b);
+      EXPECT_EQ(hit_a.index, hit_b.index);
+      EXPECT_FLOAT_EQ(hit_a.dist, hit_b.dist);
+
+      BVHTreeNearest nearest_a = {-1};
+      BVHTreeNearest nearest_b = {-1};
+      nearest_a.dist_sq = nearest_b.dist_sq = FLT_MAX;
+      BLI_bvhtree_find_nearest(
+          treedata_a->tree, co, &nearest_a, treedata_a->nearest_callback, treedata_a);
+      BLI_bvhtree_find_nearest(
+          treedata_b->tree, co, &nearest_b, treedata_b->nearest_callback, treedata_b);
+      EXPECT_FLOAT_EQ(nearest_a.dist_sq, nearest_b.dist_sq);
+    }
+  }
+};
+
+TEST_F(BVHCacheTest, ReuseDeformed)
+{
+  Mesh *mesh_prev = grid_mesh_new(64, 0.0f);
+  BVHTreeFromMesh treedata_prev;
+  BKE_bvhtree_from_mesh_get(&treedata_prev, mesh_prev, BVHTREE_FROM_LOOPTRI, 4);
+  BVHTree *tree_prev = treedata_prev.tree;
+  free_bvhtree_from_mesh(&treedata_prev);
+
+  /* Same topology, the tree is moved to the new mesh and refit. */
+  Mesh *mesh = grid_mesh_new(64, 0.5f);
+  bvhcache_reuse(mesh, bvhcache_release(mesh_prev));
+  EXPECT_EQ(mesh_prev->runtime.bvh_cache, nullptr);
+  EXPECT_NE(mesh->runtime.bvh_cache, nullptr);
+  EXPECT_FALSE(bvhcache_has_tree(mesh->runtime.bvh_cache, tree_prev));
+
+  BVHTreeFromMesh treedata;
+  BKE_bvhtree_from_mesh_get(&treedata, mesh, BVHTREE_FROM_LOOPTRI, 4);
+  EXPECT_EQ(treedata.tree, tree_prev);
+  EXPECT_TRUE(bvhcache_has_tree(mesh->runtime.bvh_cache, tree_prev));
+
+  Mesh *mesh_new = grid_mesh_new(64, 0.5f);
+  BVHTreeFromMesh treedata_new;
+  BKE_bvhtree_from_mesh_get(&treedata_new, mesh_new, BVHTREE_FROM_LOOPTRI, 4);
+  compare_queries(&treedata, &treedata_new);
+
+  free_bvhtree_from_mesh(&treedata);
+  free_bvhtree_from_mesh(&treedata_new);
+  BKE_id_free(nullptr, mesh_prev);
+  BKE_id_free(nullptr, mesh);
+  BKE_id_free(nullptr, mesh_new);
+}
+
+TEST_F(BVHCacheTest, ReuseTopologyChanged)
+{
+  Mesh *mesh_prev = grid_mesh_new(32, 0.0f);
+  BVHTreeFromMesh treedata;
+  BKE_bvhtree_from_mesh_get(&treedata, mesh_prev, BVHTREE_FROM_LOOSEEDGES, 2);
+  BKE_bvhtree_from_mesh_get(&treedata, mesh_prev, BVHTREE_FROM_LOOPTRI, 4);
+  free_bvhtree_from_mesh(&treedata);
+
+  /* Same element counts, different connectivity. */
+  Mesh *mesh = grid_mesh_new(32, 0.0f);
+  SWAP(uint, mesh->mloop[0].v, mesh->mloop[1].v);
+  bvhcache_reuse(mesh, bvhcache_release(mesh_prev));
+  EXPECT_EQ(mesh->runtime.bvh_cache, nullptr);
+
+  /* Different element counts. */
+  Mesh *mesh_other = grid_mesh_new(33, 0.0f);
+  BKE_bvhtree_from_mesh_get(&treedata, mesh_other, BVHTREE_FROM_LOOPTRI, 4);
+  free_bvhtree_from_mesh(&treedata);
+  bvhcache_reuse(mesh_prev, bvhcache_release(mesh_other));
+  EXPECT_EQ(mesh_prev->runtime.bvh_cache, nullptr);
+
+  BKE_id_free(nullptr, mesh_prev);
+  BKE_id_free(nullptr, mesh);
+  BKE_id_free(nullptr, mesh_other);
+}
+
+TEST_F(BVHCacheTest, TagCoordsChanged)
+{
+  Mesh *mesh = grid_mesh_new(64, 0.0f);
+  BVHTreeFromMesh treedata;
+  BKE_bvhtree_from_mesh_get(&treedata, mesh, BVHTREE_FROM_VERTS, 2);
+  BVHTree *tree_verts = treedata.tree;
+  free_bvhtree_from_mesh(&treedata);
+
+  Mesh *mesh_new = grid_mesh_new(64, 0.25f);
+  float(*vert_coords)[3] = BKE_mesh_vert_coords_alloc(mesh_new, nullptr);
+  BKE_mesh_vert_coords_apply(mesh, vert_coords);
+  MEM_freeN(vert_coords);
+  EXPECT_FALSE(bvhcache_has_tree(mesh->runtime.bvh_cache, tree_verts));
+
+  BKE_bvhtree_from_mesh_get(&treedata, mesh, BVHTREE_FROM_VERTS, 2);
+  EXPECT_EQ(treedata.tree, tree_verts);
+
+  BVHTreeFromMesh treedata_new;
+  BKE_bvhtree_from_mesh_get(&treedata_new, mesh_new, BVHTREE_FROM_VERTS, 2);
+  compare_queries(&treedata, &treedata_new);
+
+  free_bvhtree_from_mesh(&treedata);
+  free_bvhtree_from_mesh(&treedata_new);
+  BKE_id_free(nullptr, mesh);
+  BKE_id_free(nullptr, mesh_new);
+}
+
+/* Evaluation of objects through the depsgraph, which moves the trees between evaluated meshes. */
+class BVHCacheDepsgraphTest : public BVHCacheTest {
+ public:
+  static void SetUpTestCase()
+  {
+    /* Same minimal initialization as the blend file loading tests. */
+    CLG_init();
+    BLI_threadapi_init();
+
+    DNA_sdna_current_init();
+    BKE_blender_globals_init();
+
+    BKE_idtype_init();
+    BKE_appdir_init();
+    IMB_init();
+    BKE_images_init();
+    BKE_modifier_init();
+    DEG_register_node_types();
+    RNA_init();
+    init_nodesystem();
+
+    G.background = true;
+    G.factory_startup = true;
+  }
+
+  static void TearDownTestCase()
+  {
+    BKE_blender_free();
+    RNA_exit();
+
+    DEG_free_node_types();
+    DNA_sdna_current_free();
+    BLI_threadapi_exit();
+
+    BKE_blender_atexit();
+
+    BKE_tempdir_session_purge();
+
+    CLG_exit();
+  }
+};
+
+TEST_F(BVHCacheDepsgraphTest, ReuseAfterGeometryUpdate)
+{
+  Main *bmain = G.main;
+  Scene *scene = BKE_scene_add(bmain, "Scene");
+  ViewLayer *view_layer = BKE_view_layer_default_view(scene);
+  Object *object = BKE_object_add(bmain, view_layer, OB_MESH, "Grid");
+  Mesh *mesh = (Mesh *)object->data;
+  BKE_mesh_nomain_to_mesh(grid_mesh_new(64, 0.0f), mesh, object, &CD_MASK_MESH, true);
+
+  Depsgraph *depsgraph = DEG_graph_new(bmain, scene, view_layer, DAG_EVAL_VIEWPORT);
+  DEG_graph_build_from_view_layer(depsgraph);
+  BKE_scene_graph_update_tagged(depsgraph, bmain);
+
+  Object *object_eval = DEG_get_evaluated_object(depsgraph, object);
+  BVHTreeFromMesh treedata;
+  BKE_bvhtree_from_mesh_get(
+      &treedata, BKE_object_get_evaluated_mesh(object_eval), BVHTREE_FROM_LOOPTRI, 4);
+  BVHTree *tree_prev = treedata.tree;
+  free_bvhtree_from_mesh(&treedata);
+
+  /* Deform the original mesh, the object is evaluated again with the same topology. Freeing the
+   * previous evaluated mesh keeps its trees for the new one. */
+  for (int i = 0; i < mesh->totvert; i++) {
+    float *co = mesh->mvert[i].co;
+    co[2] = 0.5f * sinf(co[0] * 4.0f) * cosf(co[1] * 3.0f);
+  }
+  DEG_id_tag_update(&mesh->id, ID_RECALC_GEOMETRY);
+  BKE_scene_graph_update_tagged(depsgraph, bmain);
+
+  Mesh *mesh_eval = BKE_object_get_evaluated_mesh(object_eval);
+  EXPECT_EQ(object_eval->runtime.bvh_cache_retained, nullptr);
+  ASSERT_NE(mesh_eval->runtime.bvh_cache, nullptr);
+  BKE_bvhtree_from_mesh_get(&treedata, mesh_eval, BVHTREE_FROM_LOOPTRI, 4);
+  EXPECT_EQ(treedata.tree, tree_prev);
+
+  /* The refit tree gives the same results as a new one. */
+  Mesh *mesh_new = BKE_mesh_copy_for_eval(mesh_eval, false);
+  BVHTreeFromMesh treedata_new;
+  BKE_bvhtree_from_mesh_get(&treedata_new, mesh_new, BVHTREE_FROM_LOOPTRI, 4);
+  EXPECT_NE(treedata_new.tree, tree_prev);
+  compare_queries(&treedata, &treedata_new);
+
+  free_bvhtree_from_mesh(&treedata);
+  free_bvhtree_from_mesh(&treedata_new);
+  BKE_id_free(nullptr, mesh_new);
+  DEG_graph_free(depsgraph);
+}
+
+}  // namespace blender::bke::tests
@@ -277,7 +277,7 @@ int BKE_crazyspace_get_first_deform_matrices_editbmesh(struct Depsgraph *depsgra
       continue;
     }
 
-    if (mti->type == eModifierTypeType_OnlyDeform && mti->deformMatricesEM) {
+    if (BKE_modifier_is_deform_only(md) && mti->deformMatricesEM) {
       if (!defmats) {
         const int required_mode = eModifierMode_Realtime | eModifierMode_Editmode;
         CustomData_MeshMasks cd_mask_extra = CD_MASK_BAREMESH;
@@ -354,14 +354,12 @@ static bool crazyspace_modifier_supports_deform_matrices(ModifierData *md)
   if (ELEM(md->type, eModifierType_Subsurf, eModifierType_Multires)) {
     return true;
   }
-  const ModifierTypeInfo *mti = BKE_modifier_get_info(md->type);
-  return (mti->type == eModifierTypeType_OnlyDeform);
+  return BKE_modifier_is_deform_only(md);
 }
 
 static bool crazyspace_modifier_supports_deform(ModifierData *md)
 {
-  const ModifierTypeInfo *mti = BKE_modifier_get_info(md->type);
-  return (mti->type == eModifierTypeType_OnlyDeform);
+  return BKE_modifier_is_deform_only(md);
 }
 
 int BKE_sculpt_get_first_deform_matrices(struct Depsgraph *depsgraph,
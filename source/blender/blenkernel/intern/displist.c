@@ -879,7 +879,7 @@ static bool curve_calc_modifiers_pre(
       if (!BKE_modifier_is_enabled(scene, md, required_mode)) {
         continue;
       }
-      if (mti->type != eModifierTypeType_OnlyDeform) {
+      if (!BKE_modifier_is_deform_only(md)) {
         continue;
       }
 
@@ -1013,7 +1013,7 @@ static void curve_calc_modifiers_post(Depsgraph *depsgraph,
       modified = BKE_mesh_new_nomain_from_curve_displist(ob, dispbase);
     }
 
-    if (mti->type == eModifierTypeType_OnlyDeform ||
+    if (BKE_modifier_is_deform_only(md) ||
         (mti->type == eModifierTypeType_DeformOrConstruct && !modified)) {
       if (modified) {
         if (!vertCos) {
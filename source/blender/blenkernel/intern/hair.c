@@ -49,8 +49,8 @@
 
 #include "BLO_read_write.h"
 
-static const char *HAIR_ATTR_POSITION = "Position";
-static const char *HAIR_ATTR_RADIUS = "Radius";
+const char *HAIR_ATTR_POSITION = "Position";
+const char *HAIR_ATTR_RADIUS = "Radius";
 
 /* Hair datablock */
 
@@ -351,7 +351,7 @@ static Hair *hair_evaluate_modifiers(struct Depsgraph *depsgraph,
       continue;
     }
 
-    if ((mti->type == eModifierTypeType_OnlyDeform) &&
+    if (BKE_modifier_is_deform_only(md) &&
         (mti->flags & eModifierTypeFlag_AcceptsVertexCosOnly)) {
       /* Ensure we are not modifying the input. */
       if (hair == hair_input) {
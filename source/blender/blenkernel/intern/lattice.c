@@ -565,7 +565,7 @@ void BKE_lattice_modifiers_calc(struct Depsgraph *depsgraph, Scene *scene, Objec
     if (mti->isDisabled && mti->isDisabled(scene, md, 0)) {
       continue;
     }
-    if (mti->type != eModifierTypeType_OnlyDeform) {
+    if (!BKE_modifier_is_deform_only(md)) {
       continue;
     }
 
@@ -47,6 +47,7 @@
 #include "BLT_translation.h"
 
 #include "BKE_anim_data.h"
+#include "BKE_bvhutils.h"
 #include "BKE_deform.h"
 #include "BKE_editmesh.h"
 #include "BKE_global.h"
@@ -320,7 +321,7 @@ IDTypeInfo IDType_ID_ME = {
     .name = "Mesh",
     .name_plural = "meshes",
     .translation_context = BLT_I18NCONTEXT_ID_MESH,
-    .flags = 0,
+    .flags = IDTYPE_FLAGS_THREADSAFE_READ_DATA,
 
     .init_data = mesh_init_data,
     .copy_data = mesh_copy_data,
@@ -1736,7 +1737,19 @@ void BKE_mesh_vert_coords_apply(Mesh *mesh, const float (*vert_coords)[3])
   for (int i = 0; i < mesh->totvert; i++, mv++) {
     copy_v3_v3(mv->co, vert_coords[i]);
   }
+  BKE_mesh_tag_coords_changed(mesh);
+}
+
+/**
+ * Call after moving the vertices of \a mesh without changing its topology. Normals are
+ * recalculated and cached BVH trees are refit the next time they are used.
+ */
+void BKE_mesh_tag_coords_changed(Mesh *mesh)
+{
   mesh->runtime.cd_dirty_vert |= CD_MASK_NORMAL;
+  if (mesh->runtime.bvh_cache != NULL) {
+    bvhcache_tag_outdated(mesh->runtime.bvh_cache);
+  }
 }
 
 void BKE_mesh_vert_coords_apply_with_mat4(Mesh *mesh,
@@ -1749,7 +1762,7 @@ void BKE_mesh_vert_coords_apply_with_mat4(Mesh *mesh,
   for (int i = 0; i < mesh->totvert; i++, mv++) {
     mul_v3_m4v3(mv->co, mat, vert_coords[i]);
   }
-  mesh->runtime.cd_dirty_vert |= CD_MASK_NORMAL;
+  BKE_mesh_tag_coords_changed(mesh);
 }
 
 void BKE_mesh_vert_normals_apply(Mesh *mesh, const short (*vert_normals)[3])
@@ -42,6 +42,7 @@
 
 #include "BLI_linklist.h"
 #include "BLI_listbase.h"
+#include "BLI_math_vector.h"
 #include "BLI_path_util.h"
 #include "BLI_session_uuid.h"
 #include "BLI_string.h"
@@ -188,6 +189,9 @@ void BKE_modifier_free_ex(ModifierData *md, const int flag)
   if (mti->freeData) {
     mti->freeData(md);
   }
+  else if (mti->freeRuntimeData && md->runtime) {
+    mti->freeRuntimeData(md->runtime);
+  }
   if (md->error) {
     MEM_freeN(md->error);
   }
@@ -227,8 +231,7 @@ bool BKE_modifier_supports_mapping(ModifierData *md)
 {
   const ModifierTypeInfo *mti = BKE_modifier_get_info(md->type);
 
-  return (mti->type == eModifierTypeType_OnlyDeform ||
-          (mti->flags & eModifierTypeFlag_SupportsMapping));
+  return (BKE_modifier_is_deform_only(md) || (mti->flags & eModifierTypeFlag_SupportsMapping));
 }
 
 bool BKE_modifier_is_preview(ModifierData *md)
@@ -386,7 +389,21 @@ bool BKE_modifier_couldbe_cage(struct Scene *scene, ModifierData *md)
 bool BKE_modifier_is_same_topology(ModifierData *md)
 {
   const ModifierTypeInfo *mti = BKE_modifier_get_info(md->type);
-  return ELEM(mti->type, eModifierTypeType_OnlyDeform, eModifierTypeType_NonGeometrical);
+  return (mti->type == eModifierTypeType_NonGeometrical) || BKE_modifier_is_deform_only(md);
+}
+
+/**
+ * Whether the modifier is evaluated through its deform callbacks. Besides deform-only modifier
+ * types this includes constructive modifiers that only move vertices with their current settings.
+ */
+bool BKE_modifier_is_deform_only(ModifierData *md)
+{
+  const ModifierTypeInfo *mti = BKE_modifier_get_info(md->type);
+  if (mti->type == eModifierTypeType_OnlyDeform) {
+    return true;
+  }
+  return (mti->type == eModifierTypeType_Constructive) && mti->deformVerts && mti->isDeformOnly &&
+         mti->isDeformOnly(md);
 }
 
 bool BKE_modifier_is_non_geometrical(ModifierData *md)
@@ -561,7 +578,7 @@ CDMaskLink *BKE_modifier_calc_data_masks(struct Scene *scene,
     curr = MEM_callocN(sizeof(CDMaskLink), "CDMaskLink");
 
     if (BKE_modifier_is_enabled(scene, md, required_mode)) {
-      if (mti->type == eModifierTypeType_OnlyDeform) {
+      if (BKE_modifier_is_deform_only(md)) {
         have_deform_modifier = true;
       }
 
@@ -849,14 +866,13 @@ bool BKE_modifiers_uses_subsurf_facedots(struct Scene *scene, Object *ob)
   }
   /* Now from this point, search for subsurf modifier. */
   for (; md; md = md->prev) {
-    const ModifierTypeInfo *mti = BKE_modifier_get_info(md->type);
     if (md->type == eModifierType_Subsurf) {
       ModifierMode mode = eModifierMode_Realtime | eModifierMode_Editmode;
       if (BKE_modifier_is_enabled(scene, md, mode)) {
         return true;
       }
     }
-    else if (mti->type == eModifierTypeType_OnlyDeform) {
+    else if (BKE_modifier_is_deform_only(md)) {
       /* These modifiers do not reset the subdiv flag nor change the topology.
        * We can still search for a subsurf modifier. */
     }
@@ -989,6 +1005,14 @@ static void modwrap_dependsOnNormals(Mesh *me)
   }
 }
 
+/* Bounds reported by a modifier are only valid until the next modifier changes the geometry. */
+static void modwrap_bounds_clear(const ModifierEvalContext *ctx)
+{
+  if ((ctx->flag & MOD_APPLY_ORCO) == 0) {
+    ctx->object->runtime.use_modifier_bounds = false;
+  }
+}
+
 /* wrapper around ModifierTypeInfo.modifyMesh that ensures valid normals */
 
 struct Mesh *BKE_modifier_modify_mesh(ModifierData *md,
@@ -1007,6 +1031,7 @@ struct Mesh *BKE_modifier_modify_mesh(ModifierData *md,
   if (mti->dependsOnNormals && mti->dependsOnNormals(md)) {
     modwrap_dependsOnNormals(me);
   }
+  modwrap_bounds_clear(ctx);
   return mti->modifyMesh(md, ctx, me);
 }
 
@@ -1022,6 +1047,7 @@ void BKE_modifier_deform_verts(ModifierData *md,
   if (me && mti->dependsOnNormals && mti->dependsOnNormals(md)) {
     modwrap_dependsOnNormals(me);
   }
+  modwrap_bounds_clear(ctx);
   mti->deformVerts(md, ctx, me, vertexCos, numVerts);
 }
 
@@ -1038,9 +1064,29 @@ void BKE_modifier_deform_vertsEM(ModifierData *md,
   if (me && mti->dependsOnNormals && mti->dependsOnNormals(md)) {
     BKE_mesh_calc_normals(me);
   }
+  modwrap_bounds_clear(ctx);
   mti->deformVertsEM(md, ctx, em, me, vertexCos, numVerts);
 }
 
+/**
+ * Report the object space bounds of the positions a modifier just computed, for modifiers that
+ * know them without looking at every vertex (conservative bounds are fine). They are used for
+ * the bounding box of the evaluated mesh, unless a later modifier in the stack changes it.
+ */
+void BKE_modifier_bounds_set(const ModifierEvalContext *ctx,
+                             const float min[3],
+                             const float max[3])
+{
+  /* Only the mesh modifier stack uses them, curves apply modifiers to control points. */
+  if ((ctx->flag & MOD_APPLY_ORCO) || ctx->object->type != OB_MESH) {
+    return;
+  }
+  Object_Runtime *runtime = &ctx->object->runtime;
+  copy_v3_v3(runtime->modifier_bounds[0], min);
+  copy_v3_v3(runtime->modifier_bounds[1], max);
+  runtime->use_modifier_bounds = true;
+}
+
 /* end modifier callback wrappers */
 
 /**
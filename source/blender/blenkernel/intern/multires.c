@@ -291,8 +291,6 @@ float (*BKE_multires_create_deformed_base_mesh_vert_coords(struct Depsgraph *dep
   float(*deformed_verts)[3] = BKE_mesh_vert_coords_alloc(base_mesh, &num_deformed_verts);
 
   for (ModifierData *md = first_md; md != NULL; md = md->next) {
-    const ModifierTypeInfo *mti = BKE_modifier_get_info(md->type);
-
     if (md == &mmd->modifier) {
       break;
     }
@@ -301,7 +299,7 @@ float (*BKE_multires_create_deformed_base_mesh_vert_coords(struct Depsgraph *dep
       continue;
     }
 
-    if (mti->type != eModifierTypeType_OnlyDeform) {
+    if (!BKE_modifier_is_deform_only(md)) {
       break;
     }
 
@@ -4660,6 +4660,8 @@ static void registerFunctionNodes(void)
   register_node_type_fn_combine_strings();
   register_node_type_fn_object_transforms();
   register_node_type_fn_random_float();
+  register_node_type_fn_sphere_inversion();
+  register_node_type_fn_plane_reflection();
 }
 
 void init_nodesystem(void)
@@ -75,6 +75,7 @@
 #include "BKE_anim_visualization.h"
 #include "BKE_animsys.h"
 #include "BKE_armature.h"
+#include "BKE_bvhutils.h"
 #include "BKE_camera.h"
 #include "BKE_collection.h"
 #include "BKE_constraint.h"
@@ -277,6 +278,14 @@ static void object_copy_data(Main *bmain, ID *id_dst, const ID *id_src, const in
   }
 }
 
+static void object_free_bvh_cache_retained(Object *ob)
+{
+  if (ob->runtime.bvh_cache_retained != NULL) {
+    bvhcache_free(ob->runtime.bvh_cache_retained);
+    ob->runtime.bvh_cache_retained = NULL;
+  }
+}
+
 static void object_free_data(ID *id)
 {
   Object *ob = (Object *)id;
@@ -286,6 +295,8 @@ static void object_free_data(ID *id)
   /* BKE_<id>_free shall never touch to ID->us. Never ever. */
   BKE_object_free_modifiers(ob, LIB_ID_CREATE_NO_USER_REFCOUNT);
   BKE_object_free_shaderfx(ob, LIB_ID_CREATE_NO_USER_REFCOUNT);
+  /* Freeing the derived caches above moved the trees of the evaluated mesh here. */
+  object_free_bvh_cache_retained(ob);
 
   MEM_SAFE_FREE(ob->mat);
   MEM_SAFE_FREE(ob->matbits);
@@ -893,6 +904,8 @@ void BKE_object_eval_assign_data(Object *object_eval, ID *data_eval, bool is_own
 
 /**
  * Free data derived from mesh, called when mesh changes or is freed.
+ * The BVH trees of an owned evaluated mesh are kept for the next evaluation, they are only freed
+ * with the object or by #BKE_object_free_caches.
  */
 void BKE_object_free_derived_caches(Object *ob)
 {
@@ -904,6 +917,13 @@ void BKE_object_free_derived_caches(Object *ob)
     if (ob->runtime.is_data_eval_owned) {
       ID *data_eval = ob->runtime.data_eval;
       if (GS(data_eval->name) == ID_ME) {
+        struct BVHCache *bvh_cache = bvhcache_release((Mesh *)data_eval);
+        if (bvh_cache != NULL) {
+          if (ob->runtime.bvh_cache_retained != NULL) {
+            bvhcache_free(ob->runtime.bvh_cache_retained);
+          }
+          ob->runtime.bvh_cache_retained = bvh_cache;
+        }
         BKE_mesh_eval_delete((Mesh *)data_eval);
       }
       else {
@@ -972,6 +992,7 @@ void BKE_object_free_caches(Object *object)
    */
   if ((object->base_flag & BASE_FROM_DUPLI) == 0) {
     BKE_object_free_derived_caches(object);
+    object_free_bvh_cache_retained(object);
     update_flag |= ID_RECALC_GEOMETRY;
   }
 
@@ -3044,7 +3065,11 @@ void BKE_object_boundbox_calc_from_mesh(struct Object *ob, struct Mesh *me_eval)
 
   INIT_MINMAX(min, max);
 
-  if (!BKE_mesh_wrapper_minmax(me_eval, min, max)) {
+  if (ob->runtime.use_modifier_bounds) {
+    copy_v3_v3(min, ob->runtime.modifier_bounds[0]);
+    copy_v3_v3(max, ob->runtime.modifier_bounds[1]);
+  }
+  else if (!BKE_mesh_wrapper_minmax(me_eval, min, max)) {
     zero_v3(min);
     zero_v3(max);
   }
@@ -4176,7 +4201,7 @@ int BKE_object_is_deform_modified(Scene *scene, Object *ob)
        md && (flag != (eModifierMode_Render | eModifierMode_Realtime));
        md = md->next) {
     const ModifierTypeInfo *mti = BKE_modifier_get_info(md->type);
-    bool can_deform = mti->type == eModifierTypeType_OnlyDeform || is_modifier_animated;
+    bool can_deform = BKE_modifier_is_deform_only(md) || is_modifier_animated;
 
     if (!can_deform) {
       can_deform = constructive_modifier_is_deform_modified(md);
@@ -4252,6 +4277,7 @@ void BKE_object_runtime_reset_on_copy(Object *object, const int UNUSED(flag))
   runtime->data_eval = NULL;
   runtime->mesh_deform_eval = NULL;
   runtime->curve_cache = NULL;
+  runtime->bvh_cache_retained = NULL;
 }
 
 /**
@@ -1494,7 +1494,6 @@ static bool sculpt_modifiers_active(Scene *scene, Sculpt *sd, Object *ob)
 
   /* exception for shape keys because we can edit those */
   for (; md; md = md->next) {
-    const ModifierTypeInfo *mti = BKE_modifier_get_info(md->type);
     if (!BKE_modifier_is_enabled(scene, md, eModifierMode_Realtime)) {
       continue;
     }
@@ -1508,7 +1507,7 @@ static bool sculpt_modifiers_active(Scene *scene, Sculpt *sd, Object *ob)
       continue;
     }
 
-    if (mti->type == eModifierTypeType_OnlyDeform) {
+    if (BKE_modifier_is_deform_only(md)) {
       return true;
     }
     if ((sd->flags & SCULPT_ONLY_DEFORM) == 0) {
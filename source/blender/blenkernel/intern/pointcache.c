@@ -45,6 +45,7 @@
 
 #include "BLI_blenlib.h"
 #include "BLI_math.h"
+#include "BLI_mmap.h"
 #include "BLI_string.h"
 #include "BLI_utildefines.h"
 
@@ -69,6 +70,8 @@
 
 #include "BIK_api.h"
 
+#include "pointcache_blocks.h"
+
 #ifdef WITH_BULLET
 #  include "RBI_api.h"
 #endif
@@ -85,6 +88,12 @@
 
 #define LZO_OUT_LEN(size) ((size) + (size) / 16 + 64 + 3)
 
+/* Identifiers at the start of cache files. Files with data arrays in blocks (see
+ * #PTCACHE_TYPEFLAG_BLOCKS) use a new one, so that older versions reject them instead of reading
+ * the arrays per point. */
+#define PTCACHE_FILE_ID "BPHYSICS"
+#define PTCACHE_FILE_ID_BLOCKS "BPHYSIC2"
+
 #ifdef WITH_LZMA
 #  include "LzmaLib.h"
 #endif
@@ -1607,6 +1616,7 @@ static int ptcache_file_write(PTCacheFile *pf, const void *f, unsigned int tot,
 {
   return (fwrite(f, size, tot, pf->fp) == tot);
 }
+
 static int ptcache_file_data_read(PTCacheFile *pf)
 {
   int i;
@@ -1620,24 +1630,12 @@ static int ptcache_file_data_read(PTCacheFile *pf)
 
   return 1;
 }
-static int ptcache_file_data_write(PTCacheFile *pf)
-{
-  int i;
-
-  for (i = 0; i < BPHYS_TOT_DATA; i++) {
-    if ((pf->data_types & (1 << i)) &&
-        !ptcache_file_write(pf, pf->cur[i], 1, ptcache_data_size[i])) {
-      return 0;
-    }
-  }
-
-  return 1;
-}
 static int ptcache_file_header_begin_read(PTCacheFile *pf)
 {
   unsigned int typeflag = 0;
   int error = 0;
   char bphysics[8];
+  bool is_blocks_version = false;
 
   pf->data_types = 0;
 
@@ -1645,8 +1643,11 @@ static int ptcache_file_header_begin_read(PTCacheFile *pf)
     error = 1;
   }
 
-  if (!error && !STREQLEN(bphysics, "BPHYSICS", 8)) {
-    error = 1;
+  if (!error) {
+    is_blocks_version = STREQLEN(bphysics, PTCACHE_FILE_ID_BLOCKS, 8);
+    if (!is_blocks_version && !STREQLEN(bphysics, PTCACHE_FILE_ID, 8)) {
+      error = 1;
+    }
   }
 
   if (!error && !fread(&typeflag, sizeof(unsigned int), 1, pf->fp)) {
@@ -1656,6 +1657,11 @@ static int ptcache_file_header_begin_read(PTCacheFile *pf)
   pf->type = (typeflag & PTCACHE_TYPEFLAG_TYPEMASK);
   pf->flag = (typeflag & PTCACHE_TYPEFLAG_FLAGMASK);
 
+  /* The identifier is the version, the flag alone would be ignored by older readers. */
+  if (is_blocks_version != ((pf->flag & PTCACHE_TYPEFLAG_BLOCKS) != 0)) {
+    error = 1;
+  }
+
   /* if there was an error set file as it was */
   if (error) {
     BLI_fseek(pf->fp, 0, SEEK_SET);
@@ -1665,7 +1671,8 @@ static int ptcache_file_header_begin_read(PTCacheFile *pf)
 }
 static int ptcache_file_header_begin_write(PTCacheFile *pf)
 {
-  const char *bphysics = "BPHYSICS";
+  const char *bphysics = (pf->flag & PTCACHE_TYPEFLAG_BLOCKS) ? PTCACHE_FILE_ID_BLOCKS :
+                                                                PTCACHE_FILE_ID;
   unsigned int typeflag = pf->type + pf->flag;
 
   if (fwrite(bphysics, sizeof(char), 8, pf->fp) != 8) {
@@ -1909,6 +1916,7 @@ static PTCacheMem *ptcache_disk_frame_to_mem(PTCacheID *pid, int cfra)
 {
   PTCacheFile *pf = ptcache_file_open(pid, PTCACHE_FILE_READ, cfra);
   PTCacheMem *pm = NULL;
+  BLI_mmap_file *mmap_file = NULL;
   unsigned int i, error = 0;
 
   if (pf == NULL) {
@@ -1923,6 +1931,11 @@ static PTCacheMem *ptcache_disk_frame_to_mem(PTCacheID *pid, int cfra)
     error = 1;
   }
 
+  if (!error && (pf->flag & PTCACHE_TYPEFLAG_BLOCKS)) {
+    /* Playback reads data directly from the mapping, which is optional. */
+    mmap_file = BLI_mmap_open(fileno(pf->fp));
+  }
+
   if (!error) {
     pm = MEM_callocN(sizeof(PTCacheMem), "Pointcache mem");
 
@@ -1932,7 +1945,17 @@ static PTCacheMem *ptcache_disk_frame_to_mem(PTCacheID *pid, int cfra)
 
     ptcache_data_alloc(pm);
 
-    if (pf->flag & PTCACHE_TYPEFLAG_COMPRESS) {
+    if (pf->flag & PTCACHE_TYPEFLAG_BLOCKS) {
+      for (i = 0; i < BPHYS_TOT_DATA; i++) {
+        if ((pf->data_types & (1 << i)) &&
+            !ptcache_blocks_read(
+                pf->fp, mmap_file, pm->data[i], (size_t)pm->totpoint * ptcache_data_size[i])) {
+          error = 1;
+          break;
+        }
+      }
+    }
+    else if (pf->flag & PTCACHE_TYPEFLAG_COMPRESS) {
       for (i = 0; i < BPHYS_TOT_DATA; i++) {
         unsigned int out_len = pm->totpoint * ptcache_data_size[i];
         if (pf->data_types & (1 << i)) {
@@ -1968,7 +1991,18 @@ static PTCacheMem *ptcache_disk_frame_to_mem(PTCacheID *pid, int cfra)
       extra->data = MEM_callocN(extra->totdata * ptcache_extra_datasize[extra->type],
                                 "Pointcache extradata->data");
 
-      if (pf->flag & PTCACHE_TYPEFLAG_COMPRESS) {
+      BLI_addtail(&pm->extradata, extra);
+
+      if (pf->flag & PTCACHE_TYPEFLAG_BLOCKS) {
+        if (!ptcache_blocks_read(pf->fp,
+                                 mmap_file,
+                                 extra->data,
+                                 (size_t)extra->totdata * ptcache_extra_datasize[extra->type])) {
+          error = 1;
+          break;
+        }
+      }
+      else if (pf->flag & PTCACHE_TYPEFLAG_COMPRESS) {
         ptcache_file_compressed_read(pf,
                                      (unsigned char *)(extra->data),
                                      extra->totdata * ptcache_extra_datasize[extra->type]);
@@ -1976,11 +2010,13 @@ static PTCacheMem *ptcache_disk_frame_to_mem(PTCacheID *pid, int cfra)
       else {
         ptcache_file_read(pf, extra->data, extra->totdata, ptcache_extra_datasize[extra->type]);
       }
-
-      BLI_addtail(&pm->extradata, extra);
     }
   }
 
+  if (mmap_file != NULL) {
+    BLI_mmap_free(mmap_file);
+  }
+
   if (error && pm) {
     ptcache_mem_clear(pm);
     MEM_freeN(pm);
@@ -2024,34 +2060,20 @@ static int ptcache_mem_frame_to_disk(PTCacheID *pid, PTCacheMem *pm)
     pf->flag |= PTCACHE_TYPEFLAG_COMPRESS;
   }
 
+  pf->flag |= PTCACHE_TYPEFLAG_BLOCKS;
+
   if (!ptcache_file_header_begin_write(pf) || !pid->write_header(pf)) {
     error = 1;
   }
 
   if (!error) {
-    if (pid->cache->compression) {
-      for (i = 0; i < BPHYS_TOT_DATA; i++) {
-        if (pm->data[i]) {
-          unsigned int in_len = pm->totpoint * ptcache_data_size[i];
-          unsigned char *out = (unsigned char *)MEM_callocN(LZO_OUT_LEN(in_len) * 4,
-                                                            "pointcache_lzo_buffer");
-          ptcache_file_compressed_write(
-              pf, (unsigned char *)(pm->data[i]), in_len, out, pid->cache->compression);
-          MEM_freeN(out);
-        }
-      }
-    }
-    else {
-      BKE_ptcache_mem_pointers_init(pm);
-      ptcache_file_pointers_init(pf);
-
-      for (i = 0; i < pm->totpoint; i++) {
-        ptcache_data_copy(pm->cur, pf->cur);
-        if (!ptcache_file_data_write(pf)) {
-          error = 1;
-          break;
-        }
-        BKE_ptcache_mem_pointers_incr(pm);
+    for (i = 0; i < BPHYS_TOT_DATA; i++) {
+      if (pm->data[i] && !ptcache_blocks_write(pf->fp,
+                                               pm->data[i],
+                                               (size_t)pm->totpoint * ptcache_data_size[i],
+                                               pid->cache->compression)) {
+        error = 1;
+        break;
       }
     }
   }
@@ -2067,16 +2089,12 @@ static int ptcache_mem_frame_to_disk(PTCacheID *pid, PTCacheMem *pm)
       ptcache_file_write(pf, &extra->type, 1, sizeof(unsigned int));
       ptcache_file_write(pf, &extra->totdata, 1, sizeof(unsigned int));
 
-      if (pid->cache->compression) {
-        unsigned int in_len = extra->totdata * ptcache_extra_datasize[extra->type];
-        unsigned char *out = (unsigned char *)MEM_callocN(LZO_OUT_LEN(in_len) * 4,
-                                                          "pointcache_lzo_buffer");
-        ptcache_file_compressed_write(
-            pf, (unsigned char *)(extra->data), in_len, out, pid->cache->compression);
-        MEM_freeN(out);
-      }
-      else {
-        ptcache_file_write(pf, extra->data, extra->totdata, ptcache_extra_datasize[extra->type]);
+      if (!ptcache_blocks_write(pf->fp,
+                                extra->data,
+                                (size_t)extra->totdata * ptcache_extra_datasize[extra->type],
+                                pid->cache->compression)) {
+        error = 1;
+        break;
       }
     }
   }
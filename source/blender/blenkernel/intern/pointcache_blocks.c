@@ -0,0 +1,303 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup bke
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "atomic_ops.h"
+
+#include "BLI_fileops.h"
+#include "BLI_mmap.h"
+#include "BLI_task.h"
+#include "BLI_utildefines.h"
+
+#include "pointcache_blocks.h"
+
+#ifdef WITH_LZO
+#  ifdef WITH_SYSTEM_LZO
+#    include <lzo/lzo1x.h>
+#  else
+#    include "minilzo.h"
+#  endif
+#  define LZO_HEAP_ALLOC(var, size) \
+    lzo_align_t __LZO_MMODEL var[((size) + (sizeof(lzo_align_t) - 1)) / sizeof(lzo_align_t)]
+#endif
+
+#define LZO_OUT_LEN(size) ((size) + (size) / 16 + 64 + 3)
+
+#ifdef WITH_LZMA
+#  include "LzmaLib.h"
+#endif
+
+typedef struct PTCacheBlock {
+  /* Zero when the block is stored uncompressed, otherwise #PointCache.compression. */
+  unsigned int compression;
+  /* Size of the block in the file. */
+  unsigned int size;
+} PTCacheBlock;
+
+typedef struct PTCacheBlocksData {
+  /* Uncompressed data array. */
+  unsigned char *data;
+  size_t data_len;
+  PTCacheBlock *blocks;
+  /* Compressed data of every block, NULL for blocks that are stored uncompressed. */
+  unsigned char **blocks_data;
+  /* When reading, the data of all blocks, with #block_offsets. */
+  const unsigned char *src;
+  const size_t *block_offsets;
+  int compression;
+  unsigned int errors_num;
+} PTCacheBlocksData;
+
+static size_t ptcache_blocks_num(const size_t data_len)
+{
+  return (data_len + PTCACHE_BLOCK_SIZE - 1) / PTCACHE_BLOCK_SIZE;
+}
+
+static void ptcache_block_compress_cb(void *__restrict userdata,
+                                      const int index,
+                                      const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  PTCacheBlocksData *data = userdata;
+  const size_t offset = (size_t)index * PTCACHE_BLOCK_SIZE;
+  const unsigned char *in = data->data + offset;
+  const size_t in_len = MIN2(PTCACHE_BLOCK_SIZE, data->data_len - offset);
+  unsigned char *out = MEM_mallocN(LZO_OUT_LEN(in_len), "pointcache_block_buffer");
+  size_t out_len = 0;
+  bool compressed = false;
+
+  (void)in; /* unused when building w/o compression */
+
+#ifdef WITH_LZO
+  if (data->compression == 1) {
+    LZO_HEAP_ALLOC(wrkmem, LZO1X_MEM_COMPRESS);
+    lzo_uint lzo_out_len = 0;
+
+    const int r = lzo1x_1_compress(in, (lzo_uint)in_len, out, &lzo_out_len, wrkmem);
+    out_len = (size_t)lzo_out_len;
+    compressed = (r == LZO_E_OK) && (out_len < in_len);
+  }
+#endif
+#ifdef WITH_LZMA
+  if (data->compression == 2) {
+    /* Properties are stored in front of the compressed data. Blocks are compressed in parallel
+     * already, so use a single thread and a dictionary that fits a block. */
+    size_t props_len = LZMA_PROPS_SIZE;
+    out_len = in_len - MIN2(in_len, LZMA_PROPS_SIZE);
+
+    const int r = LzmaCompress(out + LZMA_PROPS_SIZE,
+                               &out_len,
+                               in,
+                               in_len,
+                               out,
+                               &props_len,
+                               5,
+                               PTCACHE_BLOCK_SIZE,
+                               3,
+                               0,
+                               2,
+                               32,
+                               1);
+    out_len += LZMA_PROPS_SIZE;
+    compressed = (r == SZ_OK) && (props_len == LZMA_PROPS_SIZE) && (out_len < in_len);
+  }
+#endif
+
+  if (compressed) {
+    data->blocks[index].compression = (unsigned int)data->compression;
+    data->blocks[index].size = (unsigned int)out_len;
+    data->blocks_data[index] = out;
+  }
+  else {
+    data->blocks[index].compression = 0;
+    data->blocks[index].size = (unsigned int)in_len;
+    data->blocks_data[index] = NULL;
+    MEM_freeN(out);
+  }
+}
+
+bool ptcache_blocks_write(FILE *fp, const void *data_array, size_t len, int compression)
+{
+  const size_t blocks_num = ptcache_blocks_num(len);
+  const unsigned int blocks_num_stored = (unsigned int)blocks_num;
+  if ((size_t)blocks_num_stored != blocks_num) {
+    return false;
+  }
+
+  PTCacheBlocksData data = {
+      .data = (unsigned char *)data_array,
+      .data_len = len,
+      .blocks = MEM_calloc_arrayN(MAX2(blocks_num, 1), sizeof(PTCacheBlock), __func__),
+      .blocks_data = MEM_calloc_arrayN(MAX2(blocks_num, 1), sizeof(unsigned char *), __func__),
+      .compression = compression,
+  };
+
+  if (compression) {
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.min_iter_per_thread = 1;
+    BLI_task_parallel_range(0, (int)blocks_num, &data, ptcache_block_compress_cb, &settings);
+  }
+  else {
+    for (size_t i = 0; i < blocks_num; i++) {
+      data.blocks[i].size = (unsigned int)MIN2(PTCACHE_BLOCK_SIZE, len - i * PTCACHE_BLOCK_SIZE);
+    }
+  }
+
+  bool ok = (fwrite(&blocks_num_stored, sizeof(unsigned int), 1, fp) == 1) &&
+            (fwrite(data.blocks, sizeof(PTCacheBlock), blocks_num, fp) == blocks_num);
+
+  if (compression) {
+    for (size_t i = 0; i < blocks_num && ok; i++) {
+      const unsigned char *block_data = data.blocks_data[i] ?
+                                            data.blocks_data[i] :
+                                            data.data + i * PTCACHE_BLOCK_SIZE;
+      ok = (fwrite(block_data, 1, data.blocks[i].size, fp) == data.blocks[i].size);
+    }
+  }
+  else if (ok) {
+    /* Uncompressed blocks follow each other in memory too. */
+    ok = (fwrite(data_array, 1, len, fp) == len);
+  }
+
+  for (size_t i = 0; i < blocks_num; i++) {
+    MEM_SAFE_FREE(data.blocks_data[i]);
+  }
+  MEM_freeN(data.blocks_data);
+  MEM_freeN(data.blocks);
+
+  return ok;
+}
+
+static void ptcache_block_decompress_cb(void *__restrict userdata,
+                                        const int index,
+                                        const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  PTCacheBlocksData *data = userdata;
+  const size_t offset = (size_t)index * PTCACHE_BLOCK_SIZE;
+  unsigned char *out = data->data + offset;
+  const size_t out_len = MIN2(PTCACHE_BLOCK_SIZE, data->data_len - offset);
+  const unsigned char *in = data->src + data->block_offsets[index];
+  const size_t in_len = data->blocks[index].size;
+  bool success = false;
+
+  switch (data->blocks[index].compression) {
+    case 0:
+      if (in_len == out_len) {
+        memcpy(out, in, out_len);
+        success = true;
+      }
+      break;
+#ifdef WITH_LZO
+    case 1: {
+      lzo_uint lzo_out_len = (lzo_uint)out_len;
+      const int r = lzo1x_decompress_safe(in, (lzo_uint)in_len, out, &lzo_out_len, NULL);
+      success = (r == LZO_E_OK) && (lzo_out_len == out_len);
+      break;
+    }
+#endif
+#ifdef WITH_LZMA
+    case 2: {
+      if (in_len > LZMA_PROPS_SIZE) {
+        size_t leni = in_len - LZMA_PROPS_SIZE, leno = out_len;
+        const int r = LzmaUncompress(out, &leno, in + LZMA_PROPS_SIZE, &leni, in, LZMA_PROPS_SIZE);
+        success = (r == SZ_OK) && (leno == out_len);
+      }
+      break;
+    }
+#endif
+  }
+
+  if (!success) {
+    atomic_add_and_fetch_uint32(&data->errors_num, 1);
+  }
+}
+
+bool ptcache_blocks_read(FILE *fp, BLI_mmap_file *mmap_file, void *result, size_t len)
+{
+  const size_t blocks_num = ptcache_blocks_num(len);
+  unsigned int blocks_num_stored = 0;
+  if (fread(&blocks_num_stored, sizeof(unsigned int), 1, fp) != 1 ||
+      (size_t)blocks_num_stored != blocks_num) {
+    return false;
+  }
+
+  PTCacheBlocksData data = {
+      .data = result,
+      .data_len = len,
+      .blocks = MEM_malloc_arrayN(MAX2(blocks_num, 1), sizeof(PTCacheBlock), __func__),
+  };
+  if (fread(data.blocks, sizeof(PTCacheBlock), blocks_num, fp) != blocks_num) {
+    MEM_freeN(data.blocks);
+    return false;
+  }
+
+  size_t *block_offsets = MEM_malloc_arrayN(blocks_num + 1, sizeof(size_t), __func__);
+  block_offsets[0] = 0;
+  for (size_t i = 0; i < blocks_num; i++) {
+    /* Also keeps a damaged table from requesting huge buffers. */
+    if (data.blocks[i].size > LZO_OUT_LEN(PTCACHE_BLOCK_SIZE)) {
+      MEM_freeN(block_offsets);
+      MEM_freeN(data.blocks);
+      return false;
+    }
+    block_offsets[i + 1] = block_offsets[i] + data.blocks[i].size;
+  }
+  const size_t src_len = block_offsets[blocks_num];
+  unsigned char *src_buffer = NULL;
+  bool ok = true;
+
+  if (mmap_file != NULL) {
+    const int64_t offset = BLI_ftell(fp);
+    if (offset < 0 || (size_t)offset > BLI_mmap_get_length(mmap_file) ||
+        src_len > BLI_mmap_get_length(mmap_file) - (size_t)offset ||
+        BLI_fseek(fp, (int64_t)src_len, SEEK_CUR) != 0) {
+      ok = false;
+    }
+    else {
+      data.src = (const unsigned char *)BLI_mmap_get_pointer(mmap_file) + offset;
+    }
+  }
+  else {
+    src_buffer = MEM_mallocN(MAX2(src_len, 1), "pointcache_blocks_buffer");
+    ok = (fread(src_buffer, 1, src_len, fp) == src_len);
+    data.src = src_buffer;
+  }
+
+  if (ok) {
+    data.block_offsets = block_offsets;
+
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.min_iter_per_thread = 1;
+    BLI_task_parallel_range(0, (int)blocks_num, &data, ptcache_block_decompress_cb, &settings);
+
+    ok = (data.errors_num == 0) && !(mmap_file && BLI_mmap_any_io_error(mmap_file));
+  }
+
+  MEM_SAFE_FREE(src_buffer);
+  MEM_freeN(block_offsets);
+  MEM_freeN(data.blocks);
+
+  return ok;
+}
@@ -0,0 +1,58 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup bke
+ *
+ * Data arrays of disk point caches, written as a whole (not per point) in blocks of
+ * #PTCACHE_BLOCK_SIZE that are compressed and decompressed on multiple threads.
+ * Layout: the number of blocks, a #PTCacheBlock for every block, then the data of all blocks.
+ */
+
+#include <stdio.h>
+
+#include "BLI_sys_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct BLI_mmap_file;
+
+/* Uncompressed size of the blocks of data arrays, which are compressed independently. */
+#define PTCACHE_BLOCK_SIZE (1 << 20)
+
+/**
+ * Write \a len bytes of \a data_array at the current position of \a fp.
+ *
+ * \param compression: #PointCache.compression, blocks that don't get smaller are stored as is.
+ */
+bool ptcache_blocks_write(FILE *fp, const void *data_array, size_t len, int compression);
+
+/**
+ * Read a data array written by #ptcache_blocks_write into \a result, which has \a len bytes.
+ *
+ * \param mmap_file: Mapping of the file, when available the blocks are decompressed (or copied)
+ * directly from it, so reading the file happens on multiple threads as well. Otherwise they are
+ * read with `fread` first.
+ */
+bool ptcache_blocks_read(FILE *fp, struct BLI_mmap_file *mmap_file, void *result, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
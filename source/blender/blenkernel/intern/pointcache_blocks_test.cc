@@ -0,0 +1,143 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <string>
+#include <vector>
+
+#ifndef WIN32
+#  include <unistd.h>
+#endif
+
+#include "BLI_fileops.h"
+#include "BLI_mmap.h"
+#include "BLI_rand.hh"
+
+#include "pointcache_blocks.h"
+
+namespace blender::bke::tests {
+
+class PointCacheBlocksTest : public testing::Test {
+ protected:
+  std::string filepath;
+
+  void SetUp() override
+  {
+    filepath = testing::TempDir() + "blender_pointcache_blocks_test.bphys";
+  }
+
+  void TearDown() override
+  {
+    BLI_delete(filepath.c_str(), false, false);
+  }
+
+  /* Data that compresses well in the first half and not at all in the second. */
+  static std::vector<char> data_new(const size_t len)
+  {
+    std::vector<char> data(len);
+    RandomNumberGenerator rng(len);
+    for (size_t i = 0; i < len; i++) {
+      data[i] = (i < len / 2) ? (char)(i / 64) : (char)rng.get_int32();
+    }
+    return data;
+  }
+
+  /* Write the array, followed by a marker to check where reading stops. */
+  void write(const std::vector<char> &data, const int compression)
+  {
+    FILE *fp = BLI_fopen(filepath.c_str(), "wb");
+    ASSERT_NE(fp, nullptr);
+    EXPECT_TRUE(ptcache_blocks_write(fp, data.data(), data.size(), compression));
+    const unsigned int marker = 0xC0FFEE;
+    EXPECT_EQ(fwrite(&marker, sizeof(marker), 1, fp), 1);
+    fclose(fp);
+  }
+
+  bool read(std::vector<char> &result, const bool use_mmap)
+  {
+    FILE *fp = BLI_fopen(filepath.c_str(), "rb");
+    EXPECT_NE(fp, nullptr);
+    BLI_mmap_file *mmap_file = use_mmap ? BLI_mmap_open(fileno(fp)) : nullptr;
+    if (use_mmap) {
+      EXPECT_NE(mmap_file, nullptr);
+    }
+
+    const bool ok = ptcache_blocks_read(fp, mmap_file, result.data(), result.size());
+    if (ok) {
+      unsigned int marker = 0;
+      EXPECT_EQ(fread(&marker, sizeof(marker), 1, fp), 1);
+      EXPECT_EQ(marker, 0xC0FFEE);
+    }
+
+    if (mmap_file != nullptr) {
+      BLI_mmap_free(mmap_file);
+    }
+    fclose(fp);
+    return ok;
+  }
+
+  void truncate_file(const size_t len)
+  {
+#ifndef WIN32
+    ASSERT_EQ(truncate(filepath.c_str(), (off_t)len), 0);
+#else
+    UNUSED_VARS(len);
+#endif
+  }
+};
+
+TEST_F(PointCacheBlocksTest, RoundTrip)
+{
+  const size_t lengths[] = {0, 17, PTCACHE_BLOCK_SIZE, PTCACHE_BLOCK_SIZE * 5 / 2};
+  for (const size_t len : lengths) {
+    const std::vector<char> data = data_new(len);
+    /* Compression types without support in this build store all blocks uncompressed. */
+    for (const int compression : {0, 1, 2}) {
+      write(data, compression);
+      /* Mapped reading, and the fallback when mapping is not available. */
+      for (const bool use_mmap : {true, false}) {
+        if (len == 0 && use_mmap) {
+          continue;
+        }
+        std::vector<char> result(len, 0);
+        EXPECT_TRUE(read(result, use_mmap));
+        EXPECT_EQ(result, data);
+      }
+    }
+  }
+}
+
+TEST_F(PointCacheBlocksTest, WrongLength)
+{
+  write(data_new(PTCACHE_BLOCK_SIZE * 2), 1);
+  std::vector<char> result(PTCACHE_BLOCK_SIZE * 3);
+  EXPECT_FALSE(read(result, true));
+  EXPECT_FALSE(read(result, false));
+}
+
+#ifndef WIN32
+TEST_F(PointCacheBlocksTest, TruncatedTable)
+{
+  const std::vector<char> data = data_new(PTCACHE_BLOCK_SIZE * 3);
+  write(data, 1);
+  /* Block count and a part of the table of block sizes. */
+  truncate_file(sizeof(unsigned int) * 3);
+  std::vector<char> result(data.size());
+  EXPECT_FALSE(read(result, true));
+  EXPECT_FALSE(read(result, false));
+}
+
+TEST_F(PointCacheBlocksTest, TruncatedData)
+{
+  const std::vector<char> data = data_new(PTCACHE_BLOCK_SIZE * 3);
+  for (const int compression : {0, 1, 2}) {
+    write(data, compression);
+    truncate_file(PTCACHE_BLOCK_SIZE);
+    std::vector<char> result(data.size());
+    EXPECT_FALSE(read(result, true));
+    EXPECT_FALSE(read(result, false));
+  }
+}
+#endif
+
+}  // namespace blender::bke::tests
@@ -330,7 +330,7 @@ static PointCloud *pointcloud_evaluate_modifiers(struct Depsgraph *depsgraph,
       continue;
     }
 
-    if ((mti->type == eModifierTypeType_OnlyDeform) &&
+    if (BKE_modifier_is_deform_only(md) &&
         (mti->flags & eModifierTypeFlag_AcceptsVertexCosOnly)) {
       /* Ensure we are not modifying the input. */
       if (pointcloud == pointcloud_input) {
@@ -99,6 +99,9 @@ typedef struct ShrinkwrapCalcCBData {
 
   float *proj_axis;
   SpaceTransform *local2aux;
+
+  /* Normal projection only. */
+  struct ShrinkwrapProjectRays *rays;
 } ShrinkwrapCalcCBData;
 
 /* Checks if the modifier needs target normals with these settings. */
@@ -434,6 +437,66 @@ static void shrinkwrap_calc_nearest_vertex(ShrinkwrapCalcData *calc)
       0, calc->numVerts, &data, shrinkwrap_calc_nearest_vertex_cb_ex, &settings);
 }
 
+/* don't use this because this dist value could be incompatible
+ * this value used by the callback for comparing previous/new dist values.
+ * also, at the moment there is no need to have a corrected 'dist' value */
+// #define USE_DIST_CORRECT
+
+/* Ray of #BKE_shrinkwrap_project_normal in target space. */
+static void shrinkwrap_project_normal_ray(const float vert[3],
+                                          const float dir[3],
+                                          const SpaceTransform *transf,
+                                          float r_co[3],
+                                          float r_no[3])
+{
+  copy_v3_v3(r_co, vert);
+  copy_v3_v3(r_no, dir);
+
+  /* Apply space transform (TODO readjust dist) */
+  if (transf) {
+    BLI_space_transform_apply(transf, r_co);
+    BLI_space_transform_apply_normal(transf, r_no);
+  }
+}
+
+/**
+ * Second half of #BKE_shrinkwrap_project_normal, \a hit_tmp is the result of the ray-cast in
+ * target space. Returns true if it's a valid hit, which is then copied to \a hit.
+ */
+static bool shrinkwrap_project_normal_apply_hit(char options,
+                                                const float dir[3],
+                                                const SpaceTransform *transf,
+                                                BVHTreeRayHit *hit_tmp,
+                                                BVHTreeRayHit *hit)
+{
+  if (hit_tmp->index != -1) {
+    /* invert the normal first so face culling works on rotated objects */
+    if (transf) {
+      BLI_space_transform_invert_normal(transf, hit_tmp->no);
+    }
+
+    if (options & MOD_SHRINKWRAP_CULL_TARGET_MASK) {
+      /* apply backface */
+      const float dot = dot_v3v3(dir, hit_tmp->no);
+      if (((options & MOD_SHRINKWRAP_CULL_TARGET_FRONTFACE) && dot <= 0.0f) ||
+          ((options & MOD_SHRINKWRAP_CULL_TARGET_BACKFACE) && dot >= 0.0f)) {
+        return false; /* Ignore hit */
+      }
+    }
+
+    if (transf) {
+      /* Inverting space transform (TODO make coeherent with the initial dist readjust) */
+      BLI_space_transform_invert(transf, hit_tmp->co);
+    }
+
+    BLI_assert(hit_tmp->dist <= hit->dist);
+
+    memcpy(hit, hit_tmp, sizeof(*hit_tmp));
+    return true;
+  }
+  return false;
+}
+
 /*
  * This function raycast a single vertex and updates the hit if the "hit" is considered valid.
  * Returns true if "hit" was updated.
@@ -450,158 +513,187 @@ bool BKE_shrinkwrap_project_normal(char options,
                                    ShrinkwrapTreeData *tree,
                                    BVHTreeRayHit *hit)
 {
-  /* don't use this because this dist value could be incompatible
-   * this value used by the callback for comparing previous/new dist values.
-   * also, at the moment there is no need to have a corrected 'dist' value */
-  // #define USE_DIST_CORRECT
-
-  float tmp_co[3], tmp_no[3];
-  const float *co, *no;
+  float co[3], no[3];
   BVHTreeRayHit hit_tmp;
 
   /* Copy from hit (we need to convert hit rays from one space coordinates to the other */
   memcpy(&hit_tmp, hit, sizeof(hit_tmp));
 
-  /* Apply space transform (TODO readjust dist) */
-  if (transf) {
-    copy_v3_v3(tmp_co, vert);
-    BLI_space_transform_apply(transf, tmp_co);
-    co = tmp_co;
-
-    copy_v3_v3(tmp_no, dir);
-    BLI_space_transform_apply_normal(transf, tmp_no);
-    no = tmp_no;
+  shrinkwrap_project_normal_ray(vert, dir, transf, co, no);
 
 #ifdef USE_DIST_CORRECT
+  if (transf) {
     hit_tmp.dist *= mat4_to_scale(((SpaceTransform *)transf)->local2target);
-#endif
-  }
-  else {
-    co = vert;
-    no = dir;
   }
+#endif
 
   hit_tmp.index = -1;
 
   BLI_bvhtree_ray_cast(
       tree->bvh, co, no, ray_radius, &hit_tmp, tree->treeData.raycast_callback, &tree->treeData);
 
-  if (hit_tmp.index != -1) {
-    /* invert the normal first so face culling works on rotated objects */
-    if (transf) {
-      BLI_space_transform_invert_normal(transf, hit_tmp.no);
-    }
-
-    if (options & MOD_SHRINKWRAP_CULL_TARGET_MASK) {
-      /* apply backface */
-      const float dot = dot_v3v3(dir, hit_tmp.no);
-      if (((options & MOD_SHRINKWRAP_CULL_TARGET_FRONTFACE) && dot <= 0.0f) ||
-          ((options & MOD_SHRINKWRAP_CULL_TARGET_BACKFACE) && dot >= 0.0f)) {
-        return false; /* Ignore hit */
-      }
-    }
+  if (!shrinkwrap_project_normal_apply_hit(options, dir, transf, &hit_tmp, hit)) {
+    return false;
+  }
 
-    if (transf) {
-      /* Inverting space transform (TODO make coeherent with the initial dist readjust) */
-      BLI_space_transform_invert(transf, hit_tmp.co);
 #ifdef USE_DIST_CORRECT
-      hit_tmp.dist = len_v3v3(vert, hit_tmp.co);
-#endif
-    }
-
-    BLI_assert(hit_tmp.dist <= hit->dist);
-
-    memcpy(hit, &hit_tmp, sizeof(hit_tmp));
-    return true;
+  if (transf) {
+    hit->dist = len_v3v3(vert, hit->co);
   }
-  return false;
+#endif
+  return true;
 }
 
-static void shrinkwrap_calc_normal_projection_cb_ex(void *__restrict userdata,
-                                                    const int i,
-                                                    const TaskParallelTLS *__restrict tls)
+/**
+ * Rays of the vertices projected by #shrinkwrap_calc_normal_projection, only vertices with a
+ * non-zero weight get a ray. All arrays are taken from a single allocation, see
+ * #shrinkwrap_project_rays_alloc.
+ */
+typedef struct ShrinkwrapProjectRays {
+  int len;
+  void *memory;
+  int *vert_index;
+  float *weight;
+  float (*co)[3];
+  float (*no)[3];
+  /** \note 'hit.dist' is kept in the targets space, this is only used
+   * for finding the best hit, to get the real dist,
+   * measure the len_v3v3() from the input coord to hit.co */
+  BVHTreeRayHit *hit;
+  bool *is_aux;
+
+  /* Scratch data of #shrinkwrap_project_normal_batch. */
+  float (*target_co)[3];
+  float (*target_no)[3];
+  BVHTreeRayHit *target_hit;
+  bool *is_hit;
+  /* Directions of the projection over the negative direction. */
+  float (*neg_no)[3];
+} ShrinkwrapProjectRays;
+
+static void *shrinkwrap_project_rays_take(char **memory, const size_t size)
 {
-  ShrinkwrapCalcCBData *data = userdata;
-
-  ShrinkwrapCalcData *calc = data->calc;
-  ShrinkwrapTreeData *tree = data->tree;
-  ShrinkwrapTreeData *aux_tree = data->aux_tree;
-
-  float *proj_axis = data->proj_axis;
-  SpaceTransform *local2aux = data->local2aux;
+  void *array = *memory;
+  *memory += size;
+  return array;
+}
 
-  BVHTreeRayHit *hit = tls->userdata_chunk;
+/* Allocate all arrays of \a rays for up to \a verts_num rays. */
+static void shrinkwrap_project_rays_alloc(ShrinkwrapProjectRays *rays, const int verts_num)
+{
+  const size_t len = (size_t)verts_num;
+  /* Larger elements first, so that all arrays are aligned. */
+  const size_t size = len * (sizeof(*rays->hit) + sizeof(*rays->target_hit) + sizeof(*rays->co) +
+                             sizeof(*rays->no) + sizeof(*rays->target_co) +
+                             sizeof(*rays->target_no) + sizeof(*rays->neg_no) +
+                             sizeof(*rays->weight) + sizeof(*rays->vert_index) +
+                             sizeof(*rays->is_aux) + sizeof(*rays->is_hit));
+  char *memory = MEM_mallocN(size, __func__);
+  rays->memory = memory;
+
+  rays->hit = shrinkwrap_project_rays_take(&memory, len * sizeof(*rays->hit));
+  rays->target_hit = shrinkwrap_project_rays_take(&memory, len * sizeof(*rays->target_hit));
+  rays->co = shrinkwrap_project_rays_take(&memory, len * sizeof(*rays->co));
+  rays->no = shrinkwrap_project_rays_take(&memory, len * sizeof(*rays->no));
+  rays->target_co = shrinkwrap_project_rays_take(&memory, len * sizeof(*rays->target_co));
+  rays->target_no = shrinkwrap_project_rays_take(&memory, len * sizeof(*rays->target_no));
+  rays->neg_no = shrinkwrap_project_rays_take(&memory, len * sizeof(*rays->neg_no));
+  rays->weight = shrinkwrap_project_rays_take(&memory, len * sizeof(*rays->weight));
+  rays->vert_index = shrinkwrap_project_rays_take(&memory, len * sizeof(*rays->vert_index));
+  rays->is_aux = shrinkwrap_project_rays_take(&memory, len * sizeof(*rays->is_aux));
+  rays->is_hit = shrinkwrap_project_rays_take(&memory, len * sizeof(*rays->is_hit));
+}
 
-  const float proj_limit_squared = calc->smd->projLimit * calc->smd->projLimit;
-  float *co = calc->vertexCos[i];
-  float tmp_co[3], tmp_no[3];
-  float weight = BKE_defvert_array_find_weight_safe(calc->dvert, i, calc->vgroup);
+typedef struct ShrinkwrapProjectBatchData {
+  ShrinkwrapProjectRays *rays;
+  char options;
+  const float (*no)[3];
+  const SpaceTransform *transf;
+} ShrinkwrapProjectBatchData;
+
+static void shrinkwrap_project_normal_batch_prepare_cb(void *__restrict userdata,
+                                                       const int i,
+                                                       const TaskParallelTLS *__restrict
+                                                           UNUSED(tls))
+{
+  ShrinkwrapProjectBatchData *data = userdata;
+  ShrinkwrapProjectRays *rays = data->rays;
 
-  if (calc->invert_vgroup) {
-    weight = 1.0f - weight;
-  }
+  shrinkwrap_project_normal_ray(
+      rays->co[i], data->no[i], data->transf, rays->target_co[i], rays->target_no[i]);
 
-  if (weight == 0.0f) {
-    return;
-  }
-
-  if (calc->vert != NULL && calc->smd->projAxis == MOD_SHRINKWRAP_PROJECT_OVER_NORMAL) {
-    /* calc->vert contains verts from evaluated mesh.  */
-    /* These coordinates are deformed by vertexCos only for normal projection
-     * (to get correct normals) for other cases calc->verts contains undeformed coordinates and
-     * vertexCos should be used */
-    copy_v3_v3(tmp_co, calc->vert[i].co);
-    normal_short_to_float_v3(tmp_no, calc->vert[i].no);
-  }
-  else {
-    copy_v3_v3(tmp_co, co);
-    copy_v3_v3(tmp_no, proj_axis);
-  }
+  memcpy(&rays->target_hit[i], &rays->hit[i], sizeof(rays->target_hit[i]));
+  rays->target_hit[i].index = -1;
+}
 
-  hit->index = -1;
+static void shrinkwrap_project_normal_batch_apply_cb(void *__restrict userdata,
+                                                     const int i,
+                                                     const TaskParallelTLS *__restrict
+                                                         UNUSED(tls))
+{
+  ShrinkwrapProjectBatchData *data = userdata;
+  ShrinkwrapProjectRays *rays = data->rays;
 
-  /* TODO: we should use FLT_MAX here, but sweepsphere code isn't prepared for that */
-  hit->dist = BVH_RAYCAST_DIST_MAX;
+  rays->is_hit[i] = shrinkwrap_project_normal_apply_hit(
+      data->options, data->no[i], data->transf, &rays->target_hit[i], &rays->hit[i]);
+}
 
-  bool is_aux = false;
+/**
+ * #BKE_shrinkwrap_project_normal for all \a rays along the directions \a no, with a single
+ * batched ray-cast. Sets #ShrinkwrapProjectRays.is_hit for the rays that got updated.
+ */
+static void shrinkwrap_project_normal_batch(char options,
+                                            ShrinkwrapProjectRays *rays,
+                                            const float (*no)[3],
+                                            const SpaceTransform *transf,
+                                            ShrinkwrapTreeData *tree)
+{
+  ShrinkwrapProjectBatchData data = {
+      .rays = rays,
+      .options = options,
+      .no = no,
+      .transf = transf,
+  };
 
-  /* Project over positive direction of axis */
-  if (calc->smd->shrinkOpts & MOD_SHRINKWRAP_PROJECT_ALLOW_POS_DIR) {
-    if (aux_tree) {
-      if (BKE_shrinkwrap_project_normal(0, tmp_co, tmp_no, 0.0, local2aux, aux_tree, hit)) {
-        is_aux = true;
-      }
-    }
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (rays->len > BKE_MESH_OMP_LIMIT);
 
-    if (BKE_shrinkwrap_project_normal(
-            calc->smd->shrinkOpts, tmp_co, tmp_no, 0.0, &calc->local2target, tree, hit)) {
-      is_aux = false;
-    }
-  }
+  BLI_task_parallel_range(
+      0, rays->len, &data, shrinkwrap_project_normal_batch_prepare_cb, &settings);
+
+  BLI_bvhtree_ray_cast_batch(tree->bvh,
+                             rays->target_co,
+                             rays->target_no,
+                             rays->len,
+                             0.0f,
+                             rays->target_hit,
+                             tree->treeData.raycast_callback,
+                             &tree->treeData,
+                             BVH_RAYCAST_DEFAULT);
 
-  /* Project over negative direction of axis */
-  if (calc->smd->shrinkOpts & MOD_SHRINKWRAP_PROJECT_ALLOW_NEG_DIR) {
-    float inv_no[3];
-    negate_v3_v3(inv_no, tmp_no);
+  BLI_task_parallel_range(
+      0, rays->len, &data, shrinkwrap_project_normal_batch_apply_cb, &settings);
+}
 
-    char options = calc->smd->shrinkOpts;
+static void shrinkwrap_calc_normal_projection_cb_ex(void *__restrict userdata,
+                                                    const int ray,
+                                                    const TaskParallelTLS *__restrict
+                                                        UNUSED(tls))
+{
+  ShrinkwrapCalcCBData *data = userdata;
 
-    if ((options & MOD_SHRINKWRAP_INVERT_CULL_TARGET) &&
-        (options & MOD_SHRINKWRAP_CULL_TARGET_MASK)) {
-      options ^= MOD_SHRINKWRAP_CULL_TARGET_MASK;
-    }
+  ShrinkwrapCalcData *calc = data->calc;
+  ShrinkwrapTreeData *tree = data->tree;
+  ShrinkwrapTreeData *aux_tree = data->aux_tree;
+  ShrinkwrapProjectRays *rays = data->rays;
 
-    if (aux_tree) {
-      if (BKE_shrinkwrap_project_normal(0, tmp_co, inv_no, 0.0, local2aux, aux_tree, hit)) {
-        is_aux = true;
-      }
-    }
+  SpaceTransform *local2aux = data->local2aux;
 
-    if (BKE_shrinkwrap_project_normal(
-            options, tmp_co, inv_no, 0.0, &calc->local2target, tree, hit)) {
-      is_aux = false;
-    }
-  }
+  const float proj_limit_squared = calc->smd->projLimit * calc->smd->projLimit;
+  float *co = calc->vertexCos[rays->vert_index[ray]];
+  const float *tmp_co = rays->co[ray];
+  BVHTreeRayHit *hit = &rays->hit[ray];
 
   /* don't set the initial dist (which is more efficient),
    * because its calculated in the targets space, we want the dist in our own space */
@@ -612,7 +704,7 @@ static void shrinkwrap_calc_normal_projection_cb_ex(void *__restrict userdata,
   }
 
   if (hit->index != -1) {
-    if (is_aux) {
+    if (rays->is_aux[ray]) {
       BKE_shrinkwrap_snap_point_to_surface(aux_tree,
                                            local2aux,
                                            calc->smd->shrinkMode,
@@ -635,7 +727,17 @@ static void shrinkwrap_calc_normal_projection_cb_ex(void *__restrict userdata,
                                            hit->co);
     }
 
-    interp_v3_v3v3(co, co, hit->co, weight);
+    interp_v3_v3v3(co, co, hit->co, rays->weight[ray]);
+  }
+}
+
+/* Update #ShrinkwrapProjectRays.is_aux after a projection on the auxiliary or main target. */
+static void shrinkwrap_project_rays_update_is_aux(ShrinkwrapProjectRays *rays, const bool is_aux)
+{
+  for (int i = 0; i < rays->len; i++) {
+    if (rays->is_hit[i]) {
+      rays->is_aux[i] = is_aux;
+    }
   }
 }
 
@@ -646,11 +748,6 @@ static void shrinkwrap_calc_normal_projection(ShrinkwrapCalcData *calc)
 
   /* Raycast and tree stuff */
 
-  /** \note 'hit.dist' is kept in the targets space, this is only used
-   * for finding the best hit, to get the real dist,
-   * measure the len_v3v3() from the input coord to hit.co */
-  BVHTreeRayHit hit;
-
   /* auxiliary target */
   Mesh *auxMesh = NULL;
   ShrinkwrapTreeData *aux_tree = NULL;
@@ -704,23 +801,97 @@ static void shrinkwrap_calc_normal_projection(ShrinkwrapCalcData *calc)
     aux_tree = &aux_tree_stack;
   }
 
-  /* After successfully build the trees, start projection vertices. */
+  /* After successfully build the trees, gather the rays of all vertices with a weight. */
+  ShrinkwrapProjectRays rays = {0};
+  shrinkwrap_project_rays_alloc(&rays, calc->numVerts);
+
+  for (int i = 0; i < calc->numVerts; i++) {
+    float weight = BKE_defvert_array_find_weight_safe(calc->dvert, i, calc->vgroup);
+
+    if (calc->invert_vgroup) {
+      weight = 1.0f - weight;
+    }
+
+    if (weight == 0.0f) {
+      continue;
+    }
+
+    const int ray = rays.len++;
+    rays.vert_index[ray] = i;
+    rays.weight[ray] = weight;
+
+    if (calc->vert != NULL && calc->smd->projAxis == MOD_SHRINKWRAP_PROJECT_OVER_NORMAL) {
+      /* calc->vert contains verts from evaluated mesh.  */
+      /* These coordinates are deformed by vertexCos only for normal projection
+       * (to get correct normals) for other cases calc->verts contains undeformed coordinates and
+       * vertexCos should be used */
+      copy_v3_v3(rays.co[ray], calc->vert[i].co);
+      normal_short_to_float_v3(rays.no[ray], calc->vert[i].no);
+    }
+    else {
+      copy_v3_v3(rays.co[ray], calc->vertexCos[i]);
+      copy_v3_v3(rays.no[ray], proj_axis);
+    }
+  }
+
+  for (int i = 0; i < rays.len; i++) {
+    rays.hit[i].index = -1;
+    /* TODO: we should use FLT_MAX here, but sweepsphere code isn't prepared for that */
+    rays.hit[i].dist = BVH_RAYCAST_DIST_MAX;
+    rays.is_aux[i] = false;
+  }
+
+  /* Project all rays at once, in the same order the hits are found for a single vertex:
+   * the auxiliary target before the main target and the positive direction first. */
+  if (calc->smd->shrinkOpts & MOD_SHRINKWRAP_PROJECT_ALLOW_POS_DIR) {
+    if (aux_tree) {
+      shrinkwrap_project_normal_batch(0, &rays, rays.no, &local2aux, aux_tree);
+      shrinkwrap_project_rays_update_is_aux(&rays, true);
+    }
+
+    shrinkwrap_project_normal_batch(
+        calc->smd->shrinkOpts, &rays, rays.no, &calc->local2target, calc->tree);
+    shrinkwrap_project_rays_update_is_aux(&rays, false);
+  }
+
+  /* Project over negative direction of axis */
+  if (calc->smd->shrinkOpts & MOD_SHRINKWRAP_PROJECT_ALLOW_NEG_DIR) {
+    for (int i = 0; i < rays.len; i++) {
+      negate_v3_v3(rays.neg_no[i], rays.no[i]);
+    }
+
+    char options = calc->smd->shrinkOpts;
+
+    if ((options & MOD_SHRINKWRAP_INVERT_CULL_TARGET) &&
+        (options & MOD_SHRINKWRAP_CULL_TARGET_MASK)) {
+      options ^= MOD_SHRINKWRAP_CULL_TARGET_MASK;
+    }
+
+    if (aux_tree) {
+      shrinkwrap_project_normal_batch(0, &rays, rays.neg_no, &local2aux, aux_tree);
+      shrinkwrap_project_rays_update_is_aux(&rays, true);
+    }
+
+    shrinkwrap_project_normal_batch(options, &rays, rays.neg_no, &calc->local2target, calc->tree);
+    shrinkwrap_project_rays_update_is_aux(&rays, false);
+  }
+
+  /* Move the vertices to their hits. */
   ShrinkwrapCalcCBData data = {
       .calc = calc,
       .tree = calc->tree,
       .aux_tree = aux_tree,
-      .proj_axis = proj_axis,
       .local2aux = &local2aux,
+      .rays = &rays,
   };
   TaskParallelSettings settings;
   BLI_parallel_range_settings_defaults(&settings);
-  settings.use_threading = (calc->numVerts > BKE_MESH_OMP_LIMIT);
-  settings.userdata_chunk = &hit;
-  settings.userdata_chunk_size = sizeof(hit);
-  BLI_task_parallel_range(
-      0, calc->numVerts, &data, shrinkwrap_calc_normal_projection_cb_ex, &settings);
+  settings.use_threading = (rays.len > BKE_MESH_OMP_LIMIT);
+  BLI_task_parallel_range(0, rays.len, &data, shrinkwrap_calc_normal_projection_cb_ex, &settings);
 
   /* free data structures */
+  MEM_freeN(rays.memory);
+
   if (aux_tree) {
     BKE_shrinkwrap_free_tree(aux_tree);
   }
@@ -0,0 +1,68 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * Gzip files made of independently compressed blocks, compressed and decompressed on multiple
+ * threads.
+ *
+ * Every block of #BLI_GZIP_BLOCKS_BLOCK_SIZE uncompressed bytes is a separate gzip member,
+ * followed by a seek table stored in the extra fields of empty members. The result is a regular
+ * gzip file that any gzip reader can decompress as a whole. Members are plain zlib (deflate)
+ * streams to keep that compatibility, the speed-up comes from the parallel blocks.
+ */
+
+#include "BLI_compiler_attrs.h"
+#include "BLI_sys_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Uncompressed size of every block but the last one. */
+#define BLI_GZIP_BLOCKS_BLOCK_SIZE (1 << 20)
+
+typedef struct GzipBlocksWriter GzipBlocksWriter;
+
+/* Level as used by zlib, returns NULL when the file can't be created. */
+GzipBlocksWriter *BLI_gzip_blocks_writer_open(const char *filepath,
+                                              int level) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL();
+bool BLI_gzip_blocks_writer_write(GzipBlocksWriter *writer, const void *data, size_t data_len)
+    ATTR_NONNULL(1);
+/* Writes the remaining blocks and the seek table, returns false when any write failed. */
+bool BLI_gzip_blocks_writer_close(GzipBlocksWriter *writer) ATTR_NONNULL();
+
+typedef struct GzipBlocksReader GzipBlocksReader;
+
+/**
+ * Open a file written by #GzipBlocksWriter for reading it from the start. Batches of blocks are
+ * decompressed on multiple threads as reading goes, so only one batch is kept in memory.
+ * Returns NULL when the file doesn't end with a seek table or is corrupt, it may still be a
+ * regular gzip file then. The read position of the file is not used.
+ */
+GzipBlocksReader *BLI_gzip_blocks_reader_open(int file) ATTR_WARN_UNUSED_RESULT;
+/* Returns the number of bytes read, which is less than \a data_len at the end of the file, or -1
+ * when the file is corrupt. */
+int64_t BLI_gzip_blocks_reader_read(GzipBlocksReader *reader, void *data, size_t data_len)
+    ATTR_NONNULL(1);
+void BLI_gzip_blocks_reader_close(GzipBlocksReader *reader) ATTR_NONNULL();
+
+#ifdef __cplusplus
+}
+#endif
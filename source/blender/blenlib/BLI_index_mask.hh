@@ -189,6 +189,15 @@ class IndexMask {
     return indices_.index_range();
   }
 
+  /**
+   * Returns an IndexMask that references a contiguous part of the indices of this IndexMask. The
+   * given range is an index into the referenced indices, not a range of the indices themselves.
+   */
+  IndexMask slice(IndexRange slice) const
+  {
+    return IndexMask(indices_.slice(slice));
+  }
+
   /**
    * Returns the largest index that is referenced by this IndexMask.
    */
@@ -137,6 +137,14 @@ typedef bool (*BVHTree_WalkParentCallback)(const BVHTreeAxisRange *bounds, void
 typedef bool (*BVHTree_WalkLeafCallback)(const BVHTreeAxisRange *bounds,
                                          int index,
                                          void *userdata);
+/* Maximum number of points per element for #BLI_bvhtree_refit. */
+#define BVH_REFIT_POINTS_MAX 4
+
+/* Fills the points of the element inserted with \a index, returns their number. */
+typedef int (*BVHTree_RefitCallback)(void *userdata,
+                                     int index,
+                                     float r_co[BVH_REFIT_POINTS_MAX][3]);
+
 /* return true to search (min, max) else (max, min). */
 typedef bool (*BVHTree_WalkOrderCallback)(const BVHTreeAxisRange *bounds,
                                           char axis,
@@ -153,6 +161,7 @@ void BLI_bvhtree_balance(BVHTree *tree);
 bool BLI_bvhtree_update_node(
     BVHTree *tree, int index, const float co[3], const float co_moving[3], int numpoints);
 void BLI_bvhtree_update_tree(BVHTree *tree);
+void BLI_bvhtree_refit(BVHTree *tree, BVHTree_RefitCallback callback, void *userdata);
 
 int BLI_bvhtree_overlap_thread_num(const BVHTree *tree);
 
@@ -216,6 +225,16 @@ int BLI_bvhtree_ray_cast(BVHTree *tree,
                          BVHTree_RayCastCallback callback,
                          void *userdata);
 
+void BLI_bvhtree_ray_cast_batch(BVHTree *tree,
+                                const float (*co)[3],
+                                const float (*dir)[3],
+                                const int rays_len,
+                                float radius,
+                                BVHTreeRayHit *hits,
+                                BVHTree_RayCastCallback callback,
+                                void *userdata,
+                                int flag);
+
 void BLI_bvhtree_ray_cast_all_ex(BVHTree *tree,
                                  const float co[3],
                                  const float dir[3],
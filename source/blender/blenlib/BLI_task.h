@@ -313,6 +313,31 @@ struct TaskNode *BLI_task_graph_node_create(struct TaskGraph *task_graph,
 bool BLI_task_graph_node_push_work(struct TaskNode *task_node);
 void BLI_task_graph_edge_create(struct TaskNode *from_node, struct TaskNode *to_node);
 
+/* Task Profiling
+ *
+ * Opt-in recording of every task pool task, task graph node and chunk of a parallel range,
+ * iterator, list-base, mempool or #blender::parallel_for loop that runs, with its begin and end
+ * time, the thread it ran on and the pool, graph or loop function it belongs to. Each thread
+ * records into its own fixed size ring buffer without locking, once a buffer is full the oldest
+ * events of that thread are overwritten.
+ *
+ * The recording can be written as Chrome trace JSON at any time, to be inspected in
+ * `chrome://tracing` or Perfetto. Events of tasks that are still running are not included. */
+
+void BLI_task_profile_enable(bool enable);
+bool BLI_task_profile_is_enabled(void);
+/* Discard all events recorded so far. */
+void BLI_task_profile_clear(void);
+bool BLI_task_profile_write_chrome_trace(const char *filepath);
+
+/* Recording of the C iteration loops, the begin time is zero when profiling is disabled. Pass an
+ * empty index range when the items have no indices. */
+uint64_t BLI_task_profile_iterator_begin(void);
+void BLI_task_profile_iterator_end(const void *func,
+                                   uint64_t begin,
+                                   int index_begin,
+                                   int index_end);
+
 #ifdef __cplusplus
 }
 #endif
@@ -38,6 +38,7 @@
 #endif
 
 #include "BLI_index_range.hh"
+#include "BLI_task_profile.hh"
 #include "BLI_utildefines.h"
 
 namespace blender {
@@ -60,13 +61,23 @@ void parallel_for(IndexRange range, int64_t grain_size, const Function &function
   if (range.size() == 0) {
     return;
   }
+  /* Every call site passes its own lambda type, so the instantiation identifies it in profiles. */
+  const void *profile_id = (const void *)&parallel_for<Function>;
 #ifdef WITH_TBB
   tbb::parallel_for(tbb::blocked_range<int64_t>(range.first(), range.one_after_last(), grain_size),
                     [&](const tbb::blocked_range<int64_t> &subrange) {
+                      task_profile::Scope profile(task_profile::EventType::ParallelForChunk,
+                                                  profile_id,
+                                                  (int)subrange.begin(),
+                                                  (int)subrange.end());
                       function(IndexRange(subrange.begin(), subrange.size()));
                     });
 #else
   UNUSED_VARS(grain_size);
+  task_profile::Scope profile(task_profile::EventType::ParallelForChunk,
+                              profile_id,
+                              (int)range.first(),
+                              (int)range.one_after_last());
   function(range);
 #endif
 }
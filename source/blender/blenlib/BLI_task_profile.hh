@@ -0,0 +1,79 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * Recording of task execution for the task profiler, used by the task pool, task graph,
+ * parallel range and #blender::parallel_for implementations. See #BLI_task_profile_enable.
+ */
+
+#include <atomic>
+
+#include "BLI_sys_types.h"
+
+namespace blender::task_profile {
+
+enum class EventType : uint8_t {
+  PoolTask,
+  GraphNode,
+  RangeChunk,
+  /** Sub-range of #blender::parallel_for. */
+  ParallelForChunk,
+  /** Chunk of a parallel iterator or list-base loop, or a mempool loop task. */
+  IteratorChunk,
+};
+
+extern std::atomic<bool> is_enabled;
+
+uint64_t time_now();
+void record(EventType type, const void *id, uint64_t begin, int range_begin, int range_end);
+
+/**
+ * Records the execution of the enclosing scope. When profiling is disabled this only costs a
+ * relaxed atomic load.
+ */
+class Scope {
+ private:
+  const void *id_;
+  uint64_t begin_ = 0;
+  int range_begin_;
+  int range_end_;
+  EventType type_;
+
+ public:
+  Scope(EventType type, const void *id, int range_begin = 0, int range_end = 0)
+      : id_(id), range_begin_(range_begin), range_end_(range_end), type_(type)
+  {
+    if (is_enabled.load(std::memory_order_relaxed)) {
+      begin_ = time_now();
+    }
+  }
+
+  Scope(const Scope &other) = delete;
+  Scope &operator=(const Scope &other) = delete;
+
+  ~Scope()
+  {
+    if (begin_ != 0) {
+      record(type_, id_, begin_, range_begin_, range_end_);
+    }
+  }
+};
+
+}  // namespace blender::task_profile
@@ -44,12 +44,17 @@
 #include "BLI_heap_simple.h"
 #include "BLI_kdopbvh.h"
 #include "BLI_math.h"
+#include "BLI_math_bits.h"
 #include "BLI_stack.h"
 #include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #include "BLI_strict_flags.h"
 
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
 /* used for iterative_raycast */
 // #define USE_SKIP_LINKS
 
@@ -88,6 +93,25 @@ typedef struct BVHNode {
   char main_axis; /* Axis used to split this node */
 } BVHNode;
 
+/* Children per node in the flat layout. */
+#define BVH_FLAT_WIDTH 4
+
+/**
+ * Node of the flat layout, see #bvhtree_flat_build.
+ * The x, y and z bounds of all children are stored side by side so they can be tested together.
+ */
+typedef struct BVHFlatNode {
+  float min[3][BVH_FLAT_WIDTH];
+  float max[3][BVH_FLAT_WIDTH];
+  /* Index of a branch in #BVHTree.flatnodes, or `-(i + 1)` for leaf `i` of #BVHTree.nodearray. */
+  int children[BVH_FLAT_WIDTH];
+  char totnode;
+  char main_axis;
+  char _pad[14];
+} BVHFlatNode;
+
+BLI_STATIC_ASSERT_ALIGN(BVHFlatNode, 16)
+
 /* keep under 26 bytes for speed purposes */
 struct BVHTree {
   BVHNode **nodes;
@@ -100,17 +124,22 @@ struct BVHTree {
   axis_t start_axis, stop_axis; /* bvhtree_kdop_axes array indices according to axis */
   axis_t axis;                  /* kdop type (6 => OBB, 7 => AABB, ...) */
   char tree_type;               /* type of tree (4 => quadtree) */
+
+  /* Optional depth first copy of the branches for faster queries, see #bvhtree_flat_build. */
+  BVHFlatNode *flatnodes;
 };
 
 /* optimization, ensure we stay small */
-BLI_STATIC_ASSERT((sizeof(void *) == 8 && sizeof(BVHTree) <= 48) ||
-                      (sizeof(void *) == 4 && sizeof(BVHTree) <= 32),
+BLI_STATIC_ASSERT((sizeof(void *) == 8 && sizeof(BVHTree) <= 56) ||
+                      (sizeof(void *) == 4 && sizeof(BVHTree) <= 36),
                   "over sized")
 
 /* avoid duplicating vars in BVHOverlapData_Thread */
 typedef struct BVHOverlapData_Shared {
   const BVHTree *tree1, *tree2;
   axis_t start_axis, stop_axis;
+  /* Both trees have a flat layout that contains all tested axes. */
+  bool use_flat;
 
   /* use for callbacks */
   BVHTree_OverlapCallback callback;
@@ -863,6 +892,100 @@ static void non_recursive_bvh_div_nodes(const BVHTree *tree,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Flat Layout
+ *
+ * Walking #BVHNode means following a pointer to every child and another one to its bounds.
+ * Once a tree is balanced, trees with at most #BVH_FLAT_WIDTH children per node also get a copy
+ * of their branches as one array of #BVHFlatNode in depth first order. Every flat node holds the
+ * x, y and z bounds of its children side by side, so queries test all children of a node with
+ * a few SIMD instructions and only touch #BVHNode for leaves.
+ *
+ * Only the x, y and z slabs are copied, which is all ray-casts and nearest point queries use.
+ * \{ */
+
+BLI_INLINE bool bvhtree_flat_child_is_leaf(const int child)
+{
+  return child < 0;
+}
+
+BLI_INLINE BVHNode *bvhtree_flat_child_leaf(const BVHTree *tree, const int child)
+{
+  return &tree->nodearray[-(child + 1)];
+}
+
+static bool bvhtree_flat_supported(const BVHTree *tree)
+{
+  return (tree->tree_type <= BVH_FLAT_WIDTH) && (tree->start_axis == 0) && (tree->totleaf > 1);
+}
+
+/**
+ * Copy the bounds of the children of \a node into the flat node at \a flat_index,
+ * then do the same for the branches among them.
+ * The order of the nodes only depends on the tree topology, so this also updates the bounds.
+ */
+static void bvhtree_flat_fill_recursive(const BVHTree *tree,
+                                        const BVHNode *node,
+                                        const int flat_index,
+                                        int *r_flat_len)
+{
+  BVHFlatNode *flat = &tree->flatnodes[flat_index];
+  int i, axis;
+
+  flat->totnode = node->totnode;
+  flat->main_axis = node->main_axis;
+
+  for (i = 0; i < BVH_FLAT_WIDTH; i++) {
+    if (i < node->totnode) {
+      const float *bv = node->children[i]->bv;
+      for (axis = 0; axis < 3; axis++) {
+        flat->min[axis][i] = bv[2 * axis];
+        flat->max[axis][i] = bv[2 * axis + 1];
+      }
+    }
+    else {
+      /* Unused slots are never traversed, an empty box keeps them out of the way. */
+      for (axis = 0; axis < 3; axis++) {
+        flat->min[axis][i] = FLT_MAX;
+        flat->max[axis][i] = -FLT_MAX;
+      }
+      flat->children[i] = 0;
+    }
+  }
+
+  for (i = 0; i < node->totnode; i++) {
+    const BVHNode *child = node->children[i];
+    if (child->totnode == 0) {
+      flat->children[i] = -(int)(child - tree->nodearray) - 1;
+    }
+    else {
+      const int child_flat_index = (*r_flat_len)++;
+      flat->children[i] = child_flat_index;
+      bvhtree_flat_fill_recursive(tree, child, child_flat_index, r_flat_len);
+    }
+  }
+}
+
+static void bvhtree_flat_update(BVHTree *tree)
+{
+  int flat_len = 1;
+  bvhtree_flat_fill_recursive(tree, tree->nodes[tree->totleaf], 0, &flat_len);
+  BLI_assert(flat_len == tree->totbranch);
+}
+
+static void bvhtree_flat_build(BVHTree *tree)
+{
+  BLI_assert(tree->flatnodes == NULL);
+  if (!bvhtree_flat_supported(tree)) {
+    return;
+  }
+  tree->flatnodes = MEM_mallocN_aligned(
+      sizeof(BVHFlatNode) * (size_t)tree->totbranch, 16, "BVHFlatNodes");
+  bvhtree_flat_update(tree);
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_bvhtree API
  * \{ */
@@ -949,6 +1072,7 @@ void BLI_bvhtree_free(BVHTree *tree)
     MEM_SAFE_FREE(tree->nodearray);
     MEM_SAFE_FREE(tree->nodebv);
     MEM_SAFE_FREE(tree->nodechild);
+    MEM_SAFE_FREE(tree->flatnodes);
     MEM_freeN(tree);
   }
 }
@@ -976,6 +1100,8 @@ void BLI_bvhtree_balance(BVHTree *tree)
   build_skip_links(tree, tree->nodes[tree->totleaf], NULL, NULL);
 #endif
 
+  bvhtree_flat_build(tree);
+
 #ifdef USE_VERIFY_TREE
   bvhtree_verify(tree);
 #endif
@@ -1038,6 +1164,15 @@ bool BLI_bvhtree_update_node(
   return true;
 }
 
+static void bvhtree_update_tree_level_cb(void *__restrict userdata,
+                                         const int j,
+                                         const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BVHTree *tree = userdata;
+  /* Branch `j` of the implicit tree, see #BLI_bvhtree_balance. */
+  node_join(tree, &tree->nodearray[tree->totleaf + j - 1]);
+}
+
 /**
  * Call #BLI_bvhtree_update_node() first for every node/point/triangle.
  */
@@ -1047,13 +1182,91 @@ void BLI_bvhtree_update_tree(BVHTree *tree)
    * TRICKY: the way we build the tree all the children have an index greater than the parent
    * This allows us todo a bottom up update by starting on the bigger numbered branch. */
 
-  BVHNode **root = tree->nodes + tree->totleaf;
-  BVHNode **index = tree->nodes + tree->totleaf + tree->totbranch - 1;
+  if (tree->totleaf > KDOPBVH_THREAD_LEAF_THRESHOLD) {
+    /* Branches only depend on the level below them, so every level can be joined in parallel.
+     * The levels are the same as in #non_recursive_bvh_div_nodes. */
+    const int tree_offset = 2 - tree->tree_type;
+    int level_start[33];
+    int levels_len = 0;
+    for (int i = 1; i <= tree->totbranch; i = i * tree->tree_type + tree_offset) {
+      BLI_assert(levels_len < (int)ARRAY_SIZE(level_start) - 1);
+      level_start[levels_len++] = i;
+    }
+    level_start[levels_len] = tree->totbranch + 1;
+
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.min_iter_per_thread = 1024;
+    for (int level = levels_len - 1; level >= 0; level--) {
+      BLI_task_parallel_range(level_start[level],
+                              min_ii(level_start[level + 1], tree->totbranch + 1),
+                              tree,
+                              bvhtree_update_tree_level_cb,
+                              &settings);
+    }
+  }
+  else {
+    BVHNode **root = tree->nodes + tree->totleaf;
+    BVHNode **index = tree->nodes + tree->totleaf + tree->totbranch - 1;
+
+    for (; index >= root; index--) {
+      node_join(tree, *index);
+    }
+  }
 
-  for (; index >= root; index--) {
-    node_join(tree, *index);
+  if (tree->flatnodes) {
+    bvhtree_flat_update(tree);
   }
 }
+
+typedef struct BVHRefitData {
+  BVHTree *tree;
+  BVHTree_RefitCallback callback;
+  void *userdata;
+} BVHRefitData;
+
+static void bvhtree_refit_leaf_cb(void *__restrict userdata,
+                                  const int i,
+                                  const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BVHRefitData *data = userdata;
+  BVHTree *tree = data->tree;
+  BVHNode *node = &tree->nodearray[i];
+  float co[BVH_REFIT_POINTS_MAX][3];
+
+  const int numpoints = data->callback(data->userdata, node->index, co);
+  BLI_assert(IN_RANGE_INCL(numpoints, 1, BVH_REFIT_POINTS_MAX));
+
+  create_kdop_hull(tree, node, co[0], numpoints, 0);
+  bvhtree_node_inflate(tree, node, tree->epsilon);
+}
+
+/**
+ * Recompute the bounds of all leaves from the current positions of their elements and update
+ * the tree, in parallel. The structure of the tree is kept, so this is much cheaper than
+ * building a new tree, but queries get slower as the elements move away from where they were
+ * when the tree was balanced.
+ *
+ * \param callback: Called with the index every leaf was inserted with, from multiple threads.
+ */
+void BLI_bvhtree_refit(BVHTree *tree, BVHTree_RefitCallback callback, void *userdata)
+{
+  BLI_assert(tree->totbranch > 0 || tree->totleaf == 0);
+
+  BVHRefitData data = {
+      .tree = tree,
+      .callback = callback,
+      .userdata = userdata,
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (tree->totleaf > KDOPBVH_THREAD_LEAF_THRESHOLD);
+  settings.min_iter_per_thread = 1024;
+  BLI_task_parallel_range(0, tree->totleaf, &data, bvhtree_refit_leaf_cb, &settings);
+
+  BLI_bvhtree_update_tree(tree);
+}
 /**
  * Number of times #BLI_bvhtree_insert has been called.
  * mainly useful for asserts functions to check we added the correct number.
@@ -1104,6 +1317,17 @@ static bool tree_overlap_test(const BVHNode *node1,
   return 1;
 }
 
+/* Same as #tree_overlap_test for the x, y and z axes of two bounds. */
+static bool tree_overlap_test_bv(const float bv1[6], const float bv2[6])
+{
+  for (int i = 0; i < 6; i += 2) {
+    if ((bv1[i] > bv2[i + 1]) || (bv2[i] > bv1[i + 1])) {
+      return false;
+    }
+  }
+  return true;
+}
+
 static void tree_overlap_traverse(BVHOverlapData_Thread *data_thread,
                                   const BVHNode *node1,
                                   const BVHNode *node2)
@@ -1192,6 +1416,101 @@ static void tree_overlap_traverse_cb(BVHOverlapData_Thread *data_thread,
   }
 }
 
+/* Bounds of child \a i of a flat node, in the same layout as #BVHNode.bv. */
+static void flat_child_bv(const BVHFlatNode *node, const int i, float r_bv[6])
+{
+  for (int axis = 0; axis < 3; axis++) {
+    r_bv[2 * axis] = node->min[axis][i];
+    r_bv[2 * axis + 1] = node->max[axis][i];
+  }
+}
+
+/* Same as #tree_overlap_test for \a bv against all children of a flat node. */
+static int flat_overlap_test(const BVHFlatNode *node, const float bv[6])
+{
+#ifdef __SSE2__
+  __m128 miss = _mm_setzero_ps();
+  for (int axis = 0; axis < 3; axis++) {
+    miss = _mm_or_ps(miss,
+                     _mm_or_ps(_mm_cmpgt_ps(_mm_load_ps(node->min[axis]),
+                                            _mm_set1_ps(bv[2 * axis + 1])),
+                               _mm_cmpgt_ps(_mm_set1_ps(bv[2 * axis]),
+                                            _mm_load_ps(node->max[axis]))));
+  }
+  return ~_mm_movemask_ps(miss) & ((1 << node->totnode) - 1);
+#else
+  int mask = 0;
+  for (int i = 0; i < node->totnode; i++) {
+    bool is_overlap = true;
+    for (int axis = 0; axis < 3; axis++) {
+      if ((node->min[axis][i] > bv[2 * axis + 1]) || (bv[2 * axis] > node->max[axis][i])) {
+        is_overlap = false;
+        break;
+      }
+    }
+    mask |= is_overlap << i;
+  }
+  return mask;
+#endif
+}
+
+/**
+ * Flat layout version of #tree_overlap_traverse and #tree_overlap_traverse_cb.
+ * \a child1 and \a child2 are children in the flat layout (see #BVHFlatNode.children),
+ * their bounds \a bv1 and \a bv2 are known to overlap.
+ */
+static void tree_overlap_traverse_flat(BVHOverlapData_Thread *data_thread,
+                                       const int child1,
+                                       const float bv1[6],
+                                       const int child2,
+                                       const float bv2[6])
+{
+  BVHOverlapData_Shared *data = data_thread->shared;
+  float bv[6];
+  int j, mask;
+
+  /* check if node1 is a leaf */
+  if (bvhtree_flat_child_is_leaf(child1)) {
+    /* check if node2 is a leaf */
+    if (bvhtree_flat_child_is_leaf(child2)) {
+      const BVHNode *node1 = bvhtree_flat_child_leaf(data->tree1, child1);
+      const BVHNode *node2 = bvhtree_flat_child_leaf(data->tree2, child2);
+
+      if (UNLIKELY(node1 == node2)) {
+        return;
+      }
+
+      if (!data->callback ||
+          data->callback(data->userdata, node1->index, node2->index, data_thread->thread)) {
+        /* both leafs, insert overlap! */
+        BVHTreeOverlap *overlap = BLI_stack_push_r(data_thread->overlap);
+        overlap->indexA = node1->index;
+        overlap->indexB = node2->index;
+      }
+    }
+    else {
+      const BVHFlatNode *node2 = &data->tree2->flatnodes[child2];
+      mask = flat_overlap_test(node2, bv1);
+      for (j = 0; j < node2->totnode; j++) {
+        if (mask & (1 << j)) {
+          flat_child_bv(node2, j, bv);
+          tree_overlap_traverse_flat(data_thread, child1, bv1, node2->children[j], bv);
+        }
+      }
+    }
+  }
+  else {
+    const BVHFlatNode *node1 = &data->tree1->flatnodes[child1];
+    mask = flat_overlap_test(node1, bv2);
+    for (j = 0; j < node1->totnode; j++) {
+      if (mask & (1 << j)) {
+        flat_child_bv(node1, j, bv);
+        tree_overlap_traverse_flat(data_thread, node1->children[j], bv, child2, bv2);
+      }
+    }
+  }
+}
+
 /**
  * a version of #tree_overlap_traverse_cb that that break on first true return.
  */
@@ -1267,6 +1586,15 @@ static void bvhtree_overlap_task_cb(void *__restrict userdata,
                               data_shared->tree1->nodes[data_shared->tree1->totleaf]->children[j],
                               data_shared->tree2->nodes[data_shared->tree2->totleaf]);
   }
+  else if (data_shared->use_flat) {
+    const BVHFlatNode *root1 = data_shared->tree1->flatnodes;
+    const BVHNode *root2 = data_shared->tree2->nodes[data_shared->tree2->totleaf];
+    float bv1[6];
+    flat_child_bv(root1, j, bv1);
+    if (tree_overlap_test_bv(bv1, root2->bv)) {
+      tree_overlap_traverse_flat(data, root1->children[j], bv1, 0, root2->bv);
+    }
+  }
   else if (data_shared->callback) {
     tree_overlap_traverse_cb(data,
                              data_shared->tree1->nodes[data_shared->tree1->totleaf]->children[j],
@@ -1327,6 +1655,8 @@ BVHTreeOverlap *BLI_bvhtree_overlap_ex(
   data_shared.tree2 = tree2;
   data_shared.start_axis = start_axis;
   data_shared.stop_axis = stop_axis;
+  data_shared.use_flat = tree1->flatnodes && tree2->flatnodes && (start_axis == 0) &&
+                         (stop_axis == 3);
 
   /* can be NULL */
   data_shared.callback = callback;
@@ -1352,6 +1682,10 @@ BVHTreeOverlap *BLI_bvhtree_overlap_ex(
     if (max_interactions) {
       tree_overlap_traverse_num(data, root1, root2);
     }
+    else if (data_shared.use_flat) {
+      /* The roots were tested above. */
+      tree_overlap_traverse_flat(data, 0, root1->bv, 0, root2->bv);
+    }
     else if (callback) {
       tree_overlap_traverse_cb(data, root1, root2);
     }
@@ -1528,6 +1862,58 @@ static void dfs_find_nearest_dfs(BVHNearestData *data, BVHNode *node)
   }
 }
 
+/* Same as #calc_nearest_point_squared for all children of a flat node. */
+static void flat_calc_nearest_point_squared(const float proj[3],
+                                            const BVHFlatNode *node,
+                                            float r_dist_sq[BVH_FLAT_WIDTH])
+{
+#ifdef __SSE2__
+  __m128 dist_sq = _mm_setzero_ps();
+  for (int axis = 0; axis < 3; axis++) {
+    const __m128 val = _mm_set1_ps(proj[axis]);
+    const __m128 nearest = _mm_min_ps(_mm_load_ps(node->max[axis]),
+                                      _mm_max_ps(_mm_load_ps(node->min[axis]), val));
+    const __m128 delta = _mm_sub_ps(val, nearest);
+    dist_sq = (axis == 0) ? _mm_mul_ps(delta, delta) :
+                            _mm_add_ps(dist_sq, _mm_mul_ps(delta, delta));
+  }
+  _mm_storeu_ps(r_dist_sq, dist_sq);
+#else
+  for (int i = 0; i < node->totnode; i++) {
+    float nearest[3];
+    for (int axis = 0; axis < 3; axis++) {
+      nearest[axis] = min_ff(node->max[axis][i], max_ff(node->min[axis][i], proj[axis]));
+    }
+    r_dist_sq[i] = len_squared_v3v3(proj, nearest);
+  }
+#endif
+}
+
+/* Flat layout version of #dfs_find_nearest_dfs for branches. */
+static void dfs_find_nearest_flat(BVHNearestData *data, const BVHFlatNode *node)
+{
+  float dist_sq[BVH_FLAT_WIDTH];
+  flat_calc_nearest_point_squared(data->proj, node, dist_sq);
+
+  /* Better heuristic to pick the closest node to dive on */
+  const bool is_forward = data->proj[node->main_axis] <= node->max[node->main_axis][0];
+  for (int j = 0; j < node->totnode; j++) {
+    const int i = is_forward ? j : node->totnode - 1 - j;
+    if (dist_sq[i] >= data->nearest.dist_sq) {
+      continue;
+    }
+
+    const int child = node->children[i];
+    if (bvhtree_flat_child_is_leaf(child)) {
+      /* Leaves are rare enough to use the regular code path. */
+      dfs_find_nearest_dfs(data, bvhtree_flat_child_leaf(data->tree, child));
+    }
+    else {
+      dfs_find_nearest_flat(data, &data->tree->flatnodes[child]);
+    }
+  }
+}
+
 static void dfs_find_nearest_begin(BVHNearestData *data, BVHNode *node)
 {
   float nearest[3], dist_sq;
@@ -1535,7 +1921,13 @@ static void dfs_find_nearest_begin(BVHNearestData *data, BVHNode *node)
   if (dist_sq >= data->nearest.dist_sq) {
     return;
   }
-  dfs_find_nearest_dfs(data, node);
+  if (data->tree->flatnodes) {
+    /* Only the root is passed in, which is always a branch of the flat layout. */
+    dfs_find_nearest_flat(data, data->tree->flatnodes);
+  }
+  else {
+    dfs_find_nearest_dfs(data, node);
+  }
 }
 
 /* Priority queue method */
@@ -1787,10 +2179,8 @@ static float ray_nearest_hit(const BVHRayCastData *data, const float bv[6])
  * [http://tog.acm.org/resources/RTNews/html/rtnv21n1.html#art9]
  *
  * TODO this doesn't take data->ray.radius into consideration */
-static float fast_ray_nearest_hit(const BVHRayCastData *data, const BVHNode *node)
+static float fast_ray_nearest_hit(const BVHRayCastData *data, const float *bv)
 {
-  const float *bv = node->bv;
-
   float t1x = (bv[data->index[0]] - data->ray.origin[0]) * data->idot_axis[0];
   float t2x = (bv[data->index[1]] - data->ray.origin[0]) * data->idot_axis[0];
   float t1y = (bv[data->index[2]] - data->ray.origin[1]) * data->idot_axis[1];
@@ -1813,7 +2203,7 @@ static void dfs_raycast(BVHRayCastData *data, BVHNode *node)
   /* ray-bv is really fast.. and simple tests revealed its worth to test it
    * before calling the ray-primitive functions */
   /* XXX: temporary solution for particles until fast_ray_nearest_hit supports ray.radius */
-  float dist = (data->ray.radius == 0.0f) ? fast_ray_nearest_hit(data, node) :
+  float dist = (data->ray.radius == 0.0f) ? fast_ray_nearest_hit(data, node->bv) :
                                             ray_nearest_hit(data, node->bv);
   if (dist >= data->hit.dist) {
     return;
@@ -1854,7 +2244,7 @@ static void dfs_raycast_all(BVHRayCastData *data, BVHNode *node)
   /* ray-bv is really fast.. and simple tests revealed its worth to test it
    * before calling the ray-primitive functions */
   /* XXX: temporary solution for particles until fast_ray_nearest_hit supports ray.radius */
-  float dist = (data->ray.radius == 0.0f) ? fast_ray_nearest_hit(data, node) :
+  float dist = (data->ray.radius == 0.0f) ? fast_ray_nearest_hit(data, node->bv) :
                                             ray_nearest_hit(data, node->bv);
   if (dist >= data->hit.dist) {
     return;
@@ -1882,6 +2272,170 @@ static void dfs_raycast_all(BVHRayCastData *data, BVHNode *node)
   }
 }
 
+/**
+ * Same as #fast_ray_nearest_hit and #ray_nearest_hit for all children of a flat node,
+ * misses are #FLT_MAX.
+ */
+static void flat_ray_nearest_hit(const BVHRayCastData *data,
+                                 const BVHFlatNode *node,
+                                 float r_dist[BVH_FLAT_WIDTH])
+{
+#ifdef __SSE2__
+  const __m128 hit_dist = _mm_set1_ps(data->hit.dist);
+  __m128 miss, dist;
+
+  if (data->ray.radius == 0.0f) {
+    __m128 t1[3], t2[3];
+    for (int axis = 0; axis < 3; axis++) {
+      const bool is_negative = data->idot_axis[axis] < 0.0f;
+      const __m128 origin = _mm_set1_ps(data->ray.origin[axis]);
+      const __m128 idot = _mm_set1_ps(data->idot_axis[axis]);
+      const __m128 bv_near = _mm_load_ps(is_negative ? node->max[axis] : node->min[axis]);
+      const __m128 bv_far = _mm_load_ps(is_negative ? node->min[axis] : node->max[axis]);
+      t1[axis] = _mm_mul_ps(_mm_sub_ps(bv_near, origin), idot);
+      t2[axis] = _mm_mul_ps(_mm_sub_ps(bv_far, origin), idot);
+    }
+    const __m128 zero = _mm_setzero_ps();
+    miss = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(t1[0], t2[1]), _mm_cmplt_ps(t2[0], t1[1])),
+                     _mm_or_ps(_mm_cmpgt_ps(t1[0], t2[2]), _mm_cmplt_ps(t2[0], t1[2])));
+    miss = _mm_or_ps(miss,
+                     _mm_or_ps(_mm_cmpgt_ps(t1[1], t2[2]), _mm_cmplt_ps(t2[1], t1[2])));
+    miss = _mm_or_ps(miss,
+                     _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(t2[0], zero), _mm_cmplt_ps(t2[1], zero)),
+                               _mm_cmplt_ps(t2[2], zero)));
+    miss = _mm_or_ps(
+        miss,
+        _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(t1[0], hit_dist), _mm_cmpgt_ps(t1[1], hit_dist)),
+                  _mm_cmpgt_ps(t1[2], hit_dist)));
+    dist = _mm_max_ps(_mm_max_ps(t1[0], t1[1]), t1[2]);
+  }
+  else {
+    const __m128 radius = _mm_set1_ps(data->ray.radius);
+    __m128 low = _mm_setzero_ps(), upper = hit_dist;
+    miss = _mm_setzero_ps();
+    for (int axis = 0; axis < 3; axis++) {
+      const __m128 origin = _mm_set1_ps(data->ray.origin[axis]);
+      const __m128 bv_min = _mm_load_ps(node->min[axis]);
+      const __m128 bv_max = _mm_load_ps(node->max[axis]);
+      if (data->ray_dot_axis[axis] == 0.0f) {
+        /* axis aligned ray */
+        miss = _mm_or_ps(miss,
+                         _mm_or_ps(_mm_cmplt_ps(origin, _mm_sub_ps(bv_min, radius)),
+                                   _mm_cmpgt_ps(origin, _mm_add_ps(bv_max, radius))));
+      }
+      else {
+        const __m128 ray_dot_axis = _mm_set1_ps(data->ray_dot_axis[axis]);
+        const __m128 ll = _mm_div_ps(_mm_sub_ps(_mm_sub_ps(bv_min, radius), origin),
+                                     ray_dot_axis);
+        const __m128 lu = _mm_div_ps(_mm_sub_ps(_mm_add_ps(bv_max, radius), origin),
+                                     ray_dot_axis);
+        if (data->ray_dot_axis[axis] > 0.0f) {
+          low = _mm_max_ps(ll, low);
+          upper = _mm_min_ps(lu, upper);
+        }
+        else {
+          low = _mm_max_ps(lu, low);
+          upper = _mm_min_ps(ll, upper);
+        }
+      }
+    }
+    /* Both bounds only shrink the interval, so checking once at the end is enough. */
+    miss = _mm_or_ps(miss, _mm_cmpgt_ps(low, upper));
+    dist = low;
+  }
+
+  _mm_storeu_ps(r_dist,
+                _mm_or_ps(_mm_and_ps(miss, _mm_set1_ps(FLT_MAX)), _mm_andnot_ps(miss, dist)));
+#else
+  for (int i = 0; i < node->totnode; i++) {
+    const float bv[6] = {node->min[0][i],
+                         node->max[0][i],
+                         node->min[1][i],
+                         node->max[1][i],
+                         node->min[2][i],
+                         node->max[2][i]};
+    r_dist[i] = (data->ray.radius == 0.0f) ? fast_ray_nearest_hit(data, bv) :
+                                             ray_nearest_hit(data, bv);
+  }
+#endif
+}
+
+/**
+ * Flat layout version of #dfs_raycast, the bounds of \a node have already been tested.
+ */
+static void dfs_raycast_flat(BVHRayCastData *data, const BVHFlatNode *node)
+{
+  float dist[BVH_FLAT_WIDTH];
+  flat_ray_nearest_hit(data, node, dist);
+
+  /* pick loop direction to dive into the tree (based on ray direction and split axis) */
+  const bool is_forward = data->ray_dot_axis[node->main_axis] > 0.0f;
+  for (int j = 0; j < node->totnode; j++) {
+    const int i = is_forward ? j : node->totnode - 1 - j;
+    if (dist[i] >= data->hit.dist) {
+      continue;
+    }
+
+    const int child = node->children[i];
+    if (bvhtree_flat_child_is_leaf(child)) {
+      const BVHNode *leaf = bvhtree_flat_child_leaf(data->tree, child);
+      if (data->callback) {
+        data->callback(data->userdata, leaf->index, &data->ray, &data->hit);
+      }
+      else {
+        data->hit.index = leaf->index;
+        data->hit.dist = dist[i];
+        madd_v3_v3v3fl(data->hit.co, data->ray.origin, data->ray.direction, dist[i]);
+      }
+    }
+    else {
+      dfs_raycast_flat(data, &data->tree->flatnodes[child]);
+    }
+  }
+}
+
+/**
+ * Flat layout version of #dfs_raycast_all, the bounds of \a node have already been tested.
+ */
+static void dfs_raycast_all_flat(BVHRayCastData *data, const BVHFlatNode *node)
+{
+  float dist[BVH_FLAT_WIDTH];
+  flat_ray_nearest_hit(data, node, dist);
+
+  /* pick loop direction to dive into the tree (based on ray direction and split axis) */
+  const bool is_forward = data->ray_dot_axis[node->main_axis] > 0.0f;
+  for (int j = 0; j < node->totnode; j++) {
+    const int i = is_forward ? j : node->totnode - 1 - j;
+    if (dist[i] >= data->hit.dist) {
+      continue;
+    }
+
+    const int child = node->children[i];
+    if (bvhtree_flat_child_is_leaf(child)) {
+      const float hit_dist = data->hit.dist;
+      data->callback(data->userdata,
+                     bvhtree_flat_child_leaf(data->tree, child)->index,
+                     &data->ray,
+                     &data->hit);
+      data->hit.index = -1;
+      data->hit.dist = hit_dist;
+    }
+    else {
+      dfs_raycast_all_flat(data, &data->tree->flatnodes[child]);
+    }
+  }
+}
+
+/**
+ * The flat layout only stores the bounds of children, test the root like #dfs_raycast does.
+ */
+static bool flat_ray_root_hit(const BVHRayCastData *data, const BVHNode *root)
+{
+  const float dist = (data->ray.radius == 0.0f) ? fast_ray_nearest_hit(data, root->bv) :
+                                                  ray_nearest_hit(data, root->bv);
+  return dist < data->hit.dist;
+}
+
 static void bvhtree_ray_cast_data_precalc(BVHRayCastData *data, int flag)
 {
   int i;
@@ -1951,8 +2505,15 @@ int BLI_bvhtree_ray_cast_ex(BVHTree *tree,
   }
 
   if (root) {
-    dfs_raycast(&data, root);
-    //      iterative_raycast(&data, root);
+    if (tree->flatnodes) {
+      if (flat_ray_root_hit(&data, root)) {
+        dfs_raycast_flat(&data, tree->flatnodes);
+      }
+    }
+    else {
+      dfs_raycast(&data, root);
+      //      iterative_raycast(&data, root);
+    }
   }
 
   if (hit) {
@@ -2040,7 +2601,14 @@ void BLI_bvhtree_ray_cast_all_ex(BVHTree *tree,
   data.hit.dist = hit_dist;
 
   if (root) {
-    dfs_raycast_all(&data, root);
+    if (tree->flatnodes) {
+      if (flat_ray_root_hit(&data, root)) {
+        dfs_raycast_all_flat(&data, tree->flatnodes);
+      }
+    }
+    else {
+      dfs_raycast_all(&data, root);
+    }
   }
 }
 
@@ -2058,6 +2626,263 @@ void BLI_bvhtree_ray_cast_all(BVHTree *tree,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name BLI_bvhtree_ray_cast_batch
+ *
+ * Rays are sorted into bins by the signs of their direction and by the cell of the tree bounds
+ * their origin is in. Neighboring rays with the same direction signs are then traced together as
+ * a packet: the children of a node are tested for every ray of the packet at once, and a child is
+ * entered when any of the rays still hits it.
+ *
+ * Rays with the same direction signs visit the children of every node in the same order, so each
+ * ray sees the same nodes in the same order as with #BLI_bvhtree_ray_cast_ex and gets the same
+ * result. Packets need the flat layout, other trees trace the sorted rays one by one.
+ * \{ */
+
+#define BVH_RAY_PACKET_SIZE 4
+/* Bits per axis of the origin cells rays are sorted by. */
+#define BVH_RAY_CELL_BITS 4
+#define BVH_RAY_KEY_NUM (8 << (3 * BVH_RAY_CELL_BITS))
+
+typedef struct BVHRayCastBatchData {
+  BVHTree *tree;
+  const float (*co)[3];
+  const float (*dir)[3];
+  float radius;
+  BVHTreeRayHit *hits;
+  BVHTree_RayCastCallback callback;
+  void *userdata;
+  int flag;
+
+  /* Ray indices sorted by bin, packet `i` is `ray_order[packet_start[i]..packet_start[i + 1]]`. */
+  const int *ray_order;
+  const int *packet_start;
+} BVHRayCastBatchData;
+
+/* The signs used to pick the loop direction in #dfs_raycast, as set by
+ * #bvhtree_ray_cast_data_precalc. */
+static uint bvhtree_ray_direction_signs(const float dir[3])
+{
+  uint signs = 0;
+  for (uint i = 0; i < 3; i++) {
+    const float ray_dot_axis = dot_v3v3(dir, bvhtree_kdop_axes[i]);
+    if (!(fabsf(ray_dot_axis) < FLT_EPSILON) && ray_dot_axis > 0.0f) {
+      signs |= 1u << i;
+    }
+  }
+  return signs;
+}
+
+/* Morton order of the cell \a co is in, with cells dividing the bounds \a bv. */
+static uint bvhtree_ray_origin_cell(const float bv[6], const float co[3])
+{
+  const uint cells_per_axis = 1u << BVH_RAY_CELL_BITS;
+  uint cell = 0;
+  for (uint axis = 0; axis < 3; axis++) {
+    const float size = bv[2 * axis + 1] - bv[2 * axis];
+    const float fac = (size > 0.0f) ? (co[axis] - bv[2 * axis]) / size : 0.0f;
+    const uint c = (uint)clamp_f(fac * (float)cells_per_axis, 0.0f, (float)(cells_per_axis - 1));
+    for (uint bit = 0; bit < BVH_RAY_CELL_BITS; bit++) {
+      cell |= ((c >> bit) & 1u) << (3 * bit + axis);
+    }
+  }
+  return cell;
+}
+
+/**
+ * Packet version of #dfs_raycast_flat, \a mask are the rays of the packet that hit \a node.
+ * All rays in the packet have the same #bvhtree_ray_direction_signs.
+ */
+static void dfs_raycast_flat_packet(BVHRayCastData *rays,
+                                    const BVHFlatNode *node,
+                                    const uint mask)
+{
+  /* A single ray is faster without the packet book-keeping. */
+  if ((mask & (mask - 1)) == 0) {
+    dfs_raycast_flat(&rays[bitscan_forward_uint(mask)], node);
+    return;
+  }
+
+  const BVHTree *tree = rays[0].tree;
+  float dist[BVH_RAY_PACKET_SIZE][BVH_FLAT_WIDTH];
+  uint r, rays_mask;
+
+  for (rays_mask = mask; rays_mask;) {
+    r = bitscan_forward_clear_uint(&rays_mask);
+    flat_ray_nearest_hit(&rays[r], node, dist[r]);
+  }
+
+  /* pick loop direction to dive into the tree (based on ray direction and split axis) */
+  const bool is_forward = rays[0].ray_dot_axis[node->main_axis] > 0.0f;
+  for (int j = 0; j < node->totnode; j++) {
+    const int i = is_forward ? j : node->totnode - 1 - j;
+    const int child = node->children[i];
+
+    uint child_mask = 0;
+    for (rays_mask = mask; rays_mask;) {
+      r = bitscan_forward_clear_uint(&rays_mask);
+      if (dist[r][i] < rays[r].hit.dist) {
+        child_mask |= 1u << r;
+      }
+    }
+    if (child_mask == 0) {
+      continue;
+    }
+
+    if (bvhtree_flat_child_is_leaf(child)) {
+      const BVHNode *leaf = bvhtree_flat_child_leaf(tree, child);
+      for (rays_mask = child_mask; rays_mask;) {
+        r = bitscan_forward_clear_uint(&rays_mask);
+        BVHRayCastData *data = &rays[r];
+        if (data->callback) {
+          data->callback(data->userdata, leaf->index, &data->ray, &data->hit);
+        }
+        else {
+          data->hit.index = leaf->index;
+          data->hit.dist = dist[r][i];
+          madd_v3_v3v3fl(data->hit.co, data->ray.origin, data->ray.direction, dist[r][i]);
+        }
+      }
+    }
+    else {
+      dfs_raycast_flat_packet(rays, &tree->flatnodes[child], child_mask);
+    }
+  }
+}
+
+static void bvhtree_ray_cast_batch_task_cb(void *__restrict userdata,
+                                           const int packet,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHRayCastBatchData *batch = userdata;
+  BVHTree *tree = batch->tree;
+  BVHNode *root = tree->nodes[tree->totleaf];
+
+  BVHRayCastData rays[BVH_RAY_PACKET_SIZE];
+  const int *ray_order = &batch->ray_order[batch->packet_start[packet]];
+  const int rays_len = batch->packet_start[packet + 1] - batch->packet_start[packet];
+  uint mask = 0;
+
+  for (int r = 0; r < rays_len; r++) {
+    BVHRayCastData *data = &rays[r];
+    const int ray_index = ray_order[r];
+
+    BLI_ASSERT_UNIT_V3(batch->dir[ray_index]);
+
+    data->tree = tree;
+    data->callback = batch->callback;
+    data->userdata = batch->userdata;
+
+    copy_v3_v3(data->ray.origin, batch->co[ray_index]);
+    copy_v3_v3(data->ray.direction, batch->dir[ray_index]);
+    data->ray.radius = batch->radius;
+
+    bvhtree_ray_cast_data_precalc(data, batch->flag);
+
+    memcpy(&data->hit, &batch->hits[ray_index], sizeof(data->hit));
+
+    if (tree->flatnodes) {
+      if (flat_ray_root_hit(data, root)) {
+        mask |= 1u << r;
+      }
+    }
+    else {
+      dfs_raycast(data, root);
+    }
+  }
+
+  if (mask) {
+    dfs_raycast_flat_packet(rays, tree->flatnodes, mask);
+  }
+
+  for (int r = 0; r < rays_len; r++) {
+    memcpy(&batch->hits[ray_order[r]], &rays[r].hit, sizeof(rays[r].hit));
+  }
+}
+
+/**
+ * Cast \a rays_len rays in parallel, with the same results as calling #BLI_bvhtree_ray_cast_ex
+ * for every ray.
+ *
+ * \param hits: Array of \a rays_len hits. As with #BLI_bvhtree_ray_cast_ex, the index and dist of
+ * every hit must be initialized, the dist limits the length of the ray.
+ * \param callback: Called from multiple threads at once, it must only write to the hit it's passed.
+ */
+void BLI_bvhtree_ray_cast_batch(BVHTree *tree,
+                                const float (*co)[3],
+                                const float (*dir)[3],
+                                const int rays_len,
+                                float radius,
+                                BVHTreeRayHit *hits,
+                                BVHTree_RayCastCallback callback,
+                                void *userdata,
+                                int flag)
+{
+  const BVHNode *root = tree->nodes[tree->totleaf];
+  if (root == NULL || rays_len == 0) {
+    return;
+  }
+
+  /* Counting sort of the rays by bin. */
+  uint *ray_key = MEM_mallocN(sizeof(*ray_key) * (size_t)rays_len, __func__);
+  int *key_start = MEM_callocN(sizeof(*key_start) * (BVH_RAY_KEY_NUM + 1), __func__);
+  int *ray_order = MEM_mallocN(sizeof(*ray_order) * (size_t)rays_len, __func__);
+  int i;
+
+  for (i = 0; i < rays_len; i++) {
+    ray_key[i] = (bvhtree_ray_direction_signs(dir[i]) << (3 * BVH_RAY_CELL_BITS)) |
+                 bvhtree_ray_origin_cell(root->bv, co[i]);
+    key_start[ray_key[i] + 1]++;
+  }
+  for (i = 0; i < BVH_RAY_KEY_NUM; i++) {
+    key_start[i + 1] += key_start[i];
+  }
+  for (i = 0; i < rays_len; i++) {
+    ray_order[key_start[ray_key[i]]++] = i;
+  }
+
+  /* Split the sorted rays into packets that don't mix direction signs. */
+  int *packet_start = MEM_mallocN(sizeof(*packet_start) * (size_t)(rays_len + 1), __func__);
+  int packets_len = 0;
+  uint packet_signs = 0;
+  for (i = 0; i < rays_len; i++) {
+    const uint signs = ray_key[ray_order[i]] >> (3 * BVH_RAY_CELL_BITS);
+    if (packets_len == 0 || signs != packet_signs ||
+        i - packet_start[packets_len - 1] == BVH_RAY_PACKET_SIZE) {
+      packet_start[packets_len++] = i;
+      packet_signs = signs;
+    }
+  }
+  packet_start[packets_len] = rays_len;
+
+  MEM_freeN(ray_key);
+  MEM_freeN(key_start);
+
+  BVHRayCastBatchData batch = {
+      .tree = tree,
+      .co = co,
+      .dir = dir,
+      .radius = radius,
+      .hits = hits,
+      .callback = callback,
+      .userdata = userdata,
+      .flag = flag,
+      .ray_order = ray_order,
+      .packet_start = packet_start,
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (rays_len > KDOPBVH_THREAD_LEAF_THRESHOLD);
+  settings.min_iter_per_thread = 16;
+  BLI_task_parallel_range(0, packets_len, &batch, bvhtree_ray_cast_batch_task_cb, &settings);
+
+  MEM_freeN(ray_order);
+  MEM_freeN(packet_start);
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_bvhtree_range_query
  *
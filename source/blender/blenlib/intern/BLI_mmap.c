@@ -0,0 +1,250 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup bli
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_fileops.h"
+#include "BLI_listbase.h"
+#include "BLI_mmap.h"
+#include "BLI_utildefines.h"
+
+#include "atomic_ops.h"
+
+#ifdef WIN32
+#  include "BLI_winstuff.h"
+#  include <io.h>
+#else
+#  include <signal.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+struct BLI_mmap_file {
+  /* Start of the mapped memory. */
+  char *memory;
+  /* Size of the file and the mapping. */
+  size_t length;
+  /* Platform specific handle of the mapping. */
+  void *handle;
+  /* Set from the signal handler, outside of the regular control flow. */
+  volatile bool io_error;
+};
+
+#ifndef WIN32
+/* IO errors while accessing mapped memory raise SIGBUS. The handler looks up the file that
+ * contains the faulting address, flags it and replaces its mapping with zero pages, so the
+ * interrupted access can continue. Readers check the flag after they are done.
+ * Faults outside of mapped files are passed on to the previous handler.
+ *
+ * Files are mapped and unmapped from any thread, e.g. while loading thumbnails or point caches,
+ * and the handler runs on the faulting thread while other threads may change the list. Mutexes
+ * are not async-signal-safe, so the list is guarded by a spin lock on atomics instead. A thread
+ * never accesses mapped memory while holding it, so the faulting thread never waits for itself. */
+
+static struct {
+  ListBase open_files;
+  uint32_t lock;
+  bool is_configured;
+  struct sigaction next_action;
+} sigbus_handler_data = {{NULL, NULL}};
+
+static void sigbus_handler_lock(void)
+{
+  while (atomic_cas_uint32(&sigbus_handler_data.lock, 0, 1) != 0) {
+    /* Spin, the lock is only held for a few list operations. */
+  }
+}
+
+static void sigbus_handler_unlock(void)
+{
+  atomic_fetch_and_and_uint32(&sigbus_handler_data.lock, 0);
+}
+
+static void sigbus_handler(int sig, siginfo_t *siginfo, void *context)
+{
+  BLI_assert(sig == SIGBUS);
+
+  const char *error_address = (const char *)siginfo->si_addr;
+  sigbus_handler_lock();
+  LISTBASE_FOREACH (LinkData *, link, &sigbus_handler_data.open_files) {
+    BLI_mmap_file *file = link->data;
+    if (error_address >= file->memory && error_address < file->memory + file->length) {
+      file->io_error = true;
+      if (mmap(file->memory,
+               file->length,
+               PROT_READ,
+               MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS,
+               -1,
+               0) == MAP_FAILED) {
+        /* Nothing sensible left to do, the access would fault again. */
+        abort();
+      }
+      sigbus_handler_unlock();
+      return;
+    }
+  }
+  sigbus_handler_unlock();
+
+  const struct sigaction *next_action = &sigbus_handler_data.next_action;
+  if (next_action->sa_flags & SA_SIGINFO) {
+    next_action->sa_sigaction(sig, siginfo, context);
+  }
+  else if (!ELEM(next_action->sa_handler, SIG_DFL, SIG_IGN)) {
+    next_action->sa_handler(sig);
+  }
+  else {
+    fprintf(stderr, "Unhandled SIGBUS caught\n");
+    abort();
+  }
+}
+
+/* Install the handler on first use and register the file with it. */
+static bool sigbus_handler_add(BLI_mmap_file *file)
+{
+  LinkData *link = BLI_genericNodeN(file);
+  bool ok = true;
+
+  sigbus_handler_lock();
+  if (!sigbus_handler_data.is_configured) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    action.sa_sigaction = sigbus_handler;
+    action.sa_flags = SA_SIGINFO;
+    ok = (sigaction(SIGBUS, &action, &sigbus_handler_data.next_action) == 0);
+    sigbus_handler_data.is_configured = ok;
+  }
+  if (ok) {
+    BLI_addtail(&sigbus_handler_data.open_files, link);
+  }
+  sigbus_handler_unlock();
+
+  if (!ok) {
+    MEM_freeN(link);
+  }
+  return ok;
+}
+
+static void sigbus_handler_remove(BLI_mmap_file *file)
+{
+  sigbus_handler_lock();
+  LinkData *link = BLI_findptr(&sigbus_handler_data.open_files, file, offsetof(LinkData, data));
+  BLI_remlink(&sigbus_handler_data.open_files, link);
+  sigbus_handler_unlock();
+
+  MEM_freeN(link);
+}
+#endif
+
+BLI_mmap_file *BLI_mmap_open(int fd)
+{
+  const size_t length = BLI_file_descriptor_size(fd);
+  /* Also catches errors, which are reported as `(size_t)-1`. */
+  if (length == 0 || length == (size_t)-1) {
+    return NULL;
+  }
+
+  void *memory, *handle = NULL;
+
+#ifdef WIN32
+  HANDLE file_handle = (HANDLE)_get_osfhandle(fd);
+  if (file_handle == INVALID_HANDLE_VALUE) {
+    return NULL;
+  }
+  handle = CreateFileMapping(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (handle == NULL) {
+    return NULL;
+  }
+  memory = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+  if (memory == NULL) {
+    CloseHandle(handle);
+    return NULL;
+  }
+#else
+  memory = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (memory == MAP_FAILED) {
+    return NULL;
+  }
+#endif
+
+  BLI_mmap_file *file = MEM_callocN(sizeof(BLI_mmap_file), __func__);
+  file->memory = memory;
+  file->length = length;
+  file->handle = handle;
+
+#ifndef WIN32
+  if (!sigbus_handler_add(file)) {
+    munmap(memory, length);
+    MEM_freeN(file);
+    return NULL;
+  }
+#endif
+
+  return file;
+}
+
+bool BLI_mmap_read(BLI_mmap_file *file, void *dest, size_t offset, size_t length)
+{
+  /* Written this way so it can't overflow. */
+  if (offset > file->length || length > file->length - offset) {
+    return false;
+  }
+  if (file->io_error) {
+    return false;
+  }
+
+  memcpy(dest, file->memory + offset, length);
+
+  return !file->io_error;
+}
+
+void *BLI_mmap_get_pointer(BLI_mmap_file *file)
+{
+  return file->memory;
+}
+
+size_t BLI_mmap_get_length(const BLI_mmap_file *file)
+{
+  return file->length;
+}
+
+bool BLI_mmap_any_io_error(const BLI_mmap_file *file)
+{
+  return file->io_error;
+}
+
+void BLI_mmap_free(BLI_mmap_file *file)
+{
+#ifdef WIN32
+  UnmapViewOfFile(file->memory);
+  CloseHandle(file->handle);
+#else
+  /* Unregister first, the handler must not map zero pages over memory that is reused. */
+  sigbus_handler_remove(file);
+  munmap(file->memory, file->length);
+#endif
+
+  MEM_freeN(file);
+}
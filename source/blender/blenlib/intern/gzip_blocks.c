@@ -0,0 +1,577 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup bli
+ *
+ * File layout, all numbers are little endian:
+ * - Blocks: gzip members, each of them decompresses to #BLI_GZIP_BLOCKS_BLOCK_SIZE bytes,
+ *   except for the last one.
+ * - Seek table: empty gzip members with an extra sub-field `BT`, holding the compressed size of
+ *   every block as `uint32`, in order.
+ * - Footer: an empty gzip member of #FOOTER_SIZE bytes with an extra sub-field `BF`, holding the
+ *   offset of the seek table (`uint64`), the uncompressed size (`uint64`), the uncompressed block
+ *   size (`uint32`) and the number of blocks (`uint32`).
+ */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zlib.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "atomic_ops.h"
+
+#include "BLI_fileops.h"
+#include "BLI_gzip_blocks.h"
+#include "BLI_math_base.h"
+#include "BLI_mmap.h"
+#include "BLI_task.h"
+#include "BLI_utildefines.h"
+
+#ifdef WIN32
+#  include "BLI_winstuff.h"
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif
+
+/* Blocks compressed together, per thread. */
+#define BATCH_BLOCKS_PER_THREAD 2
+/* Fits in the 16 bit length of an extra field. */
+#define SEEK_TABLE_MEMBER_BLOCKS_NUM 16000
+
+#define EMPTY_MEMBER_SIZE(data_len) (10 + 2 + 4 + (data_len) + 2 + 8)
+#define FOOTER_DATA_SIZE 24
+#define FOOTER_SIZE EMPTY_MEMBER_SIZE(FOOTER_DATA_SIZE)
+
+/* -------------------------------------------------------------------- */
+/** \name Empty Members
+ * \{ */
+
+static void write_uint16(uchar *dst, const uint value)
+{
+  dst[0] = (uchar)(value & 0xff);
+  dst[1] = (uchar)((value >> 8) & 0xff);
+}
+
+static void write_uint32(uchar *dst, const uint32_t value)
+{
+  write_uint16(dst, value & 0xffff);
+  write_uint16(dst + 2, value >> 16);
+}
+
+static void write_uint64(uchar *dst, const uint64_t value)
+{
+  write_uint32(dst, (uint32_t)(value & 0xffffffff));
+  write_uint32(dst + 4, (uint32_t)(value >> 32));
+}
+
+static uint read_uint16(const uchar *src)
+{
+  return (uint)src[0] | ((uint)src[1] << 8);
+}
+
+static uint32_t read_uint32(const uchar *src)
+{
+  return (uint32_t)read_uint16(src) | ((uint32_t)read_uint16(src + 2) << 16);
+}
+
+static uint64_t read_uint64(const uchar *src)
+{
+  return (uint64_t)read_uint32(src) | ((uint64_t)read_uint32(src + 4) << 32);
+}
+
+/* Gzip member that decompresses to nothing, with the data in an extra sub-field. */
+static size_t empty_member_write(uchar *dst, const char id[2], const uchar *data, uint data_len)
+{
+  BLI_assert(data_len + 4 <= 0xffff);
+  /* Magic, deflate, #FEXTRA flag, no time, no extra flags, unknown OS. */
+  const uchar header[10] = {0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 255};
+
+  uchar *p = dst;
+  memcpy(p, header, sizeof(header));
+  p += sizeof(header);
+  write_uint16(p, data_len + 4);
+  p += 2;
+  p[0] = (uchar)id[0];
+  p[1] = (uchar)id[1];
+  write_uint16(p + 2, data_len);
+  p += 4;
+  memcpy(p, data, data_len);
+  p += data_len;
+  /* Final fixed Huffman block that only contains the end of block code. */
+  p[0] = 0x03;
+  p[1] = 0x00;
+  p += 2;
+  /* CRC and size of no data. */
+  memset(p, 0, 8);
+  p += 8;
+
+  BLI_assert((size_t)(p - dst) == EMPTY_MEMBER_SIZE(data_len));
+  return (size_t)(p - dst);
+}
+
+/* Data of a member written by #empty_member_write, NULL when there is no such member. */
+static const uchar *empty_member_read(const uchar *src,
+                                      const size_t src_len,
+                                      const char id[2],
+                                      uint *r_data_len)
+{
+  if (src_len < EMPTY_MEMBER_SIZE(0)) {
+    return NULL;
+  }
+  if (src[0] != 0x1f || src[1] != 0x8b || src[2] != 8 || src[3] != 4) {
+    return NULL;
+  }
+  if (src[12] != (uchar)id[0] || src[13] != (uchar)id[1]) {
+    return NULL;
+  }
+  const uint data_len = read_uint16(src + 14);
+  if (read_uint16(src + 10) != data_len + 4 || EMPTY_MEMBER_SIZE(data_len) > src_len) {
+    return NULL;
+  }
+  const uchar *end = src + 16 + data_len;
+  if (end[0] != 0x03 || end[1] != 0x00) {
+    return NULL;
+  }
+
+  *r_data_len = data_len;
+  return src + 16;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Writing
+ * \{ */
+
+struct GzipBlocksWriter {
+  int file;
+  int level;
+
+  /* Uncompressed data of a batch of blocks, which are compressed on multiple threads. */
+  uchar *batch_data;
+  size_t batch_data_len;
+  int batch_blocks_num;
+  /* Compressed blocks of the batch, each with #compressed_capacity bytes. */
+  uchar **compressed;
+  size_t *compressed_sizes;
+  size_t compressed_capacity;
+
+  /* Compressed size of every block written so far. */
+  uint32_t *block_sizes;
+  int blocks_num;
+  int blocks_alloc;
+
+  uint64_t uncompressed_size;
+  uint64_t compressed_size;
+  bool error;
+};
+
+static bool write_all(int file, const uchar *data, size_t data_len)
+{
+  while (data_len > 0) {
+    const int64_t written = write(file, data, data_len);
+    if (written <= 0) {
+      return false;
+    }
+    data += written;
+    data_len -= (size_t)written;
+  }
+  return true;
+}
+
+GzipBlocksWriter *BLI_gzip_blocks_writer_open(const char *filepath, int level)
+{
+  const int file = BLI_open(filepath, O_BINARY | O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (file == -1) {
+    return NULL;
+  }
+
+  GzipBlocksWriter *writer = MEM_callocN(sizeof(*writer), __func__);
+  writer->file = file;
+  writer->level = level;
+
+  writer->batch_blocks_num = max_ii(BLI_task_scheduler_num_threads(), 1) *
+                             BATCH_BLOCKS_PER_THREAD;
+  writer->batch_data = MEM_mallocN((size_t)writer->batch_blocks_num * BLI_GZIP_BLOCKS_BLOCK_SIZE,
+                                   "GzipBlocksWriter.batch_data");
+  /* The gzip header and trailer are 12 bytes larger than the ones of zlib. */
+  writer->compressed_capacity = compressBound(BLI_GZIP_BLOCKS_BLOCK_SIZE) + 12;
+  writer->compressed = MEM_malloc_arrayN(
+      writer->batch_blocks_num, sizeof(*writer->compressed), "GzipBlocksWriter.compressed");
+  writer->compressed_sizes = MEM_malloc_arrayN(writer->batch_blocks_num,
+                                               sizeof(*writer->compressed_sizes),
+                                               "GzipBlocksWriter.compressed_sizes");
+  for (int i = 0; i < writer->batch_blocks_num; i++) {
+    writer->compressed[i] = MEM_mallocN(writer->compressed_capacity, "GzipBlocksWriter block");
+  }
+
+  return writer;
+}
+
+static void writer_compress_block_cb(void *__restrict userdata,
+                                     const int index,
+                                     const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  GzipBlocksWriter *writer = userdata;
+  const size_t offset = (size_t)index * BLI_GZIP_BLOCKS_BLOCK_SIZE;
+  const size_t len = MIN2((size_t)BLI_GZIP_BLOCKS_BLOCK_SIZE, writer->batch_data_len - offset);
+
+  /* Zero marks a failure. */
+  writer->compressed_sizes[index] = 0;
+
+  z_stream strm;
+  memset(&strm, 0, sizeof(strm));
+  /* Adding 16 to the window bits writes a gzip header and trailer. */
+  if (deflateInit2(&strm, writer->level, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) !=
+      Z_OK) {
+    return;
+  }
+  BLI_assert(deflateBound(&strm, len) <= writer->compressed_capacity);
+
+  strm.next_in = writer->batch_data + offset;
+  strm.avail_in = (uInt)len;
+  strm.next_out = writer->compressed[index];
+  strm.avail_out = (uInt)writer->compressed_capacity;
+  if (deflate(&strm, Z_FINISH) == Z_STREAM_END) {
+    writer->compressed_sizes[index] = strm.total_out;
+  }
+  deflateEnd(&strm);
+}
+
+static void writer_flush_batch(GzipBlocksWriter *writer)
+{
+  if (writer->batch_data_len == 0) {
+    return;
+  }
+
+  const int blocks_num = (int)((writer->batch_data_len + BLI_GZIP_BLOCKS_BLOCK_SIZE - 1) /
+                               BLI_GZIP_BLOCKS_BLOCK_SIZE);
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(0, blocks_num, writer, writer_compress_block_cb, &settings);
+
+  if (writer->blocks_num + blocks_num > writer->blocks_alloc) {
+    writer->blocks_alloc = max_ii(writer->blocks_alloc * 2, writer->blocks_num + blocks_num);
+    writer->block_sizes = MEM_reallocN(writer->block_sizes,
+                                       sizeof(*writer->block_sizes) * writer->blocks_alloc);
+  }
+
+  for (int i = 0; i < blocks_num; i++) {
+    const size_t compressed_size = writer->compressed_sizes[i];
+    if (compressed_size == 0 ||
+        !write_all(writer->file, writer->compressed[i], compressed_size)) {
+      writer->error = true;
+    }
+    writer->block_sizes[writer->blocks_num++] = (uint32_t)compressed_size;
+    writer->compressed_size += compressed_size;
+  }
+
+  writer->uncompressed_size += writer->batch_data_len;
+  writer->batch_data_len = 0;
+}
+
+bool BLI_gzip_blocks_writer_write(GzipBlocksWriter *writer, const void *data, size_t data_len)
+{
+  const size_t batch_capacity = (size_t)writer->batch_blocks_num * BLI_GZIP_BLOCKS_BLOCK_SIZE;
+  const uchar *src = data;
+
+  while (data_len > 0) {
+    const size_t copy_len = MIN2(data_len, batch_capacity - writer->batch_data_len);
+    memcpy(writer->batch_data + writer->batch_data_len, src, copy_len);
+    writer->batch_data_len += copy_len;
+    src += copy_len;
+    data_len -= copy_len;
+
+    if (writer->batch_data_len == batch_capacity) {
+      writer_flush_batch(writer);
+    }
+  }
+
+  return !writer->error;
+}
+
+static void writer_write_seek_table(GzipBlocksWriter *writer)
+{
+  const uint64_t table_offset = writer->compressed_size;
+  uchar *member = MEM_mallocN(EMPTY_MEMBER_SIZE(SEEK_TABLE_MEMBER_BLOCKS_NUM * 4), __func__);
+  uchar *member_data = MEM_mallocN(SEEK_TABLE_MEMBER_BLOCKS_NUM * 4, __func__);
+
+  for (int start = 0; start < writer->blocks_num; start += SEEK_TABLE_MEMBER_BLOCKS_NUM) {
+    const int blocks_num = min_ii(SEEK_TABLE_MEMBER_BLOCKS_NUM, writer->blocks_num - start);
+    for (int i = 0; i < blocks_num; i++) {
+      write_uint32(member_data + i * 4, writer->block_sizes[start + i]);
+    }
+    const size_t member_size = empty_member_write(member, "BT", member_data, blocks_num * 4);
+    if (!write_all(writer->file, member, member_size)) {
+      writer->error = true;
+    }
+  }
+
+  uchar footer_data[FOOTER_DATA_SIZE];
+  write_uint64(footer_data, table_offset);
+  write_uint64(footer_data + 8, writer->uncompressed_size);
+  write_uint32(footer_data + 16, BLI_GZIP_BLOCKS_BLOCK_SIZE);
+  write_uint32(footer_data + 20, (uint32_t)writer->blocks_num);
+  const size_t footer_size = empty_member_write(member, "BF", footer_data, FOOTER_DATA_SIZE);
+  if (!write_all(writer->file, member, footer_size)) {
+    writer->error = true;
+  }
+
+  MEM_freeN(member_data);
+  MEM_freeN(member);
+}
+
+bool BLI_gzip_blocks_writer_close(GzipBlocksWriter *writer)
+{
+  writer_flush_batch(writer);
+  writer_write_seek_table(writer);
+
+  bool success = !writer->error;
+  if (close(writer->file) == -1) {
+    success = false;
+  }
+
+  for (int i = 0; i < writer->batch_blocks_num; i++) {
+    MEM_freeN(writer->compressed[i]);
+  }
+  MEM_freeN(writer->compressed);
+  MEM_freeN(writer->compressed_sizes);
+  MEM_freeN(writer->batch_data);
+  MEM_SAFE_FREE(writer->block_sizes);
+  MEM_freeN(writer);
+
+  return success;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Reading
+ * \{ */
+
+/* Uncompressed size of blocks that are accepted, to keep corrupt files from requesting huge
+ * buffers. */
+#define READ_BLOCK_SIZE_MAX (64 << 20)
+
+struct GzipBlocksReader {
+  BLI_mmap_file *mmap_file;
+  const uchar *src;
+  /* Compressed offset of every block, followed by the offset of the seek table. */
+  uint64_t *block_offsets;
+  uint32_t blocks_num;
+  uint32_t block_size;
+  uint64_t uncompressed_size;
+
+  /* Decompressed data of a batch of blocks, which are decompressed on multiple threads. */
+  uchar *batch_data;
+  size_t batch_data_len;
+  size_t batch_read_len;
+  uint32_t batch_blocks_num;
+  /* First block of the next batch. */
+  uint32_t next_block;
+  uint32_t errors_num;
+};
+
+/* Read the footer and the seek table, false when they are missing or corrupt. */
+static bool reader_read_seek_table(GzipBlocksReader *reader, const size_t src_len)
+{
+  const uchar *src = reader->src;
+  if (src_len < FOOTER_SIZE) {
+    return false;
+  }
+  const size_t table_end = src_len - FOOTER_SIZE;
+
+  uint footer_len;
+  const uchar *footer = empty_member_read(src + table_end, FOOTER_SIZE, "BF", &footer_len);
+  if (footer == NULL || footer_len != FOOTER_DATA_SIZE) {
+    return false;
+  }
+  const uint64_t table_offset = read_uint64(footer);
+  const uint64_t uncompressed_size = read_uint64(footer + 8);
+  const uint32_t block_size = read_uint32(footer + 16);
+  const uint32_t blocks_num = read_uint32(footer + 20);
+  if (table_offset > table_end || block_size == 0 || block_size > READ_BLOCK_SIZE_MAX ||
+      blocks_num > INT_MAX || blocks_num != (uncompressed_size + block_size - 1) / block_size) {
+    return false;
+  }
+  /* Every block takes four bytes in the table. */
+  if ((uint64_t)blocks_num * 4 > table_end - table_offset) {
+    return false;
+  }
+
+  uint64_t *block_offsets = MEM_malloc_arrayN(
+      (size_t)blocks_num + 1, sizeof(*block_offsets), __func__);
+  if (block_offsets == NULL) {
+    return false;
+  }
+  uint32_t blocks_read = 0;
+  uint64_t offset = 0;
+  for (size_t pos = table_offset; pos < table_end;) {
+    uint data_len;
+    const uchar *data = empty_member_read(src + pos, table_end - pos, "BT", &data_len);
+    if (data == NULL || data_len % 4 != 0 || blocks_read + data_len / 4 > blocks_num) {
+      MEM_freeN(block_offsets);
+      return false;
+    }
+    for (uint i = 0; i < data_len / 4; i++) {
+      block_offsets[blocks_read++] = offset;
+      offset += read_uint32(data + i * 4);
+    }
+    pos += EMPTY_MEMBER_SIZE(data_len);
+  }
+  if (blocks_read != blocks_num || offset != table_offset) {
+    MEM_freeN(block_offsets);
+    return false;
+  }
+  block_offsets[blocks_num] = table_offset;
+
+  reader->block_offsets = block_offsets;
+  reader->blocks_num = blocks_num;
+  reader->block_size = block_size;
+  reader->uncompressed_size = uncompressed_size;
+  return true;
+}
+
+GzipBlocksReader *BLI_gzip_blocks_reader_open(int file)
+{
+  /* Mapping avoids a copy of the compressed file and leaves the read position alone. */
+  BLI_mmap_file *mmap_file = BLI_mmap_open(file);
+  if (mmap_file == NULL) {
+    return NULL;
+  }
+
+  GzipBlocksReader *reader = MEM_callocN(sizeof(*reader), __func__);
+  reader->mmap_file = mmap_file;
+  reader->src = BLI_mmap_get_pointer(mmap_file);
+
+  if (!reader_read_seek_table(reader, BLI_mmap_get_length(mmap_file)) ||
+      BLI_mmap_any_io_error(mmap_file)) {
+    BLI_gzip_blocks_reader_close(reader);
+    return NULL;
+  }
+
+  reader->batch_blocks_num = (uint32_t)min_ii(
+      max_ii(BLI_task_scheduler_num_threads(), 1) * BATCH_BLOCKS_PER_THREAD,
+      max_ii((int)reader->blocks_num, 1));
+  reader->batch_data = MEM_mallocN((size_t)reader->batch_blocks_num * reader->block_size,
+                                   "GzipBlocksReader.batch_data");
+  if (reader->batch_data == NULL) {
+    BLI_gzip_blocks_reader_close(reader);
+    return NULL;
+  }
+
+  return reader;
+}
+
+static void reader_decompress_block_cb(void *__restrict userdata,
+                                       const int index,
+                                       const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  GzipBlocksReader *reader = userdata;
+  const uint32_t block = reader->next_block + (uint32_t)index;
+  const uint64_t dst_offset = (uint64_t)block * reader->block_size;
+  const uint64_t dst_len = MIN2(reader->block_size, reader->uncompressed_size - dst_offset);
+  const uint64_t src_offset = reader->block_offsets[block];
+  const uint64_t src_len = reader->block_offsets[block + 1] - src_offset;
+
+  z_stream strm;
+  memset(&strm, 0, sizeof(strm));
+  if (src_len > UINT_MAX || inflateInit2(&strm, 16 + MAX_WBITS) != Z_OK) {
+    atomic_add_and_fetch_uint32(&reader->errors_num, 1);
+    return;
+  }
+
+  strm.next_in = (Bytef *)(reader->src + src_offset);
+  strm.avail_in = (uInt)src_len;
+  strm.next_out = reader->batch_data + (size_t)index * reader->block_size;
+  strm.avail_out = (uInt)dst_len;
+  const int result = inflate(&strm, Z_FINISH);
+  if (result != Z_STREAM_END || strm.avail_in != 0 || strm.avail_out != 0) {
+    atomic_add_and_fetch_uint32(&reader->errors_num, 1);
+  }
+  inflateEnd(&strm);
+}
+
+/* Decompress the next batch of blocks, false at the end of the file or on errors. */
+static bool reader_decompress_batch(GzipBlocksReader *reader)
+{
+  if (reader->errors_num != 0 || reader->next_block == reader->blocks_num) {
+    return false;
+  }
+
+  const uint32_t blocks_num = MIN2(reader->batch_blocks_num,
+                                   reader->blocks_num - reader->next_block);
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(0, (int)blocks_num, reader, reader_decompress_block_cb, &settings);
+
+  if (BLI_mmap_any_io_error(reader->mmap_file)) {
+    reader->errors_num++;
+  }
+  if (reader->errors_num != 0) {
+    return false;
+  }
+
+  const uint64_t batch_start = (uint64_t)reader->next_block * reader->block_size;
+  reader->next_block += blocks_num;
+  const uint64_t batch_end = MIN2((uint64_t)reader->next_block * reader->block_size,
+                                  reader->uncompressed_size);
+  reader->batch_data_len = (size_t)(batch_end - batch_start);
+  reader->batch_read_len = 0;
+  return true;
+}
+
+int64_t BLI_gzip_blocks_reader_read(GzipBlocksReader *reader, void *data, size_t data_len)
+{
+  uchar *dst = data;
+  size_t read_len = 0;
+
+  while (read_len < data_len) {
+    if (reader->batch_read_len == reader->batch_data_len) {
+      if (!reader_decompress_batch(reader)) {
+        break;
+      }
+    }
+    const size_t copy_len = MIN2(data_len - read_len,
+                                 reader->batch_data_len - reader->batch_read_len);
+    memcpy(dst + read_len, reader->batch_data + reader->batch_read_len, copy_len);
+    reader->batch_read_len += copy_len;
+    read_len += copy_len;
+  }
+
+  if (reader->errors_num != 0) {
+    return -1;
+  }
+  return (int64_t)read_len;
+}
+
+void BLI_gzip_blocks_reader_close(GzipBlocksReader *reader)
+{
+  MEM_SAFE_FREE(reader->batch_data);
+  MEM_SAFE_FREE(reader->block_offsets);
+  BLI_mmap_free(reader->mmap_file);
+  MEM_freeN(reader);
+}
+
+/** \} */
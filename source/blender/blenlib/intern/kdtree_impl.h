@@ -22,6 +22,7 @@
 
 #include "BLI_kdtree_impl.h"
 #include "BLI_math.h"
+#include "BLI_task.h"
 #include "BLI_strict_flags.h"
 #include "BLI_utildefines.h"
 
@@ -58,6 +59,11 @@ struct KDTree {
 
 #define KD_NODE_UNSET ((uint)-1)
 
+/* Sub-trees with more nodes than this are balanced in a separate task. */
+#define KD_BALANCE_TASK_MIN 16384
+/* Number of queries per task in the batched searches. */
+#define KD_BATCH_CHUNK_SIZE 256
+
 /**
  * When set we know all values are unbalanced,
  * otherwise clear them when re-balancing: see T62210.
@@ -75,6 +81,13 @@ static void copy_vn_vn(float v0[KD_DIMS], const float v1[KD_DIMS])
   }
 }
 
+static void zero_vn(float v0[KD_DIMS])
+{
+  for (uint j = 0; j < KD_DIMS; j++) {
+    v0[j] = 0.0f;
+  }
+}
+
 static float len_squared_vnvn(const float v0[KD_DIMS], const float v1[KD_DIMS])
 {
   float d = 0.0f;
@@ -145,19 +158,12 @@ void BLI_kdtree_nd_(insert)(KDTree *tree, int index, const float co[KD_DIMS])
 #endif
 }
 
-static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
+/* Partially sort the nodes around the median on \a axis, returns the index of the median. */
+static uint kdtree_balance_partition(KDTreeNode *nodes, const uint nodes_len, const uint axis)
 {
-  KDTreeNode *node;
   float co;
   uint left, right, median, i, j;
 
-  if (nodes_len <= 0) {
-    return KD_NODE_UNSET;
-  }
-  else if (nodes_len == 1) {
-    return 0 + ofs;
-  }
-
   /* quicksort style sorting around median */
   left = 0;
   right = nodes_len - 1;
@@ -190,6 +196,23 @@ static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const u
     }
   }
 
+  return median;
+}
+
+static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
+{
+  KDTreeNode *node;
+  uint median;
+
+  if (nodes_len <= 0) {
+    return KD_NODE_UNSET;
+  }
+  else if (nodes_len == 1) {
+    return 0 + ofs;
+  }
+
+  median = kdtree_balance_partition(nodes, nodes_len, axis);
+
   /* set node and sort subnodes */
   node = &nodes[median];
   node->d = axis;
@@ -201,6 +224,59 @@ static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const u
   return median + ofs;
 }
 
+typedef struct KDTreeBalanceTask {
+  KDTreeNode *nodes;
+  uint nodes_len;
+  uint axis;
+  uint ofs;
+  /* Where to store the root of the balanced sub-tree. */
+  uint *r_root;
+} KDTreeBalanceTask;
+
+static uint kdtree_balance_threaded(
+    TaskPool *pool, KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs);
+
+static void kdtree_balance_task_run(TaskPool *__restrict pool, void *taskdata)
+{
+  KDTreeBalanceTask *task = taskdata;
+  *task->r_root = kdtree_balance_threaded(
+      pool, task->nodes, task->nodes_len, task->axis, task->ofs);
+}
+
+/**
+ * Same result as #kdtree_balance, the two halves of large sub-trees only touch their own nodes,
+ * so the left half is balanced in another task.
+ */
+static uint kdtree_balance_threaded(
+    TaskPool *pool, KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
+{
+  KDTreeNode *node;
+  uint median;
+
+  if (nodes_len < KD_BALANCE_TASK_MIN) {
+    return kdtree_balance(nodes, nodes_len, axis, ofs);
+  }
+
+  median = kdtree_balance_partition(nodes, nodes_len, axis);
+
+  node = &nodes[median];
+  node->d = axis;
+  axis = (axis + 1) % KD_DIMS;
+
+  KDTreeBalanceTask *task = MEM_mallocN(sizeof(*task), __func__);
+  task->nodes = nodes;
+  task->nodes_len = median;
+  task->axis = axis;
+  task->ofs = ofs;
+  task->r_root = &node->left;
+  BLI_task_pool_push(pool, kdtree_balance_task_run, task, true, NULL);
+
+  node->right = kdtree_balance_threaded(
+      pool, nodes + median + 1, (nodes_len - (median + 1)), axis, (median + 1) + ofs);
+
+  return median + ofs;
+}
+
 void BLI_kdtree_nd_(balance)(KDTree *tree)
 {
   if (tree->root != KD_NODE_ROOT_IS_INIT) {
@@ -210,7 +286,15 @@ void BLI_kdtree_nd_(balance)(KDTree *tree)
     }
   }
 
-  tree->root = kdtree_balance(tree->nodes, tree->nodes_len, 0, 0);
+  if (tree->nodes_len < KD_BALANCE_TASK_MIN) {
+    tree->root = kdtree_balance(tree->nodes, tree->nodes_len, 0, 0);
+  }
+  else {
+    TaskPool *pool = BLI_task_pool_create(NULL, TASK_PRIORITY_HIGH);
+    tree->root = kdtree_balance_threaded(pool, tree->nodes, tree->nodes_len, 0, 0);
+    BLI_task_pool_work_and_wait(pool);
+    BLI_task_pool_free(pool);
+  }
 
 #ifdef DEBUG
   tree->is_balanced = true;
@@ -230,18 +314,30 @@ static uint *realloc_nodes(uint *stack, uint *stack_len_capacity, const bool is_
   return stack_new;
 }
 
-/**
- * Find nearest returns index, and -1 if no node is found.
- */
-int BLI_kdtree_nd_(find_nearest)(const KDTree *tree,
-                                 const float co[KD_DIMS],
-                                 KDTreeNearest *r_nearest)
+/* Traversal stack, starts out as a fixed size buffer and moves to the heap when it is full. */
+typedef struct KDTreeStack {
+  uint *data;
+  uint capacity;
+  bool is_alloc;
+} KDTreeStack;
+
+BLI_INLINE void kdtree_stack_ensure(KDTreeStack *stack, const uint cur)
+{
+  if (UNLIKELY(cur + KD_DIMS > stack->capacity)) {
+    stack->data = realloc_nodes(stack->data, &stack->capacity, stack->is_alloc);
+    stack->is_alloc = true;
+  }
+}
+
+static int kdtree_find_nearest_ex(const KDTree *tree,
+                                  const float co[KD_DIMS],
+                                  KDTreeNearest *r_nearest,
+                                  KDTreeStack *stack)
 {
   const KDTreeNode *nodes = tree->nodes;
   const KDTreeNode *root, *min_node;
-  uint *stack, stack_default[KD_STACK_INIT];
   float min_dist, cur_dist;
-  uint stack_len_capacity, cur = 0;
+  uint cur = 0;
 
 #ifdef DEBUG
   BLI_assert(tree->is_balanced == true);
@@ -251,32 +347,29 @@ int BLI_kdtree_nd_(find_nearest)(const KDTree *tree,
     return -1;
   }
 
-  stack = stack_default;
-  stack_len_capacity = KD_STACK_INIT;
-
   root = &nodes[tree->root];
   min_node = root;
   min_dist = len_squared_vnvn(root->co, co);
 
   if (co[root->d] < root->co[root->d]) {
     if (root->right != KD_NODE_UNSET) {
-      stack[cur++] = root->right;
+      stack->data[cur++] = root->right;
     }
     if (root->left != KD_NODE_UNSET) {
-      stack[cur++] = root->left;
+      stack->data[cur++] = root->left;
     }
   }
   else {
     if (root->left != KD_NODE_UNSET) {
-      stack[cur++] = root->left;
+      stack->data[cur++] = root->left;
     }
     if (root->right != KD_NODE_UNSET) {
-      stack[cur++] = root->right;
+      stack->data[cur++] = root->right;
     }
   }
 
   while (cur--) {
-    const KDTreeNode *node = &nodes[stack[cur]];
+    const KDTreeNode *node = &nodes[stack->data[cur]];
 
     cur_dist = node->co[node->d] - co[node->d];
 
@@ -290,11 +383,11 @@ int BLI_kdtree_nd_(find_nearest)(const KDTree *tree,
           min_node = node;
         }
         if (node->left != KD_NODE_UNSET) {
-          stack[cur++] = node->left;
+          stack->data[cur++] = node->left;
         }
       }
       if (node->right != KD_NODE_UNSET) {
-        stack[cur++] = node->right;
+        stack->data[cur++] = node->right;
       }
     }
     else {
@@ -307,16 +400,14 @@ int BLI_kdtree_nd_(find_nearest)(const KDTree *tree,
           min_node = node;
         }
         if (node->right != KD_NODE_UNSET) {
-          stack[cur++] = node->right;
+          stack->data[cur++] = node->right;
         }
       }
       if (node->left != KD_NODE_UNSET) {
-        stack[cur++] = node->left;
+        stack->data[cur++] = node->left;
       }
     }
-    if (UNLIKELY(cur + KD_DIMS > stack_len_capacity)) {
-      stack = realloc_nodes(stack, &stack_len_capacity, stack_default != stack);
-    }
+    kdtree_stack_ensure(stack, cur);
   }
 
   if (r_nearest) {
@@ -325,11 +416,26 @@ int BLI_kdtree_nd_(find_nearest)(const KDTree *tree,
     copy_vn_vn(r_nearest->co, min_node->co);
   }
 
-  if (stack != stack_default) {
-    MEM_freeN(stack);
+  return min_node->index;
+}
+
+/**
+ * Find nearest returns index, and -1 if no node is found.
+ */
+int BLI_kdtree_nd_(find_nearest)(const KDTree *tree,
+                                 const float co[KD_DIMS],
+                                 KDTreeNearest *r_nearest)
+{
+  uint stack_default[KD_STACK_INIT];
+  KDTreeStack stack = {stack_default, KD_STACK_INIT, false};
+
+  const int index = kdtree_find_nearest_ex(tree, co, r_nearest, &stack);
+
+  if (stack.is_alloc) {
+    MEM_freeN(stack.data);
   }
 
-  return min_node->index;
+  return index;
 }
 
 /**
@@ -636,27 +742,21 @@ static void nearest_add_in_range(KDTreeNearest **r_nearest,
   copy_vn_vn(to->co, co);
 }
 
-/**
- * Range search returns number of points nearest_len, with results in nearest
- *
- * \param r_nearest: Allocated array of nearest nearest_len (caller is responsible for freeing).
- */
-int BLI_kdtree_nd_(range_search_with_len_squared_cb)(
-    const KDTree *tree,
-    const float co[KD_DIMS],
-    KDTreeNearest **r_nearest,
-    const float range,
-    float (*len_sq_fn)(const float co_search[KD_DIMS],
-                       const float co_test[KD_DIMS],
-                       const void *user_data),
-    const void *user_data)
+static int kdtree_range_search_ex(const KDTree *tree,
+                                  const float co[KD_DIMS],
+                                  KDTreeNearest **r_nearest,
+                                  const float range,
+                                  float (*len_sq_fn)(const float co_search[KD_DIMS],
+                                                     const float co_test[KD_DIMS],
+                                                     const void *user_data),
+                                  const void *user_data,
+                                  KDTreeStack *stack)
 {
   const KDTreeNode *nodes = tree->nodes;
-  uint *stack, stack_default[KD_STACK_INIT];
   KDTreeNearest *nearest = NULL;
   const float range_sq = range * range;
   float dist_sq;
-  uint stack_len_capacity, cur = 0;
+  uint cur = 0;
   uint nearest_len = 0, nearest_len_capacity = 0;
 
 #ifdef DEBUG
@@ -664,6 +764,7 @@ int BLI_kdtree_nd_(range_search_with_len_squared_cb)(
 #endif
 
   if (UNLIKELY(tree->root == KD_NODE_UNSET)) {
+    *r_nearest = NULL;
     return 0;
   }
 
@@ -672,22 +773,19 @@ int BLI_kdtree_nd_(range_search_with_len_squared_cb)(
     BLI_assert(user_data == NULL);
   }
 
-  stack = stack_default;
-  stack_len_capacity = ARRAY_SIZE(stack_default);
-
-  stack[cur++] = tree->root;
+  stack->data[cur++] = tree->root;
 
   while (cur--) {
-    const KDTreeNode *node = &nodes[stack[cur]];
+    const KDTreeNode *node = &nodes[stack->data[cur]];
 
     if (co[node->d] + range < node->co[node->d]) {
       if (node->left != KD_NODE_UNSET) {
-        stack[cur++] = node->left;
+        stack->data[cur++] = node->left;
       }
     }
     else if (co[node->d] - range > node->co[node->d]) {
       if (node->right != KD_NODE_UNSET) {
-        stack[cur++] = node->right;
+        stack->data[cur++] = node->right;
       }
     }
     else {
@@ -698,20 +796,14 @@ int BLI_kdtree_nd_(range_search_with_len_squared_cb)(
       }
 
       if (node->left != KD_NODE_UNSET) {
-        stack[cur++] = node->left;
+        stack->data[cur++] = node->left;
       }
       if (node->right != KD_NODE_UNSET) {
-        stack[cur++] = node->right;
+        stack->data[cur++] = node->right;
       }
     }
 
-    if (UNLIKELY(cur + KD_DIMS > stack_len_capacity)) {
-      stack = realloc_nodes(stack, &stack_len_capacity, stack_default != stack);
-    }
-  }
-
-  if (stack != stack_default) {
-    MEM_freeN(stack);
+    kdtree_stack_ensure(stack, cur);
   }
 
   if (nearest_len) {
@@ -723,6 +815,34 @@ int BLI_kdtree_nd_(range_search_with_len_squared_cb)(
   return (int)nearest_len;
 }
 
+/**
+ * Range search returns number of points nearest_len, with results in nearest
+ *
+ * \param r_nearest: Allocated array of nearest nearest_len (caller is responsible for freeing).
+ */
+int BLI_kdtree_nd_(range_search_with_len_squared_cb)(
+    const KDTree *tree,
+    const float co[KD_DIMS],
+    KDTreeNearest **r_nearest,
+    const float range,
+    float (*len_sq_fn)(const float co_search[KD_DIMS],
+                       const float co_test[KD_DIMS],
+                       const void *user_data),
+    const void *user_data)
+{
+  uint stack_default[KD_STACK_INIT];
+  KDTreeStack stack = {stack_default, KD_STACK_INIT, false};
+
+  const int nearest_len = kdtree_range_search_ex(
+      tree, co, r_nearest, range, len_sq_fn, user_data, &stack);
+
+  if (stack.is_alloc) {
+    MEM_freeN(stack.data);
+  }
+
+  return nearest_len;
+}
+
 int BLI_kdtree_nd_(range_search)(const KDTree *tree,
                                  const float co[KD_DIMS],
                                  KDTreeNearest **r_nearest,
@@ -731,6 +851,140 @@ int BLI_kdtree_nd_(range_search)(const KDTree *tree,
   return BLI_kdtree_nd_(range_search_with_len_squared_cb)(tree, co, r_nearest, range, NULL, NULL);
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Batched Queries
+ *
+ * Run many independent queries on the same tree in parallel. Every thread keeps its own
+ * traversal stack, so deep trees only move the stack to the heap once per thread instead of
+ * once per query.
+ * \{ */
+
+typedef struct KDTreeBatchData {
+  const KDTree *tree;
+  const float (*co)[KD_DIMS];
+  float range;
+  KDTreeNearest *r_nearest;
+  KDTreeNearest **r_nearest_range;
+  int *r_nearest_range_len;
+} KDTreeBatchData;
+
+typedef struct KDTreeBatchTLS {
+  KDTreeStack stack;
+  uint stack_default[KD_STACK_INIT];
+} KDTreeBatchTLS;
+
+static KDTreeStack *kdtree_batch_tls_stack(KDTreeBatchTLS *tls)
+{
+  if (tls->stack.data == NULL) {
+    tls->stack.data = tls->stack_default;
+    tls->stack.capacity = KD_STACK_INIT;
+    tls->stack.is_alloc = false;
+  }
+  else if (!tls->stack.is_alloc) {
+    /* The chunk may have been copied since the last query, don't point into the old copy. */
+    tls->stack.data = tls->stack_default;
+  }
+  return &tls->stack;
+}
+
+static void kdtree_batch_tls_free(const void *__restrict UNUSED(userdata),
+                                  void *__restrict chunk)
+{
+  KDTreeBatchTLS *tls = chunk;
+  if (tls->stack.is_alloc) {
+    MEM_freeN(tls->stack.data);
+  }
+}
+
+static void kdtree_find_nearest_batch_cb(void *__restrict userdata,
+                                         const int iter,
+                                         const TaskParallelTLS *__restrict tls)
+{
+  const KDTreeBatchData *data = userdata;
+  KDTreeNearest *r_nearest = &data->r_nearest[iter];
+  if (kdtree_find_nearest_ex(data->tree,
+                             data->co[iter],
+                             r_nearest,
+                             kdtree_batch_tls_stack(tls->userdata_chunk)) == -1) {
+    r_nearest->index = -1;
+    r_nearest->dist = FLT_MAX;
+    zero_vn(r_nearest->co);
+  }
+}
+
+static void kdtree_range_search_batch_cb(void *__restrict userdata,
+                                         const int iter,
+                                         const TaskParallelTLS *__restrict tls)
+{
+  const KDTreeBatchData *data = userdata;
+  data->r_nearest_range_len[iter] = kdtree_range_search_ex(
+      data->tree,
+      data->co[iter],
+      &data->r_nearest_range[iter],
+      data->range,
+      NULL,
+      NULL,
+      kdtree_batch_tls_stack(tls->userdata_chunk));
+}
+
+static void kdtree_batch_run(KDTreeBatchData *data, const uint co_len, TaskParallelRangeFunc func)
+{
+  KDTreeBatchTLS tls = {.stack = {.data = NULL}};
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = KD_BATCH_CHUNK_SIZE;
+  settings.userdata_chunk = &tls;
+  settings.userdata_chunk_size = sizeof(tls);
+  settings.func_free = kdtree_batch_tls_free;
+
+  BLI_task_parallel_range(0, (int)co_len, data, func, &settings);
+}
+
+/**
+ * Find the nearest point for every coordinate in \a co, in parallel.
+ *
+ * \param r_nearest: Array of \a co_len results. When the tree is empty the index is -1.
+ */
+void BLI_kdtree_nd_(find_nearest_batch)(const KDTree *tree,
+                                        const float (*co)[KD_DIMS],
+                                        const uint co_len,
+                                        KDTreeNearest *r_nearest)
+{
+  KDTreeBatchData data = {
+      .tree = tree,
+      .co = co,
+      .r_nearest = r_nearest,
+  };
+  kdtree_batch_run(&data, co_len, kdtree_find_nearest_batch_cb);
+}
+
+/**
+ * Range search for every coordinate in \a co, in parallel.
+ *
+ * \param r_nearest: Array of \a co_len result arrays, sorted by distance like
+ * #BLI_kdtree_3d_range_search. Every non-null array must be freed by the caller.
+ * \param r_nearest_len: Array of \a co_len result counts.
+ */
+void BLI_kdtree_nd_(range_search_batch)(const KDTree *tree,
+                                        const float (*co)[KD_DIMS],
+                                        const uint co_len,
+                                        const float range,
+                                        KDTreeNearest **r_nearest,
+                                        int *r_nearest_len)
+{
+  KDTreeBatchData data = {
+      .tree = tree,
+      .co = co,
+      .range = range,
+      .r_nearest_range = r_nearest,
+      .r_nearest_range_len = r_nearest_len,
+  };
+  kdtree_batch_run(&data, co_len, kdtree_range_search_batch_cb);
+}
+
+/** \} */
+
 /**
  * A version of #BLI_kdtree_3d_range_search which runs a callback
  * instead of allocating an array.
@@ -23,6 +23,7 @@
 #include "MEM_guardedalloc.h"
 
 #include "BLI_task.h"
+#include "BLI_task_profile.hh"
 
 #include <memory>
 #include <vector>
@@ -54,6 +55,8 @@ struct TaskNode {
 #endif
   /* Successors to execute after this task, for serial execution fallback. */
   std::vector<TaskNode *> successors;
+  /* Graph the node belongs to, to identify it in task profiles. */
+  TaskGraph *task_graph;
 
   /* User function to be executed with given task data. */
   TaskGraphNodeRunFunction run_func;
@@ -72,13 +75,11 @@ struct TaskNode {
                  tbb::flow::unlimited,
                  std::bind(&TaskNode::run, this, std::placeholders::_1)),
 #endif
+        task_graph(task_graph),
         run_func(run_func),
         task_data(task_data),
         free_func(free_func)
   {
-#ifndef WITH_TBB
-    UNUSED_VARS(task_graph);
-#endif
   }
 
   TaskNode(const TaskNode &other) = delete;
@@ -94,6 +95,7 @@ struct TaskNode {
 #ifdef WITH_TBB
   tbb::flow::continue_msg run(const tbb::flow::continue_msg UNUSED(input))
   {
+    blender::task_profile::Scope profile(blender::task_profile::EventType::GraphNode, task_graph);
     tbb::this_task_arena::isolate([this] { run_func(task_data); });
     return tbb::flow::continue_msg();
   }
@@ -101,7 +103,11 @@ struct TaskNode {
 
   void run_serial()
   {
-    run_func(task_data);
+    {
+      blender::task_profile::Scope profile(blender::task_profile::EventType::GraphNode,
+                                           task_graph);
+      run_func(task_data);
+    }
     for (TaskNode *successor : successors) {
       successor->run_serial();
     }
@@ -148,9 +148,16 @@ static void parallel_iterator_func_do(TaskParallelIteratorState *__restrict stat
       BLI_spin_unlock(state->iter_shared.spin_lock);
     }
 
+    const uint64_t profile_begin = BLI_task_profile_iterator_begin();
     for (i = 0; i < current_chunk_size; ++i) {
       state->func(state->userdata, current_chunk_items[i], current_chunk_indices[i], &tls);
     }
+    if (current_chunk_size != 0) {
+      BLI_task_profile_iterator_end((const void *)state->func,
+                                    profile_begin,
+                                    current_chunk_indices[0],
+                                    current_chunk_indices[current_chunk_size - 1] + 1);
+    }
   }
 
   MALLOCA_FREE(current_chunk_items, items_size);
@@ -357,9 +364,11 @@ static void parallel_mempool_func(TaskPool *__restrict pool, void *taskdata)
   BLI_mempool_iter *iter = taskdata;
   MempoolIterData *item;
 
+  const uint64_t profile_begin = BLI_task_profile_iterator_begin();
   while ((item = BLI_mempool_iterstep(iter)) != NULL) {
     state->func(state->userdata, item);
   }
+  BLI_task_profile_iterator_end((const void *)state->func, profile_begin, 0, 0);
 }
 
 /**
@@ -391,10 +400,12 @@ void BLI_task_parallel_mempool(BLI_mempool *mempool,
     BLI_mempool_iter iter;
     BLI_mempool_iternew(mempool, &iter);
 
+    const uint64_t profile_begin = BLI_task_profile_iterator_begin();
     for (void *item = BLI_mempool_iterstep(&iter); item != NULL;
          item = BLI_mempool_iterstep(&iter)) {
       func(userdata, item);
     }
+    BLI_task_profile_iterator_end((const void *)func, profile_begin, 0, 0);
     return;
   }
 
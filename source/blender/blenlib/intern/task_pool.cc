@@ -31,6 +31,7 @@
 #include "BLI_math.h"
 #include "BLI_mempool.h"
 #include "BLI_task.h"
+#include "BLI_task_profile.hh"
 #include "BLI_threads.h"
 
 #ifdef WITH_TBB
@@ -114,6 +115,7 @@ class Task {
   /* Execute task. */
   void operator()() const
   {
+    blender::task_profile::Scope profile(blender::task_profile::EventType::PoolTask, pool);
 #ifdef WITH_TBB
     tbb::this_task_arena::isolate([this] { run(pool, taskdata); });
 #else
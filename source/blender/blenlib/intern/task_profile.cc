@@ -0,0 +1,255 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup bli
+ *
+ * Task profiler, per-thread recording of task execution and Chrome trace export.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <vector>
+
+#include "BLI_fileops.h"
+#include "BLI_task.h"
+#include "BLI_task_profile.hh"
+#include "BLI_threads.h"
+#include "BLI_utildefines.h"
+
+namespace blender::task_profile {
+
+/* Number of events kept per thread, about 1.3 MB per thread that ran a task while recording. */
+#define TASK_PROFILE_THREAD_EVENTS_NUM (1 << 15)
+
+struct Event {
+  uint64_t begin;
+  uint64_t end;
+  const void *id;
+  int range_begin;
+  int range_end;
+  EventType type;
+};
+
+/**
+ * Ring buffer of a single thread. Only the owning thread writes events, the total number of
+ * events written is published after the event itself, so a reader can tell which slots may have
+ * been overwritten while it was copying them.
+ */
+struct ThreadBuffer {
+  int thread_index;
+  bool is_main_thread;
+  std::atomic<uint64_t> events_num{0};
+  /* Events before this index were discarded by #BLI_task_profile_clear. */
+  std::atomic<uint64_t> events_cleared_num{0};
+  Event events[TASK_PROFILE_THREAD_EVENTS_NUM];
+};
+
+std::atomic<bool> is_enabled{false};
+
+static uint64_t start_time = 0;
+
+/* Buffers are kept until exit, threads may end while their events are still needed. The lock
+ * is only taken when a thread records its first event and when writing the trace. */
+static std::mutex buffers_mutex;
+static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+static thread_local ThreadBuffer *thread_buffer = nullptr;
+
+uint64_t time_now()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static ThreadBuffer *thread_buffer_ensure()
+{
+  if (thread_buffer == nullptr) {
+    std::unique_ptr<ThreadBuffer> buffer = std::make_unique<ThreadBuffer>();
+    buffer->is_main_thread = BLI_thread_is_main();
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    buffer->thread_index = (int)buffers.size();
+    thread_buffer = buffer.get();
+    buffers.push_back(std::move(buffer));
+  }
+  return thread_buffer;
+}
+
+void record(EventType type, const void *id, uint64_t begin, int range_begin, int range_end)
+{
+  ThreadBuffer *buffer = thread_buffer_ensure();
+  const uint64_t index = buffer->events_num.load(std::memory_order_relaxed);
+
+  Event &event = buffer->events[index % TASK_PROFILE_THREAD_EVENTS_NUM];
+  event.begin = begin;
+  event.end = time_now();
+  event.id = id;
+  event.range_begin = range_begin;
+  event.range_end = range_end;
+  event.type = type;
+
+  buffer->events_num.store(index + 1, std::memory_order_release);
+}
+
+/* Copy the events of a buffer that are still valid, oldest first. */
+static std::vector<Event> thread_buffer_events_get(const ThreadBuffer &buffer)
+{
+  const uint64_t capacity = TASK_PROFILE_THREAD_EVENTS_NUM;
+  const uint64_t end = buffer.events_num.load(std::memory_order_acquire);
+  const uint64_t start = std::max(buffer.events_cleared_num.load(std::memory_order_relaxed),
+                                  (end > capacity) ? end - capacity : 0);
+
+  std::vector<Event> events;
+  events.reserve(end - start);
+  for (uint64_t i = start; i < end; i++) {
+    events.push_back(buffer.events[i % capacity]);
+  }
+
+  /* Slots the owning thread started overwriting while they were copied. */
+  const uint64_t end_after = buffer.events_num.load(std::memory_order_acquire);
+  if (end_after + 1 > start + capacity) {
+    const uint64_t overwritten_num = std::min(end_after + 1 - capacity - start, end - start);
+    events.erase(events.begin(), events.begin() + (int64_t)overwritten_num);
+  }
+  return events;
+}
+
+static const char *event_type_name(const EventType type)
+{
+  switch (type) {
+    case EventType::PoolTask:
+      return "task_pool";
+    case EventType::GraphNode:
+      return "task_graph";
+    case EventType::RangeChunk:
+      return "parallel_range";
+    case EventType::ParallelForChunk:
+      return "parallel_for";
+    case EventType::IteratorChunk:
+      return "parallel_iterator";
+  }
+  return "";
+}
+
+static void trace_event_write(FILE *file, const Event &event, const int thread_index)
+{
+  const char *type_name = event_type_name(event.type);
+  /* Events may have started before the recording did, when it was enabled while they ran. */
+  const uint64_t begin = std::max(event.begin, start_time);
+
+  fprintf(file,
+          ",\n{\"name\":\"%s %p\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+          "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"id\":\"%p\"",
+          type_name,
+          event.id,
+          type_name,
+          thread_index,
+          (double)(begin - start_time) / 1000.0,
+          (double)(event.end - begin) / 1000.0,
+          event.id);
+  /* Mempool loops have no indices. */
+  if (event.range_end > event.range_begin) {
+    fprintf(file, ",\"begin\":%d,\"end\":%d", event.range_begin, event.range_end);
+  }
+  fprintf(file, "}}");
+}
+
+}  // namespace blender::task_profile
+
+using namespace blender::task_profile;
+
+void BLI_task_profile_enable(bool enable)
+{
+  if (enable && start_time == 0) {
+    start_time = time_now();
+  }
+  is_enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool BLI_task_profile_is_enabled(void)
+{
+  return is_enabled.load(std::memory_order_relaxed);
+}
+
+void BLI_task_profile_clear(void)
+{
+  std::lock_guard<std::mutex> lock(buffers_mutex);
+  for (std::unique_ptr<ThreadBuffer> &buffer : buffers) {
+    buffer->events_cleared_num.store(buffer->events_num.load(std::memory_order_acquire),
+                                     std::memory_order_relaxed);
+  }
+  start_time = time_now();
+}
+
+uint64_t BLI_task_profile_iterator_begin(void)
+{
+  return is_enabled.load(std::memory_order_relaxed) ? time_now() : 0;
+}
+
+void BLI_task_profile_iterator_end(const void *func,
+                                   uint64_t begin,
+                                   int index_begin,
+                                   int index_end)
+{
+  if (begin != 0) {
+    record(EventType::IteratorChunk, func, begin, index_begin, index_end);
+  }
+}
+
+bool BLI_task_profile_write_chrome_trace(const char *filepath)
+{
+  FILE *file = BLI_fopen(filepath, "w");
+  if (file == nullptr) {
+    return false;
+  }
+
+  /* The process name doubles as first element, so every event can be written with a leading
+   * separator. */
+  fprintf(file,
+          "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+          "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Blender\"}}");
+
+  std::lock_guard<std::mutex> lock(buffers_mutex);
+  for (const std::unique_ptr<ThreadBuffer> &buffer : buffers) {
+    if (buffer->is_main_thread) {
+      fprintf(file,
+              ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+              "\"args\":{\"name\":\"Main Thread\"}}",
+              buffer->thread_index);
+    }
+    else {
+      fprintf(file,
+              ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+              "\"args\":{\"name\":\"Worker Thread %d\"}}",
+              buffer->thread_index,
+              buffer->thread_index);
+    }
+
+    for (const Event &event : thread_buffer_events_get(*buffer)) {
+      if (event.end >= start_time) {
+        trace_event_write(file, event, buffer->thread_index);
+      }
+    }
+  }
+
+  fprintf(file, "\n]}\n");
+  const bool ok = (ferror(file) == 0);
+  fclose(file);
+  return ok;
+}
@@ -27,6 +27,7 @@
 #include "DNA_listBase.h"
 
 #include "BLI_task.h"
+#include "BLI_task_profile.hh"
 #include "BLI_threads.h"
 
 #include "atomic_ops.h"
@@ -89,6 +90,10 @@ struct RangeTask {
 
   void operator()(const tbb::blocked_range<int> &r) const
   {
+    blender::task_profile::Scope profile(blender::task_profile::EventType::RangeChunk,
+                                         (const void *)func,
+                                         r.begin(),
+                                         r.end());
     tbb::this_task_arena::isolate([this, r] {
       TaskParallelTLS tls;
       tls.userdata_chunk = userdata_chunk;
@@ -136,8 +141,12 @@ void BLI_task_parallel_range(const int start,
    * main userdata chunk directly. */
   TaskParallelTLS tls;
   tls.userdata_chunk = settings->userdata_chunk;
-  for (int i = start; i < stop; i++) {
-    func(userdata, i, &tls);
+  {
+    blender::task_profile::Scope profile(
+        blender::task_profile::EventType::RangeChunk, (const void *)func, start, stop);
+    for (int i = start; i < stop; i++) {
+      func(userdata, i, &tls);
+    }
   }
   if (settings->func_free != NULL) {
     settings->func_free(userdata, settings->userdata_chunk);
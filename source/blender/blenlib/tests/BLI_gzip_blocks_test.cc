@@ -0,0 +1,176 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+#include <cstdio>
+#include <fcntl.h>
+#include <string>
+#include <vector>
+
+#include "zlib.h"
+
+#include "BLI_fileops.h"
+#include "BLI_gzip_blocks.h"
+#include "BLI_rand.hh"
+
+#ifdef WIN32
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif
+
+namespace blender::tests {
+
+/* Compressible data that differs between blocks. */
+static std::vector<char> gzip_blocks_test_data(const size_t size)
+{
+  std::vector<char> data(size);
+  RandomNumberGenerator rng(0);
+  for (size_t i = 0; i < size; i++) {
+    data[i] = (i % 7 == 0) ? (char)rng.get_int32(256) : (char)(i / 1000);
+  }
+  return data;
+}
+
+/* Read the whole file with uneven reads, false when it isn't written in blocks or corrupt. */
+static bool gzip_blocks_read(const std::string &filepath, std::vector<char> &r_data)
+{
+  const int file = BLI_open(filepath.c_str(), O_BINARY | O_RDONLY, 0);
+  EXPECT_NE(file, -1);
+  GzipBlocksReader *reader = BLI_gzip_blocks_reader_open(file);
+  close(file);
+  if (reader == nullptr) {
+    return false;
+  }
+
+  r_data.clear();
+  bool success = true;
+  for (size_t i = 0;; i++) {
+    const size_t len = 54321 + i % 3 * 1000000;
+    const size_t offset = r_data.size();
+    r_data.resize(offset + len);
+    const int64_t read_len = BLI_gzip_blocks_reader_read(reader, r_data.data() + offset, len);
+    if (read_len < 0) {
+      success = false;
+      break;
+    }
+    r_data.resize(offset + (size_t)read_len);
+    if ((size_t)read_len < len) {
+      break;
+    }
+  }
+  BLI_gzip_blocks_reader_close(reader);
+  return success;
+}
+
+static void gzip_blocks_write(const std::string &filepath, const std::vector<char> &data)
+{
+  GzipBlocksWriter *writer = BLI_gzip_blocks_writer_open(filepath.c_str(), 1);
+  ASSERT_NE(writer, nullptr);
+  /* Uneven writes, crossing block and batch boundaries. */
+  for (size_t offset = 0; offset < data.size();) {
+    const size_t len = std::min<size_t>(data.size() - offset, 12345 + offset % 100000);
+    EXPECT_TRUE(BLI_gzip_blocks_writer_write(writer, data.data() + offset, len));
+    offset += len;
+  }
+  EXPECT_TRUE(BLI_gzip_blocks_writer_close(writer));
+}
+
+/* Overwrite bytes of the file, counting from its end when \a offset is negative. */
+static void file_bytes_overwrite(const std::string &filepath,
+                                 const int64_t offset,
+                                 const std::vector<uchar> &bytes)
+{
+  FILE *file = BLI_fopen(filepath.c_str(), "r+b");
+  ASSERT_NE(file, nullptr);
+  fseek(file, (long)offset, (offset < 0) ? SEEK_END : SEEK_SET);
+  fwrite(bytes.data(), 1, bytes.size(), file);
+  fclose(file);
+}
+
+static void gzip_blocks_round_trip_test(const size_t size)
+{
+  const std::string filepath = testing::TempDir() + "blender_gzip_blocks_test.gz";
+  const std::vector<char> data = gzip_blocks_test_data(size);
+
+  gzip_blocks_write(filepath, data);
+
+  std::vector<char> result;
+  EXPECT_TRUE(gzip_blocks_read(filepath, result));
+  EXPECT_EQ(result, data);
+
+  /* The file is a regular gzip file as well. */
+  gzFile gz_file = (gzFile)BLI_gzopen(filepath.c_str(), "rb");
+  ASSERT_NE(gz_file, nullptr);
+  std::vector<char> gz_result(size + 1);
+  EXPECT_EQ(gzread(gz_file, gz_result.data(), (uint)gz_result.size()), (int)size);
+  EXPECT_EQ(memcmp(gz_result.data(), data.data(), size), 0);
+  gzclose(gz_file);
+
+  BLI_delete(filepath.c_str(), false, false);
+}
+
+TEST(gzip_blocks, RoundTripEmpty)
+{
+  gzip_blocks_round_trip_test(0);
+}
+
+TEST(gzip_blocks, RoundTripSmall)
+{
+  gzip_blocks_round_trip_test(1000);
+}
+
+TEST(gzip_blocks, RoundTripBlockSize)
+{
+  gzip_blocks_round_trip_test(BLI_GZIP_BLOCKS_BLOCK_SIZE);
+}
+
+TEST(gzip_blocks, RoundTripLarge)
+{
+  gzip_blocks_round_trip_test(BLI_GZIP_BLOCKS_BLOCK_SIZE * 5 + 4321);
+}
+
+TEST(gzip_blocks, RegularGzipFile)
+{
+  const std::string filepath = testing::TempDir() + "blender_gzip_blocks_test_regular.gz";
+  const std::vector<char> data = gzip_blocks_test_data(100000);
+
+  gzFile gz_file = (gzFile)BLI_gzopen(filepath.c_str(), "wb1");
+  ASSERT_NE(gz_file, nullptr);
+  gzwrite(gz_file, data.data(), (uint)data.size());
+  gzclose(gz_file);
+
+  /* Not written in blocks, so it has to be read as a regular gzip file. */
+  std::vector<char> result;
+  EXPECT_FALSE(gzip_blocks_read(filepath, result));
+
+  BLI_delete(filepath.c_str(), false, false);
+}
+
+TEST(gzip_blocks, CorruptFooter)
+{
+  const std::string filepath = testing::TempDir() + "blender_gzip_blocks_test_footer.gz";
+  gzip_blocks_write(filepath, gzip_blocks_test_data(100000));
+
+  /* A huge uncompressed size must not be allocated. The footer data starts 16 bytes into the
+   * last member, which is 50 bytes. */
+  file_bytes_overwrite(filepath, -50 + 16 + 8, {0, 0, 0, 0, 0, 0, 0, 0x10});
+  std::vector<char> result;
+  EXPECT_FALSE(gzip_blocks_read(filepath, result));
+
+  BLI_delete(filepath.c_str(), false, false);
+}
+
+TEST(gzip_blocks, CorruptBlock)
+{
+  const std::string filepath = testing::TempDir() + "blender_gzip_blocks_test_block.gz";
+  gzip_blocks_write(filepath, gzip_blocks_test_data(BLI_GZIP_BLOCKS_BLOCK_SIZE * 2));
+
+  /* Damage the compressed data of the first block. */
+  file_bytes_overwrite(filepath, 100, {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff});
+  std::vector<char> result;
+  EXPECT_FALSE(gzip_blocks_read(filepath, result));
+
+  BLI_delete(filepath.c_str(), false, false);
+}
+
+}  // namespace blender::tests
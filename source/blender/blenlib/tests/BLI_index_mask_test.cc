@@ -1,6 +1,7 @@
 /* Apache License, Version 2.0 */
 
 #include "BLI_index_mask.hh"
+#include "BLI_vector.hh"
 #include "testing/testing.h"
 
 namespace blender::tests {
@@ -40,4 +41,18 @@ TEST(index_mask, RangeConstructor)
   EXPECT_EQ(indices[2], 5);
 }
 
+TEST(index_mask, Slice)
+{
+  Vector<int64_t> indices = {2, 3, 5, 7, 8, 9, 10};
+  IndexMask mask = indices.as_span();
+  IndexMask slice = mask.slice(IndexRange(1, 4));
+  EXPECT_EQ(slice.size(), 4);
+  EXPECT_EQ(slice[0], 3);
+  EXPECT_EQ(slice[3], 8);
+  EXPECT_EQ(slice.min_array_size(), 9);
+  EXPECT_FALSE(slice.is_range());
+  EXPECT_TRUE(mask.slice(IndexRange(3, 4)).is_range());
+  EXPECT_EQ(mask.slice(IndexRange(3, 4)).as_range().first(), 7);
+}
+
 }  // namespace blender::tests
@@ -132,3 +132,268 @@ TEST(kdopbvh, OptimalFindNearest_500)
 {
   find_nearest_points_test(500, 1.0, 1000, 12, true);
 }
+
+/* -------------------------------------------------------------------- */
+/* Flat Layout
+ *
+ * Trees with up to four children per node are queried through their flat layout,
+ * trees with eight children use the regular nodes. Both must give the same results. */
+
+static BVHTree *random_boxes_tree(const float (*boxes)[2][3], int boxes_len, int tree_type)
+{
+  BVHTree *tree = BLI_bvhtree_new(boxes_len, 0.0, tree_type, 6);
+  for (int i = 0; i < boxes_len; i++) {
+    BLI_bvhtree_insert(tree, i, boxes[i][0], 2);
+  }
+  BLI_bvhtree_balance(tree);
+  return tree;
+}
+
+static void random_boxes(float (*boxes)[2][3], int boxes_len, struct RNG *rng)
+{
+  for (int i = 0; i < boxes_len; i++) {
+    float center[3], size[3];
+    rng_v3_round(center, 3, rng, 1 << 20, 1.0f);
+    rng_v3_round(size, 3, rng, 1 << 20, 0.05f);
+    for (int j = 0; j < 3; j++) {
+      boxes[i][0][j] = center[j] - fabsf(size[j]);
+      boxes[i][1][j] = center[j] + fabsf(size[j]);
+    }
+  }
+}
+
+static void compare_ray_casts(BVHTree *tree_a, BVHTree *tree_b, float radius, struct RNG *rng)
+{
+  for (int i = 0; i < 500; i++) {
+    float co[3], dir[3];
+    rng_v3_round(co, 3, rng, 1 << 20, 2.0f);
+    BLI_rng_get_float_unit_v3(rng, dir);
+    if (i % 10 == 0) {
+      /* Include axis aligned rays. */
+      zero_v3(dir);
+      dir[i % 3] = (i % 20 == 0) ? 1.0f : -1.0f;
+    }
+
+    BVHTreeRayHit hit_a = {-1, BVH_RAYCAST_DIST_MAX};
+    BVHTreeRayHit hit_b = {-1, BVH_RAYCAST_DIST_MAX};
+    BLI_bvhtree_ray_cast(tree_a, co, dir, radius, &hit_a, NULL, NULL);
+    BLI_bvhtree_ray_cast(tree_b, co, dir, radius, &hit_b, NULL, NULL);
+    EXPECT_EQ(hit_a.index, hit_b.index);
+    EXPECT_EQ(hit_a.dist, hit_b.dist);
+  }
+}
+
+static void compare_find_nearest(BVHTree *tree_a, BVHTree *tree_b, struct RNG *rng)
+{
+  for (int i = 0; i < 500; i++) {
+    float co[3];
+    rng_v3_round(co, 3, rng, 1 << 20, 1.5f);
+
+    BVHTreeNearest nearest_a = {-1};
+    BVHTreeNearest nearest_b = {-1};
+    nearest_a.dist_sq = nearest_b.dist_sq = FLT_MAX;
+    BLI_bvhtree_find_nearest(tree_a, co, &nearest_a, NULL, NULL);
+    BLI_bvhtree_find_nearest(tree_b, co, &nearest_b, NULL, NULL);
+    EXPECT_EQ(nearest_a.dist_sq, nearest_b.dist_sq);
+  }
+}
+
+static int overlap_cmp(const void *a_v, const void *b_v)
+{
+  const BVHTreeOverlap *a = (const BVHTreeOverlap *)a_v;
+  const BVHTreeOverlap *b = (const BVHTreeOverlap *)b_v;
+  if (a->indexA != b->indexA) {
+    return a->indexA < b->indexA ? -1 : 1;
+  }
+  if (a->indexB != b->indexB) {
+    return a->indexB < b->indexB ? -1 : 1;
+  }
+  return 0;
+}
+
+static void compare_overlap(BVHTree *tree_a, BVHTree *tree_b)
+{
+  uint overlap_a_len, overlap_b_len;
+  BVHTreeOverlap *overlap_a = BLI_bvhtree_overlap(tree_a, tree_a, &overlap_a_len, NULL, NULL);
+  BVHTreeOverlap *overlap_b = BLI_bvhtree_overlap(tree_b, tree_b, &overlap_b_len, NULL, NULL);
+  ASSERT_EQ(overlap_a_len, overlap_b_len);
+
+  qsort(overlap_a, overlap_a_len, sizeof(*overlap_a), overlap_cmp);
+  qsort(overlap_b, overlap_b_len, sizeof(*overlap_b), overlap_cmp);
+  for (uint i = 0; i < overlap_a_len; i++) {
+    EXPECT_EQ(overlap_a[i].indexA, overlap_b[i].indexA);
+    EXPECT_EQ(overlap_a[i].indexB, overlap_b[i].indexB);
+  }
+
+  MEM_freeN(overlap_a);
+  MEM_freeN(overlap_b);
+}
+
+static void flat_layout_test(int boxes_len, int tree_type, int random_seed)
+{
+  struct RNG *rng = BLI_rng_new(random_seed);
+  float(*boxes)[2][3] = (float(*)[2][3])MEM_mallocN(sizeof(float[2][3]) * boxes_len, __func__);
+  random_boxes(boxes, boxes_len, rng);
+
+  BVHTree *tree_flat = random_boxes_tree(boxes, boxes_len, tree_type);
+  BVHTree *tree_nodes = random_boxes_tree(boxes, boxes_len, 8);
+
+  compare_ray_casts(tree_flat, tree_nodes, 0.0f, rng);
+  compare_ray_casts(tree_flat, tree_nodes, 0.01f, rng);
+  compare_find_nearest(tree_flat, tree_nodes, rng);
+  compare_overlap(tree_flat, tree_nodes);
+
+  /* Move the boxes, the flat layout has to follow. */
+  random_boxes(boxes, boxes_len, rng);
+  for (int i = 0; i < boxes_len; i++) {
+    BLI_bvhtree_update_node(tree_flat, i, boxes[i][0], NULL, 2);
+    BLI_bvhtree_update_node(tree_nodes, i, boxes[i][0], NULL, 2);
+  }
+  BLI_bvhtree_update_tree(tree_flat);
+  BLI_bvhtree_update_tree(tree_nodes);
+
+  compare_ray_casts(tree_flat, tree_nodes, 0.0f, rng);
+  compare_find_nearest(tree_flat, tree_nodes, rng);
+  compare_overlap(tree_flat, tree_nodes);
+
+  BLI_bvhtree_free(tree_flat);
+  BLI_bvhtree_free(tree_nodes);
+  MEM_freeN(boxes);
+  BLI_rng_free(rng);
+}
+
+TEST(kdopbvh, FlatLayout_2)
+{
+  flat_layout_test(2, 4, 1);
+}
+TEST(kdopbvh, FlatLayout_1000_Binary)
+{
+  flat_layout_test(1000, 2, 2);
+}
+TEST(kdopbvh, FlatLayout_1000)
+{
+  flat_layout_test(1000, 4, 3);
+}
+TEST(kdopbvh, FlatLayout_10000)
+{
+  flat_layout_test(10000, 4, 4);
+}
+
+static int refit_boxes_cb(void *userdata, int index, float r_co[BVH_REFIT_POINTS_MAX][3])
+{
+  const float(*boxes)[2][3] = (const float(*)[2][3])userdata;
+  copy_v3_v3(r_co[0], boxes[index][0]);
+  copy_v3_v3(r_co[1], boxes[index][1]);
+  return 2;
+}
+
+static void refit_test(int boxes_len, int tree_type, int random_seed)
+{
+  struct RNG *rng = BLI_rng_new(random_seed);
+  float(*boxes)[2][3] = (float(*)[2][3])MEM_mallocN(sizeof(float[2][3]) * boxes_len, __func__);
+  random_boxes(boxes, boxes_len, rng);
+
+  /* Insert in reverse order, so leaf positions and indices differ. */
+  BVHTree *tree_refit = BLI_bvhtree_new(boxes_len, 0.0, tree_type, 6);
+  for (int i = boxes_len - 1; i >= 0; i--) {
+    BLI_bvhtree_insert(tree_refit, i, boxes[i][0], 2);
+  }
+  BLI_bvhtree_balance(tree_refit);
+
+  /* Deform the boxes, the refit tree must give the same results as a new tree. */
+  for (int i = 0; i < boxes_len; i++) {
+    for (int j = 0; j < 2; j++) {
+      boxes[i][j][0] += 0.5f * sinf(boxes[i][j][1] * 4.0f);
+      boxes[i][j][2] *= 1.5f;
+    }
+  }
+  BLI_bvhtree_refit(tree_refit, refit_boxes_cb, boxes);
+  BVHTree *tree_new = random_boxes_tree(boxes, boxes_len, tree_type);
+
+  compare_ray_casts(tree_refit, tree_new, 0.0f, rng);
+  compare_ray_casts(tree_refit, tree_new, 0.01f, rng);
+  compare_find_nearest(tree_refit, tree_new, rng);
+  compare_overlap(tree_refit, tree_new);
+
+  BLI_bvhtree_free(tree_refit);
+  BLI_bvhtree_free(tree_new);
+  MEM_freeN(boxes);
+  BLI_rng_free(rng);
+}
+
+TEST(kdopbvh, Refit_1)
+{
+  refit_test(1, 4, 5);
+}
+TEST(kdopbvh, Refit_1000_Binary)
+{
+  refit_test(1000, 2, 6);
+}
+TEST(kdopbvh, Refit_10000)
+{
+  refit_test(10000, 4, 7);
+}
+TEST(kdopbvh, Refit_10000_Octree)
+{
+  refit_test(10000, 8, 8);
+}
+
+/* -------------------------------------------------------------------- */
+/* Batched Ray-Cast */
+
+static void ray_cast_batch_test(int boxes_len, int rays_len, int tree_type, int random_seed)
+{
+  struct RNG *rng = BLI_rng_new(random_seed);
+  float(*boxes)[2][3] = (float(*)[2][3])MEM_mallocN(sizeof(float[2][3]) * boxes_len, __func__);
+  float(*co)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * rays_len, __func__);
+  float(*dir)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * rays_len, __func__);
+  BVHTreeRayHit *hits = (BVHTreeRayHit *)MEM_mallocN(sizeof(BVHTreeRayHit) * rays_len, __func__);
+
+  random_boxes(boxes, boxes_len, rng);
+  BVHTree *tree = random_boxes_tree(boxes, boxes_len, tree_type);
+
+  for (const float radius : {0.0f, 0.01f}) {
+    for (int i = 0; i < rays_len; i++) {
+      rng_v3_round(co[i], 3, rng, 1 << 20, 2.0f);
+      BLI_rng_get_float_unit_v3(rng, dir[i]);
+      if (i % 10 == 0) {
+        zero_v3(dir[i]);
+        dir[i][i % 3] = (i % 20 == 0) ? 1.0f : -1.0f;
+      }
+      hits[i].index = -1;
+      /* Limit some of the rays. */
+      hits[i].dist = (i % 3 == 0) ? 0.5f : BVH_RAYCAST_DIST_MAX;
+    }
+
+    BLI_bvhtree_ray_cast_batch(
+        tree, co, dir, rays_len, radius, hits, NULL, NULL, BVH_RAYCAST_DEFAULT);
+
+    for (int i = 0; i < rays_len; i++) {
+      BVHTreeRayHit hit = {-1};
+      hit.dist = (i % 3 == 0) ? 0.5f : BVH_RAYCAST_DIST_MAX;
+      BLI_bvhtree_ray_cast(tree, co[i], dir[i], radius, &hit, NULL, NULL);
+      EXPECT_EQ(hit.index, hits[i].index);
+      EXPECT_EQ(hit.dist, hits[i].dist);
+    }
+  }
+
+  BLI_bvhtree_free(tree);
+  MEM_freeN(hits);
+  MEM_freeN(dir);
+  MEM_freeN(co);
+  MEM_freeN(boxes);
+  BLI_rng_free(rng);
+}
+
+TEST(kdopbvh, RayCastBatch_1)
+{
+  ray_cast_batch_test(1, 100, 4, 1);
+}
+TEST(kdopbvh, RayCastBatch_1000)
+{
+  ray_cast_batch_test(1000, 5000, 4, 2);
+}
+TEST(kdopbvh, RayCastBatch_1000_Octree)
+{
+  ray_cast_batch_test(1000, 5000, 8, 3);
+}
@@ -0,0 +1,140 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_kdtree.h"
+#include "BLI_math_vector.h"
+#include "BLI_rand.h"
+
+/* -------------------------------------------------------------------- */
+/* Helper Functions */
+
+static KDTree_3d *kdtree_random_new(float (*coords)[3], int coords_len, uint seed)
+{
+  RNG *rng = BLI_rng_new(seed);
+  KDTree_3d *tree = BLI_kdtree_3d_new(coords_len);
+  for (int i = 0; i < coords_len; i++) {
+    BLI_rng_get_float_unit_v3(rng, coords[i]);
+    mul_v3_fl(coords[i], BLI_rng_get_float(rng));
+    BLI_kdtree_3d_insert(tree, i, coords[i]);
+  }
+  BLI_rng_free(rng);
+  BLI_kdtree_3d_balance(tree);
+  return tree;
+}
+
+static void random_query_points(float (*coords)[3], int coords_len, uint seed)
+{
+  RNG *rng = BLI_rng_new(seed);
+  for (int i = 0; i < coords_len; i++) {
+    for (int j = 0; j < 3; j++) {
+      coords[i][j] = BLI_rng_get_float(rng) * 2.4f - 1.2f;
+    }
+  }
+  BLI_rng_free(rng);
+}
+
+/* -------------------------------------------------------------------- */
+/* Tests */
+
+TEST(kdtree, FindNearestBatchEmpty)
+{
+  KDTree_3d *tree = BLI_kdtree_3d_new(0);
+  BLI_kdtree_3d_balance(tree);
+
+  const float co[2][3] = {{0.0f, 0.0f, 0.0f}, {1.0f, 2.0f, 3.0f}};
+  KDTreeNearest_3d nearest[2];
+  BLI_kdtree_3d_find_nearest_batch(tree, co, 2, nearest);
+  EXPECT_EQ(nearest[0].index, -1);
+  EXPECT_EQ(nearest[1].index, -1);
+
+  KDTreeNearest_3d *nearest_range[2];
+  int nearest_range_len[2];
+  BLI_kdtree_3d_range_search_batch(tree, co, 2, 1.0f, nearest_range, nearest_range_len);
+  EXPECT_EQ(nearest_range_len[0], 0);
+  EXPECT_EQ(nearest_range_len[1], 0);
+
+  BLI_kdtree_3d_free(tree);
+}
+
+/* Large enough to balance with tasks, the nearest point of every tree point must be itself. */
+TEST(kdtree, BalanceThreaded)
+{
+  const int points_len = 100000;
+  float(*points)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+  KDTree_3d *tree = kdtree_random_new(points, points_len, 1);
+
+  for (int i = 0; i < points_len; i++) {
+    KDTreeNearest_3d nearest;
+    EXPECT_EQ(BLI_kdtree_3d_find_nearest(tree, points[i], &nearest), i);
+    EXPECT_EQ(nearest.dist, 0.0f);
+  }
+
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(points);
+}
+
+TEST(kdtree, FindNearestBatch)
+{
+  const int points_len = 50000;
+  const int queries_len = 20000;
+  float(*points)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+  float(*queries)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * queries_len, __func__);
+  KDTree_3d *tree = kdtree_random_new(points, points_len, 2);
+  random_query_points(queries, queries_len, 3);
+
+  KDTreeNearest_3d *nearest = (KDTreeNearest_3d *)MEM_mallocN(
+      sizeof(KDTreeNearest_3d) * queries_len, __func__);
+  BLI_kdtree_3d_find_nearest_batch(tree, queries, queries_len, nearest);
+
+  for (int i = 0; i < queries_len; i++) {
+    KDTreeNearest_3d expected;
+    EXPECT_EQ(BLI_kdtree_3d_find_nearest(tree, queries[i], &expected), nearest[i].index);
+    EXPECT_EQ(expected.dist, nearest[i].dist);
+    EXPECT_EQ_ARRAY(expected.co, nearest[i].co, 3);
+  }
+
+  MEM_freeN(nearest);
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(queries);
+  MEM_freeN(points);
+}
+
+TEST(kdtree, RangeSearchBatch)
+{
+  const int points_len = 20000;
+  const int queries_len = 2000;
+  const float range = 0.1f;
+  float(*points)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+  float(*queries)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * queries_len, __func__);
+  KDTree_3d *tree = kdtree_random_new(points, points_len, 4);
+  random_query_points(queries, queries_len, 5);
+
+  KDTreeNearest_3d **nearest = (KDTreeNearest_3d **)MEM_mallocN(
+      sizeof(KDTreeNearest_3d *) * queries_len, __func__);
+  int *nearest_len = (int *)MEM_mallocN(sizeof(int) * queries_len, __func__);
+  BLI_kdtree_3d_range_search_batch(tree, queries, queries_len, range, nearest, nearest_len);
+
+  for (int i = 0; i < queries_len; i++) {
+    KDTreeNearest_3d *expected;
+    const int expected_len = BLI_kdtree_3d_range_search(tree, queries[i], &expected, range);
+    ASSERT_EQ(expected_len, nearest_len[i]);
+    for (int j = 0; j < expected_len; j++) {
+      EXPECT_EQ(expected[j].dist, nearest[i][j].dist);
+    }
+    if (expected) {
+      MEM_freeN(expected);
+    }
+    if (nearest[i]) {
+      MEM_freeN(nearest[i]);
+    }
+  }
+
+  MEM_freeN(nearest_len);
+  MEM_freeN(nearest);
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(queries);
+  MEM_freeN(points);
+}
@@ -0,0 +1,148 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+#include <fcntl.h>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef WIN32
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif
+
+#include "BLI_fileops.h"
+#include "BLI_index_range.hh"
+#include "BLI_mmap.h"
+
+namespace blender::tests {
+
+static std::string mmap_test_file_write(const std::string &contents)
+{
+  const std::string filepath = testing::TempDir() + "blender_mmap_test.bin";
+  std::ofstream file(filepath, std::ios::binary);
+  file.write(contents.data(), (std::streamsize)contents.size());
+  file.close();
+  return filepath;
+}
+
+TEST(mmap, Read)
+{
+  const std::string contents = "BLENDER-v293 mapped file contents";
+  const std::string filepath = mmap_test_file_write(contents);
+
+  const int file = BLI_open(filepath.c_str(), O_BINARY | O_RDONLY, 0);
+  ASSERT_NE(file, -1);
+  BLI_mmap_file *mmap_file = BLI_mmap_open(file);
+  /* The mapping stays valid after the file is closed. */
+  close(file);
+  ASSERT_NE(mmap_file, nullptr);
+
+  EXPECT_EQ(BLI_mmap_get_length(mmap_file), contents.size());
+  EXPECT_EQ(memcmp(BLI_mmap_get_pointer(mmap_file), contents.data(), contents.size()), 0);
+
+  char buffer[7];
+  EXPECT_TRUE(BLI_mmap_read(mmap_file, buffer, 0, 7));
+  EXPECT_EQ(memcmp(buffer, "BLENDER", 7), 0);
+  EXPECT_TRUE(BLI_mmap_read(mmap_file, buffer, contents.size() - 5, 5));
+  EXPECT_EQ(memcmp(buffer, "tents", 5), 0);
+
+  /* Ranges outside of the file. */
+  EXPECT_FALSE(BLI_mmap_read(mmap_file, buffer, contents.size() - 4, 5));
+  EXPECT_FALSE(BLI_mmap_read(mmap_file, buffer, contents.size() + 1, 0));
+  EXPECT_FALSE(BLI_mmap_read(mmap_file, buffer, 1, SIZE_MAX));
+  EXPECT_TRUE(BLI_mmap_read(mmap_file, buffer, contents.size(), 0));
+
+  EXPECT_FALSE(BLI_mmap_any_io_error(mmap_file));
+  BLI_mmap_free(mmap_file);
+  BLI_delete(filepath.c_str(), false, false);
+}
+
+#ifndef WIN32
+TEST(mmap, TruncatedFileIOError)
+{
+  const std::string contents(1 << 16, 'x');
+  const std::string filepath = mmap_test_file_write(contents);
+
+  const int file = BLI_open(filepath.c_str(), O_BINARY | O_RDONLY, 0);
+  ASSERT_NE(file, -1);
+  BLI_mmap_file *mmap_file = BLI_mmap_open(file);
+  close(file);
+  ASSERT_NE(mmap_file, nullptr);
+
+  /* Accessing pages that are no longer backed by the file raises SIGBUS, which is handled. */
+  ASSERT_EQ(truncate(filepath.c_str(), 0), 0);
+  char buffer[16];
+  EXPECT_FALSE(BLI_mmap_read(mmap_file, buffer, contents.size() - 16, 16));
+  EXPECT_TRUE(BLI_mmap_any_io_error(mmap_file));
+
+  BLI_mmap_free(mmap_file);
+  BLI_delete(filepath.c_str(), false, false);
+}
+
+TEST(mmap, Threaded)
+{
+  /* Files are opened and freed from several threads at once, while one of them faults. */
+  const std::string contents(1 << 16, 'x');
+  const std::string filepath = mmap_test_file_write(contents);
+  const std::string filepath_truncated = testing::TempDir() + "blender_mmap_test_truncated.bin";
+  {
+    std::ofstream file(filepath_truncated, std::ios::binary);
+    file.write(contents.data(), (std::streamsize)contents.size());
+  }
+
+  const int file_truncated = BLI_open(filepath_truncated.c_str(), O_BINARY | O_RDONLY, 0);
+  ASSERT_NE(file_truncated, -1);
+  BLI_mmap_file *mmap_file_truncated = BLI_mmap_open(file_truncated);
+  close(file_truncated);
+  ASSERT_NE(mmap_file_truncated, nullptr);
+  ASSERT_EQ(truncate(filepath_truncated.c_str(), 0), 0);
+
+  std::vector<std::thread> threads;
+  std::vector<int> reads_ok(8, 0);
+  for (const int i : IndexRange(8)) {
+    threads.emplace_back([&, i]() {
+      for (int j = 0; j < 200; j++) {
+        const int file = BLI_open(filepath.c_str(), O_BINARY | O_RDONLY, 0);
+        BLI_mmap_file *mmap_file = BLI_mmap_open(file);
+        close(file);
+        char buffer[16];
+        if (mmap_file != nullptr && BLI_mmap_read(mmap_file, buffer, contents.size() - 16, 16)) {
+          reads_ok[i]++;
+        }
+        if (mmap_file != nullptr) {
+          BLI_mmap_free(mmap_file);
+        }
+      }
+    });
+  }
+  char buffer[16];
+  EXPECT_FALSE(BLI_mmap_read(mmap_file_truncated, buffer, contents.size() - 16, 16));
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  for (const int count : reads_ok) {
+    EXPECT_EQ(count, 200);
+  }
+  EXPECT_TRUE(BLI_mmap_any_io_error(mmap_file_truncated));
+  BLI_mmap_free(mmap_file_truncated);
+  BLI_delete(filepath.c_str(), false, false);
+  BLI_delete(filepath_truncated.c_str(), false, false);
+}
+#endif
+
+TEST(mmap, EmptyFile)
+{
+  const std::string filepath = mmap_test_file_write("");
+
+  const int file = BLI_open(filepath.c_str(), O_BINARY | O_RDONLY, 0);
+  ASSERT_NE(file, -1);
+  EXPECT_EQ(BLI_mmap_open(file), nullptr);
+  close(file);
+  BLI_delete(filepath.c_str(), false, false);
+}
+
+}  // namespace blender::tests
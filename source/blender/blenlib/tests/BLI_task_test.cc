@@ -1,6 +1,8 @@
 /* Apache License, Version 2.0 */
 
 #include "testing/testing.h"
+#include <fstream>
+#include <sstream>
 #include <string.h>
 
 #include "atomic_ops.h"
@@ -11,7 +13,9 @@
 
 #include "BLI_listbase.h"
 #include "BLI_mempool.h"
+#include "BLI_string.h"
 #include "BLI_task.h"
+#include "BLI_task.hh"
 
 #define NUM_ITEMS 10000
 
@@ -181,3 +185,138 @@ TEST(task, ListBaseIter)
   MEM_freeN(items_buffer);
   BLI_threadapi_exit();
 }
+
+/* *** Task profiling. *** */
+
+static void task_profile_range_func(void *userdata,
+                                    int index,
+                                    const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  int *data = (int *)userdata;
+  data[index] = index;
+}
+
+static void task_profile_pool_func(TaskPool *__restrict UNUSED(pool), void *taskdata)
+{
+  atomic_add_and_fetch_uint32((uint32_t *)taskdata, 1);
+}
+
+static std::string task_profile_trace_get()
+{
+  const std::string filepath = testing::TempDir() + "blender_task_profile_test.json";
+  EXPECT_TRUE(BLI_task_profile_write_chrome_trace(filepath.c_str()));
+
+  std::ifstream file(filepath);
+  std::stringstream stream;
+  stream << file.rdbuf();
+  file.close();
+  remove(filepath.c_str());
+  return stream.str();
+}
+
+TEST(task, ProfileChromeTrace)
+{
+  int data[NUM_ITEMS] = {0};
+  uint32_t tasks_done = 0;
+
+  BLI_threadapi_init();
+  BLI_task_profile_enable(true);
+  BLI_task_profile_clear();
+  EXPECT_TRUE(BLI_task_profile_is_enabled());
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 100;
+  BLI_task_parallel_range(0, NUM_ITEMS, data, task_profile_range_func, &settings);
+
+  TaskPool *pool = BLI_task_pool_create(&tasks_done, TASK_PRIORITY_HIGH);
+  for (int i = 0; i < 16; i++) {
+    BLI_task_pool_push(pool, task_profile_pool_func, &tasks_done, false, NULL);
+  }
+  BLI_task_pool_work_and_wait(pool);
+  BLI_task_pool_free(pool);
+  EXPECT_EQ(tasks_done, 16);
+
+  const std::string trace = task_profile_trace_get();
+  EXPECT_EQ(trace.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["), 0);
+  EXPECT_NE(trace.find("\"thread_name\""), std::string::npos);
+  EXPECT_NE(trace.find("\"cat\":\"parallel_range\""), std::string::npos);
+  EXPECT_NE(trace.find("\"cat\":\"task_pool\""), std::string::npos);
+  EXPECT_EQ(trace.substr(trace.size() - 3), "]}\n");
+
+  /* Cleared events are not written, nothing is recorded while disabled. */
+  BLI_task_profile_clear();
+  BLI_task_profile_enable(false);
+  BLI_task_parallel_range(0, NUM_ITEMS, data, task_profile_range_func, &settings);
+  EXPECT_EQ(task_profile_trace_get().find("\"ph\":\"X\""), std::string::npos);
+
+  BLI_threadapi_exit();
+}
+
+static void task_profile_listbase_func(void *userdata,
+                                       void *UNUSED(item),
+                                       int UNUSED(index),
+                                       const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  atomic_add_and_fetch_uint32((uint32_t *)userdata, 1);
+}
+
+static void task_profile_mempool_func(void *userdata, MempoolIterData *UNUSED(item))
+{
+  atomic_add_and_fetch_uint32((uint32_t *)userdata, 1);
+}
+
+TEST(task, ProfileChromeTraceLoops)
+{
+  BLI_threadapi_init();
+  BLI_task_profile_enable(true);
+  BLI_task_profile_clear();
+
+  int data[NUM_ITEMS] = {0};
+  blender::parallel_for(blender::IndexRange(NUM_ITEMS), 100, [&](blender::IndexRange range) {
+    for (const int64_t i : range) {
+      data[i] = (int)i;
+    }
+  });
+
+  LinkData *items_buffer = (LinkData *)MEM_calloc_arrayN(
+      NUM_ITEMS, sizeof(*items_buffer), __func__);
+  ListBase list = {NULL, NULL};
+  for (int i = 0; i < NUM_ITEMS; i++) {
+    BLI_addtail(&list, &items_buffer[i]);
+  }
+  uint32_t listbase_done = 0;
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  BLI_task_parallel_listbase(&list, &listbase_done, task_profile_listbase_func, &settings);
+  EXPECT_EQ(listbase_done, NUM_ITEMS);
+  MEM_freeN(items_buffer);
+
+  BLI_mempool *mempool = BLI_mempool_create(sizeof(int), 0, 64, BLI_MEMPOOL_ALLOW_ITER);
+  for (int i = 0; i < NUM_ITEMS; i++) {
+    BLI_mempool_alloc(mempool);
+  }
+  uint32_t mempool_done = 0;
+  BLI_task_parallel_mempool(mempool, &mempool_done, task_profile_mempool_func, true);
+  EXPECT_EQ(mempool_done, NUM_ITEMS);
+  BLI_mempool_destroy(mempool);
+
+  const std::string trace = task_profile_trace_get();
+  EXPECT_NE(trace.find("\"cat\":\"parallel_for\""), std::string::npos);
+  EXPECT_NE(trace.find("\"cat\":\"parallel_iterator\""), std::string::npos);
+  char listbase_name[64], mempool_name[64];
+  BLI_snprintf(listbase_name,
+               sizeof(listbase_name),
+               "\"parallel_iterator %p\"",
+               (const void *)task_profile_listbase_func);
+  BLI_snprintf(mempool_name,
+               sizeof(mempool_name),
+               "\"parallel_iterator %p\"",
+               (const void *)task_profile_mempool_func);
+  EXPECT_NE(trace.find(listbase_name), std::string::npos);
+  EXPECT_NE(trace.find(mempool_name), std::string::npos);
+
+  BLI_task_profile_clear();
+  BLI_task_profile_enable(false);
+  BLI_threadapi_exit();
+}
@@ -0,0 +1,98 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_kdopbvh.h"
+#include "BLI_math_vector.h"
+#include "BLI_rand.h"
+#include "BLI_timeit.hh"
+
+/* Compare one ray-cast at a time against the batched ray-casts, which sort the rays into
+ * coherent packets and run in parallel. */
+
+static const int boxes_len = 500000;
+static const int rays_len = 1000000;
+
+static BVHTree *random_boxes_tree(int seed)
+{
+  BVHTree *tree = BLI_bvhtree_new(boxes_len, 0.0f, 4, 6);
+  RNG *rng = BLI_rng_new((uint)seed);
+  for (int i = 0; i < boxes_len; i++) {
+    float co[2][3];
+    BLI_rng_get_float_unit_v3(rng, co[0]);
+    mul_v3_fl(co[0], 10.0f * BLI_rng_get_float(rng));
+    BLI_rng_get_float_unit_v3(rng, co[1]);
+    mul_v3_fl(co[1], 0.02f);
+    add_v3_v3(co[1], co[0]);
+    BLI_bvhtree_insert(tree, i, co[0], 2);
+  }
+  BLI_rng_free(rng);
+  BLI_bvhtree_balance(tree);
+  return tree;
+}
+
+static void ray_cast_compare(const float (*co)[3], const float (*dir)[3])
+{
+  BVHTree *tree = random_boxes_tree(0);
+  BVHTreeRayHit *hits = (BVHTreeRayHit *)MEM_mallocN(sizeof(*hits) * rays_len, __func__);
+
+  {
+    SCOPED_TIMER("ray_cast");
+    for (int i = 0; i < rays_len; i++) {
+      hits[i].index = -1;
+      hits[i].dist = BVH_RAYCAST_DIST_MAX;
+      BLI_bvhtree_ray_cast(tree, co[i], dir[i], 0.0f, &hits[i], NULL, NULL);
+    }
+  }
+  {
+    SCOPED_TIMER("ray_cast_batch");
+    for (int i = 0; i < rays_len; i++) {
+      hits[i].index = -1;
+      hits[i].dist = BVH_RAYCAST_DIST_MAX;
+    }
+    BLI_bvhtree_ray_cast_batch(
+        tree, co, dir, rays_len, 0.0f, hits, NULL, NULL, BVH_RAYCAST_DEFAULT);
+  }
+
+  BLI_bvhtree_free(tree);
+  MEM_freeN(hits);
+}
+
+TEST(kdopbvh_performance, RayCastRandom)
+{
+  float(*co)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * rays_len, __func__);
+  float(*dir)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * rays_len, __func__);
+  RNG *rng = BLI_rng_new(1);
+  for (int i = 0; i < rays_len; i++) {
+    BLI_rng_get_float_unit_v3(rng, co[i]);
+    mul_v3_fl(co[i], 10.0f * BLI_rng_get_float(rng));
+    BLI_rng_get_float_unit_v3(rng, dir[i]);
+  }
+  BLI_rng_free(rng);
+
+  ray_cast_compare(co, dir);
+
+  MEM_freeN(co);
+  MEM_freeN(dir);
+}
+
+TEST(kdopbvh_performance, RayCastProjection)
+{
+  /* Parallel rays from a grid, like a shrinkwrap projection along an axis. */
+  float(*co)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * rays_len, __func__);
+  float(*dir)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * rays_len, __func__);
+  const int side = 1000;
+  for (int i = 0; i < rays_len; i++) {
+    co[i][0] = (float)(i % side) / (float)side * 20.0f - 10.0f;
+    co[i][1] = (float)(i / side) / (float)side * 20.0f - 10.0f;
+    co[i][2] = -20.0f;
+    copy_v3_fl3(dir[i], 0.0f, 0.0f, 1.0f);
+  }
+
+  ray_cast_compare(co, dir);
+
+  MEM_freeN(co);
+  MEM_freeN(dir);
+}
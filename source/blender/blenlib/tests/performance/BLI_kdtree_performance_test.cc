@@ -0,0 +1,105 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_kdtree.h"
+#include "BLI_rand.h"
+#include "BLI_task.h"
+#include "BLI_timeit.hh"
+
+/* Compare one query at a time against the batched queries, which also run in parallel. */
+
+static const int points_len = 1000000;
+static const int queries_len = 1000000;
+
+static void random_coords(float (*coords)[3], int coords_len, uint seed)
+{
+  RNG *rng = BLI_rng_new(seed);
+  for (int i = 0; i < coords_len; i++) {
+    for (int j = 0; j < 3; j++) {
+      coords[i][j] = BLI_rng_get_float(rng) * 2.0f - 1.0f;
+    }
+  }
+  BLI_rng_free(rng);
+}
+
+static KDTree_3d *kdtree_new_balanced(const float (*coords)[3], int coords_len)
+{
+  KDTree_3d *tree = BLI_kdtree_3d_new(coords_len);
+  for (int i = 0; i < coords_len; i++) {
+    BLI_kdtree_3d_insert(tree, i, coords[i]);
+  }
+  {
+    SCOPED_TIMER("balance");
+    BLI_kdtree_3d_balance(tree);
+  }
+  return tree;
+}
+
+TEST(kdtree_performance, FindNearest)
+{
+  float(*points)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+  float(*queries)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * queries_len, __func__);
+  KDTreeNearest_3d *nearest = (KDTreeNearest_3d *)MEM_mallocN(
+      sizeof(KDTreeNearest_3d) * queries_len, __func__);
+  random_coords(points, points_len, 0);
+  random_coords(queries, queries_len, 1);
+
+  KDTree_3d *tree = kdtree_new_balanced(points, points_len);
+
+  {
+    SCOPED_TIMER("find_nearest");
+    for (int i = 0; i < queries_len; i++) {
+      BLI_kdtree_3d_find_nearest(tree, queries[i], &nearest[i]);
+    }
+  }
+  {
+    SCOPED_TIMER("find_nearest_batch");
+    BLI_kdtree_3d_find_nearest_batch(tree, queries, queries_len, nearest);
+  }
+
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(nearest);
+  MEM_freeN(queries);
+  MEM_freeN(points);
+}
+
+TEST(kdtree_performance, RangeSearch)
+{
+  /* About 40 points in range of every query. */
+  const float range = 0.025f;
+  float(*points)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+  float(*queries)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * queries_len, __func__);
+  KDTreeNearest_3d **nearest = (KDTreeNearest_3d **)MEM_mallocN(
+      sizeof(KDTreeNearest_3d *) * queries_len, __func__);
+  int *nearest_len = (int *)MEM_mallocN(sizeof(int) * queries_len, __func__);
+  random_coords(points, points_len, 2);
+  random_coords(queries, queries_len, 3);
+
+  KDTree_3d *tree = kdtree_new_balanced(points, points_len);
+
+  {
+    SCOPED_TIMER("range_search");
+    for (int i = 0; i < queries_len; i++) {
+      nearest_len[i] = BLI_kdtree_3d_range_search(tree, queries[i], &nearest[i], range);
+    }
+  }
+  for (int i = 0; i < queries_len; i++) {
+    MEM_SAFE_FREE(nearest[i]);
+  }
+  {
+    SCOPED_TIMER("range_search_batch");
+    BLI_kdtree_3d_range_search_batch(tree, queries, queries_len, range, nearest, nearest_len);
+  }
+  for (int i = 0; i < queries_len; i++) {
+    MEM_SAFE_FREE(nearest[i]);
+  }
+
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(nearest_len);
+  MEM_freeN(nearest);
+  MEM_freeN(queries);
+  MEM_freeN(points);
+}
@@ -103,10 +103,13 @@
 #include "BLI_blenlib.h"
 #include "BLI_endian_switch.h"
 #include "BLI_ghash.h"
+#include "BLI_gzip_blocks.h"
 #include "BLI_linklist.h"
 #include "BLI_math.h"
 #include "BLI_memarena.h"
 #include "BLI_mempool.h"
+#include "BLI_mmap.h"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 
 #include "BLT_translation.h"
@@ -249,6 +252,14 @@
 /* use GHash for BHead name-based lookups (speeds up linking) */
 #define USE_GHASH_BHEAD
 
+/**
+ * Read the data of data-blocks that support it (see #IDTYPE_FLAGS_THREADSAFE_READ_DATA) in
+ * parallel, after the ID structs of the whole file have been read.
+ * Only used when blocks can be read without seeking in the file, see
+ * #read_data_can_run_in_parallel.
+ */
+#define USE_PARALLEL_READ_DATA
+
 /* Use GHash for restoring pointers by name */
 #define USE_GHASH_RESTORE_POINTER
 
@@ -723,6 +734,9 @@ static Main *blo_find_main(FileData *fd, const char *filepath, const char *relab
 
 typedef struct BlendDataReader {
   FileData *fd;
+  /* Data of the data-block being read, this is #FileData.datamap unless the data-block is read
+   * on a separate thread. */
+  struct OldNewMap *datamap;
 } BlendDataReader;
 
 typedef struct BlendLibReader {
@@ -996,11 +1010,30 @@ BHead *blo_bhead_next(FileData *fd, BHead *thisblock)
 }
 
 #ifdef USE_BHEAD_READ_ON_DEMAND
+/* Data of a block that wasn't read yet, when the file is memory mapped, NULL otherwise.
+ * Accessing it doesn't depend on the read position of the file. */
+static const void *blo_bhead_data_in_memory(FileData *fd, BHead *thisblock)
+{
+  if (fd->mmap_file == NULL) {
+    return NULL;
+  }
+  const char *memory = BLI_mmap_get_pointer(fd->mmap_file);
+  BHeadN *new_bhead = BHEADN_FROM_BHEAD(thisblock);
+  BLI_assert(new_bhead->has_data == false && new_bhead->file_offset != 0);
+  /* The block was skipped with a successful seek, so it lies within the file. */
+  return memory + new_bhead->file_offset;
+}
+
 static bool blo_bhead_read_data(FileData *fd, BHead *thisblock, void *buf)
 {
   bool success = true;
   BHeadN *new_bhead = BHEADN_FROM_BHEAD(thisblock);
   BLI_assert(new_bhead->has_data == false && new_bhead->file_offset != 0);
+  /* Don't move the read position, so blocks can be read from multiple threads. */
+  if (fd->mmap_file != NULL) {
+    return BLI_mmap_read(
+        fd->mmap_file, buf, (size_t)new_bhead->file_offset, (size_t)new_bhead->bhead.len);
+  }
   off64_t offset_backup = fd->file_offset;
   if (UNLIKELY(fd->seek(fd, new_bhead->file_offset, SEEK_SET) == -1)) {
     success = false;
@@ -1202,6 +1235,24 @@ static off64_t fd_seek_data_from_file(FileData *filedata, off64_t offset, int wh
   return filedata->file_offset;
 }
 
+/* Memory mapped file reading. */
+
+static ssize_t fd_read_from_mmap(FileData *filedata,
+                                 void *buffer,
+                                 size_t size,
+                                 bool *UNUSED(r_is_memchunck_identical))
+{
+  /* Don't read more bytes than there are available in the file. */
+  const size_t readsize = MIN2(size, filedata->buffersize - (size_t)filedata->file_offset);
+
+  if (!BLI_mmap_read(filedata->mmap_file, buffer, (size_t)filedata->file_offset, readsize)) {
+    return EOF;
+  }
+  filedata->file_offset += readsize;
+
+  return (ssize_t)readsize;
+}
+
 /* GZip file reading. */
 
 static ssize_t fd_read_gzip_from_file(FileData *filedata,
@@ -1223,6 +1274,21 @@ static ssize_t fd_read_gzip_from_file(FileData *filedata,
   return readsize;
 }
 
+static ssize_t fd_read_gzip_blocks_from_file(FileData *filedata,
+                                             void *buffer,
+                                             size_t size,
+                                             bool *UNUSED(r_is_memchunck_identical))
+{
+  const int64_t readsize = BLI_gzip_blocks_reader_read(filedata->gzip_blocks_reader, buffer, size);
+
+  if (readsize < 0) {
+    return EOF;
+  }
+
+  filedata->file_offset += readsize;
+  return (ssize_t)readsize;
+}
+
 /* Memory reading. */
 
 static ssize_t fd_read_from_memory(FileData *filedata,
@@ -1239,6 +1305,31 @@ static ssize_t fd_read_from_memory(FileData *filedata,
   return readsize;
 }
 
+/* Also used for memory mapped files, #FileData.buffersize is the size of the data. */
+static off64_t fd_seek_from_memory(FileData *filedata, off64_t offset, int whence)
+{
+  off64_t new_offset;
+  switch (whence) {
+    case SEEK_SET:
+      new_offset = offset;
+      break;
+    case SEEK_CUR:
+      new_offset = filedata->file_offset + offset;
+      break;
+    case SEEK_END:
+      new_offset = (off64_t)filedata->buffersize + offset;
+      break;
+    default:
+      return -1;
+  }
+
+  if (new_offset < 0 || new_offset > (off64_t)filedata->buffersize) {
+    return -1;
+  }
+  filedata->file_offset = new_offset;
+  return new_offset;
+}
+
 /* MemFile reading. */
 
 static ssize_t fd_read_from_memfile(FileData *filedata,
@@ -1360,14 +1451,19 @@ static FileData *blo_decode_and_check(FileData *fd, ReportList *reports)
   return fd;
 }
 
+/**
+ * \param is_minimal: Only the header and a few blocks will be read, e.g. for thumbnails.
+ */
 static FileData *blo_filedata_from_file_descriptor(const char *filepath,
                                                    ReportList *reports,
-                                                   int file)
+                                                   int file,
+                                                   const bool is_minimal)
 {
   FileDataReadFn *read_fn = NULL;
   FileDataSeekFn *seek_fn = NULL; /* Optional. */
 
   gzFile gzfile = (gzFile)Z_NULL;
+  GzipBlocksReader *gzip_blocks_reader = NULL;
 
   char header[7];
 
@@ -1390,6 +1486,16 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
     seek_fn = fd_seek_data_from_file;
   }
 
+  /* Gzip file written in blocks, decompressed on multiple threads. Minimal reads only need the
+   * start of the file, streaming decompresses much less of it. */
+  if ((read_fn == NULL) && !is_minimal && (header[0] == 0x1f && header[1] == 0x8b)) {
+    gzip_blocks_reader = BLI_gzip_blocks_reader_open(file);
+    if (gzip_blocks_reader != NULL) {
+      /* Like regular gzip files, blocks are read in order without seeking. */
+      read_fn = fd_read_gzip_blocks_from_file;
+    }
+  }
+
   /* Gzip file. */
   errno = 0;
   if ((read_fn == NULL) &&
@@ -1420,14 +1526,29 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
 
   fd->filedes = file;
   fd->gzfiledes = gzfile;
+  fd->gzip_blocks_reader = gzip_blocks_reader;
 
   fd->read = read_fn;
   fd->seek = seek_fn;
 
+  /* Map uncompressed files, so blocks are only read from disk when they are used and their data
+   * is copied straight from the page cache. Fall back to regular reading when mapping fails. */
+  if (read_fn == fd_read_data_from_file) {
+    BLI_mmap_file *mmap_file = BLI_mmap_open(file);
+    if (mmap_file != NULL) {
+      fd->mmap_file = mmap_file;
+      fd->buffersize = BLI_mmap_get_length(mmap_file);
+      fd->read = fd_read_from_mmap;
+      fd->seek = fd_seek_from_memory;
+    }
+  }
+
   return fd;
 }
 
-static FileData *blo_filedata_from_file_open(const char *filepath, ReportList *reports)
+static FileData *blo_filedata_from_file_open(const char *filepath,
+                                             ReportList *reports,
+                                             const bool is_minimal)
 {
   errno = 0;
   const int file = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
@@ -1439,7 +1560,7 @@ static FileData *blo_filedata_from_file_open(const char *filepath, ReportList *r
                 errno ? strerror(errno) : TIP_("unknown error reading file"));
     return NULL;
   }
-  FileData *fd = blo_filedata_from_file_descriptor(filepath, reports, file);
+  FileData *fd = blo_filedata_from_file_descriptor(filepath, reports, file, is_minimal);
   if ((fd == NULL) || (fd->filedes == -1)) {
     close(file);
   }
@@ -1450,7 +1571,7 @@ static FileData *blo_filedata_from_file_open(const char *filepath, ReportList *r
 /* on each new library added, it now checks for the current FileData and expands relativeness */
 FileData *blo_filedata_from_file(const char *filepath, ReportList *reports)
 {
-  FileData *fd = blo_filedata_from_file_open(filepath, reports);
+  FileData *fd = blo_filedata_from_file_open(filepath, reports, false);
   if (fd != NULL) {
     /* needed for library_append and read_libraries */
     BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
@@ -1466,7 +1587,7 @@ FileData *blo_filedata_from_file(const char *filepath, ReportList *reports)
  */
 static FileData *blo_filedata_from_file_minimal(const char *filepath)
 {
-  FileData *fd = blo_filedata_from_file_open(filepath, NULL);
+  FileData *fd = blo_filedata_from_file_open(filepath, NULL, true);
   if (fd != NULL) {
     decode_blender_header(fd);
     if (fd->flags & FD_FLAGS_FILE_OK) {
@@ -1580,6 +1701,14 @@ void blo_filedata_free(FileData *fd)
       gzclose(fd->gzfiledes);
     }
 
+    if (fd->gzip_blocks_reader != NULL) {
+      BLI_gzip_blocks_reader_close(fd->gzip_blocks_reader);
+    }
+
+    if (fd->mmap_file != NULL) {
+      BLI_mmap_free(fd->mmap_file);
+    }
+
     if (fd->strm.next_in) {
       if (inflateEnd(&fd->strm) != Z_OK) {
         printf("close gzip stream error\n");
@@ -1784,12 +1913,6 @@ static void *newdataadr(FileData *fd, const void *adr)
   return oldnewmap_lookup_and_inc(fd->datamap, adr, true);
 }
 
-/* only direct databocks */
-static void *newdataadr_no_us(FileData *fd, const void *adr)
-{
-  return oldnewmap_lookup_and_inc(fd->datamap, adr, false);
-}
-
 /* direct datablocks with global linking */
 void *blo_read_get_new_globaldata_address(FileData *fd, const void *adr)
 {
@@ -2146,7 +2269,11 @@ static void switch_endian_structs(const struct SDNA *filesdna, BHead *bhead)
   }
 }
 
-static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
+/**
+ * \param r_read_error: Set when the data of \a bh could not be read. Reading data-blocks can
+ * happen on multiple threads, the caller clears #FD_FLAGS_FILE_OK.
+ */
+static void *read_struct_ex(FileData *fd, BHead *bh, const char *blockname, bool *r_read_error)
 {
   void *temp = NULL;
 
@@ -2161,7 +2288,7 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
       if (BHEADN_FROM_BHEAD(bh)->has_data == false) {
         bh = blo_bhead_read_full(fd, bh);
         if (UNLIKELY(bh == NULL)) {
-          fd->flags &= ~FD_FLAGS_FILE_OK;
+          *r_read_error = true;
           return NULL;
         }
       }
@@ -2171,16 +2298,27 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
 
     if (fd->compflags[bh->SDNAnr] != SDNA_CMP_REMOVED) {
       if (fd->compflags[bh->SDNAnr] == SDNA_CMP_NOT_EQUAL) {
+        const void *data = (bh + 1);
 #ifdef USE_BHEAD_READ_ON_DEMAND
         if (BHEADN_FROM_BHEAD(bh)->has_data == false) {
-          bh = blo_bhead_read_full(fd, bh);
-          if (UNLIKELY(bh == NULL)) {
-            fd->flags &= ~FD_FLAGS_FILE_OK;
-            return NULL;
+          /* Reconstruct straight from the file in memory, without a copy of the old struct. */
+          data = blo_bhead_data_in_memory(fd, bh);
+          if (data == NULL) {
+            bh = blo_bhead_read_full(fd, bh);
+            if (UNLIKELY(bh == NULL)) {
+              *r_read_error = true;
+              return NULL;
+            }
+            data = (bh + 1);
           }
         }
 #endif
-        temp = DNA_struct_reconstruct(fd->reconstruct_info, bh->SDNAnr, bh->nr, (bh + 1));
+        temp = DNA_struct_reconstruct(fd->reconstruct_info, bh->SDNAnr, bh->nr, data);
+        if (UNLIKELY(fd->mmap_file && BLI_mmap_any_io_error(fd->mmap_file))) {
+          *r_read_error = true;
+          MEM_freeN(temp);
+          temp = NULL;
+        }
       }
       else {
         /* SDNA_CMP_EQUAL */
@@ -2193,7 +2331,7 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
           /* Instead of allocating the bhead, then copying it,
            * read the data from the file directly into the memory. */
           if (UNLIKELY(!blo_bhead_read_data(fd, bh, temp))) {
-            fd->flags &= ~FD_FLAGS_FILE_OK;
+            *r_read_error = true;
             MEM_freeN(temp);
             temp = NULL;
           }
@@ -2214,6 +2352,16 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
   return temp;
 }
 
+static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
+{
+  bool read_error = false;
+  void *temp = read_struct_ex(fd, bh, blockname, &read_error);
+  if (UNLIKELY(read_error)) {
+    fd->flags &= ~FD_FLAGS_FILE_OK;
+  }
+  return temp;
+}
+
 /* Like read_struct, but gets a pointer without allocating. Only works for
  * undo since DNA must match. */
 static const void *peek_struct_undo(FileData *fd, BHead *bhead)
@@ -5233,7 +5381,7 @@ static void direct_link_library(FileData *fd, Library *lib, Main *main)
   //  printf("direct_link_library: filepath %s\n", lib->filepath);
   //  printf("direct_link_library: filepath_abs %s\n", lib->filepath_abs);
 
-  BlendDataReader reader = {fd};
+  BlendDataReader reader = {fd, fd->datamap};
   BKE_packedfile_blend_read(&reader, &lib->packedfile);
 
   /* new main */
@@ -5406,12 +5554,12 @@ static const char *dataname(short id_code)
   return "Data from Lib Block";
 }
 
-static bool direct_link_id(FileData *fd, Main *main, const int tag, ID *id, ID *id_old)
+static bool direct_link_id(BlendDataReader *reader, Main *main, const int tag, ID *id, ID *id_old)
 {
-  BlendDataReader reader = {fd};
+  FileData *fd = reader->fd;
 
   /* Read part of datablock that is common between real and embedded datablocks. */
-  direct_link_id_common(&reader, main->curlib, id, id_old, tag);
+  direct_link_id_common(reader, main->curlib, id, id_old, tag);
 
   if (tag & LIB_TAG_ID_LINK_PLACEHOLDER) {
     /* For placeholder we only need to set the tag, no further data to read. */
@@ -5421,7 +5569,7 @@ static bool direct_link_id(FileData *fd, Main *main, const int tag, ID *id, ID *
 
   const IDTypeInfo *id_type = BKE_idtype_get_info_from_id(id);
   if (id_type->blend_read_data != NULL) {
-    id_type->blend_read_data(&reader, id);
+    id_type->blend_read_data(reader, id);
   }
 
   /* XXX Very weakly handled currently, see comment in read_libblock() before trying to
@@ -5430,19 +5578,19 @@ static bool direct_link_id(FileData *fd, Main *main, const int tag, ID *id, ID *
 
   switch (GS(id->name)) {
     case ID_WM:
-      direct_link_windowmanager(&reader, (wmWindowManager *)id);
+      direct_link_windowmanager(reader, (wmWindowManager *)id);
       break;
     case ID_SCR:
-      success = direct_link_screen(&reader, (bScreen *)id);
+      success = direct_link_screen(reader, (bScreen *)id);
       break;
     case ID_SCE:
-      direct_link_scene(&reader, (Scene *)id);
+      direct_link_scene(reader, (Scene *)id);
       break;
     case ID_OB:
-      direct_link_object(&reader, (Object *)id);
+      direct_link_object(reader, (Object *)id);
       break;
     case ID_IP:
-      direct_link_ipo(&reader, (Ipo *)id);
+      direct_link_ipo(reader, (Ipo *)id);
       break;
     case ID_LI:
       direct_link_library(fd, (Library *)id, main);
@@ -5488,14 +5636,22 @@ static bool direct_link_id(FileData *fd, Main *main, const int tag, ID *id, ID *
   /* try to restore (when undoing) or clear ID's cache pointers. */
   if (id_type->foreach_cache != NULL) {
     BKE_idtype_id_foreach_cache(
-        id, blo_cache_storage_entry_restore_in_new, reader.fd->cache_storage);
+        id, blo_cache_storage_entry_restore_in_new, fd->cache_storage);
   }
 
   return success;
 }
 
-/* Read all data associated with a datablock into datamap. */
-static BHead *read_data_into_datamap(FileData *fd, BHead *bhead, const char *allocname)
+/**
+ * Read all data associated with a datablock into datamap.
+ *
+ * \param r_read_error: See #read_struct_ex.
+ */
+static BHead *read_data_into_datamap(FileData *fd,
+                                     OldNewMap *datamap,
+                                     BHead *bhead,
+                                     const char *allocname,
+                                     bool *r_read_error)
 {
   bhead = blo_bhead_next(fd, bhead);
 
@@ -5516,9 +5672,9 @@ static BHead *read_data_into_datamap(FileData *fd, BHead *bhead, const char *all
     }
 #endif
 
-    void *data = read_struct(fd, bhead, allocname);
+    void *data = read_struct_ex(fd, bhead, allocname, r_read_error);
     if (data) {
-      oldnewmap_insert(fd->datamap, bhead->old, data, 0);
+      oldnewmap_insert(datamap, bhead->old, data, 0);
     }
 
     bhead = blo_bhead_next(fd, bhead);
@@ -5774,6 +5930,102 @@ static bool read_libblock_undo_restore(
  * When reading for undo, libraries, linked datablocks and unchanged datablocks
  * will be restored from the old database. Only new or changed datablocks will
  * actually be read. */
+#ifdef USE_PARALLEL_READ_DATA
+
+/* Data-block whose data is read after the ID structs of the whole file have been read. */
+typedef struct DeferredReadData {
+  struct DeferredReadData *next, *prev;
+  Main *main;
+  /* Block of the ID struct, followed by the data blocks. */
+  BHead *bhead;
+  ID *id;
+  int id_tag;
+  const char *allocname;
+  bool success;
+  /* Tasks don't change the shared #FileData.flags, see #read_struct_ex. */
+  bool read_error;
+} DeferredReadData;
+
+/* Data-blocks can only be read on other threads when reading blocks doesn't depend on the read
+ * position of the file, and when they aren't restored from the old main on undo. */
+static bool read_data_can_run_in_parallel(const FileData *fd)
+{
+  if (fd->memfile != NULL) {
+    return false;
+  }
+  return (fd->seek == NULL) || (fd->mmap_file != NULL);
+}
+
+static bool read_libblock_can_defer(const FileData *fd, const ID *id, const ID *id_old)
+{
+  if (!fd->use_deferred_read_data || id_old != NULL) {
+    return false;
+  }
+  const IDTypeInfo *id_type = BKE_idtype_get_info_from_id(id);
+  return (id_type->flags & IDTYPE_FLAGS_THREADSAFE_READ_DATA) != 0;
+}
+
+typedef struct DeferredReadDataTaskData {
+  FileData *fd;
+  DeferredReadData **deferred;
+} DeferredReadDataTaskData;
+
+static void read_libblock_deferred_data_cb(void *__restrict userdata,
+                                           const int index,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  DeferredReadDataTaskData *data = userdata;
+  DeferredReadData *deferred = data->deferred[index];
+  FileData *fd = data->fd;
+
+  /* Pointers are only resolved within the data-block, so every task can use its own map. */
+  OldNewMap *datamap = oldnewmap_new();
+  read_data_into_datamap(
+      fd, datamap, deferred->bhead, deferred->allocname, &deferred->read_error);
+  BlendDataReader reader = {fd, datamap};
+  deferred->success = direct_link_id(
+      &reader, deferred->main, deferred->id_tag, deferred->id, NULL);
+  oldnewmap_clear(datamap);
+  oldnewmap_free(datamap);
+}
+
+/* Read the data of all data-blocks that were deferred by #read_libblock. */
+static void read_libblocks_deferred_data(FileData *fd)
+{
+  const int deferred_len = BLI_listbase_count(&fd->deferred_read_data);
+  if (deferred_len == 0) {
+    return;
+  }
+
+  DeferredReadData **deferred = MEM_malloc_arrayN(deferred_len, sizeof(*deferred), __func__);
+  int i = 0;
+  LISTBASE_FOREACH (DeferredReadData *, deferred_data, &fd->deferred_read_data) {
+    deferred[i++] = deferred_data;
+  }
+
+  DeferredReadDataTaskData data = {fd, deferred};
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  /* Data-blocks differ a lot in size, balance them one by one. */
+  settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(0, deferred_len, &data, read_libblock_deferred_data_cb, &settings);
+
+  for (i = 0; i < deferred_len; i++) {
+    if (deferred[i]->read_error) {
+      fd->flags &= ~FD_FLAGS_FILE_OK;
+    }
+    if (!deferred[i]->success) {
+      /* Same as in #read_libblock. */
+      BKE_id_free(deferred[i]->main, deferred[i]->id);
+    }
+  }
+
+  MEM_freeN(deferred);
+  BLI_freelistN(&fd->deferred_read_data);
+}
+
+#endif /* USE_PARALLEL_READ_DATA */
+
 static BHead *read_libblock(FileData *fd,
                             Main *main,
                             BHead *bhead,
@@ -5847,15 +6099,43 @@ static BHead *read_libblock(FileData *fd,
       }
     }
 
-    direct_link_id(fd, main, id_tag, id, id_old);
+    BlendDataReader reader = {fd, fd->datamap};
+    direct_link_id(&reader, main, id_tag, id, id_old);
     return blo_bhead_next(fd, bhead);
   }
 
   /* Read datablock contents.
    * Use convenient malloc name for debugging and better memory link prints. */
   const char *allocname = dataname(idcode);
-  bhead = read_data_into_datamap(fd, bhead, allocname);
-  const bool success = direct_link_id(fd, main, id_tag, id, id_old);
+
+#ifdef USE_PARALLEL_READ_DATA
+  if (read_libblock_can_defer(fd, id, id_old)) {
+    DeferredReadData *deferred = MEM_mallocN(sizeof(*deferred), __func__);
+    deferred->main = main;
+    deferred->bhead = bhead;
+    deferred->id = id;
+    deferred->id_tag = id_tag;
+    deferred->allocname = allocname;
+    deferred->success = false;
+    deferred->read_error = false;
+    BLI_addtail(&fd->deferred_read_data, deferred);
+
+    /* Only read the headers of the data blocks for now. */
+    bhead = blo_bhead_next(fd, bhead);
+    while (bhead && bhead->code == DATA) {
+      bhead = blo_bhead_next(fd, bhead);
+    }
+    return bhead;
+  }
+#endif
+
+  bool read_error = false;
+  bhead = read_data_into_datamap(fd, fd->datamap, bhead, allocname, &read_error);
+  if (UNLIKELY(read_error)) {
+    fd->flags &= ~FD_FLAGS_FILE_OK;
+  }
+  BlendDataReader reader = {fd, fd->datamap};
+  const bool success = direct_link_id(&reader, main, id_tag, id, id_old);
   oldnewmap_clear(fd->datamap);
 
   if (!success) {
@@ -6169,9 +6449,13 @@ static BHead *read_userdef(BlendFileData *bfd, FileData *fd, BHead *bhead)
   user->subversionfile = bfd->main->subversionfile;
 
   /* read all data into fd->datamap */
-  bhead = read_data_into_datamap(fd, bhead, "user def");
+  bool read_error = false;
+  bhead = read_data_into_datamap(fd, fd->datamap, bhead, "user def", &read_error);
+  if (UNLIKELY(read_error)) {
+    fd->flags &= ~FD_FLAGS_FILE_OK;
+  }
 
-  BlendDataReader reader_ = {fd};
+  BlendDataReader reader_ = {fd, fd->datamap};
   BlendDataReader *reader = &reader_;
 
   BLO_read_list(reader, &user->themes);
@@ -6296,6 +6580,10 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     }
   }
 
+#ifdef USE_PARALLEL_READ_DATA
+  fd->use_deferred_read_data = read_data_can_run_in_parallel(fd);
+#endif
+
   while (bhead) {
     switch (bhead->code) {
       case DATA:
@@ -6347,6 +6635,12 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     }
   }
 
+#ifdef USE_PARALLEL_READ_DATA
+  /* Linking and versioning below expect all data to be read. */
+  read_libblocks_deferred_data(fd);
+  fd->use_deferred_read_data = false;
+#endif
+
   /* do before read_libraries, but skip undo case */
   if (fd->memfile == NULL) {
     if ((fd->skip_flags & BLO_READ_SKIP_DATA) == 0) {
@@ -7975,17 +8269,21 @@ static void read_libraries(FileData *basefd, ListBase *mainlist)
 
 void *BLO_read_get_new_data_address(BlendDataReader *reader, const void *old_address)
 {
-  return newdataadr(reader->fd, old_address);
+  return oldnewmap_lookup_and_inc(reader->datamap, old_address, true);
 }
 
 void *BLO_read_get_new_data_address_no_us(BlendDataReader *reader, const void *old_address)
 {
-  return newdataadr_no_us(reader->fd, old_address);
+  return oldnewmap_lookup_and_inc(reader->datamap, old_address, false);
 }
 
 void *BLO_read_get_new_packed_address(BlendDataReader *reader, const void *old_address)
 {
-  return newpackedadr(reader->fd, old_address);
+  FileData *fd = reader->fd;
+  if (fd->packedmap && old_address) {
+    return oldnewmap_lookup_and_inc(fd->packedmap, old_address, true);
+  }
+  return oldnewmap_lookup_and_inc(reader->datamap, old_address, true);
 }
 
 ID *BLO_read_get_new_id_address(BlendLibReader *reader, Library *lib, ID *id)
@@ -8104,7 +8402,7 @@ void BLO_read_pointer_array(BlendDataReader *reader, void **ptr_p)
 {
   FileData *fd = reader->fd;
 
-  void *orig_array = newdataadr(fd, *ptr_p);
+  void *orig_array = BLO_read_get_new_data_address(reader, *ptr_p);
   if (orig_array == NULL) {
     *ptr_p = NULL;
     return;
@@ -33,7 +33,9 @@
 #include "DNA_windowmanager_types.h" /* for ReportType */
 #include "zlib.h"
 
+struct BLI_mmap_file;
 struct BLOCacheStorage;
+struct GzipBlocksReader;
 struct GSet;
 struct IDNameLib_Map;
 struct Key;
@@ -85,6 +87,8 @@ typedef struct FileData {
 
   /** Regular file reading. */
   int filedes;
+  /** Memory mapped file reading, #buffersize is the size of the file. */
+  struct BLI_mmap_file *mmap_file;
 
   /** Variables needed for reading from memory / stream. */
   const char *buffer;
@@ -96,6 +100,8 @@ typedef struct FileData {
 
   /** Variables needed for reading from file. */
   gzFile gzfiledes;
+  /** Gzip file written in blocks, decompressed on multiple threads. */
+  struct GzipBlocksReader *gzip_blocks_reader;
   /** Gzip stream for memory decompression. */
   z_stream strm;
 
@@ -118,6 +124,12 @@ typedef struct FileData {
   /** Optionally skip some data-blocks when they're not needed. */
   eBLOReadSkip skip_flags;
 
+  /** When set, the data of data-blocks that can be read on other threads is only read after all
+   * ID structs, see #USE_PARALLEL_READ_DATA. */
+  bool use_deferred_read_data;
+  /** Data-blocks whose data still has to be read. */
+  ListBase deferred_read_data;
+
   struct OldNewMap *datamap;
   struct OldNewMap *globmap;
   struct OldNewMap *libmap;
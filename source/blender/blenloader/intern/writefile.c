@@ -124,6 +124,7 @@
 
 #include "BLI_bitmap.h"
 #include "BLI_blenlib.h"
+#include "BLI_gzip_blocks.h"
 #include "BLI_mempool.h"
 #include "MEM_guardedalloc.h" /* MEM_freeN */
 
@@ -185,6 +186,12 @@
 /** Use if we want to store how many bytes have been written to the file. */
 // #define USE_WRITE_DATA_LEN
 
+/**
+ * Compress files in independent blocks on multiple threads, see #BLI_gzip_blocks.h.
+ * The result is still a regular gzip file, so it can be read by versions without support for it.
+ */
+#define USE_GZIP_BLOCKS
+
 /* -------------------------------------------------------------------- */
 /** \name Internal Write Wrapper's (Abstracts Compression)
  * \{ */
@@ -192,6 +199,7 @@
 typedef enum {
   WW_WRAP_NONE = 1,
   WW_WRAP_ZLIB,
+  WW_WRAP_GZIP_BLOCKS,
 } eWriteWrapType;
 
 typedef struct WriteWrap WriteWrap;
@@ -208,6 +216,7 @@ struct WriteWrap {
   union {
     int file_handle;
     gzFile gz_handle;
+    GzipBlocksWriter *gzip_blocks_handle;
   } _user_data;
 };
 
@@ -263,6 +272,30 @@ static size_t ww_write_zlib(WriteWrap *ww, const char *buf, size_t buf_len)
 }
 #undef FILE_HANDLE
 
+/* zlib, in blocks */
+#define FILE_HANDLE(ww) (ww)->_user_data.gzip_blocks_handle
+
+static bool ww_open_gzip_blocks(WriteWrap *ww, const char *filepath)
+{
+  GzipBlocksWriter *writer = BLI_gzip_blocks_writer_open(filepath, 1);
+
+  if (writer != NULL) {
+    FILE_HANDLE(ww) = writer;
+    return true;
+  }
+
+  return false;
+}
+static bool ww_close_gzip_blocks(WriteWrap *ww)
+{
+  return BLI_gzip_blocks_writer_close(FILE_HANDLE(ww));
+}
+static size_t ww_write_gzip_blocks(WriteWrap *ww, const char *buf, size_t buf_len)
+{
+  return BLI_gzip_blocks_writer_write(FILE_HANDLE(ww), buf, buf_len) ? buf_len : 0;
+}
+#undef FILE_HANDLE
+
 /* --- end compression types --- */
 
 static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
@@ -277,6 +310,14 @@ static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
       r_ww->use_buf = false;
       break;
     }
+    case WW_WRAP_GZIP_BLOCKS: {
+      r_ww->open = ww_open_gzip_blocks;
+      r_ww->close = ww_close_gzip_blocks;
+      r_ww->write = ww_write_gzip_blocks;
+      /* Data is collected into blocks. */
+      r_ww->use_buf = false;
+      break;
+    }
     default: {
       r_ww->open = ww_open_none;
       r_ww->close = ww_close_none;
@@ -2107,7 +2148,11 @@ bool BLO_write_file(Main *mainvar,
   BLI_snprintf(tempname, sizeof(tempname), "%s@", filepath);
 
   if (write_flags & G_FILE_COMPRESS) {
+#ifdef USE_GZIP_BLOCKS
+    ww_type = WW_WRAP_GZIP_BLOCKS;
+#else
     ww_type = WW_WRAP_ZLIB;
+#endif
   }
   else {
     ww_type = WW_WRAP_NONE;
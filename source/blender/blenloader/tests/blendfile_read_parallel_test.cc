@@ -0,0 +1,104 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include "blendfile_loading_base_test.h"
+
+#include <string>
+
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+
+#include "BLI_fileops.h"
+#include "BLI_listbase.h"
+#include "BLI_string.h"
+
+#include "BKE_customdata.h"
+#include "BKE_global.h"
+#include "BKE_lib_id.h"
+#include "BKE_main.h"
+#include "BKE_mesh.h"
+
+#include "BLO_readfile.h"
+#include "BLO_writefile.h"
+
+/* Files written and read back, the data of meshes is read on multiple threads. */
+class BlendfileReadParallelTest : public BlendfileLoadingBaseTest {
+ protected:
+  static constexpr int meshes_num = 64;
+  std::string filepath;
+
+  void SetUp() override
+  {
+    filepath = testing::TempDir() + "blender_read_parallel_test.blend";
+
+    Main *bmain = G_MAIN;
+    for (int i = 0; i < meshes_num; i++) {
+      char name[MAX_ID_NAME - 2];
+      BLI_snprintf(name, sizeof(name), "ParallelMesh%d", i);
+      Mesh *mesh = BKE_mesh_add(bmain, name);
+      /* Different sizes, so the tasks don't all take the same time. */
+      Mesh *mesh_src = BKE_mesh_new_nomain(16 * (i + 1), 0, 0, 0, 0);
+      for (int v = 0; v < mesh_src->totvert; v++) {
+        mesh_src->mvert[v].co[0] = (float)i;
+        mesh_src->mvert[v].co[1] = (float)v;
+      }
+      BKE_mesh_nomain_to_mesh(mesh_src, mesh, nullptr, &CD_MASK_MESH, true);
+      /* Keep the mesh when saving, it has no users. */
+      id_fake_user_set(&mesh->id);
+    }
+  }
+
+  void TearDown() override
+  {
+    Main *bmain = G_MAIN;
+    LISTBASE_FOREACH_MUTABLE (Mesh *, mesh, &bmain->meshes) {
+      BKE_id_delete(bmain, mesh);
+    }
+    BLI_delete(filepath.c_str(), false, false);
+    BlendfileLoadingBaseTest::TearDown();
+  }
+
+  void write_and_read(const int write_flags)
+  {
+    BlendFileWriteParams params = {BLO_WRITE_PATH_REMAP_NONE};
+    ASSERT_TRUE(BLO_write_file(G_MAIN, filepath.c_str(), write_flags, &params, nullptr));
+
+    bfile = BLO_read_from_file(filepath.c_str(), BLO_READ_SKIP_NONE, nullptr);
+    ASSERT_NE(bfile, nullptr);
+    ASSERT_EQ(BLI_listbase_count(&bfile->main->meshes), meshes_num);
+
+    LISTBASE_FOREACH (const Mesh *, mesh, &bfile->main->meshes) {
+      int i = 0;
+      ASSERT_EQ(sscanf(mesh->id.name + 2, "ParallelMesh%d", &i), 1);
+      ASSERT_EQ(mesh->totvert, 16 * (i + 1));
+      ASSERT_NE(mesh->mvert, nullptr);
+      for (int v = 0; v < mesh->totvert; v++) {
+        EXPECT_EQ(mesh->mvert[v].co[0], (float)i);
+        EXPECT_EQ(mesh->mvert[v].co[1], (float)v);
+      }
+    }
+  }
+};
+
+/* Uncompressed files are read through a memory mapping. */
+TEST_F(BlendfileReadParallelTest, Uncompressed)
+{
+  write_and_read(G.fileflags & ~G_FILE_COMPRESS);
+}
+
+TEST_F(BlendfileReadParallelTest, Compressed)
+{
+  write_and_read(G.fileflags | G_FILE_COMPRESS);
+}
@@ -0,0 +1,174 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include "blendfile_loading_base_test.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "DNA_brush_types.h"
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_object_types.h"
+#include "DNA_scene_types.h"
+
+#include "BLI_listbase.h"
+#include "BLI_string.h"
+
+#include "BKE_brush.h"
+#include "BKE_customdata.h"
+#include "BKE_global.h"
+#include "BKE_lib_id.h"
+#include "BKE_main.h"
+#include "BKE_mesh.h"
+#include "BKE_object.h"
+#include "BKE_scene.h"
+
+#include "DEG_depsgraph.h"
+
+#include "BLO_undofile.h"
+#include "BLO_writefile.h"
+
+/* Memfile undo steps written and read back, unchanged data is shared with the previous step.
+ * Every ID is written for every step, edits without any update tagging must be stored too. */
+class BlendfileUndoTest : public BlendfileLoadingBaseTest {
+ protected:
+  Mesh *mesh = nullptr;
+  Object *object = nullptr;
+  Brush *brush = nullptr;
+  Scene *scene = nullptr;
+  MemFile *memfile_prev = nullptr;
+  MemFile *memfile = nullptr;
+
+  void SetUp() override
+  {
+    Main *bmain = G_MAIN;
+    mesh = BKE_mesh_add(bmain, "UndoMesh");
+    object = BKE_object_add_only_object(bmain, OB_MESH, "UndoObject");
+    BKE_mesh_nomain_to_mesh(
+        BKE_mesh_new_nomain(4, 0, 0, 0, 0), mesh, object, &CD_MASK_MESH, true);
+    object->data = mesh;
+    id_us_plus(&mesh->id);
+    brush = BKE_brush_add(bmain, "UndoBrush", OB_MODE_SCULPT);
+    scene = BKE_scene_add(bmain, "UndoScene");
+
+    memfile_prev = undo_push(nullptr);
+  }
+
+  void TearDown() override
+  {
+    /* Later steps don't own the chunks they share with earlier ones. */
+    for (MemFile *memfile_iter : {memfile, memfile_prev}) {
+      if (memfile_iter != nullptr) {
+        BLO_memfile_free(memfile_iter);
+        MEM_freeN(memfile_iter);
+      }
+    }
+    Main *bmain = G_MAIN;
+    BKE_id_delete(bmain, object);
+    BKE_id_delete(bmain, mesh);
+    BKE_id_delete(bmain, brush);
+    BKE_id_delete(bmain, scene);
+    BlendfileLoadingBaseTest::TearDown();
+  }
+
+  static MemFile *undo_push(MemFile *reference)
+  {
+    MemFile *memfile_new = (MemFile *)MEM_callocN(sizeof(MemFile), __func__);
+    EXPECT_TRUE(BLO_write_file_mem(G_MAIN, reference, memfile_new, G.fileflags));
+    return memfile_new;
+  }
+
+  /* Read the last undo step, the caller must free the returned main. */
+  Main *undo_read()
+  {
+    return BLO_memfile_main_get(memfile, G_MAIN, nullptr);
+  }
+
+  bool id_chunks_shared(const ID *id)
+  {
+    int chunks_num = 0;
+    bool is_identical = true;
+    LISTBASE_FOREACH (const MemFileChunk *, chunk, &memfile->chunks) {
+      if (chunk->id_session_uuid == id->session_uuid) {
+        is_identical &= chunk->is_identical;
+        chunks_num++;
+      }
+    }
+    EXPECT_GT(chunks_num, 0);
+    return is_identical;
+  }
+};
+
+TEST_F(BlendfileUndoTest, UnchangedIDReused)
+{
+  memfile = undo_push(memfile_prev);
+  EXPECT_TRUE(id_chunks_shared(&mesh->id));
+  EXPECT_TRUE(id_chunks_shared(&object->id));
+}
+
+TEST_F(BlendfileUndoTest, InPlaceEditTaggingUser)
+{
+  /* Like sculpt mode, where the coordinates of the mesh are changed while only the object is
+   * tagged for update. */
+  mesh->mvert[2].co[0] = 5.0f;
+  DEG_id_tag_update(&object->id, ID_RECALC_GEOMETRY);
+  memfile = undo_push(memfile_prev);
+  EXPECT_FALSE(id_chunks_shared(&mesh->id));
+
+  Main *bmain_undo = undo_read();
+  ASSERT_NE(bmain_undo, nullptr);
+  const Mesh *mesh_undo = (const Mesh *)BLI_findstring(
+      &bmain_undo->meshes, "MEUndoMesh", offsetof(ID, name));
+  ASSERT_NE(mesh_undo, nullptr);
+  ASSERT_EQ(mesh_undo->totvert, 4);
+  EXPECT_EQ(mesh_undo->mvert[2].co[0], 5.0f);
+  BKE_main_free(bmain_undo);
+}
+
+TEST_F(BlendfileUndoTest, UntaggedBrushEdit)
+{
+  /* Brushes are not evaluated by the depsgraph, changes to them are never tagged. */
+  brush->size = 123;
+  memfile = undo_push(memfile_prev);
+
+  Main *bmain_undo = undo_read();
+  ASSERT_NE(bmain_undo, nullptr);
+  const Brush *brush_undo = (const Brush *)BLI_findstring(
+      &bmain_undo->brushes, "BRUndoBrush", offsetof(ID, name));
+  ASSERT_NE(brush_undo, nullptr);
+  EXPECT_EQ(brush_undo->size, 123);
+  BKE_main_free(bmain_undo);
+}
+
+TEST_F(BlendfileUndoTest, UntaggedSceneListEdit)
+{
+  /* Like the marker operators, which change a list owned by the scene (not the scene struct
+   * itself) and don't tag anything for update. */
+  TimeMarker *marker = (TimeMarker *)MEM_callocN(sizeof(TimeMarker), __func__);
+  marker->frame = 42;
+  STRNCPY(marker->name, "UndoMarker");
+  BLI_addtail(&scene->markers, marker);
+  memfile = undo_push(memfile_prev);
+  EXPECT_FALSE(id_chunks_shared(&scene->id));
+
+  Main *bmain_undo = undo_read();
+  ASSERT_NE(bmain_undo, nullptr);
+  const Scene *scene_undo = (const Scene *)BLI_findstring(
+      &bmain_undo->scenes, "SCUndoScene", offsetof(ID, name));
+  ASSERT_NE(scene_undo, nullptr);
+  ASSERT_EQ(BLI_listbase_count(&scene_undo->markers), 1);
+  EXPECT_EQ(((const TimeMarker *)scene_undo->markers.first)->frame, 42);
+  BKE_main_free(bmain_undo);
+}
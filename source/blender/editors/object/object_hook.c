@@ -549,7 +549,7 @@ static int add_hook_object(const bContext *C,
   }
 
   md = obedit->modifiers.first;
-  while (md && BKE_modifier_get_info(md->type)->type == eModifierTypeType_OnlyDeform) {
+  while (md && BKE_modifier_is_deform_only(md)) {
     md = md->next;
   }
 
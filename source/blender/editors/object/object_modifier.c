@@ -184,7 +184,7 @@ ModifierData *ED_object_modifier_add(
     if (mti->flags & eModifierTypeFlag_RequiresOriginalData) {
       md = ob->modifiers.first;
 
-      while (md && BKE_modifier_get_info(md->type)->type == eModifierTypeType_OnlyDeform) {
+      while (md && BKE_modifier_is_deform_only(md)) {
         md = md->next;
       }
 
@@ -428,9 +428,7 @@ void ED_object_modifier_clear(Main *bmain, Scene *scene, Object *ob)
 bool ED_object_modifier_move_up(ReportList *reports, Object *ob, ModifierData *md)
 {
   if (md->prev) {
-    const ModifierTypeInfo *mti = BKE_modifier_get_info(md->type);
-
-    if (mti->type != eModifierTypeType_OnlyDeform) {
+    if (!BKE_modifier_is_deform_only(md)) {
       const ModifierTypeInfo *nmti = BKE_modifier_get_info(md->prev->type);
 
       if (nmti->flags & eModifierTypeFlag_RequiresOriginalData) {
@@ -456,9 +454,7 @@ bool ED_object_modifier_move_down(ReportList *reports, Object *ob, ModifierData
     const ModifierTypeInfo *mti = BKE_modifier_get_info(md->type);
 
     if (mti->flags & eModifierTypeFlag_RequiresOriginalData) {
-      const ModifierTypeInfo *nmti = BKE_modifier_get_info(md->next->type);
-
-      if (nmti->type != eModifierTypeType_OnlyDeform) {
+      if (!BKE_modifier_is_deform_only(md->next)) {
         BKE_report(reports, RPT_WARNING, "Cannot move beyond a non-deforming modifier");
         return false;
       }
@@ -753,7 +749,7 @@ static int modifier_apply_obdata(
       multires_force_sculpt_rebuild(ob);
     }
 
-    if (mmd && mmd->totlvl && mti->type == eModifierTypeType_OnlyDeform) {
+    if (mmd && mmd->totlvl && BKE_modifier_is_deform_only(md_eval)) {
       if (!multiresModifier_reshapeFromDeformModifier(depsgraph, ob, mmd, md_eval)) {
         BKE_report(reports, RPT_ERROR, "Multires modifier returned error, skipping apply");
         return 0;
@@ -0,0 +1,86 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup fn
+ *
+ * An #MFBufferPool provides the memory for arrays that are computed while multi-functions are
+ * evaluated. Buffers that are given back are reused by later requests of a similar size, also
+ * across evaluations. Memory is only returned to the system when the pool is destructed.
+ *
+ * A pool is passed to the called functions with #MFContextBuilder::set_buffer_pool. When the same
+ * pool is used for repeated evaluations, e.g. every frame of a simulation, no memory has to be
+ * allocated once the pool has all the buffers it needs.
+ *
+ * A pool must not be used by multiple threads at the same time. Tasks that evaluate in parallel
+ * use one of the #task_pools each, those are kept as well to reuse their buffers.
+ */
+
+#include <memory>
+
+#include "BLI_linear_allocator.hh"
+#include "BLI_map.hh"
+#include "BLI_vector.hh"
+
+#include "FN_cpp_type.hh"
+
+namespace blender::fn {
+
+class MFBufferPool : NonCopyable, NonMovable {
+ private:
+  /* Buffers are never freed individually, so they can be taken from a linear allocator. */
+  LinearAllocator<> allocator_;
+  /* Buffers that are too large for the linear allocator are allocated separately. */
+  Vector<void *> large_buffers_;
+  /* Buffers that can be reused, grouped by their size class and alignment. */
+  Map<std::pair<int64_t, int64_t>, Vector<void *>> free_buffers_;
+  /* Pools of tasks that run in parallel, see #task_pools. */
+  Vector<std::unique_ptr<MFBufferPool>> task_pools_;
+
+  int64_t allocation_amount_ = 0;
+  int64_t reuse_amount_ = 0;
+  int64_t allocated_bytes_ = 0;
+
+ public:
+  MFBufferPool() = default;
+  ~MFBufferPool();
+
+  /**
+   * Get an uninitialized buffer that can hold an array of the given type and size. It has to be
+   * given back with #deallocate using the same type and size.
+   */
+  void *allocate(const CPPType &type, int64_t size);
+  void deallocate(void *buffer, const CPPType &type, int64_t size);
+
+  /**
+   * Get a separate pool for every task that is evaluated in parallel, e.g. for different parts of
+   * a mask. Must not be called while other threads use this pool.
+   */
+  Span<std::unique_ptr<MFBufferPool>> task_pools(int64_t amount);
+
+  /* The statistics include the task pools. */
+
+  /** Number of buffers that had to be allocated, because no free buffer could be reused. */
+  int64_t allocation_amount() const;
+  /** Number of requests that were served with a buffer that had been given back before. */
+  int64_t reuse_amount() const;
+  /** Total size of all buffers owned by the pool. */
+  int64_t allocated_bytes() const;
+};
+
+}  // namespace blender::fn
@@ -28,6 +28,95 @@
 
 namespace blender::fn {
 
+namespace builder_detail {
+
+/** Gives the same value for every index, used for inputs that are a single value. */
+template<typename T> class SingleValueAccessor {
+ private:
+  const T &value_;
+
+ public:
+  SingleValueAccessor(const T &value) : value_(value)
+  {
+  }
+
+  const T &operator[](const int64_t UNUSED(index)) const
+  {
+    return value_;
+  }
+};
+
+template<typename Fn> inline void devirtualize_vspans(const Fn &fn)
+{
+  fn();
+}
+
+template<typename Fn, typename T, typename... Rest>
+inline void devirtualize_vspans(const Fn &fn, const VSpan<T> &span, const Rest &... rest)
+{
+  if (span.is_single_element()) {
+    const SingleValueAccessor<T> accessor{span.as_single_element()};
+    devirtualize_vspans([&](const auto &... others) { fn(accessor, others...); }, rest...);
+  }
+  else {
+    const Span<T> accessor = span.as_full_array();
+    devirtualize_vspans([&](const auto &... others) { fn(accessor, others...); }, rest...);
+  }
+}
+
+/**
+ * Calls the element function for every index in the mask and constructs the outputs from the
+ * results.
+ *
+ * Indexing a #VSpan checks its category for every element, which keeps the compiler from
+ * inlining the element function into a tight loop. So when all inputs are single values or
+ * arrays, they are passed to the loop as #SingleValueAccessor or #Span instead. Every
+ * combination of the two gets its own loop, and a contiguous mask gets a plain counting loop
+ * that can be vectorized. Inputs of other categories fall back to indexing the virtual spans.
+ *
+ * When all inputs are single values, the element function is only called once and the result is
+ * copied to every index.
+ */
+template<typename ElementFuncT, typename Out1, typename... In>
+inline void call_element_fn(IndexMask mask,
+                            const ElementFuncT &element_fn,
+                            MutableSpan<Out1> out1,
+                            const VSpan<In> &... inputs)
+{
+  Out1 *__restrict out1_data = out1.data();
+
+  if (mask.size() > 1 && (... && inputs.is_single_element())) {
+    const Out1 value = element_fn(inputs.as_single_element()...);
+    mask.foreach_index(
+        [&](const int64_t i) { new (static_cast<void *>(out1_data + i)) Out1(value); });
+    return;
+  }
+
+  auto loop = [&](const auto &... accessors) {
+    if (mask.is_range()) {
+      const IndexRange range = mask.as_range();
+      const int64_t end = range.one_after_last();
+      for (int64_t i = range.start(); i < end; i++) {
+        new (static_cast<void *>(out1_data + i)) Out1(element_fn(accessors[i]...));
+      }
+    }
+    else {
+      for (const int64_t i : mask.indices()) {
+        new (static_cast<void *>(out1_data + i)) Out1(element_fn(accessors[i]...));
+      }
+    }
+  };
+
+  if ((... && (inputs.is_single_element() || inputs.is_full_array()))) {
+    devirtualize_vspans(loop, inputs...);
+  }
+  else {
+    loop(inputs...);
+  }
+}
+
+}  // namespace builder_detail
+
 /**
  * Generates a multi-function with the following parameters:
  * 1. single input (SI) of type In1
@@ -35,6 +124,14 @@ namespace blender::fn {
  *
  * This example creates a function that adds 10 to the incoming values:
  *  CustomMF_SI_SO<int, int> fn("add 10", [](int value) { return value + 10; });
+ *
+ * The element function is a template parameter, so it is inlined into the loops over the
+ * elements. Pass a lambda rather than a function pointer, a pointer is only known at run-time
+ * and is called for every element.
+ *
+ * Optionally a batch function can be given as well. It is called instead of the element function
+ * when the mask is a contiguous range and the input is an array, with the input and output
+ * sliced to that range. It has to construct all outputs.
  */
 template<typename In1, typename Out1> class CustomMF_SI_SO : public MultiFunction {
  private:
@@ -55,11 +152,30 @@ template<typename In1, typename Out1> class CustomMF_SI_SO : public MultiFunctio
   {
   }
 
+  template<typename ElementFuncT, typename BatchFuncT>
+  CustomMF_SI_SO(StringRef name, ElementFuncT element_fn, BatchFuncT batch_fn)
+      : CustomMF_SI_SO(name, CustomMF_SI_SO::create_function(element_fn, batch_fn))
+  {
+  }
+
   template<typename ElementFuncT> static FunctionT create_function(ElementFuncT element_fn)
   {
     return [=](IndexMask mask, VSpan<In1> in1, MutableSpan<Out1> out1) {
-      mask.foreach_index(
-          [&](int i) { new (static_cast<void *>(&out1[i])) Out1(element_fn(in1[i])); });
+      builder_detail::call_element_fn(mask, element_fn, out1, in1);
+    };
+  }
+
+  template<typename ElementFuncT, typename BatchFuncT>
+  static FunctionT create_function(ElementFuncT element_fn, BatchFuncT batch_fn)
+  {
+    return [=](IndexMask mask, VSpan<In1> in1, MutableSpan<Out1> out1) {
+      if (mask.is_range() && in1.is_full_array()) {
+        const IndexRange range = mask.as_range();
+        batch_fn(in1.as_full_array().slice(range), out1.slice(range.start(), range.size()));
+      }
+      else {
+        builder_detail::call_element_fn(mask, element_fn, out1, in1);
+      }
     };
   }
 
@@ -76,6 +192,8 @@ template<typename In1, typename Out1> class CustomMF_SI_SO : public MultiFunctio
  * 1. single input (SI) of type In1
  * 2. single input (SI) of type In2
  * 3. single output (SO) of type Out1
+ *
+ * See #CustomMF_SI_SO for the element and batch functions.
  */
 template<typename In1, typename In2, typename Out1>
 class CustomMF_SI_SI_SO : public MultiFunction {
@@ -98,11 +216,32 @@ class CustomMF_SI_SI_SO : public MultiFunction {
   {
   }
 
+  template<typename ElementFuncT, typename BatchFuncT>
+  CustomMF_SI_SI_SO(StringRef name, ElementFuncT element_fn, BatchFuncT batch_fn)
+      : CustomMF_SI_SI_SO(name, CustomMF_SI_SI_SO::create_function(element_fn, batch_fn))
+  {
+  }
+
   template<typename ElementFuncT> static FunctionT create_function(ElementFuncT element_fn)
   {
     return [=](IndexMask mask, VSpan<In1> in1, VSpan<In2> in2, MutableSpan<Out1> out1) {
-      mask.foreach_index(
-          [&](int i) { new (static_cast<void *>(&out1[i])) Out1(element_fn(in1[i], in2[i])); });
+      builder_detail::call_element_fn(mask, element_fn, out1, in1, in2);
+    };
+  }
+
+  template<typename ElementFuncT, typename BatchFuncT>
+  static FunctionT create_function(ElementFuncT element_fn, BatchFuncT batch_fn)
+  {
+    return [=](IndexMask mask, VSpan<In1> in1, VSpan<In2> in2, MutableSpan<Out1> out1) {
+      if (mask.is_range() && in1.is_full_array() && in2.is_full_array()) {
+        const IndexRange range = mask.as_range();
+        batch_fn(in1.as_full_array().slice(range),
+                 in2.as_full_array().slice(range),
+                 out1.slice(range.start(), range.size()));
+      }
+      else {
+        builder_detail::call_element_fn(mask, element_fn, out1, in1, in2);
+      }
     };
   }
 
@@ -121,6 +260,8 @@ class CustomMF_SI_SI_SO : public MultiFunction {
  * 2. single input (SI) of type In2
  * 3. single input (SI) of type In3
  * 4. single output (SO) of type Out1
+ *
+ * See #CustomMF_SI_SO for the element function.
  */
 template<typename In1, typename In2, typename In3, typename Out1>
 class CustomMF_SI_SI_SI_SO : public MultiFunction {
@@ -152,9 +293,7 @@ class CustomMF_SI_SI_SI_SO : public MultiFunction {
                VSpan<In2> in2,
                VSpan<In3> in3,
                MutableSpan<Out1> out1) {
-      mask.foreach_index([&](int i) {
-        new (static_cast<void *>(&out1[i])) Out1(element_fn(in1[i], in2[i], in3[i]));
-      });
+      builder_detail::call_element_fn(mask, element_fn, out1, in1, in2, in3);
     };
   }
 
@@ -222,9 +361,8 @@ template<typename From, typename To> class CustomMF_Convert : public MultiFuncti
     VSpan<From> inputs = params.readonly_single_input<From>(0);
     MutableSpan<To> outputs = params.uninitialized_single_output<To>(1);
 
-    for (int64_t i : mask) {
-      new (static_cast<void *>(&outputs[i])) To(inputs[i]);
-    }
+    builder_detail::call_element_fn(
+        mask, [](const From &value) { return To(value); }, outputs, inputs);
   }
 };
 
@@ -0,0 +1,151 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup fn
+ *
+ * Multi-functions for the conformal model of 3D space. Points, spheres and planes are vectors in
+ * a 5D space with the basis e1, e2, e3, no (the origin) and ni (infinity), where no and ni are
+ * null vectors with `no . ni = -1`. Reflecting a point in a sphere vector inverts it in the
+ * sphere, reflecting it in a plane vector mirrors it.
+ *
+ * All functions work on vectors only, so that every operation has a short closed form. More
+ * complex conformal transformations are built by chaining reflections.
+ */
+
+#include "BLI_float3.hh"
+
+#include "FN_multi_function.hh"
+
+namespace blender::fn {
+
+struct ConformalVector {
+  /** Coefficients of e1, e2 and e3. */
+  float3 euclidean = {0.0f, 0.0f, 0.0f};
+  /** Coefficient of no. */
+  float origin = 0.0f;
+  /** Coefficient of ni. */
+  float infinity = 0.0f;
+
+  ConformalVector() = default;
+
+  ConformalVector(const float3 &euclidean, float origin, float infinity)
+      : euclidean(euclidean), origin(origin), infinity(infinity)
+  {
+  }
+
+  static float dot(const ConformalVector &a, const ConformalVector &b)
+  {
+    return float3::dot(a.euclidean, b.euclidean) - a.origin * b.infinity -
+           a.infinity * b.origin;
+  }
+
+  /** Embed a point: `x + no + 0.5 * |x|^2 * ni`. */
+  static ConformalVector from_point(const float3 &point)
+  {
+    return {point, 1.0f, 0.5f * point.length_squared()};
+  }
+
+  /** Dual sphere: `c + no + 0.5 * (|c|^2 - r^2) * ni`. */
+  static ConformalVector from_sphere(const float3 &center, const float radius)
+  {
+    return {center, 1.0f, 0.5f * (center.length_squared() - radius * radius)};
+  }
+
+  /** Dual plane: `n + d * ni` for a unit normal and the distance of the plane to the origin. */
+  static ConformalVector from_plane(const float3 &normal, const float distance)
+  {
+    return {normal, 0.0f, distance};
+  }
+
+  /** Euclidean position of a point that may be scaled, zero for the point at infinity. */
+  float3 to_point() const
+  {
+    return (origin != 0.0f) ? euclidean / origin : float3(0.0f, 0.0f, 0.0f);
+  }
+
+  /**
+   * Sandwich product `-v x v^-1` of a vector versor, which is the reflection of \a x in \a v:
+   * `x - 2 * (x . v) / (v . v) * v`.
+   */
+  static ConformalVector reflect(const ConformalVector &x, const ConformalVector &v)
+  {
+    const float v_sq = dot(v, v);
+    if (v_sq == 0.0f) {
+      return x;
+    }
+    const float fac = 2.0f * dot(x, v) / v_sq;
+    return {
+        x.euclidean - v.euclidean * fac, x.origin - v.origin * fac, x.infinity - v.infinity * fac};
+  }
+
+  uint64_t hash() const
+  {
+    uint64_t x1 = *reinterpret_cast<const uint32_t *>(&origin);
+    uint64_t x2 = *reinterpret_cast<const uint32_t *>(&infinity);
+    return euclidean.hash() ^ (x1 * 4563539) ^ (x2 * 2760251);
+  }
+
+  friend bool operator==(const ConformalVector &a, const ConformalVector &b)
+  {
+    return a.euclidean == b.euclidean && a.origin == b.origin && a.infinity == b.infinity;
+  }
+
+  friend std::ostream &operator<<(std::ostream &stream, const ConformalVector &v)
+  {
+    stream << "(" << v.euclidean << ", " << v.origin << ", " << v.infinity << ")";
+    return stream;
+  }
+};
+
+/** Vector -> Conformal point. */
+class ConformalMF_PointEmbed : public MultiFunction {
+ public:
+  ConformalMF_PointEmbed();
+  void call(IndexMask mask, MFParams params, MFContext context) const override;
+};
+
+/** Center, Radius -> Conformal sphere. */
+class ConformalMF_Sphere : public MultiFunction {
+ public:
+  ConformalMF_Sphere();
+  void call(IndexMask mask, MFParams params, MFContext context) const override;
+};
+
+/** Normal, Distance -> Conformal plane. The normal is normalized. */
+class ConformalMF_Plane : public MultiFunction {
+ public:
+  ConformalMF_Plane();
+  void call(IndexMask mask, MFParams params, MFContext context) const override;
+};
+
+/** Versor, Value -> Reflected value. */
+class ConformalMF_Sandwich : public MultiFunction {
+ public:
+  ConformalMF_Sandwich();
+  void call(IndexMask mask, MFParams params, MFContext context) const override;
+};
+
+/** Conformal point -> Vector. */
+class ConformalMF_ExtractPoint : public MultiFunction {
+ public:
+  ConformalMF_ExtractPoint();
+  void call(IndexMask mask, MFParams params, MFContext context) const override;
+};
+
+}  // namespace blender::fn
@@ -19,10 +19,10 @@
 /** \file
  * \ingroup fn
  *
- * An #MFContext is passed along with every call to a multi-function. Right now it does nothing,
- * but it can be used for the following purposes:
+ * An #MFContext is passed along with every call to a multi-function. It can be used for the
+ * following purposes:
  * - Pass debug information up and down the function call stack.
- * - Pass reusable memory buffers to sub-functions to increase performance.
+ * - Pass reusable memory buffers to sub-functions to increase performance (see #MFBufferPool).
  * - Pass cached data to called functions.
  */
 
@@ -33,24 +33,44 @@
 namespace blender::fn {
 
 class MFContext;
+class MFBufferPool;
 
 class MFContextBuilder {
  private:
   Map<std::string, const void *> global_contexts_;
+  MFBufferPool *buffer_pool_ = nullptr;
 
   friend MFContext;
 
  public:
+  MFContextBuilder() = default;
+  /**
+   * Same global contexts as the given context, but a different buffer pool. Used for tasks that
+   * evaluate in parallel, which can't share a pool.
+   */
+  MFContextBuilder(MFContext context, MFBufferPool &buffer_pool);
+
   template<typename T> void add_global_context(std::string name, const T *context)
   {
     global_contexts_.add_new(std::move(name), static_cast<const void *>(context));
   }
+
+  /**
+   * Called functions take their temporary buffers from this pool, instead of allocating new ones
+   * for every call. The pool has to outlive all calls that use this context.
+   */
+  void set_buffer_pool(MFBufferPool &buffer_pool)
+  {
+    buffer_pool_ = &buffer_pool;
+  }
 };
 
 class MFContext {
  private:
   MFContextBuilder &builder_;
 
+  friend MFContextBuilder;
+
  public:
   MFContext(MFContextBuilder &builder) : builder_(builder)
   {
@@ -62,6 +82,19 @@ class MFContext {
     /* TODO: Implement type checking. */
     return static_cast<const T *>(context);
   }
+
+  /**
+   * The pool that temporary buffers should be taken from, or null when there is none.
+   */
+  MFBufferPool *buffer_pool() const
+  {
+    return builder_.buffer_pool_;
+  }
 };
 
+inline MFContextBuilder::MFContextBuilder(MFContext context, MFBufferPool &buffer_pool)
+    : global_contexts_(context.builder_.global_contexts_), buffer_pool_(&buffer_pool)
+{
+}
+
 }  // namespace blender::fn
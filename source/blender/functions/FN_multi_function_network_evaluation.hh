@@ -25,6 +25,7 @@
 namespace blender::fn {
 
 class MFNetworkEvaluationStorage;
+class MFBufferPool;
 
 class MFNetworkEvaluator : public MultiFunction {
  private:
@@ -39,6 +40,13 @@ class MFNetworkEvaluator : public MultiFunction {
  private:
   using Storage = MFNetworkEvaluationStorage;
 
+  bool can_evaluate_in_chunks(MFParams params) const;
+  void evaluate_in_chunks(IndexMask mask, MFParams params, MFContext context) const;
+  void evaluate(IndexMask mask,
+                MFParams params,
+                MFContext context,
+                MFBufferPool &buffer_pool) const;
+
   void copy_inputs_to_storage(MFParams params, Storage &storage) const;
   void copy_outputs_to_storage(
       MFParams params,
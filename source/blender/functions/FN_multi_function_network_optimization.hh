@@ -22,8 +22,23 @@
 
 namespace blender::fn::mf_network_optimization {
 
-void dead_node_removal(MFNetwork &network);
-void constant_folding(MFNetwork &network, ResourceCollector &resources);
-void common_subnetwork_elimination(MFNetwork &network);
+/**
+ * Describes how much an optimization pass changed a network.
+ */
+struct OptimizationStats {
+  /** Number of nodes that have been removed from the network. */
+  int removed_node_amount = 0;
+  /** Number of nodes that have been added to the network, e.g. constants for folded values. */
+  int added_node_amount = 0;
+};
+
+/**
+ * The passes remove nodes from the network, sockets of removed nodes must not be used afterwards.
+ * Run them once the network is complete and before an #MFNetworkEvaluator is created for it,
+ * after everything that still looks up sockets, e.g. through an #MFNetworkTreeMap, is done.
+ */
+OptimizationStats dead_node_removal(MFNetwork &network);
+OptimizationStats constant_folding(MFNetwork &network, ResourceCollector &resources);
+OptimizationStats common_subnetwork_elimination(MFNetwork &network);
 
 }  // namespace blender::fn::mf_network_optimization
@@ -170,6 +170,14 @@ class GMutableSpan {
     BLI_assert(type_->is<T>());
     return MutableSpan<T>(static_cast<T *>(data_), size_);
   }
+
+  GMutableSpan slice(const int64_t start, const int64_t size) const
+  {
+    BLI_assert(start >= 0);
+    BLI_assert(size >= 0);
+    BLI_assert(start + size <= size_);
+    return GMutableSpan(*type_, POINTER_OFFSET(data_, type_->size() * start), size);
+  }
 };
 
 enum class VSpanCategory {
@@ -435,6 +443,32 @@ class GVSpan : public VSpanBase<void> {
     return GSpan(*this->type_, data, this->virtual_size_);
   }
 
+  /**
+   * Returns a virtual span that references a contiguous part of this virtual span. When it
+   * contains a single element, only the virtual size changes.
+   */
+  GVSpan slice(const int64_t start, const int64_t size) const
+  {
+    BLI_assert(start >= 0);
+    BLI_assert(size >= 0);
+    BLI_assert(start + size <= this->virtual_size_);
+
+    GVSpan ref = *this;
+    ref.virtual_size_ = size;
+    switch (this->category_) {
+      case VSpanCategory::Single:
+        break;
+      case VSpanCategory::FullArray:
+        ref.data_.full_array.data = POINTER_OFFSET(this->data_.full_array.data,
+                                                   start * type_->size());
+        break;
+      case VSpanCategory::FullPointerArray:
+        ref.data_.full_pointer_array.data = this->data_.full_pointer_array.data + start;
+        break;
+    }
+    return ref;
+  }
+
   void materialize_to_uninitialized(void *dst) const
   {
     this->materialize_to_uninitialized(IndexRange(virtual_size_), dst);
@@ -444,6 +478,17 @@ class GVSpan : public VSpanBase<void> {
   {
     BLI_assert(this->size() >= mask.min_array_size());
 
+    switch (this->category_) {
+      case VSpanCategory::Single:
+        type_->fill_uninitialized_indices(this->data_.single.data, dst, mask);
+        return;
+      case VSpanCategory::FullArray:
+        type_->copy_to_uninitialized_indices(this->data_.full_array.data, dst, mask);
+        return;
+      case VSpanCategory::FullPointerArray:
+        break;
+    }
+
     int64_t element_size = type_->size();
     for (int64_t i : mask) {
       type_->copy_to_uninitialized((*this)[i], POINTER_OFFSET(dst, element_size * i));
@@ -0,0 +1,118 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup fn
+ */
+
+#include "MEM_guardedalloc.h"
+
+#include "FN_multi_function_buffer_pool.hh"
+
+namespace blender::fn {
+
+/* The linear allocator computes the sizes of its blocks with 32 bit integers. */
+static constexpr int64_t large_buffer_size = 1 << 28;
+
+/**
+ * Arrays of slightly different sizes should be able to share buffers, e.g. when chunks of a mask
+ * that skips indices are evaluated. Therefore sizes are rounded up to one of four classes per
+ * power of two, so that less than a fifth of a buffer stays unused.
+ */
+static int64_t get_size_class(const int64_t size_in_bytes)
+{
+  int64_t power_of_two = 64;
+  if (size_in_bytes <= power_of_two) {
+    return power_of_two;
+  }
+  while (power_of_two * 2 <= size_in_bytes) {
+    power_of_two *= 2;
+  }
+  const int64_t step = power_of_two / 4;
+  return (size_in_bytes + step - 1) / step * step;
+}
+
+MFBufferPool::~MFBufferPool()
+{
+  for (void *buffer : large_buffers_) {
+    MEM_freeN(buffer);
+  }
+}
+
+void *MFBufferPool::allocate(const CPPType &type, const int64_t size)
+{
+  const int64_t size_class = get_size_class(type.size() * size);
+  const std::pair<int64_t, int64_t> key{size_class, type.alignment()};
+
+  Vector<void *> *free_buffers = free_buffers_.lookup_ptr(key);
+  if (free_buffers != nullptr && !free_buffers->is_empty()) {
+    reuse_amount_++;
+    return free_buffers->pop_last();
+  }
+
+  allocation_amount_++;
+  allocated_bytes_ += size_class;
+  if (size_class >= large_buffer_size) {
+    void *buffer = MEM_mallocN_aligned(size_class, type.alignment(), AT);
+    large_buffers_.append(buffer);
+    return buffer;
+  }
+  return allocator_.allocate(size_class, type.alignment());
+}
+
+void MFBufferPool::deallocate(void *buffer, const CPPType &type, const int64_t size)
+{
+  const int64_t size_class = get_size_class(type.size() * size);
+  const std::pair<int64_t, int64_t> key{size_class, type.alignment()};
+  free_buffers_.lookup_or_add_default(key).append(buffer);
+}
+
+Span<std::unique_ptr<MFBufferPool>> MFBufferPool::task_pools(const int64_t amount)
+{
+  while (task_pools_.size() < amount) {
+    task_pools_.append(std::make_unique<MFBufferPool>());
+  }
+  return task_pools_.as_span().slice(0, amount);
+}
+
+int64_t MFBufferPool::allocation_amount() const
+{
+  int64_t amount = allocation_amount_;
+  for (const std::unique_ptr<MFBufferPool> &pool : task_pools_) {
+    amount += pool->allocation_amount();
+  }
+  return amount;
+}
+
+int64_t MFBufferPool::reuse_amount() const
+{
+  int64_t amount = reuse_amount_;
+  for (const std::unique_ptr<MFBufferPool> &pool : task_pools_) {
+    amount += pool->reuse_amount();
+  }
+  return amount;
+}
+
+int64_t MFBufferPool::allocated_bytes() const
+{
+  int64_t bytes = allocated_bytes_;
+  for (const std::unique_ptr<MFBufferPool> &pool : task_pools_) {
+    bytes += pool->allocated_bytes();
+  }
+  return bytes;
+}
+
+}  // namespace blender::fn
@@ -0,0 +1,140 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "FN_cpp_type.hh"
+#include "FN_multi_function_builder.hh"
+#include "FN_multi_function_conformal.hh"
+
+namespace blender::fn {
+
+MAKE_CPP_TYPE(ConformalVector, blender::fn::ConformalVector)
+
+ConformalMF_PointEmbed::ConformalMF_PointEmbed()
+{
+  MFSignatureBuilder signature = this->get_builder("Conformal Point Embed");
+  signature.single_input<float3>("Vector");
+  signature.single_output<ConformalVector>("Point");
+}
+
+void ConformalMF_PointEmbed::call(IndexMask mask,
+                                  MFParams params,
+                                  MFContext UNUSED(context)) const
+{
+  VSpan<float3> vectors = params.readonly_single_input<float3>(0, "Vector");
+  MutableSpan<ConformalVector> points = params.uninitialized_single_output<ConformalVector>(
+      1, "Point");
+
+  builder_detail::call_element_fn(
+      mask,
+      [](const float3 &vector) { return ConformalVector::from_point(vector); },
+      points,
+      vectors);
+}
+
+ConformalMF_Sphere::ConformalMF_Sphere()
+{
+  MFSignatureBuilder signature = this->get_builder("Conformal Sphere");
+  signature.single_input<float3>("Center");
+  signature.single_input<float>("Radius");
+  signature.single_output<ConformalVector>("Sphere");
+}
+
+void ConformalMF_Sphere::call(IndexMask mask, MFParams params, MFContext UNUSED(context)) const
+{
+  VSpan<float3> centers = params.readonly_single_input<float3>(0, "Center");
+  VSpan<float> radii = params.readonly_single_input<float>(1, "Radius");
+  MutableSpan<ConformalVector> spheres = params.uninitialized_single_output<ConformalVector>(
+      2, "Sphere");
+
+  builder_detail::call_element_fn(
+      mask,
+      [](const float3 &center, const float radius) {
+        return ConformalVector::from_sphere(center, radius);
+      },
+      spheres,
+      centers,
+      radii);
+}
+
+ConformalMF_Plane::ConformalMF_Plane()
+{
+  MFSignatureBuilder signature = this->get_builder("Conformal Plane");
+  signature.single_input<float3>("Normal");
+  signature.single_input<float>("Distance");
+  signature.single_output<ConformalVector>("Plane");
+}
+
+void ConformalMF_Plane::call(IndexMask mask, MFParams params, MFContext UNUSED(context)) const
+{
+  VSpan<float3> normals = params.readonly_single_input<float3>(0, "Normal");
+  VSpan<float> distances = params.readonly_single_input<float>(1, "Distance");
+  MutableSpan<ConformalVector> planes = params.uninitialized_single_output<ConformalVector>(
+      2, "Plane");
+
+  builder_detail::call_element_fn(
+      mask,
+      [](const float3 &normal, const float distance) {
+        return ConformalVector::from_plane(normal.normalized(), distance);
+      },
+      planes,
+      normals,
+      distances);
+}
+
+ConformalMF_Sandwich::ConformalMF_Sandwich()
+{
+  MFSignatureBuilder signature = this->get_builder("Conformal Sandwich");
+  signature.single_input<ConformalVector>("Versor");
+  signature.single_input<ConformalVector>("Value");
+  signature.single_output<ConformalVector>("Result");
+}
+
+void ConformalMF_Sandwich::call(IndexMask mask, MFParams params, MFContext UNUSED(context)) const
+{
+  VSpan<ConformalVector> versors = params.readonly_single_input<ConformalVector>(0, "Versor");
+  VSpan<ConformalVector> values = params.readonly_single_input<ConformalVector>(1, "Value");
+  MutableSpan<ConformalVector> results = params.uninitialized_single_output<ConformalVector>(
+      2, "Result");
+
+  builder_detail::call_element_fn(
+      mask,
+      [](const ConformalVector &versor, const ConformalVector &value) {
+        return ConformalVector::reflect(value, versor);
+      },
+      results,
+      versors,
+      values);
+}
+
+ConformalMF_ExtractPoint::ConformalMF_ExtractPoint()
+{
+  MFSignatureBuilder signature = this->get_builder("Conformal Extract Point");
+  signature.single_input<ConformalVector>("Point");
+  signature.single_output<float3>("Vector");
+}
+
+void ConformalMF_ExtractPoint::call(IndexMask mask,
+                                    MFParams params,
+                                    MFContext UNUSED(context)) const
+{
+  VSpan<ConformalVector> points = params.readonly_single_input<ConformalVector>(0, "Point");
+  MutableSpan<float3> vectors = params.uninitialized_single_output<float3>(1, "Vector");
+
+  builder_detail::call_element_fn(
+      mask, [](const ConformalVector &point) { return point.to_point(); }, vectors, points);
+}
+
+}  // namespace blender::fn
@@ -28,9 +28,14 @@
  * - Avoids data copies in many cases.
  * - Every node is executed at most once.
  * - Can compute sub-functions on a single element, when the result is the same for all elements.
+ *   This includes functions that output to the caller's buffers, the value is copied to all
+ *   indices afterwards.
+ * - Large masks are split into chunks that are evaluated in parallel. The intermediate buffers of
+ *   a chunk are small enough to stay in cache and are reused by the next chunk of the same task.
+ * - Intermediate buffers are taken from an #MFBufferPool. When the caller provides a pool in the
+ *   context, buffers are also reused across evaluations.
  *
  * Possible improvements:
- * - Cache and reuse buffers.
  * - Use "deepest depth first" heuristic to decide which order the inputs of a node should be
  *   computed. This reduces the number of required temporary buffers when they are reused.
  */
@@ -38,11 +43,21 @@
 #include "FN_multi_function_network_evaluation.hh"
 
 #include "BLI_stack.hh"
+#include "BLI_task.h"
+#include "BLI_task.hh"
+
+#include "FN_multi_function_buffer_pool.hh"
 
 namespace blender::fn {
 
 struct Value;
 
+/**
+ * Number of indices evaluated at once when the mask is split into chunks. The intermediate
+ * buffers of a chunk should fit into the cache of a core.
+ */
+static constexpr int64_t evaluation_chunk_size = 4096;
+
 /**
  * This keeps track of all the values that flow through the multi-function network. Therefore it
  * maintains a mapping between output sockets and their corresponding values. Every `value`
@@ -56,9 +71,10 @@ class MFNetworkEvaluationStorage {
   IndexMask mask_;
   Array<Value *> value_per_output_id_;
   int64_t min_array_size_;
+  MFBufferPool &buffer_pool_;
 
  public:
-  MFNetworkEvaluationStorage(IndexMask mask, int socket_id_amount);
+  MFNetworkEvaluationStorage(IndexMask mask, int socket_id_amount, MFBufferPool &buffer_pool);
   ~MFNetworkEvaluationStorage();
 
   /* Add the values that have been provided by the caller of the multi-function network. */
@@ -97,6 +113,10 @@ class MFNetworkEvaluationStorage {
   bool socket_is_computed(const MFOutputSocket &socket);
   bool is_same_value_for_every_index(const MFOutputSocket &socket);
   bool socket_has_buffer_for_output(const MFOutputSocket &socket);
+
+ private:
+  void *allocate_array(const CPPType &type);
+  void free_array(void *buffer, const CPPType &type);
 };
 
 MFNetworkEvaluator::MFNetworkEvaluator(Vector<const MFOutputSocket *> inputs,
@@ -141,8 +161,121 @@ void MFNetworkEvaluator::call(IndexMask mask, MFParams params, MFContext context
     return;
   }
 
+  if (mask.size() > evaluation_chunk_size && this->can_evaluate_in_chunks(params)) {
+    this->evaluate_in_chunks(mask, params, context);
+  }
+  else if (context.buffer_pool() != nullptr) {
+    this->evaluate(mask, params, context, *context.buffer_pool());
+  }
+  else {
+    /* Buffers are still reused between the nodes of this evaluation. */
+    MFBufferPool buffer_pool;
+    this->evaluate(mask, params, context, buffer_pool);
+  }
+}
+
+bool MFNetworkEvaluator::can_evaluate_in_chunks(MFParams params) const
+{
+  /* Vector outputs are appended to by every function that computes them, so they cannot be
+   * split into parts that are filled independently. */
+  for (const MFOutputSocket *socket : inputs_) {
+    if (socket->data_type().category() != MFDataType::Single) {
+      return false;
+    }
+  }
+  for (const MFInputSocket *socket : outputs_) {
+    if (socket->data_type().category() != MFDataType::Single) {
+      return false;
+    }
+  }
+  /* When all inputs are single values, every function is only evaluated once anyway. */
+  for (const int input_index : inputs_.index_range()) {
+    if (!params.readonly_single_input(input_index).is_single_element()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Split the mask into chunks of #evaluation_chunk_size indices and evaluate the network for all
+ * of them in parallel. The indices of every chunk are shifted to start at zero, so that the
+ * intermediate buffers only have to be as large as the chunk and not as the entire mask.
+ */
+BLI_NOINLINE void MFNetworkEvaluator::evaluate_in_chunks(IndexMask mask,
+                                                         MFParams params,
+                                                         MFContext context) const
+{
+  Vector<GVSpan> inputs;
+  for (const int input_index : inputs_.index_range()) {
+    inputs.append(params.readonly_single_input(input_index));
+  }
+  Vector<GMutableSpan> outputs;
+  for (const int output_index : outputs_.index_range()) {
+    outputs.append(params.uninitialized_single_output(inputs_.size() + output_index));
+  }
+
+  const int64_t chunks_num = (mask.size() + evaluation_chunk_size - 1) / evaluation_chunk_size;
+  /* Every task evaluates a range of chunks with its own buffer pool, so that pools are never used
+   * by multiple threads. The pools of the caller's pool are kept for the next evaluation. */
+  const int64_t tasks_num = std::min<int64_t>(chunks_num,
+                                              std::max(BLI_task_scheduler_num_threads(), 1));
+  Span<std::unique_ptr<MFBufferPool>> task_pools;
+  if (context.buffer_pool() != nullptr) {
+    task_pools = context.buffer_pool()->task_pools(tasks_num);
+  }
+
+  parallel_for(IndexRange(tasks_num), 1, [&](IndexRange task_range) {
+    for (const int64_t task_index : task_range) {
+      MFBufferPool local_buffer_pool;
+      MFBufferPool &buffer_pool = task_pools.is_empty() ? local_buffer_pool :
+                                                          *task_pools[task_index];
+      /* Functions called by this task take their buffers from the same pool. */
+      MFContextBuilder task_context{context, buffer_pool};
+      Vector<int64_t> chunk_indices;
+
+      const int64_t chunks_start = chunks_num * task_index / tasks_num;
+      const int64_t chunks_end = chunks_num * (task_index + 1) / tasks_num;
+      for (const int64_t chunk_index : IndexRange(chunks_start, chunks_end - chunks_start)) {
+        const int64_t chunk_start = chunk_index * evaluation_chunk_size;
+        const IndexMask sub_mask = mask.slice(
+            IndexRange(chunk_start, std::min(evaluation_chunk_size, mask.size() - chunk_start)));
+        const int64_t offset = sub_mask[0];
+        const int64_t chunk_array_size = sub_mask.min_array_size() - offset;
+
+        IndexMask chunk_mask;
+        if (sub_mask.is_range()) {
+          chunk_mask = IndexRange(chunk_array_size);
+        }
+        else {
+          chunk_indices.clear();
+          for (const int64_t i : sub_mask) {
+            chunk_indices.append(i - offset);
+          }
+          chunk_mask = chunk_indices.as_span();
+        }
+
+        MFParamsBuilder chunk_params(*this, chunk_array_size);
+        for (const GVSpan &input : inputs) {
+          chunk_params.add_readonly_single_input(input.slice(offset, chunk_array_size));
+        }
+        for (const GMutableSpan &output : outputs) {
+          chunk_params.add_uninitialized_single_output(output.slice(offset, chunk_array_size));
+        }
+
+        this->evaluate(chunk_mask, chunk_params, task_context, buffer_pool);
+      }
+    }
+  });
+}
+
+BLI_NOINLINE void MFNetworkEvaluator::evaluate(IndexMask mask,
+                                               MFParams params,
+                                               MFContext context,
+                                               MFBufferPool &buffer_pool) const
+{
   const MFNetwork &network = outputs_[0]->node().network();
-  Storage storage(mask, network.socket_id_amount());
+  Storage storage(mask, network.socket_id_amount(), buffer_pool);
 
   Vector<const MFInputSocket *> outputs_to_initialize_in_the_end;
 
@@ -370,9 +503,18 @@ bool MFNetworkEvaluator::can_do_single_value_evaluation(const MFFunctionNode &fu
       return false;
     }
   }
-  if (storage.mask().min_array_size() >= 1) {
-    for (const MFOutputSocket *socket : function_node.outputs()) {
-      if (storage.socket_has_buffer_for_output(*socket)) {
+
+  /* A single output value can be copied to the caller's buffer afterwards, but vectors and
+   * mutable values are computed in the caller's buffer directly. */
+  const MultiFunction &function = function_node.function();
+  for (int param_index : function.param_indices()) {
+    MFParamType param_type = function.param_type(param_index);
+    if (ELEM(param_type.category(),
+             MFParamType::VectorOutput,
+             MFParamType::SingleMutable,
+             MFParamType::VectorMutable)) {
+      const MFOutputSocket &socket = function_node.output_for_param(param_index);
+      if (storage.socket_has_buffer_for_output(socket)) {
         return false;
       }
     }
@@ -454,6 +596,11 @@ struct OutputValue : public Value {
 struct OutputSingleValue : public OutputValue {
   /** This span has been provided by the code that called the multi-function network. */
   GMutableSpan span;
+  /**
+   * When the value is the same for every index, it is computed only once into this buffer and
+   * then copied to all indices of the span. It is kept for other nodes that use the same value.
+   */
+  void *single_value = nullptr;
 
   OutputSingleValue(GMutableSpan span) : OutputValue(ValueType::OutputSingle), span(span)
   {
@@ -506,10 +653,13 @@ struct OwnVectorValue : public Value {
 /** \name Storage methods
  * \{ */
 
-MFNetworkEvaluationStorage::MFNetworkEvaluationStorage(IndexMask mask, int socket_id_amount)
+MFNetworkEvaluationStorage::MFNetworkEvaluationStorage(IndexMask mask,
+                                                       int socket_id_amount,
+                                                       MFBufferPool &buffer_pool)
     : mask_(mask),
       value_per_output_id_(socket_id_amount, nullptr),
-      min_array_size_(mask.min_array_size())
+      min_array_size_(mask.min_array_size()),
+      buffer_pool_(buffer_pool)
 {
 }
 
@@ -528,16 +678,32 @@ MFNetworkEvaluationStorage::~MFNetworkEvaluationStorage()
       }
       else {
         type.destruct_indices(span.data(), mask_);
-        MEM_freeN(span.data());
+        this->free_array(span.data(), type);
       }
     }
     else if (any_value->type == ValueType::OwnVector) {
       OwnVectorValue *value = static_cast<OwnVectorValue *>(any_value);
       delete value->vector_array;
     }
+    else if (any_value->type == ValueType::OutputSingle) {
+      OutputSingleValue *value = static_cast<OutputSingleValue *>(any_value);
+      if (value->single_value != nullptr) {
+        value->span.type().destruct(value->single_value);
+      }
+    }
   }
 }
 
+void *MFNetworkEvaluationStorage::allocate_array(const CPPType &type)
+{
+  return buffer_pool_.allocate(type, min_array_size_);
+}
+
+void MFNetworkEvaluationStorage::free_array(void *buffer, const CPPType &type)
+{
+  buffer_pool_.deallocate(buffer, type, min_array_size_);
+}
+
 IndexMask MFNetworkEvaluationStorage::mask() const
 {
   return mask_;
@@ -567,8 +733,10 @@ bool MFNetworkEvaluationStorage::is_same_value_for_every_index(const MFOutputSoc
       return static_cast<InputSingleValue *>(any_value)->virtual_span.is_single_element();
     case ValueType::InputVector:
       return static_cast<InputVectorValue *>(any_value)->virtual_array_span.is_single_array();
-    case ValueType::OutputSingle:
-      return static_cast<OutputSingleValue *>(any_value)->span.size() == 1;
+    case ValueType::OutputSingle: {
+      OutputSingleValue *value = static_cast<OutputSingleValue *>(any_value);
+      return value->single_value != nullptr || value->span.size() == 1;
+    }
     case ValueType::OutputVector:
       return static_cast<OutputVectorValue *>(any_value)->vector_array->size() == 1;
   }
@@ -607,6 +775,13 @@ void MFNetworkEvaluationStorage::finish_output_socket(const MFOutputSocket &sock
   if (ELEM(any_value->type, ValueType::OutputSingle, ValueType::OutputVector)) {
     static_cast<OutputValue *>(any_value)->is_computed = true;
   }
+  if (any_value->type == ValueType::OutputSingle) {
+    OutputSingleValue *value = static_cast<OutputSingleValue *>(any_value);
+    if (value->single_value != nullptr) {
+      GMutableSpan span = value->span;
+      span.type().fill_uninitialized_indices(value->single_value, span.data(), mask_);
+    }
+  }
 }
 
 void MFNetworkEvaluationStorage::finish_input_socket(const MFInputSocket &socket)
@@ -638,7 +813,7 @@ void MFNetworkEvaluationStorage::finish_input_socket(const MFInputSocket &socket
         }
         else {
           type.destruct_indices(span.data(), mask_);
-          MEM_freeN(span.data());
+          this->free_array(span.data(), type);
         }
         value_per_output_id_[origin.id()] = nullptr;
       }
@@ -702,7 +877,7 @@ GMutableSpan MFNetworkEvaluationStorage::get_single_output__full(const MFOutputS
   Value *any_value = value_per_output_id_[socket.id()];
   if (any_value == nullptr) {
     const CPPType &type = socket.data_type().single_type();
-    void *buffer = MEM_mallocN_aligned(min_array_size_ * type.size(), type.alignment(), AT);
+    void *buffer = this->allocate_array(type);
     GMutableSpan span(type, buffer, min_array_size_);
 
     auto *value = allocator_.construct<OwnSingleValue>(span, socket.targets().size(), false);
@@ -730,9 +905,12 @@ GMutableSpan MFNetworkEvaluationStorage::get_single_output__single(const MFOutpu
   }
 
   BLI_assert(any_value->type == ValueType::OutputSingle);
-  GMutableSpan span = static_cast<OutputSingleValue *>(any_value)->span;
-  BLI_assert(span.size() == 1);
-  return span;
+  OutputSingleValue *value = static_cast<OutputSingleValue *>(any_value);
+  BLI_assert(value->single_value == nullptr);
+  const CPPType &type = value->span.type();
+  /* The value is copied to all indices of the caller's buffer when the socket is finished. */
+  value->single_value = allocator_.allocate(type.size(), type.alignment());
+  return GMutableSpan(type, value->single_value, 1);
 }
 
 GVectorArray &MFNetworkEvaluationStorage::get_vector_output__full(const MFOutputSocket &socket)
@@ -802,7 +980,7 @@ GMutableSpan MFNetworkEvaluationStorage::get_mutable_single__full(const MFInputS
   }
 
   GVSpan virtual_span = this->get_single_input__full(input);
-  void *new_buffer = MEM_mallocN_aligned(min_array_size_ * type.size(), type.alignment(), AT);
+  void *new_buffer = this->allocate_array(type);
   GMutableSpan new_array_ref(type, new_buffer, min_array_size_);
   virtual_span.materialize_to_uninitialized(mask_, new_array_ref.data());
 
@@ -987,6 +1165,9 @@ GVSpan MFNetworkEvaluationStorage::get_single_input__single(const MFInputSocket
   if (any_value->type == ValueType::OutputSingle) {
     OutputSingleValue *value = static_cast<OutputSingleValue *>(any_value);
     BLI_assert(value->is_computed);
+    if (value->single_value != nullptr) {
+      return GSpan(value->span.type(), value->single_value, 1);
+    }
     BLI_assert(value->span.size() == 1);
     return value->span;
   }
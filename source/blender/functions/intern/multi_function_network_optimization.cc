@@ -128,12 +128,16 @@ static Vector<MFNode *> find_nodes_based_on_mask(MFNetwork &network,
 /**
  * Unused nodes are all those nodes that no dummy node depends upon.
  */
-void dead_node_removal(MFNetwork &network)
+OptimizationStats dead_node_removal(MFNetwork &network)
 {
   Array<bool> node_is_used_mask = mask_nodes_to_the_left(network,
                                                          network.dummy_nodes().cast<MFNode *>());
   Vector<MFNode *> nodes_to_remove = find_nodes_based_on_mask(network, node_is_used_mask, false);
   network.remove(nodes_to_remove);
+
+  OptimizationStats stats;
+  stats.removed_node_amount = nodes_to_remove.size();
+  return stats;
 }
 
 /** \} */
@@ -191,11 +195,14 @@ static MFInputSocket *try_find_dummy_target_socket(MFOutputSocket *output_socket
 }
 
 static Vector<MFInputSocket *> find_constant_inputs_to_fold(
-    MFNetwork &network, Vector<MFDummyNode *> &r_temporary_nodes)
+    MFNetwork &network,
+    Vector<MFNode *> &r_constant_nodes,
+    Vector<MFDummyNode *> &r_temporary_nodes)
 {
   Vector<MFNode *> non_constant_nodes = find_non_constant_nodes(network);
   Array<bool> is_not_constant_mask = mask_nodes_to_the_right(network, non_constant_nodes);
   Vector<MFNode *> constant_nodes = find_nodes_based_on_mask(network, is_not_constant_mask, false);
+  r_constant_nodes.extend(constant_nodes);
 
   Vector<MFInputSocket *> sockets_to_compute;
   for (MFNode *node : constant_nodes) {
@@ -300,19 +307,20 @@ static Array<MFOutputSocket *> compute_constant_sockets_and_add_folded_nodes(
   return add_constant_folded_sockets(network_fn, params, resources, network);
 }
 
-class MyClass {
-  MFDummyNode node;
-};
-
 /**
  * Find function nodes that always output the same value and replace those with constant nodes.
+ * The replaced nodes are removed, unless they are still used by other nodes.
  */
-void constant_folding(MFNetwork &network, ResourceCollector &resources)
+OptimizationStats constant_folding(MFNetwork &network, ResourceCollector &resources)
 {
+  OptimizationStats stats;
+
+  Vector<MFNode *> constant_nodes;
   Vector<MFDummyNode *> temporary_nodes;
-  Vector<MFInputSocket *> inputs_to_fold = find_constant_inputs_to_fold(network, temporary_nodes);
+  Vector<MFInputSocket *> inputs_to_fold = find_constant_inputs_to_fold(
+      network, constant_nodes, temporary_nodes);
   if (inputs_to_fold.size() == 0) {
-    return;
+    return stats;
   }
 
   Array<MFOutputSocket *> folded_sockets = compute_constant_sockets_and_add_folded_nodes(
@@ -324,6 +332,21 @@ void constant_folding(MFNetwork &network, ResourceCollector &resources)
   }
 
   network.remove(temporary_nodes.as_span().cast<MFNode *>());
+
+  /* Constant nodes can still be used, when only some of their outputs have been folded. */
+  Array<bool> node_is_used_mask = mask_nodes_to_the_left(network,
+                                                         network.dummy_nodes().cast<MFNode *>());
+  Vector<MFNode *> nodes_to_remove;
+  for (MFNode *node : constant_nodes) {
+    if (!node_is_used_mask[node->id()]) {
+      nodes_to_remove.append(node);
+    }
+  }
+  network.remove(nodes_to_remove);
+
+  stats.removed_node_amount = nodes_to_remove.size();
+  stats.added_node_amount = folded_sockets.size();
+  return stats;
 }
 
 /** \} */
@@ -451,6 +474,9 @@ static bool nodes_output_same_values(DisjointSet &cache, const MFNode &a, const
     if (origin_a == nullptr || origin_b == nullptr) {
       return false;
     }
+    if (origin_a->index() != origin_b->index()) {
+      return false;
+    }
     if (!nodes_output_same_values(cache, origin_a->node(), origin_b->node())) {
       return false;
     }
@@ -461,7 +487,8 @@ static bool nodes_output_same_values(DisjointSet &cache, const MFNode &a, const
 }
 
 static void relink_duplicate_nodes(MFNetwork &network,
-                                   MultiValueMap<uint64_t, MFNode *> &nodes_by_hash)
+                                   MultiValueMap<uint64_t, MFNode *> &nodes_by_hash,
+                                   Vector<MFNode *> &r_duplicate_nodes)
 {
   DisjointSet same_node_cache{network.node_id_amount()};
 
@@ -482,6 +509,7 @@ static void relink_duplicate_nodes(MFNetwork &network,
           for (int i : deduplicated_node.outputs().index_range()) {
             network.relink(node->output(i), deduplicated_node.output(i));
           }
+          r_duplicate_nodes.append(node);
         }
         else {
           remaining_nodes.append(node);
@@ -496,11 +524,20 @@ static void relink_duplicate_nodes(MFNetwork &network,
  * Tries to detect duplicate sub-networks and eliminates them. This can help quite a lot when node
  * groups were used to create the network.
  */
-void common_subnetwork_elimination(MFNetwork &network)
+OptimizationStats common_subnetwork_elimination(MFNetwork &network)
 {
   Array<uint64_t> node_hashes = compute_node_hashes(network);
   MultiValueMap<uint64_t, MFNode *> nodes_by_hash = group_nodes_by_hash(network, node_hashes);
-  relink_duplicate_nodes(network, nodes_by_hash);
+
+  /* The duplicates are only removed in the end, because they are still compared with other nodes
+   * while their targets are relinked. */
+  Vector<MFNode *> duplicate_nodes;
+  relink_duplicate_nodes(network, nodes_by_hash, duplicate_nodes);
+  network.remove(duplicate_nodes);
+
+  OptimizationStats stats;
+  stats.removed_node_amount = duplicate_nodes.size();
+  return stats;
 }
 
 /** \} */
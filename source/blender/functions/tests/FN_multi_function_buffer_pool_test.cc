@@ -0,0 +1,58 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "FN_multi_function_buffer_pool.hh"
+
+namespace blender::fn::tests {
+
+TEST(multi_function_buffer_pool, ReuseBuffer)
+{
+  MFBufferPool pool;
+  const CPPType &type = CPPType::get<float>();
+
+  void *buffer_1 = pool.allocate(type, 1000);
+  EXPECT_NE(buffer_1, nullptr);
+  EXPECT_TRUE(type.pointer_has_valid_alignment(buffer_1));
+  EXPECT_EQ(pool.allocation_amount(), 1);
+  EXPECT_EQ(pool.reuse_amount(), 0);
+
+  pool.deallocate(buffer_1, type, 1000);
+  void *buffer_2 = pool.allocate(type, 1000);
+  EXPECT_EQ(buffer_1, buffer_2);
+  EXPECT_EQ(pool.allocation_amount(), 1);
+  EXPECT_EQ(pool.reuse_amount(), 1);
+  pool.deallocate(buffer_2, type, 1000);
+}
+
+TEST(multi_function_buffer_pool, SimilarSizes)
+{
+  MFBufferPool pool;
+  const CPPType &float_type = CPPType::get<float>();
+  const CPPType &int_type = CPPType::get<int32_t>();
+
+  /* Buffers of slightly different sizes and types with the same size share a buffer. */
+  void *buffer_1 = pool.allocate(float_type, 1000);
+  pool.deallocate(buffer_1, float_type, 1000);
+  void *buffer_2 = pool.allocate(int_type, 990);
+  EXPECT_EQ(buffer_1, buffer_2);
+  pool.deallocate(buffer_2, int_type, 990);
+
+  /* Buffers that are used at the same time are different. */
+  void *buffer_3 = pool.allocate(float_type, 1000);
+  void *buffer_4 = pool.allocate(float_type, 1000);
+  EXPECT_NE(buffer_3, buffer_4);
+  EXPECT_EQ(pool.allocation_amount(), 2);
+
+  /* Much larger buffers are not served with smaller ones. */
+  pool.deallocate(buffer_3, float_type, 1000);
+  void *buffer_5 = pool.allocate(float_type, 2000);
+  EXPECT_NE(buffer_5, buffer_3);
+  EXPECT_EQ(pool.allocation_amount(), 3);
+  EXPECT_GE(pool.allocated_bytes(), 4 * (1000 + 1000 + 2000));
+
+  pool.deallocate(buffer_4, float_type, 1000);
+  pool.deallocate(buffer_5, float_type, 2000);
+}
+
+}  // namespace blender::fn::tests
@@ -0,0 +1,124 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "BLI_array.hh"
+
+#include "FN_multi_function_conformal.hh"
+
+namespace blender::fn::tests {
+
+static Array<float3> reflect_points(const ConformalVector &versor, Span<float3> points)
+{
+  const int64_t size = points.size();
+  ConformalMF_PointEmbed embed_fn;
+  ConformalMF_Sandwich sandwich_fn;
+  ConformalMF_ExtractPoint extract_fn;
+  MFContextBuilder context;
+
+  Array<ConformalVector> embedded(size);
+  {
+    MFParamsBuilder params(embed_fn, size);
+    params.add_readonly_single_input(points);
+    params.add_uninitialized_single_output(embedded.as_mutable_span());
+    embed_fn.call(IndexRange(size), params, context);
+  }
+  Array<ConformalVector> reflected(size);
+  {
+    MFParamsBuilder params(sandwich_fn, size);
+    params.add_readonly_single_input(&versor);
+    params.add_readonly_single_input(embedded.as_span());
+    params.add_uninitialized_single_output(reflected.as_mutable_span());
+    sandwich_fn.call(IndexRange(size), params, context);
+  }
+  Array<float3> result(size);
+  {
+    MFParamsBuilder params(extract_fn, size);
+    params.add_readonly_single_input(reflected.as_span());
+    params.add_uninitialized_single_output(result.as_mutable_span());
+    extract_fn.call(IndexRange(size), params, context);
+  }
+  return result;
+}
+
+TEST(multi_function_conformal, EmbedExtract)
+{
+  /* Reflecting in the zero vector leaves the values unchanged. */
+  Array<float3> points = {{1.0f, 2.0f, 3.0f}, {-4.0f, 0.5f, 0.0f}, {0.0f, 0.0f, 0.0f}};
+  ConformalVector identity({0.0f, 0.0f, 0.0f}, 0.0f, 0.0f);
+  Array<float3> result = reflect_points(identity, points);
+  for (const int64_t i : points.index_range()) {
+    EXPECT_EQ(result[i], points[i]);
+  }
+}
+
+TEST(multi_function_conformal, SphereInversion)
+{
+  const float3 center = {1.0f, -2.0f, 0.5f};
+  const float radius = 2.0f;
+  Array<float3> points = {{3.0f, -2.0f, 0.5f}, {0.0f, 0.0f, 0.0f}, {5.0f, 1.0f, -2.0f}};
+
+  ConformalMF_Sphere sphere_fn;
+  ConformalVector sphere;
+  MFParamsBuilder params(sphere_fn, 1);
+  params.add_readonly_single_input(&center);
+  params.add_readonly_single_input(&radius);
+  params.add_uninitialized_single_output(&sphere);
+  MFContextBuilder context;
+  sphere_fn.call({0}, params, context);
+
+  Array<float3> result = reflect_points(sphere, points);
+  for (const int64_t i : points.index_range()) {
+    /* Inversion in the sphere: c + r^2 * (x - c) / |x - c|^2. */
+    const float3 offset = points[i] - center;
+    const float3 expected = center + offset * (radius * radius / offset.length_squared());
+    EXPECT_V3_NEAR(result[i], expected, 1e-5f);
+  }
+  /* Points on the sphere stay in place. */
+  EXPECT_V3_NEAR(result[0], points[0], 1e-5f);
+}
+
+TEST(multi_function_conformal, PlaneReflection)
+{
+  const float3 normal = {0.0f, 0.0f, 2.0f};
+  const float distance = 1.0f;
+  Array<float3> points = {{1.0f, 2.0f, 3.0f}, {0.0f, 0.0f, 1.0f}, {-1.0f, 0.0f, -1.0f}};
+
+  ConformalMF_Plane plane_fn;
+  ConformalVector plane;
+  MFParamsBuilder params(plane_fn, 1);
+  params.add_readonly_single_input(&normal);
+  params.add_readonly_single_input(&distance);
+  params.add_uninitialized_single_output(&plane);
+  MFContextBuilder context;
+  plane_fn.call({0}, params, context);
+
+  Array<float3> result = reflect_points(plane, points);
+  EXPECT_V3_NEAR(result[0], float3(1.0f, 2.0f, -1.0f), 1e-5f);
+  EXPECT_V3_NEAR(result[1], float3(0.0f, 0.0f, 1.0f), 1e-5f);
+  EXPECT_V3_NEAR(result[2], float3(-1.0f, 0.0f, 3.0f), 1e-5f);
+}
+
+TEST(multi_function_conformal, SandwichMask)
+{
+  /* Indices outside of a non-contiguous mask are not written. */
+  ConformalMF_Sandwich fn;
+  const ConformalVector sphere = ConformalVector::from_sphere({0.0f, 0.0f, 0.0f}, 1.0f);
+  Array<ConformalVector> values = {ConformalVector::from_point({2.0f, 0.0f, 0.0f}),
+                                   ConformalVector::from_point({0.0f, 4.0f, 0.0f}),
+                                   ConformalVector::from_point({0.0f, 0.0f, 0.5f})};
+  Array<ConformalVector> results(3, ConformalVector({-1.0f, -1.0f, -1.0f}, -1.0f, -1.0f));
+
+  MFParamsBuilder params(fn, 3);
+  params.add_readonly_single_input(&sphere);
+  params.add_readonly_single_input(values.as_span());
+  params.add_uninitialized_single_output(results.as_mutable_span());
+  MFContextBuilder context;
+  fn.call({0, 2}, params, context);
+
+  EXPECT_V3_NEAR(results[0].to_point(), float3(0.5f, 0.0f, 0.0f), 1e-6f);
+  EXPECT_EQ(results[1].origin, -1.0f);
+  EXPECT_V3_NEAR(results[2].to_point(), float3(0.0f, 0.0f, 2.0f), 1e-6f);
+}
+
+}  // namespace blender::fn::tests
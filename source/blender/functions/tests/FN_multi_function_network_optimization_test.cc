@@ -0,0 +1,197 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "FN_multi_function_builder.hh"
+#include "FN_multi_function_network.hh"
+#include "FN_multi_function_network_evaluation.hh"
+#include "FN_multi_function_network_optimization.hh"
+
+namespace blender::fn::tests {
+namespace {
+
+using namespace mf_network_optimization;
+
+static void evaluate_network(const MFOutputSocket &input_socket,
+                             const MFInputSocket &output_socket,
+                             Span<int> values,
+                             MutableSpan<int> r_results)
+{
+  MFNetworkEvaluator network_fn{{&input_socket}, {&output_socket}};
+
+  MFParamsBuilder params(network_fn, values.size());
+  params.add_readonly_single_input(values);
+  params.add_uninitialized_single_output(r_results);
+
+  MFContextBuilder context;
+
+  network_fn.call(IndexRange(values.size()), params, context);
+}
+
+/* Outputs the input value incremented by one and by two. */
+class TwoOutputsFunction : public MultiFunction {
+ public:
+  TwoOutputsFunction()
+  {
+    MFSignatureBuilder signature = this->get_builder("Two Outputs");
+    signature.single_input<int>("Value");
+    signature.single_output<int>("Value + 1");
+    signature.single_output<int>("Value + 2");
+  }
+
+  void call(IndexMask mask, MFParams params, MFContext UNUSED(context)) const override
+  {
+    VSpan<int> values = params.readonly_single_input<int>(0);
+    MutableSpan<int> results_1 = params.uninitialized_single_output<int>(1);
+    MutableSpan<int> results_2 = params.uninitialized_single_output<int>(2);
+
+    for (int64_t i : mask) {
+      results_1[i] = values[i] + 1;
+      results_2[i] = values[i] + 2;
+    }
+  }
+};
+
+TEST(multi_function_network_optimization, DeadNodeRemoval)
+{
+  CustomMF_SI_SO<int, int> add_10_fn("add 10", [](int value) { return value + 10; });
+
+  MFNetwork network;
+
+  MFNode &node1 = network.add_function(add_10_fn);
+  MFNode &node2 = network.add_function(add_10_fn);
+  MFNode &node3 = network.add_function(add_10_fn);
+  MFOutputSocket &input_socket = network.add_input("Input", MFDataType::ForSingle<int>());
+  MFInputSocket &output_socket = network.add_output("Output", MFDataType::ForSingle<int>());
+  network.add_link(input_socket, node1.input(0));
+  network.add_link(node1.output(0), output_socket);
+  network.add_link(input_socket, node2.input(0));
+  network.add_link(node2.output(0), node3.input(0));
+
+  OptimizationStats stats = dead_node_removal(network);
+  EXPECT_EQ(stats.removed_node_amount, 2);
+  EXPECT_EQ(stats.added_node_amount, 0);
+  EXPECT_EQ(network.function_nodes().size(), 1);
+
+  stats = dead_node_removal(network);
+  EXPECT_EQ(stats.removed_node_amount, 0);
+}
+
+TEST(multi_function_network_optimization, ConstantFolding)
+{
+  CustomMF_Constant<int> constant_fn{3};
+  CustomMF_SI_SO<int, int> add_10_fn("add 10", [](int value) { return value + 10; });
+  CustomMF_SI_SI_SO<int, int, int> multiply_fn("multiply", [](int a, int b) { return a * b; });
+
+  MFNetwork network;
+
+  MFNode &node1 = network.add_function(constant_fn);
+  MFNode &node2 = network.add_function(add_10_fn);
+  MFNode &node3 = network.add_function(add_10_fn);
+  MFNode &node4 = network.add_function(multiply_fn);
+  MFOutputSocket &input_socket = network.add_input("Input", MFDataType::ForSingle<int>());
+  MFInputSocket &output_socket = network.add_output("Output", MFDataType::ForSingle<int>());
+  network.add_link(node1.output(0), node2.input(0));
+  network.add_link(node2.output(0), node3.input(0));
+  network.add_link(input_socket, node4.input(0));
+  network.add_link(node3.output(0), node4.input(1));
+  network.add_link(node4.output(0), output_socket);
+
+  ResourceCollector resources;
+  OptimizationStats stats = constant_folding(network, resources);
+
+  /* The constant and both additions are replaced by a single constant. */
+  EXPECT_EQ(stats.removed_node_amount, 3);
+  EXPECT_EQ(stats.added_node_amount, 1);
+  EXPECT_EQ(network.function_nodes().size(), 2);
+  EXPECT_TRUE(&output_socket.origin()->node() == &node4);
+  EXPECT_EQ(node4.input(1).origin()->node().inputs().size(), 0);
+
+  Array<int> values = {0, 1, 2, 5};
+  Array<int> results(values.size(), -1);
+  evaluate_network(input_socket, output_socket, values, results);
+  EXPECT_EQ(results[0], 0);
+  EXPECT_EQ(results[1], 23);
+  EXPECT_EQ(results[2], 46);
+  EXPECT_EQ(results[3], 115);
+
+  /* Nothing is left to fold. */
+  stats = constant_folding(network, resources);
+  EXPECT_EQ(stats.removed_node_amount, 0);
+  EXPECT_EQ(stats.added_node_amount, 0);
+}
+
+TEST(multi_function_network_optimization, CommonSubnetworkElimination)
+{
+  CustomMF_SI_SO<int, int> add_10_fn("add 10", [](int value) { return value + 10; });
+  CustomMF_SI_SI_SO<int, int, int> multiply_fn("multiply", [](int a, int b) { return a * b; });
+
+  MFNetwork network;
+
+  /* Two identical chains of additions that are multiplied. */
+  MFNode &node1 = network.add_function(add_10_fn);
+  MFNode &node2 = network.add_function(add_10_fn);
+  MFNode &node3 = network.add_function(add_10_fn);
+  MFNode &node4 = network.add_function(add_10_fn);
+  MFNode &node5 = network.add_function(multiply_fn);
+  MFOutputSocket &input_socket = network.add_input("Input", MFDataType::ForSingle<int>());
+  MFInputSocket &output_socket = network.add_output("Output", MFDataType::ForSingle<int>());
+  network.add_link(input_socket, node1.input(0));
+  network.add_link(node1.output(0), node2.input(0));
+  network.add_link(input_socket, node3.input(0));
+  network.add_link(node3.output(0), node4.input(0));
+  network.add_link(node2.output(0), node5.input(0));
+  network.add_link(node4.output(0), node5.input(1));
+  network.add_link(node5.output(0), output_socket);
+
+  OptimizationStats stats = common_subnetwork_elimination(network);
+  EXPECT_EQ(stats.removed_node_amount, 2);
+  EXPECT_EQ(network.function_nodes().size(), 3);
+  EXPECT_TRUE(node5.input(0).origin() == node5.input(1).origin());
+
+  Array<int> values = {0, 1, 2};
+  Array<int> results(values.size(), -1);
+  evaluate_network(input_socket, output_socket, values, results);
+  EXPECT_EQ(results[0], 400);
+  EXPECT_EQ(results[1], 441);
+  EXPECT_EQ(results[2], 484);
+
+  stats = common_subnetwork_elimination(network);
+  EXPECT_EQ(stats.removed_node_amount, 0);
+}
+
+TEST(multi_function_network_optimization, CommonSubnetworkEliminationDifferentOutputs)
+{
+  TwoOutputsFunction two_outputs_fn;
+  CustomMF_SI_SO<int, int> add_10_fn("add 10", [](int value) { return value + 10; });
+  CustomMF_SI_SI_SO<int, int, int> multiply_fn("multiply", [](int a, int b) { return a * b; });
+
+  MFNetwork network;
+
+  /* The additions use the same function, but read different outputs of the same node. */
+  MFNode &node1 = network.add_function(two_outputs_fn);
+  MFNode &node2 = network.add_function(add_10_fn);
+  MFNode &node3 = network.add_function(add_10_fn);
+  MFNode &node4 = network.add_function(multiply_fn);
+  MFOutputSocket &input_socket = network.add_input("Input", MFDataType::ForSingle<int>());
+  MFInputSocket &output_socket = network.add_output("Output", MFDataType::ForSingle<int>());
+  network.add_link(input_socket, node1.input(0));
+  network.add_link(node1.output(0), node2.input(0));
+  network.add_link(node1.output(1), node3.input(0));
+  network.add_link(node2.output(0), node4.input(0));
+  network.add_link(node3.output(0), node4.input(1));
+  network.add_link(node4.output(0), output_socket);
+
+  OptimizationStats stats = common_subnetwork_elimination(network);
+  EXPECT_EQ(stats.removed_node_amount, 0);
+  EXPECT_EQ(network.function_nodes().size(), 4);
+
+  Array<int> values = {0, 1};
+  Array<int> results(values.size(), -1);
+  evaluate_network(input_socket, output_socket, values, results);
+  EXPECT_EQ(results[0], 11 * 12);
+  EXPECT_EQ(results[1], 12 * 13);
+}
+
+}  // namespace
+}  // namespace blender::fn::tests
@@ -2,6 +2,7 @@
 
 #include "testing/testing.h"
 
+#include "FN_multi_function_buffer_pool.hh"
 #include "FN_multi_function_builder.hh"
 #include "FN_multi_function_network.hh"
 #include "FN_multi_function_network_evaluation.hh"
@@ -251,5 +252,203 @@ TEST(multi_function_network, Test2)
   }
 }
 
+TEST(multi_function_network, LargeMask)
+{
+  CustomMF_SI_SO<int, int> add_10_fn("add 10", [](int value) { return value + 10; });
+  CustomMF_SI_SI_SO<int, int, int> multiply_fn("multiply", [](int a, int b) { return a * b; });
+
+  MFNetwork network;
+
+  MFNode &node1 = network.add_function(add_10_fn);
+  MFNode &node2 = network.add_function(multiply_fn);
+  MFOutputSocket &input_socket_1 = network.add_input("Input 1", MFDataType::ForSingle<int>());
+  MFOutputSocket &input_socket_2 = network.add_input("Input 2", MFDataType::ForSingle<int>());
+  MFInputSocket &output_socket_1 = network.add_output("Output 1", MFDataType::ForSingle<int>());
+  MFInputSocket &output_socket_2 = network.add_output("Output 2", MFDataType::ForSingle<int>());
+  network.add_link(input_socket_1, node1.input(0));
+  network.add_link(node1.output(0), node2.input(0));
+  network.add_link(input_socket_2, node2.input(1));
+  network.add_link(node2.output(0), output_socket_1);
+  network.add_link(input_socket_1, output_socket_2);
+
+  MFNetworkEvaluator network_fn{{&input_socket_1, &input_socket_2},
+                                {&output_socket_1, &output_socket_2}};
+
+  /* Large enough to be split into many chunks, with a partial chunk at the end. */
+  const int64_t size = 100003;
+  Array<int> values_1(size);
+  Array<int> values_2(size);
+  for (const int64_t i : IndexRange(size)) {
+    values_1[i] = (int)i % 1000;
+    values_2[i] = (int)i % 7;
+  }
+
+  Vector<int64_t> indices;
+  for (int64_t i = 5; i < size; i += 3) {
+    indices.append(i);
+  }
+
+  {
+    Array<int> results_1(size, -1);
+    Array<int> results_2(size, -1);
+
+    MFParamsBuilder params(network_fn, size);
+    params.add_readonly_single_input(values_1.as_span());
+    params.add_readonly_single_input(values_2.as_span());
+    params.add_uninitialized_single_output(results_1.as_mutable_span());
+    params.add_uninitialized_single_output(results_2.as_mutable_span());
+
+    MFContextBuilder context;
+
+    network_fn.call(IndexRange(size), params, context);
+
+    for (const int64_t i : IndexRange(size)) {
+      EXPECT_EQ(results_1[i], (values_1[i] + 10) * values_2[i]);
+      EXPECT_EQ(results_2[i], values_1[i]);
+    }
+  }
+  {
+    Array<int> results_1(size, -1);
+    Array<int> results_2(size, -1);
+    int value_2 = 3;
+
+    MFParamsBuilder params(network_fn, size);
+    params.add_readonly_single_input(values_1.as_span());
+    params.add_readonly_single_input(&value_2);
+    params.add_uninitialized_single_output(results_1.as_mutable_span());
+    params.add_uninitialized_single_output(results_2.as_mutable_span());
+
+    MFContextBuilder context;
+
+    network_fn.call(indices.as_span(), params, context);
+
+    for (const int64_t i : IndexRange(size)) {
+      if (i >= 5 && (i - 5) % 3 == 0) {
+        EXPECT_EQ(results_1[i], (values_1[i] + 10) * 3);
+        EXPECT_EQ(results_2[i], values_1[i]);
+      }
+      else {
+        EXPECT_EQ(results_1[i], -1);
+        EXPECT_EQ(results_2[i], -1);
+      }
+    }
+  }
+}
+
+TEST(multi_function_network, BufferPool)
+{
+  CustomMF_SI_SO<int, int> add_10_fn("add 10", [](int value) { return value + 10; });
+  CustomMF_SI_SI_SO<int, int, int> multiply_fn("multiply", [](int a, int b) { return a * b; });
+
+  MFNetwork network;
+
+  MFNode &node1 = network.add_function(add_10_fn);
+  MFNode &node2 = network.add_function(add_10_fn);
+  MFNode &node3 = network.add_function(multiply_fn);
+  MFOutputSocket &input_socket = network.add_input("Input", MFDataType::ForSingle<int>());
+  MFInputSocket &output_socket = network.add_output("Output", MFDataType::ForSingle<int>());
+  network.add_link(input_socket, node1.input(0));
+  network.add_link(node1.output(0), node2.input(0));
+  network.add_link(node1.output(0), node3.input(0));
+  network.add_link(node2.output(0), node3.input(1));
+  network.add_link(node3.output(0), output_socket);
+
+  MFNetworkEvaluator network_fn{{&input_socket}, {&output_socket}};
+  MFBufferPool buffer_pool;
+
+  /* Evaluate small and chunked masks like in multiple frames of a simulation. */
+  for (const int64_t size : {100, 10000}) {
+    int64_t allocation_amount = 0;
+    for (const int iteration : IndexRange(3)) {
+      Array<int> values(size, 2);
+      Array<int> results(size, -1);
+
+      MFParamsBuilder params(network_fn, size);
+      params.add_readonly_single_input(values.as_span());
+      params.add_uninitialized_single_output(results.as_mutable_span());
+
+      MFContextBuilder context;
+      context.set_buffer_pool(buffer_pool);
+
+      network_fn.call(IndexRange(size), params, context);
+
+      EXPECT_EQ(results[0], 12 * 22);
+      EXPECT_EQ(results.last(), 12 * 22);
+
+      if (iteration == 0) {
+        allocation_amount = buffer_pool.allocation_amount();
+        EXPECT_GT(allocation_amount, 0);
+      }
+      else {
+        /* All buffers are reused after the first evaluation. */
+        EXPECT_EQ(buffer_pool.allocation_amount(), allocation_amount);
+      }
+    }
+  }
+  EXPECT_GT(buffer_pool.reuse_amount(), 0);
+}
+
+TEST(multi_function_network, SingleValueOutputs)
+{
+  int add_calls = 0;
+  int multiply_calls = 0;
+  CustomMF_SI_SO<int, int> add_10_fn("add 10", [&](int value) {
+    add_calls++;
+    return value + 10;
+  });
+  CustomMF_SI_SI_SO<int, int, int> multiply_fn("multiply", [&](int a, int b) {
+    multiply_calls++;
+    return a * b;
+  });
+
+  MFNetwork network;
+
+  /* The result of the addition is output directly and used by the multiplication. */
+  MFNode &node1 = network.add_function(add_10_fn);
+  MFNode &node2 = network.add_function(multiply_fn);
+  MFOutputSocket &input_socket = network.add_input("Input", MFDataType::ForSingle<int>());
+  MFInputSocket &output_socket_1 = network.add_output("Output 1", MFDataType::ForSingle<int>());
+  MFInputSocket &output_socket_2 = network.add_output("Output 2", MFDataType::ForSingle<int>());
+  MFInputSocket &output_socket_3 = network.add_output("Output 3", MFDataType::ForSingle<int>());
+  network.add_link(input_socket, node1.input(0));
+  network.add_link(node1.output(0), node2.input(0));
+  network.add_link(node1.output(0), node2.input(1));
+  network.add_link(node1.output(0), output_socket_1);
+  network.add_link(node2.output(0), output_socket_2);
+  network.add_link(input_socket, output_socket_3);
+
+  MFNetworkEvaluator network_fn{{&input_socket},
+                                {&output_socket_1, &output_socket_2, &output_socket_3}};
+
+  /* Large enough to be split into chunks, if the inputs were not single values. */
+  const int64_t size = 10000;
+  int value = 5;
+  Array<int> results_1(size, -1);
+  Array<int> results_2(size, -1);
+  Array<int> results_3(size, -1);
+
+  MFParamsBuilder params(network_fn, size);
+  params.add_readonly_single_input(&value);
+  params.add_uninitialized_single_output(results_1.as_mutable_span());
+  params.add_uninitialized_single_output(results_2.as_mutable_span());
+  params.add_uninitialized_single_output(results_3.as_mutable_span());
+
+  MFContextBuilder context;
+
+  network_fn.call(IndexRange(1, size - 1), params, context);
+
+  /* Every function is evaluated once, even though its outputs are broadcast to all indices. */
+  EXPECT_EQ(add_calls, 1);
+  EXPECT_EQ(multiply_calls, 1);
+  EXPECT_EQ(results_1[0], -1);
+  EXPECT_EQ(results_2[0], -1);
+  EXPECT_EQ(results_3[0], -1);
+  for (const int64_t i : IndexRange(1, size - 1)) {
+    EXPECT_EQ(results_1[i], 15);
+    EXPECT_EQ(results_2[i], 225);
+    EXPECT_EQ(results_3[i], 5);
+  }
+}
+
 }  // namespace
 }  // namespace blender::fn::tests
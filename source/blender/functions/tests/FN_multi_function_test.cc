@@ -249,6 +249,104 @@ TEST(multi_function, CustomMF_SI_SI_SO)
   EXPECT_EQ(outputs[3], 90);
 }
 
+TEST(multi_function, CustomMF_SI_SI_SO_InputCategories)
+{
+  CustomMF_SI_SI_SO<int, int, int> fn("sub", [](int a, int b) { return a - b; });
+
+  Array<int> values_a = {4, 6, 8, 9, 12};
+  Array<int> values_b = {1, 2, 3, 4, 5};
+  const int value_b = 10;
+  Array<const int *> pointers_b = {
+      &values_b[4], &values_b[3], &values_b[2], &values_b[1], &value_b};
+  MFContextBuilder context;
+
+  /* Array and array, contiguous mask. */
+  {
+    Array<int> outputs(values_a.size(), -1);
+    MFParamsBuilder params(fn, values_a.size());
+    params.add_readonly_single_input(values_a.as_span());
+    params.add_readonly_single_input(values_b.as_span());
+    params.add_uninitialized_single_output(outputs.as_mutable_span());
+    fn.call(IndexRange(1, 3), params, context);
+    EXPECT_EQ(outputs[0], -1);
+    EXPECT_EQ(outputs[1], 4);
+    EXPECT_EQ(outputs[2], 5);
+    EXPECT_EQ(outputs[3], 5);
+    EXPECT_EQ(outputs[4], -1);
+  }
+  /* Single and array. */
+  {
+    Array<int> outputs(values_a.size(), -1);
+    MFParamsBuilder params(fn, values_a.size());
+    params.add_readonly_single_input(&value_b);
+    params.add_readonly_single_input(values_b.as_span());
+    params.add_uninitialized_single_output(outputs.as_mutable_span());
+    fn.call(IndexRange(values_a.size()), params, context);
+    EXPECT_EQ(outputs[0], 9);
+    EXPECT_EQ(outputs[1], 8);
+    EXPECT_EQ(outputs[2], 7);
+    EXPECT_EQ(outputs[3], 6);
+    EXPECT_EQ(outputs[4], 5);
+  }
+  /* Array and pointer array, uses the virtual spans. */
+  {
+    Array<int> outputs(values_a.size(), -1);
+    MFParamsBuilder params(fn, values_a.size());
+    params.add_readonly_single_input(values_a.as_span());
+    params.add_readonly_single_input(VSpan<int>(pointers_b.as_span()));
+    params.add_uninitialized_single_output(outputs.as_mutable_span());
+    fn.call({0, 2, 4}, params, context);
+    EXPECT_EQ(outputs[0], -1);
+    EXPECT_EQ(outputs[1], -1);
+    EXPECT_EQ(outputs[2], 5);
+    EXPECT_EQ(outputs[3], -1);
+    EXPECT_EQ(outputs[4], 2);
+  }
+}
+
+TEST(multi_function, CustomMF_SI_SO_Batch)
+{
+  int batch_calls = 0;
+  CustomMF_SI_SO<float, float> fn(
+      "double",
+      [](float a) { return a * 2.0f; },
+      [&](Span<float> in1, MutableSpan<float> out1) {
+        batch_calls++;
+        for (const int64_t i : in1.index_range()) {
+          out1[i] = in1[i] * 2.0f;
+        }
+      });
+
+  Array<float> inputs = {1.0f, 2.0f, 3.0f, 4.0f};
+  Array<float> outputs(inputs.size(), 0.0f);
+  MFContextBuilder context;
+
+  {
+    MFParamsBuilder params(fn, inputs.size());
+    params.add_readonly_single_input(inputs.as_span());
+    params.add_uninitialized_single_output(outputs.as_mutable_span());
+    fn.call(IndexRange(1, 2), params, context);
+  }
+  EXPECT_EQ(batch_calls, 1);
+  EXPECT_EQ(outputs[0], 0.0f);
+  EXPECT_EQ(outputs[1], 4.0f);
+  EXPECT_EQ(outputs[2], 6.0f);
+  EXPECT_EQ(outputs[3], 0.0f);
+
+  /* Not a range, the element function is used. */
+  {
+    MFParamsBuilder params(fn, inputs.size());
+    params.add_readonly_single_input(inputs.as_span());
+    params.add_uninitialized_single_output(outputs.as_mutable_span());
+    fn.call({0, 3}, params, context);
+  }
+  EXPECT_EQ(batch_calls, 1);
+  EXPECT_EQ(outputs[0], 2.0f);
+  EXPECT_EQ(outputs[1], 4.0f);
+  EXPECT_EQ(outputs[2], 6.0f);
+  EXPECT_EQ(outputs[3], 8.0f);
+}
+
 TEST(multi_function, CustomMF_SI_SI_SI_SO)
 {
   CustomMF_SI_SI_SI_SO<int, std::string, bool, uint> fn{
@@ -276,6 +374,52 @@ TEST(multi_function, CustomMF_SI_SI_SI_SO)
   EXPECT_EQ(outputs[3], 13);
 }
 
+TEST(multi_function, CustomMF_SI_SI_SO_SingleInputs)
+{
+  int element_calls = 0;
+  CustomMF_SI_SI_SO<int, int, int> fn("add", [&](int a, int b) {
+    element_calls++;
+    return a + b;
+  });
+
+  Array<int> values = {1, 2, 3, 4, 5};
+  Array<int> results(values.size(), -1);
+  MFContextBuilder context;
+
+  /* The result is the same for every index, so it is only computed once. */
+  {
+    int value_1 = 3;
+    int value_2 = 4;
+    MFParamsBuilder params(fn, results.size());
+    params.add_readonly_single_input(&value_1);
+    params.add_readonly_single_input(&value_2);
+    params.add_uninitialized_single_output(results.as_mutable_span());
+    fn.call({0, 2, 3, 4}, params, context);
+  }
+  EXPECT_EQ(element_calls, 1);
+  EXPECT_EQ(results[0], 7);
+  EXPECT_EQ(results[1], -1);
+  EXPECT_EQ(results[2], 7);
+  EXPECT_EQ(results[3], 7);
+  EXPECT_EQ(results[4], 7);
+
+  /* One input is an array. */
+  {
+    int value_2 = 10;
+    MFParamsBuilder params(fn, results.size());
+    params.add_readonly_single_input(values.as_span());
+    params.add_readonly_single_input(&value_2);
+    params.add_uninitialized_single_output(results.as_mutable_span());
+    fn.call(IndexRange(1, 3), params, context);
+  }
+  EXPECT_EQ(element_calls, 4);
+  EXPECT_EQ(results[0], 7);
+  EXPECT_EQ(results[1], 12);
+  EXPECT_EQ(results[2], 13);
+  EXPECT_EQ(results[3], 14);
+  EXPECT_EQ(results[4], 7);
+}
+
 TEST(multi_function, CustomMF_SM)
 {
   CustomMF_SM<std::string> fn("AddSuffix", [](std::string &value) { value += " test"; });
@@ -219,4 +219,28 @@ TEST(generic_virtual_span, SingleConstructor)
   EXPECT_EQ(converted[2], 5);
 }
 
+TEST(generic_virtual_span, Slice)
+{
+  int values[5] = {3, 4, 5, 6, 7};
+  GVSpan span{Span<int>(values, 5)};
+  GVSpan slice = span.slice(1, 3);
+  EXPECT_EQ(slice.size(), 3);
+  EXPECT_TRUE(slice.is_full_array());
+  EXPECT_EQ(slice[0], &values[1]);
+  EXPECT_EQ(slice[2], &values[3]);
+
+  std::array<const int *, 3> pointers = {&values[4], &values[0], &values[2]};
+  GVSpan pointer_span = GVSpan::FromFullPointerArray(
+      CPPType::get<int32_t>(), (const void *const *)pointers.data(), 3);
+  GVSpan pointer_slice = pointer_span.slice(1, 2);
+  EXPECT_EQ(pointer_slice.size(), 2);
+  EXPECT_EQ(pointer_slice[0], &values[0]);
+  EXPECT_EQ(pointer_slice[1], &values[2]);
+
+  GVSpan single_slice = GVSpan::FromSingle(CPPType::get<int32_t>(), &values[0], 10).slice(4, 6);
+  EXPECT_EQ(single_slice.size(), 6);
+  EXPECT_TRUE(single_slice.is_single_element());
+  EXPECT_EQ(single_slice.as_single_element(), &values[0]);
+}
+
 }  // namespace blender::fn::tests
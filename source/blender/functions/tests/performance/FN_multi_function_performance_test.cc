@@ -0,0 +1,188 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "BLI_array.hh"
+#include "BLI_math_base_safe.h"
+#include "BLI_rand.hh"
+#include "BLI_timeit.hh"
+#include "BLI_vector.hh"
+
+#include "FN_multi_function_builder.hh"
+
+namespace blender::fn::tests {
+
+/* Math node multi-functions built the way the builders used to build them, with every element
+ * read through #VSpan::operator[] and function pointers passed as element functions, compared to
+ * the current builders. The node functions themselves are local to the nodes module, so the
+ * element functions are repeated here. */
+
+static const int64_t elements_num = 10000000;
+static const int repeat = 5;
+
+template<typename In1, typename Out1, typename ElementFuncT>
+static CustomMF_SI_SO<In1, Out1> *per_element_fn_1(StringRef name, ElementFuncT element_fn)
+{
+  /* A #std::function selects the constructor that takes the whole loop. */
+  std::function<void(IndexMask, VSpan<In1>, MutableSpan<Out1>)> function =
+      [=](IndexMask mask, VSpan<In1> in1, MutableSpan<Out1> out1) {
+        mask.foreach_index(
+            [&](int i) { new (static_cast<void *>(&out1[i])) Out1(element_fn(in1[i])); });
+      };
+  return new CustomMF_SI_SO<In1, Out1>(name, function);
+}
+
+template<typename In1, typename In2, typename Out1, typename ElementFuncT>
+static CustomMF_SI_SI_SO<In1, In2, Out1> *per_element_fn_2(StringRef name,
+                                                           ElementFuncT element_fn)
+{
+  std::function<void(IndexMask, VSpan<In1>, VSpan<In2>, MutableSpan<Out1>)> function =
+      [=](IndexMask mask, VSpan<In1> in1, VSpan<In2> in2, MutableSpan<Out1> out1) {
+        mask.foreach_index([&](int i) {
+          new (static_cast<void *>(&out1[i])) Out1(element_fn(in1[i], in2[i]));
+        });
+      };
+  return new CustomMF_SI_SI_SO<In1, In2, Out1>(name, function);
+}
+
+enum class InputMode {
+  /* All inputs are arrays. */
+  Arrays,
+  /* The second input is a single value, like an unconnected socket. */
+  SingleSecond,
+};
+
+/* Best time of a few calls, in milliseconds. */
+static double time_call(const MultiFunction &fn,
+                        IndexMask mask,
+                        const InputMode mode,
+                        Span<float> in1,
+                        Span<float> in2,
+                        MutableSpan<float> out)
+{
+  double best_ms = 0.0;
+  for (int i = 0; i < repeat; i++) {
+    MFParamsBuilder params(fn, in1.size());
+    params.add_readonly_single_input(in1);
+    if (fn.param_indices().size() == 3) {
+      if (mode == InputMode::SingleSecond) {
+        params.add_readonly_single_input(&in2[0]);
+      }
+      else {
+        params.add_readonly_single_input(in2);
+      }
+    }
+    params.add_uninitialized_single_output(out);
+    MFContextBuilder context;
+
+    const timeit::TimePoint start = timeit::Clock::now();
+    fn.call(mask, params, context);
+    const timeit::Nanoseconds duration = timeit::Clock::now() - start;
+
+    const double ms = (double)duration.count() / 1e6;
+    best_ms = (i == 0) ? ms : std::min(best_ms, ms);
+  }
+  return best_ms;
+}
+
+static void compare(const char *name,
+                    const MultiFunction &fn_old,
+                    const MultiFunction &fn_new,
+                    Span<float> in1,
+                    Span<float> in2,
+                    Span<int64_t> sparse_indices)
+{
+  Array<float> out_old(in1.size(), 0.0f);
+  Array<float> out_new(in1.size(), 0.0f);
+
+  const struct {
+    const char *label;
+    IndexMask mask;
+    InputMode mode;
+  } cases[] = {
+      {"range, arrays", IndexRange(in1.size()), InputMode::Arrays},
+      {"range, single", IndexRange(in1.size()), InputMode::SingleSecond},
+      {"indices, arrays", sparse_indices, InputMode::Arrays},
+  };
+
+  for (const auto &test_case : cases) {
+    const double old_ms = time_call(fn_old, test_case.mask, test_case.mode, in1, in2, out_old);
+    const double new_ms = time_call(fn_new, test_case.mask, test_case.mode, in1, in2, out_new);
+    printf("%-14s %-16s  old %8.2f ms  new %8.2f ms  speedup %5.2fx\n",
+           name,
+           test_case.label,
+           old_ms,
+           new_ms,
+           old_ms / std::max(new_ms, 1e-6));
+
+    for (const int64_t i : test_case.mask) {
+      if (std::isnan(out_old[i])) {
+        EXPECT_TRUE(std::isnan(out_new[i]));
+      }
+      else {
+        EXPECT_EQ(out_old[i], out_new[i]);
+      }
+    }
+  }
+}
+
+TEST(multi_function_performance, MathNodes)
+{
+  Array<float> in1(elements_num);
+  Array<float> in2(elements_num);
+  RandomNumberGenerator rng(0);
+  for (const int64_t i : in1.index_range()) {
+    in1[i] = rng.get_float() * 20.0f - 10.0f;
+    in2[i] = rng.get_float() * 20.0f - 10.0f;
+  }
+  Vector<int64_t> sparse_indices;
+  for (int64_t i = 0; i < elements_num; i += 2) {
+    sparse_indices.append(i);
+  }
+
+  {
+    std::unique_ptr<MultiFunction> fn_old{per_element_fn_2<float, float, float>(
+        "Add", [](float a, float b) { return a + b; })};
+    CustomMF_SI_SI_SO<float, float, float> fn_new{"Add", [](float a, float b) { return a + b; }};
+    compare("Add", *fn_old, fn_new, in1, in2, sparse_indices);
+  }
+  {
+    std::unique_ptr<MultiFunction> fn_old{
+        per_element_fn_2<float, float, float>("Divide", safe_divide)};
+    CustomMF_SI_SI_SO<float, float, float> fn_new{
+        "Divide", [](float a, float b) { return safe_divide(a, b); }};
+    compare("Divide", *fn_old, fn_new, in1, in2, sparse_indices);
+  }
+  {
+    std::unique_ptr<MultiFunction> fn_old{per_element_fn_2<float, float, float>(
+        "Minimum", [](float a, float b) { return std::min(a, b); })};
+    CustomMF_SI_SI_SO<float, float, float> fn_new{
+        "Minimum", [](float a, float b) { return std::min(a, b); }};
+    compare("Minimum", *fn_old, fn_new, in1, in2, sparse_indices);
+  }
+  {
+    std::unique_ptr<MultiFunction> fn_old{per_element_fn_1<float, float>("Sqrt", safe_sqrtf)};
+    CustomMF_SI_SO<float, float> fn_new{"Sqrt", [](float a) { return safe_sqrtf(a); }};
+    compare("Sqrt", *fn_old, fn_new, in1, in2, sparse_indices);
+  }
+  {
+    std::unique_ptr<MultiFunction> fn_old{
+        per_element_fn_1<float, float>("Fraction", [](float a) { return a - floorf(a); })};
+    CustomMF_SI_SO<float, float> fn_new{"Fraction", [](float a) { return a - floorf(a); }};
+    compare("Fraction", *fn_old, fn_new, in1, in2, sparse_indices);
+  }
+  {
+    std::unique_ptr<MultiFunction> fn_old{
+        per_element_fn_1<float, float>("Sine", [](float a) { return sinf(a); })};
+    CustomMF_SI_SO<float, float> fn_new{"Sine", [](float a) { return sinf(a); }};
+    compare("Sine", *fn_old, fn_new, in1, in2, sparse_indices);
+  }
+}
+
+}  // namespace blender::fn::tests
@@ -2317,8 +2317,9 @@ typedef struct MoebiusModifierData {
 	struct Object *origin;
 	float norm_power;
 	int flags;
-	
-	char _pad0[8];
+	/** Results farther than this from the origin are moved onto this sphere, zero for no limit. */
+	float clamp_radius;
+	char _pad0[4];
 } MoebiusModifierData;
 
 typedef enum MoebiusModifierFlags{
@@ -2334,8 +2335,11 @@ typedef struct SphereReflectModifierData {
   float falloff;
 
 	int flags;
-	
-	char _pad0[4];
+  /** Upper bound for the number of faces adaptive refinement creates, zero for no limit. */
+  int max_faces;
+  /** Results farther than this from the sphere center are moved onto it, zero for no limit. */
+  float clamp_radius;
+  char _pad0[4];
 } SphereReflectModifierData;
 
 /** SphereReflectModifierData->flag */
@@ -128,7 +128,9 @@ typedef struct Object_Runtime {
 
   /** Selection id of this object; only available in the original object */
   int select_id;
-  char _pad1[3];
+  /** Use #modifier_bounds for #bb, see #BKE_modifier_bounds_set. */
+  char use_modifier_bounds;
+  char _pad1[2];
 
   /**
    * Denotes whether the evaluated data is owned by this object or is referenced and owned by
@@ -177,6 +179,18 @@ typedef struct Object_Runtime {
   /** Runtime evaluated curve-specific data, not stored in the file. */
   struct CurveCache *curve_cache;
 
+  /**
+   * BVH trees of the last evaluated mesh, given to the next evaluated mesh so they only have
+   * to be refit when the topology stays the same. See #bvhcache_release.
+   */
+  struct BVHCache *bvh_cache_retained;
+
+  /**
+   * Object space bounds of the evaluated mesh, reported by the last modifier of the stack when it
+   * knows them without looking at every vertex.
+   */
+  float modifier_bounds[2][3];
+
   unsigned short local_collections_bits;
   short _pad2[3];
 } Object_Runtime;
@@ -7179,6 +7179,16 @@ static void rna_def_modifier_moebius(BlenderRNA *brna)
   RNA_def_property_ui_range(prop, -100, 100, 0.1, 2);
   RNA_def_property_ui_text(prop, "Norm Power", "p value of the norm used.");
   RNA_def_property_update(prop, 0, "rna_Modifier_update");
+
+  prop = RNA_def_property(srna, "clamp_radius", PROP_FLOAT, PROP_DISTANCE);
+  RNA_def_property_range(prop, 0.0f, FLT_MAX);
+  RNA_def_property_ui_range(prop, 0.0f, 10000.0f, 10, 3);
+  RNA_def_property_ui_text(
+      prop,
+      "Clamp Radius",
+      "Move points that end up farther than this from the origin onto a sphere with this radius "
+      "(0 for no limit)");
+  RNA_def_property_update(prop, 0, "rna_Modifier_update");
 }
 
 static void rna_def_modifier_sphere_reflect(BlenderRNA *brna)
@@ -7227,6 +7237,24 @@ static void rna_def_modifier_sphere_reflect(BlenderRNA *brna)
   RNA_def_property_ui_range(prop, 0, 1000.0, 0.1, -1);
   RNA_def_property_ui_text(prop, "Falloff", "Falloff factor for adaptive subdivision.");
   RNA_def_property_update(prop, 0, "rna_Modifier_update");
+
+  prop = RNA_def_property(srna, "max_faces", PROP_INT, PROP_NONE);
+  RNA_def_property_range(prop, 0, INT_MAX);
+  RNA_def_property_ui_range(prop, 0, 10000000, 10000, -1);
+  RNA_def_property_ui_text(
+      prop,
+      "Max Faces",
+      "Lower the refinement level until the result has at most this many faces (0 for no limit)");
+  RNA_def_property_update(prop, 0, "rna_Modifier_update");
+
+  prop = RNA_def_property(srna, "clamp_radius", PROP_FLOAT, PROP_DISTANCE);
+  RNA_def_property_range(prop, 0.0f, FLT_MAX);
+  RNA_def_property_ui_range(prop, 0.0f, 10000.0f, 10, 3);
+  RNA_def_property_ui_text(prop,
+                           "Clamp Radius",
+                           "Move points that end up farther than this from the sphere center "
+                           "onto a sphere with this radius (0 for no limit)");
+  RNA_def_property_update(prop, 0, "rna_Modifier_update");
 }
 
 void RNA_def_modifier(BlenderRNA *brna)
@@ -0,0 +1,520 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup modifiers
+ */
+
+#include <math.h>
+
+#include "BLI_math.h"
+#include "BLI_task.hh"
+
+#include "DNA_customdata_types.h"
+#include "DNA_hair_types.h"
+#include "DNA_pointcloud_types.h"
+
+#include "BKE_customdata.h"
+#include "BKE_hair.h"
+#include "BKE_pointcloud.h"
+
+#include "MOD_conformal.hh"
+
+namespace blender::modifiers::conformal {
+
+/* Guards the stereographic projections and the sphere inversion against division by zero at
+ * the pole. */
+static const float moebius_eps = 0.0000000000000001f;
+
+/* Vertices are processed in blocks of this size, converted to a struct-of-arrays layout on the
+ * stack so that the inner loops can be vectorized by the compiler. */
+static const int64_t moebius_block_size = 256;
+
+/* Scale that moves a point at squared distance \a len_sq onto the clamp sphere when outside. */
+BLI_INLINE float moebius_clamp_factor(const float len_sq, const float clamp_sq)
+{
+  return (len_sq > clamp_sq) ? sqrtf(clamp_sq / len_sq) : 1.0f;
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Moebius Transformation
+ * \{ */
+
+void moebius_rotation_from_matrix(float r_rotation[4][4], const float control_mat[4][4])
+{
+  float quat[4];
+  float leftMat[4][4];
+  float rightMat[4][4];
+
+  mat4_to_quat(quat, control_mat);
+
+  leftMat[0][0] = leftMat[1][1] = leftMat[2][2] = leftMat[3][3] = quat[0];
+  leftMat[0][1] = leftMat[2][3] = -quat[1];
+  leftMat[0][2] = leftMat[3][1] = -quat[2];
+  leftMat[0][3] = leftMat[1][2] = -quat[3];
+  leftMat[2][1] = leftMat[3][0] = quat[3];
+  leftMat[1][3] = leftMat[2][0] = quat[2];
+  leftMat[1][0] = leftMat[3][2] = quat[1];
+
+  rightMat[0][0] = rightMat[1][1] = rightMat[2][2] = rightMat[3][3] = quat[0];
+  rightMat[0][1] = rightMat[3][2] = -quat[1];
+  rightMat[0][2] = rightMat[1][3] = -quat[2];
+  rightMat[0][3] = rightMat[2][1] = -quat[3];
+  rightMat[1][2] = rightMat[3][0] = quat[3];
+  rightMat[3][1] = rightMat[2][0] = quat[2];
+  rightMat[1][0] = rightMat[2][3] = quat[1];
+
+  mul_m4_m4m4(r_rotation, rightMat, leftMat);
+}
+
+void moebius_transform_co(const float rotation[4][4], float co[3], const float norm_power)
+{
+  float h[4];
+
+  const float norm = (norm_power == 2.0f) ? co[0] * co[0] + co[1] * co[1] + co[2] * co[2] :
+                                            powf(co[0], norm_power) + powf(co[1], norm_power) +
+                                                powf(co[2], norm_power);
+
+  mul_v3_v3fl(h, co, 2.0f);
+  h[3] = norm - 1.0f;
+
+  mul_v4_fl(h, 1.0f / max_ff(1.0f + norm, moebius_eps));
+  mul_m4_v4(rotation, h);
+  copy_v3_v3(co, h);
+  mul_v3_fl(co, 1.0f / max_ff(1.0f - h[3], moebius_eps));
+}
+
+void moebius_transform_init(MoebiusTransform *r_transform,
+                            const float object_mat[4][4],
+                            const float control_mat[4][4],
+                            const float origin[3],
+                            const bool localize,
+                            const float norm_power)
+{
+  moebius_rotation_from_matrix(r_transform->rotation, control_mat);
+  copy_m4_m4(r_transform->object_mat, object_mat);
+  invert_m4_m4(r_transform->object_imat, object_mat);
+  copy_v3_v3(r_transform->origin, origin);
+  zero_v3(r_transform->offset);
+  r_transform->norm_power = norm_power;
+  r_transform->clamp_radius = 0.0f;
+
+  if (localize) {
+    moebius_transform_co(r_transform->rotation, r_transform->offset, norm_power);
+  }
+}
+
+/* Lift a block of object space positions onto the unit 3-sphere, one array per component. */
+static void moebius_lift_block(const MoebiusTransform &transform,
+                               const float3 *positions,
+                               const int64_t size,
+                               float *x,
+                               float *y,
+                               float *z,
+                               float *w)
+{
+  const float(*m)[4] = transform.object_mat;
+  const float *origin = transform.origin;
+  for (int64_t i = 0; i < size; i++) {
+    const float3 &co = positions[i];
+    x[i] = (co.x * m[0][0] + co.y * m[1][0] + co.z * m[2][0] + m[3][0]) - origin[0];
+    y[i] = (co.x * m[0][1] + co.y * m[1][1] + co.z * m[2][1] + m[3][1]) - origin[1];
+    z[i] = (co.x * m[0][2] + co.y * m[1][2] + co.z * m[2][2] + m[3][2]) - origin[2];
+  }
+
+  /* The default Euclidean norm avoids `pow` entirely. */
+  const float p = transform.norm_power;
+  if (p == 2.0f) {
+    for (int64_t i = 0; i < size; i++) {
+      w[i] = x[i] * x[i] + y[i] * y[i] + z[i] * z[i];
+    }
+  }
+  else {
+    for (int64_t i = 0; i < size; i++) {
+      w[i] = powf(x[i], p) + powf(y[i], p) + powf(z[i], p);
+    }
+  }
+  for (int64_t i = 0; i < size; i++) {
+    const float fac = 1.0f / max_ff(1.0f + w[i], moebius_eps);
+    x[i] = (x[i] * 2.0f) * fac;
+    y[i] = (y[i] * 2.0f) * fac;
+    z[i] = (z[i] * 2.0f) * fac;
+    w[i] = (w[i] - 1.0f) * fac;
+  }
+}
+
+/* Rotate a block of lifted points and project them back to object space. */
+static void moebius_project_block(const MoebiusTransform &transform,
+                                  const float *x,
+                                  const float *y,
+                                  const float *z,
+                                  const float *w,
+                                  const int64_t size,
+                                  float3 *r_positions)
+{
+  const float(*r)[4] = transform.rotation;
+  const float(*m)[4] = transform.object_imat;
+  const float *origin = transform.origin;
+  const float *offset = transform.offset;
+  const float clamp_sq = square_f(transform.clamp_radius);
+  for (int64_t i = 0; i < size; i++) {
+    const float hx = x[i], hy = y[i], hz = z[i], hw = w[i];
+    const float rw = hx * r[0][3] + hy * r[1][3] + hz * r[2][3] + r[3][3] * hw;
+    float fac = 1.0f / max_ff(1.0f - rw, moebius_eps);
+    const float px = hx * r[0][0] + hy * r[1][0] + hz * r[2][0] + r[3][0] * hw;
+    const float py = hx * r[0][1] + hy * r[1][1] + hz * r[2][1] + r[3][1] * hw;
+    const float pz = hx * r[0][2] + hy * r[1][2] + hz * r[2][2] + r[3][2] * hw;
+    if (clamp_sq > 0.0f) {
+      fac *= moebius_clamp_factor((px * px + py * py + pz * pz) * (fac * fac), clamp_sq);
+    }
+    const float wx = px * fac + origin[0];
+    const float wy = py * fac + origin[1];
+    const float wz = pz * fac + origin[2];
+
+    float3 &co = r_positions[i];
+    co.x = (wx * m[0][0] + wy * m[1][0] + wz * m[2][0] + m[3][0]) - offset[0];
+    co.y = (wx * m[0][1] + wy * m[1][1] + wz * m[2][1] + m[3][1]) - offset[1];
+    co.z = (wx * m[0][2] + wy * m[1][2] + wz * m[2][2] + m[3][2]) - offset[2];
+  }
+}
+
+/* Call `function(start, size)` for blocks of at most #moebius_block_size elements,
+ * distributed over threads. */
+template<typename Function>
+static void moebius_foreach_block(const int64_t size, const Function &function)
+{
+  parallel_for(IndexRange(size), 4096, [&](IndexRange range) {
+    for (int64_t start = range.start(); start < range.one_after_last();
+         start += moebius_block_size) {
+      function(start, std::min(moebius_block_size, range.one_after_last() - start));
+    }
+  });
+}
+
+void moebius_transform_positions(const MoebiusTransform &transform, MutableSpan<float3> positions)
+{
+  moebius_foreach_block(positions.size(), [&](const int64_t start, const int64_t size) {
+    float x[moebius_block_size];
+    float y[moebius_block_size];
+    float z[moebius_block_size];
+    float w[moebius_block_size];
+    float3 *block = positions.data() + start;
+    moebius_lift_block(transform, block, size, x, y, z, w);
+    moebius_project_block(transform, x, y, z, w, size, block);
+  });
+}
+
+void moebius_lift_positions(const MoebiusTransform &transform,
+                            Span<float3> positions,
+                            MutableSpan<float> r_lifted)
+{
+  BLI_assert(r_lifted.size() == positions.size() * 4);
+  const int64_t stride = positions.size();
+  float *lifted = r_lifted.data();
+  moebius_foreach_block(positions.size(), [&](const int64_t start, const int64_t size) {
+    moebius_lift_block(transform,
+                       positions.data() + start,
+                       size,
+                       lifted + start,
+                       lifted + stride + start,
+                       lifted + stride * 2 + start,
+                       lifted + stride * 3 + start);
+  });
+}
+
+void moebius_project_positions(const MoebiusTransform &transform,
+                               Span<float> lifted,
+                               MutableSpan<float3> r_positions)
+{
+  BLI_assert(lifted.size() == r_positions.size() * 4);
+  const int64_t stride = r_positions.size();
+  const float *data = lifted.data();
+  moebius_foreach_block(r_positions.size(), [&](const int64_t start, const int64_t size) {
+    moebius_project_block(transform,
+                          data + start,
+                          data + stride + start,
+                          data + stride * 2 + start,
+                          data + stride * 3 + start,
+                          size,
+                          r_positions.data() + start);
+  });
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Sphere Inversion
+ * \{ */
+
+void sphere_inversion_init(SphereInversion *r_inversion,
+                           const float object_mat[4][4],
+                           const float center[3],
+                           const float radius)
+{
+  copy_m4_m4(r_inversion->object_mat, object_mat);
+  invert_m4_m4(r_inversion->object_imat, object_mat);
+  copy_v3_v3(r_inversion->center, center);
+  r_inversion->radius_sq = radius * radius;
+  r_inversion->clamp_radius = 0.0f;
+
+  /* The sphere through four of its points. Positions are inverted relative to the center, which
+   * keeps their conformal embedding small far away from the world origin. */
+  const double r = radius;
+  const kernels::Vector<double> sphere = kernels::dual(
+      kernels::sphere_from_points(kernels::point(r, 0.0, 0.0),
+                                  kernels::point(-r, 0.0, 0.0),
+                                  kernels::point(0.0, r, 0.0),
+                                  kernels::point(0.0, 0.0, r)));
+  const double norm_sq = kernels::abs(kernels::dot(sphere, sphere));
+  const double fac = (norm_sq > 0.0) ? 1.0 / sqrt(norm_sq) : 0.0;
+  r_inversion->sphere = {(float)(sphere.e1 * fac),
+                         (float)(sphere.e2 * fac),
+                         (float)(sphere.e3 * fac),
+                         (float)(sphere.no * fac),
+                         (float)(sphere.ni * fac)};
+}
+
+void sphere_inversion_positions(const SphereInversion &inversion, MutableSpan<float3> positions)
+{
+  const float(*m)[4] = inversion.object_mat;
+  const float(*im)[4] = inversion.object_imat;
+  const float *center = inversion.center;
+  const kernels::Vector<float> sphere = inversion.sphere;
+  const float clamp_sq = square_f(inversion.clamp_radius);
+
+  if (inversion.radius_sq == 0.0f) {
+    /* There is nothing to invert in a sphere without volume. */
+    return;
+  }
+
+  parallel_for(positions.index_range(), 4096, [&](IndexRange range) {
+    float3 *data = positions.data();
+    for (const int64_t i : range) {
+      const float3 co = data[i];
+      const float dx = (co.x * m[0][0] + co.y * m[1][0] + co.z * m[2][0] + m[3][0]) - center[0];
+      const float dy = (co.x * m[0][1] + co.y * m[1][1] + co.z * m[2][1] + m[3][1]) - center[1];
+      const float dz = (co.x * m[0][2] + co.y * m[1][2] + co.z * m[2][2] + m[3][2]) - center[2];
+
+      /* The center itself is sent far away. */
+      const kernels::Vector<float> inv = kernels::normalize_by_ni(
+          kernels::apply_vector_versor(sphere, kernels::point(dx, dy, dz)), moebius_eps);
+      float fac = 1.0f;
+      if (clamp_sq > 0.0f) {
+        fac = moebius_clamp_factor(inv.e1 * inv.e1 + inv.e2 * inv.e2 + inv.e3 * inv.e3, clamp_sq);
+      }
+      const float wx = inv.e1 * fac + center[0];
+      const float wy = inv.e2 * fac + center[1];
+      const float wz = inv.e3 * fac + center[2];
+
+      data[i].x = wx * im[0][0] + wy * im[1][0] + wz * im[2][0] + im[3][0];
+      data[i].y = wx * im[0][1] + wy * im[1][1] + wz * im[2][1] + im[3][1];
+      data[i].z = wx * im[0][2] + wy * im[1][2] + wz * im[2][2] + im[3][2];
+    }
+  });
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Analytic Bounds
+ *
+ * Both transformations map spheres to spheres (or planes), so the image of a ball around the
+ * input bounds is a ball that can be computed directly: in the conformal model a sphere with
+ * center `c` and radius `r` is the vector `c + no + 0.5 * (|c|^2 - r^2) * ni`, which transforms
+ * like a point. The math is done in double precision and padded slightly, so that the bounds
+ * still contain the single precision results.
+ * \{ */
+
+struct BoundsBall {
+  double center[3];
+  double radius;
+};
+
+/* Ball around the world space corners of an object space box, relative to \a world_center. */
+static BoundsBall bounds_ball_from_box(const float object_mat[4][4],
+                                       const float min[3],
+                                       const float max[3],
+                                       const float world_center[3])
+{
+  float center[3];
+  mid_v3_v3v3(center, min, max);
+  mul_m4_v3(object_mat, center);
+
+  /* An affine map keeps the box center at the center of the transformed box. */
+  float radius_sq = 0.0f;
+  for (int i = 0; i < 8; i++) {
+    float corner[3] = {
+        (i & 1) ? max[0] : min[0], (i & 2) ? max[1] : min[1], (i & 4) ? max[2] : min[2]};
+    mul_m4_v3(object_mat, corner);
+    radius_sq = max_ff(radius_sq, len_squared_v3v3(corner, center));
+  }
+
+  BoundsBall ball;
+  for (int i = 0; i < 3; i++) {
+    ball.center[i] = (double)center[i] - (double)world_center[i];
+  }
+  ball.radius = sqrt((double)radius_sq);
+  return ball;
+}
+
+/* Apply the clamp radius to the image of the input ball, false when the image is unbounded. */
+static bool bounds_ball_clamp(BoundsBall *ball, const bool bounded, const float clamp_radius)
+{
+  if (clamp_radius <= 0.0f) {
+    return bounded;
+  }
+  const double center_dist = sqrt(ball->center[0] * ball->center[0] +
+                                  ball->center[1] * ball->center[1] +
+                                  ball->center[2] * ball->center[2]);
+  if (bounded && center_dist + ball->radius <= (double)clamp_radius) {
+    return true;
+  }
+  /* Points moved onto the clamp sphere are not in the image ball anymore. */
+  ball->center[0] = ball->center[1] = ball->center[2] = 0.0;
+  ball->radius = clamp_radius;
+  return true;
+}
+
+/* Object space bounds of a ball relative to \a world_center. */
+static void bounds_ball_to_object(const BoundsBall &ball,
+                                  const float world_center[3],
+                                  const float object_imat[4][4],
+                                  const float offset[3],
+                                  float r_min[3],
+                                  float r_max[3])
+{
+  /* Padding for the rounding errors of the single precision kernels. */
+  double radius = ball.radius;
+  for (int i = 0; i < 3; i++) {
+    radius += fabs(ball.center[i] + (double)world_center[i]) * 1e-5;
+  }
+  radius += 1e-5;
+
+  INIT_MINMAX(r_min, r_max);
+  for (int i = 0; i < 8; i++) {
+    float corner[3];
+    for (int axis = 0; axis < 3; axis++) {
+      const double sign = (i & (1 << axis)) ? 1.0 : -1.0;
+      corner[axis] = (float)(ball.center[axis] + (double)world_center[axis] + sign * radius);
+    }
+    mul_m4_v3(object_imat, corner);
+    sub_v3_v3(corner, offset);
+    minmax_v3v3_v3(r_min, r_max, corner);
+  }
+}
+
+bool moebius_transform_bounds(const MoebiusTransform &transform,
+                              const float min[3],
+                              const float max[3],
+                              float r_min[3],
+                              float r_max[3])
+{
+  BoundsBall ball = bounds_ball_from_box(transform.object_mat, min, max, transform.origin);
+
+  bool bounded = false;
+  if (transform.norm_power == 2.0f) {
+    /* The lift onto the 3-sphere is the conformal embedding written in the basis e1, e2, e3,
+     * e+, e- with `no = (e- - e+) / 2` and `ni = e- + e+`, normalized to a unit e- component.
+     * The rotation acts on the first four components and fixes e-. */
+    const double *c = ball.center;
+    const double q = 0.5 * (c[0] * c[0] + c[1] * c[1] + c[2] * c[2] - ball.radius * ball.radius);
+    const double sphere[4] = {c[0], c[1], c[2], q - 0.5};
+    const double sphere_minus = q + 0.5;
+
+    const float(*r)[4] = transform.rotation;
+    double rotated[4];
+    for (int i = 0; i < 4; i++) {
+      rotated[i] = sphere[0] * r[0][i] + sphere[1] * r[1][i] + sphere[2] * r[2][i] +
+                   sphere[3] * r[3][i];
+    }
+
+    /* Back to the no and ni components. A negative no component means the inside of the input
+     * ball is mapped to the outside of the image sphere because it contains the pole. */
+    const double weight = sphere_minus - rotated[3];
+    const double infinity = 0.5 * (rotated[3] + sphere_minus);
+    if (weight > 0.0) {
+      double center_sq = 0.0;
+      for (int i = 0; i < 3; i++) {
+        ball.center[i] = rotated[i] / weight;
+        center_sq += ball.center[i] * ball.center[i];
+      }
+      ball.radius = sqrt(max_dd(center_sq - 2.0 * infinity / weight, 0.0));
+      bounded = true;
+    }
+  }
+
+  if (!bounds_ball_clamp(&ball, bounded, transform.clamp_radius)) {
+    return false;
+  }
+  bounds_ball_to_object(
+      ball, transform.origin, transform.object_imat, transform.offset, r_min, r_max);
+  return true;
+}
+
+bool sphere_inversion_bounds(const SphereInversion &inversion,
+                             const float min[3],
+                             const float max[3],
+                             float r_min[3],
+                             float r_max[3])
+{
+  BoundsBall ball = bounds_ball_from_box(inversion.object_mat, min, max, inversion.center);
+
+  /* The inversion of a ball that does not contain the center is a ball again. */
+  bool bounded = false;
+  const double *c = ball.center;
+  const double denom = c[0] * c[0] + c[1] * c[1] + c[2] * c[2] - ball.radius * ball.radius;
+  if (denom > 0.0) {
+    const double fac = (double)inversion.radius_sq / denom;
+    for (int i = 0; i < 3; i++) {
+      ball.center[i] *= fac;
+    }
+    ball.radius *= fac;
+    bounded = true;
+  }
+
+  if (!bounds_ball_clamp(&ball, bounded, inversion.clamp_radius)) {
+    return false;
+  }
+  const float offset[3] = {0.0f, 0.0f, 0.0f};
+  bounds_ball_to_object(ball, inversion.center, inversion.object_imat, offset, r_min, r_max);
+  return true;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Point Cloud and Hair Access
+ * \{ */
+
+MutableSpan<float3> pointcloud_positions_for_write(PointCloud &pointcloud)
+{
+  CustomData_duplicate_referenced_layer_named(
+      &pointcloud.pdata, CD_PROP_FLOAT3, POINTCLOUD_ATTR_POSITION, pointcloud.totpoint);
+  BKE_pointcloud_update_customdata_pointers(&pointcloud);
+  return {reinterpret_cast<float3 *>(pointcloud.co), pointcloud.totpoint};
+}
+
+MutableSpan<float3> hair_positions_for_write(Hair &hair)
+{
+  CustomData_duplicate_referenced_layer_named(
+      &hair.pdata, CD_PROP_FLOAT3, HAIR_ATTR_POSITION, hair.totpoint);
+  BKE_hair_update_customdata_pointers(&hair);
+  return {reinterpret_cast<float3 *>(hair.co), hair.totpoint};
+}
+
+/** \} */
+
+}  // namespace blender::modifiers::conformal
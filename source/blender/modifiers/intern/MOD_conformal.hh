@@ -0,0 +1,174 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup modifiers
+ *
+ * Vertex kernels shared by the conformal modifiers (Moebius and Sphere Reflect).
+ */
+
+#include "BLI_float3.hh"
+#include "BLI_span.hh"
+
+#include "MOD_conformal_kernels.hh"
+
+struct Hair;
+struct Mesh;
+struct PointCloud;
+
+namespace blender::modifiers::conformal {
+
+/**
+ * Everything the Moebius transformation needs per evaluation, so the per-vertex work is a fixed
+ * sequence of multiply-adds. The origin and localize translations are kept apart from the
+ * matrices so that results match the scalar path bit for bit.
+ */
+struct MoebiusTransform {
+  /** Object to world space. */
+  float object_mat[4][4];
+  /** World to object space. */
+  float object_imat[4][4];
+  /** Rotation of the stereographically lifted points on the unit 3-sphere. */
+  float rotation[4][4];
+  /** World space center of the transformation. */
+  float origin[3];
+  /** Object space offset subtracted from the result, zero unless localized. */
+  float offset[3];
+  float norm_power;
+  /**
+   * Results farther than this from the origin are moved onto the sphere with this radius,
+   * zero to disable. Keeps points close to the pole from ending up at huge coordinates.
+   */
+  float clamp_radius;
+};
+
+/**
+ * Build the 4D rotation of the lifted points from the control object matrix: the product of the
+ * left and right isoclinic rotations of the control object's quaternion.
+ */
+void moebius_rotation_from_matrix(float r_rotation[4][4], const float control_mat[4][4]);
+
+void moebius_transform_init(MoebiusTransform *r_transform,
+                            const float object_mat[4][4],
+                            const float control_mat[4][4],
+                            const float origin[3],
+                            bool localize,
+                            float norm_power);
+
+/**
+ * Scalar transformation of a single point that is already relative to the origin.
+ * This is the reference the batched kernel is validated against.
+ */
+void moebius_transform_co(const float rotation[4][4], float co[3], float norm_power);
+
+/** Transform object space positions in place, multi-threaded. */
+void moebius_transform_positions(const MoebiusTransform &transform, MutableSpan<float3> positions);
+
+/**
+ * The two halves of #moebius_transform_positions. Lifting onto the 3-sphere only depends on the
+ * object matrix, origin and norm, so the lifted points can be cached while the control object
+ * rotates. \a r_lifted stores the four components in consecutive arrays of the size of
+ * \a positions.
+ */
+void moebius_lift_positions(const MoebiusTransform &transform,
+                            Span<float3> positions,
+                            MutableSpan<float> r_lifted);
+void moebius_project_positions(const MoebiusTransform &transform,
+                               Span<float> lifted,
+                               MutableSpan<float3> r_positions);
+
+/**
+ * Object space bounds of the transformed box \a min, \a max, without transforming any points.
+ * Returns false when the result is unbounded, which happens when the box reaches the point that
+ * is sent to infinity and there is no clamp radius. Only the Euclidean norm is supported.
+ */
+bool moebius_transform_bounds(const MoebiusTransform &transform,
+                              const float min[3],
+                              const float max[3],
+                              float r_min[3],
+                              float r_max[3]);
+
+/**
+ * Inversion in a world space sphere, applied to object space positions. This is the conformal
+ * sandwich product with the sphere blade, evaluated with #kernels on positions relative to the
+ * sphere center.
+ */
+struct SphereInversion {
+  /** Object to world space. */
+  float object_mat[4][4];
+  /** World to object space. */
+  float object_imat[4][4];
+  float center[3];
+  float radius_sq;
+  /** Dual vector of the sphere moved to the origin, normalized to `sphere . sphere = 1`. */
+  kernels::Vector<float> sphere;
+  /** Results farther than this from the center are moved onto the sphere, zero to disable. */
+  float clamp_radius;
+};
+
+void sphere_inversion_init(SphereInversion *r_inversion,
+                           const float object_mat[4][4],
+                           const float center[3],
+                           float radius);
+
+/** Invert object space positions in the sphere in place, multi-threaded. */
+void sphere_inversion_positions(const SphereInversion &inversion, MutableSpan<float3> positions);
+
+/** Analytic bounds like #moebius_transform_bounds, unbounded when the box contains the center. */
+bool sphere_inversion_bounds(const SphereInversion &inversion,
+                             const float min[3],
+                             const float max[3],
+                             float r_min[3],
+                             float r_max[3]);
+
+/**
+ * Point positions of evaluated geometry that is changed in place. Referenced position layers are
+ * duplicated first so that the original data stays untouched.
+ */
+MutableSpan<float3> pointcloud_positions_for_write(PointCloud &pointcloud);
+MutableSpan<float3> hair_positions_for_write(Hair &hair);
+
+struct RefineParams {
+  /** World space point the refinement concentrates around. */
+  float center[3];
+  float falloff;
+  /** Cuts per edge and refinement level. */
+  int cuts;
+  /** Maximum refinement level. */
+  int iterations;
+  /** Lower the maximum level until the result has at most this many faces, zero for no limit. */
+  int max_faces;
+};
+
+/**
+ * Subdivide the faces of \a mesh close to the center, more often the closer they are.
+ * Returns null when nothing needs to be refined.
+ */
+Mesh *mesh_adaptive_refine(const Mesh &mesh,
+                           const float object_mat[4][4],
+                           const RefineParams &params);
+
+/* Number of vertices and edges inside of a triangle or quad that is filled with a grid of `n`
+ * segments per side. */
+int64_t grid_inner_verts_num(const int totloop, const int64_t n);
+int64_t grid_inner_edges_num(const int totloop, const int64_t n);
+/* Offset of row `row` in a triangular arrangement whose first row has `first` elements and
+ * every following row one less. */
+int64_t tri_row_offset(const int64_t first, const int64_t row);
+
+}  // namespace blender::modifiers::conformal
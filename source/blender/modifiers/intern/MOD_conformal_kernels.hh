@@ -0,0 +1,133 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup modifiers
+ *
+ * Straight-line versions of the gatl expressions the conformal modifiers are defined with.
+ * The generic expression templates work on sparse multivectors whose layout is only partially
+ * known at compile time. The kernels below fix the blades involved, so every operation becomes a
+ * short sequence of multiply-adds on plain scalars that also works in constant expressions.
+ *
+ * The basis is e1, e2, e3, no, ni with `no . ni = -1`, matching `ga3c`. The results agree with
+ * the corresponding gatl expressions up to rounding, see `MOD_conformal_test.cc`.
+ */
+
+namespace blender::modifiers::conformal::kernels {
+
+/** Grade 1 element: points, dual spheres and dual planes. */
+template<typename T> struct Vector {
+  T e1, e2, e3, no, ni;
+};
+
+/** Grade 4 element: the outer product of four points, a sphere through them. */
+template<typename T> struct Quadvector {
+  T e123o, e123i, e12oi, e13oi, e23oi;
+};
+
+template<typename T> constexpr T abs(const T value)
+{
+  return (value < T(0)) ? -value : value;
+}
+
+template<typename T> constexpr T dot(const Vector<T> &a, const Vector<T> &b)
+{
+  return a.e1 * b.e1 + a.e2 * b.e2 + a.e3 * b.e3 - a.no * b.ni - a.ni * b.no;
+}
+
+/** `ga3c::point(x, y, z)`. */
+template<typename T> constexpr Vector<T> point(const T x, const T y, const T z)
+{
+  return {x, y, z, T(1), (x * x + y * y + z * z) / T(2)};
+}
+
+template<typename T>
+constexpr T det3(T a0, T a1, T a2, T b0, T b1, T b2, T c0, T c1, T c2)
+{
+  return a0 * (b1 * c2 - b2 * c1) - a1 * (b0 * c2 - b2 * c0) + a2 * (b0 * c1 - b1 * c0);
+}
+
+/** Determinant of the 4x4 matrix with the given columns of the four vectors. */
+template<typename T, T Vector<T>::*A, T Vector<T>::*B, T Vector<T>::*C, T Vector<T>::*D>
+constexpr T minor4(const Vector<T> &p1,
+                   const Vector<T> &p2,
+                   const Vector<T> &p3,
+                   const Vector<T> &p4)
+{
+  return p1.*A * det3(p2.*B, p2.*C, p2.*D, p3.*B, p3.*C, p3.*D, p4.*B, p4.*C, p4.*D) -
+         p2.*A * det3(p1.*B, p1.*C, p1.*D, p3.*B, p3.*C, p3.*D, p4.*B, p4.*C, p4.*D) +
+         p3.*A * det3(p1.*B, p1.*C, p1.*D, p2.*B, p2.*C, p2.*D, p4.*B, p4.*C, p4.*D) -
+         p4.*A * det3(p1.*B, p1.*C, p1.*D, p2.*B, p2.*C, p2.*D, p3.*B, p3.*C, p3.*D);
+}
+
+/** `p1 ^ p2 ^ p3 ^ p4`, the sphere through four points. */
+template<typename T>
+constexpr Quadvector<T> sphere_from_points(const Vector<T> &p1,
+                                           const Vector<T> &p2,
+                                           const Vector<T> &p3,
+                                           const Vector<T> &p4)
+{
+  using V = Vector<T>;
+  return {minor4<T, &V::e1, &V::e2, &V::e3, &V::no>(p1, p2, p3, p4),
+          minor4<T, &V::e1, &V::e2, &V::e3, &V::ni>(p1, p2, p3, p4),
+          minor4<T, &V::e1, &V::e2, &V::no, &V::ni>(p1, p2, p3, p4),
+          minor4<T, &V::e1, &V::e3, &V::no, &V::ni>(p1, p2, p3, p4),
+          minor4<T, &V::e2, &V::e3, &V::no, &V::ni>(p1, p2, p3, p4)};
+}
+
+/** `ga3c::dual(sphere)`, the vector orthogonal to all points on the sphere. */
+template<typename T> constexpr Vector<T> dual(const Quadvector<T> &sphere)
+{
+  return {sphere.e23oi, -sphere.e13oi, sphere.e12oi, -sphere.e123o, sphere.e123i};
+}
+
+/** The sandwich `s x s^-1` with a vector, which is the negated reflection of \a x in \a s. */
+template<typename T>
+constexpr Vector<T> apply_vector_versor(const Vector<T> &s, const Vector<T> &x)
+{
+  const T fac = T(2) * dot(x, s) / dot(s, s);
+  return {s.e1 * fac - x.e1,
+          s.e2 * fac - x.e2,
+          s.e3 * fac - x.e3,
+          s.no * fac - x.no,
+          s.ni * fac - x.ni};
+}
+
+/**
+ * `ga3c::apply_even_versor(sphere, x)`. The pseudoscalar commutes with everything in the 5D
+ * algebra, so the sandwich with the quadvector equals the sandwich with its dual vector.
+ */
+template<typename T>
+constexpr Vector<T> apply_even_versor(const Quadvector<T> &sphere, const Vector<T> &x)
+{
+  return apply_vector_versor(dual(sphere), x);
+}
+
+/**
+ * `-x / abs(x | ni)`, scales a flat point to unit weight. The weight is limited to \a eps, which
+ * keeps points that are sent to infinity finite.
+ */
+template<typename T> constexpr Vector<T> normalize_by_ni(const Vector<T> &x, const T eps = T(0))
+{
+  /* `x . ni` only depends on the no component. */
+  const T weight = abs(-x.no);
+  const T fac = T(-1) / ((weight > eps) ? weight : eps);
+  return {x.e1 * fac, x.e2 * fac, x.e3 * fac, x.no * fac, x.ni * fac};
+}
+
+}  // namespace blender::modifiers::conformal::kernels
@@ -0,0 +1,807 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup modifiers
+ *
+ * Adaptive refinement of a mesh around a point, built in a single pass on the mesh arrays.
+ *
+ * Every face gets a refinement level from its distance to the center and edges take the highest
+ * level of their faces. An edge of level `L` is split into `(cuts + 1) ^ L` segments. Triangles
+ * and quads whose edges all share the face level are filled with a regular grid. Faces between
+ * refinement levels, and other faces with split edges, are split into a fan of triangles around
+ * their center, so no face keeps the extra vertices of a more refined neighbor.
+ *
+ * Every face is subdivided uniformly, its level comes from its closest point to the center. There
+ * is no adaptivity inside of a face, large faces close to the center are refined as a whole.
+ */
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_array.hh"
+#include "BLI_math.h"
+#include "BLI_task.hh"
+#include "BLI_vector.hh"
+
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+
+#include "BKE_customdata.h"
+#include "BKE_mesh.h"
+
+#include "MOD_conformal.hh"
+
+namespace blender::modifiers::conformal {
+
+/* -------------------------------------------------------------------- */
+/** \name Classification
+ * \{ */
+
+/**
+ * Number of refinement iterations an element at the given distance would go through:
+ * iteration `i` refines everything closer than `step ^ i / falloff`.
+ */
+static int refine_level_from_distance(const float dist, const RefineParams &params)
+{
+  const float step = 1.0f / (float)(params.cuts + 1);
+  float threshold = 1.0f / params.falloff;
+  int level = 0;
+  while (level < params.iterations && dist < threshold) {
+    threshold *= step;
+    level++;
+  }
+  return level;
+}
+
+/** How the refinement of a face is built. */
+enum class PolyFill {
+  /** Unchanged, none of its edges are split. */
+  Copy,
+  /** Regular grid of quads or triangles. */
+  Grid,
+  /** Triangle fan around a new center vertex. */
+  Fan,
+};
+
+struct RefineClassification {
+  /** Final level of every edge and face. */
+  Array<int> edge_levels;
+  Array<int> poly_levels;
+  /** How every face is refined, from the final levels. */
+  Array<PolyFill> poly_fills;
+  /** Number of segments per level, index by level. */
+  Array<int64_t> segments;
+
+  int64_t edge_segments(const int edge) const
+  {
+    return segments[edge_levels[edge]];
+  }
+};
+
+static void refine_classify(const Mesh &mesh,
+                            const float object_mat[4][4],
+                            const RefineParams &params,
+                            RefineClassification &r_classification)
+{
+  const Span<MVert> verts{mesh.mvert, mesh.totvert};
+  const Span<MEdge> edges{mesh.medge, mesh.totedge};
+  const Span<MPoly> polys{mesh.mpoly, mesh.totpoly};
+  const Span<MLoop> loops{mesh.mloop, mesh.totloop};
+
+  Array<float3> world_positions(verts.size());
+  parallel_for(verts.index_range(), 4096, [&](IndexRange range) {
+    for (const int64_t i : range) {
+      mul_v3_m4v3(world_positions[i], object_mat, verts[i].co);
+    }
+  });
+
+  /* Distance to the closest point of the face, using a fan triangulation. */
+  r_classification.poly_levels.reinitialize(polys.size());
+  MutableSpan<int> poly_levels = r_classification.poly_levels;
+  parallel_for(polys.index_range(), 1024, [&](IndexRange range) {
+    for (const int64_t i : range) {
+      const MPoly &mp = polys[i];
+      const Span<MLoop> poly_loops = loops.slice(mp.loopstart, mp.totloop);
+      const float3 &co_first = world_positions[poly_loops[0].v];
+      float dist_sq = FLT_MAX;
+      for (const int64_t j : IndexRange(1, mp.totloop - 2)) {
+        float closest[3];
+        closest_on_tri_to_point_v3(closest,
+                                   params.center,
+                                   co_first,
+                                   world_positions[poly_loops[j].v],
+                                   world_positions[poly_loops[j + 1].v]);
+        dist_sq = min_ff(dist_sq, len_squared_v3v3(closest, params.center));
+      }
+      poly_levels[i] = refine_level_from_distance(sqrtf(dist_sq), params);
+    }
+  });
+
+  /* Loose edges are never refined. */
+  r_classification.edge_levels.reinitialize(edges.size());
+  MutableSpan<int> edge_levels = r_classification.edge_levels;
+  edge_levels.fill(0);
+  for (const int64_t i : polys.index_range()) {
+    const MPoly &mp = polys[i];
+    for (const MLoop &ml : loops.slice(mp.loopstart, mp.totloop)) {
+      edge_levels[ml.e] = max_ii(edge_levels[ml.e], poly_levels[i]);
+    }
+  }
+
+  r_classification.segments.reinitialize(params.iterations + 1);
+  int64_t segments = 1;
+  for (const int level : IndexRange(params.iterations + 1)) {
+    r_classification.segments[level] = segments;
+    /* Saturate, such counts are rejected by the budget anyway. */
+    segments = std::min<int64_t>(segments * (params.cuts + 1), 1 << 20);
+  }
+}
+
+/**
+ * Fill type of a face with all levels limited to `max_level`.
+ * \param r_boundary_loops: Number of points on the split boundary of the face.
+ */
+static PolyFill refine_poly_fill(const MPoly &mp,
+                                 const Span<MLoop> loops,
+                                 const RefineClassification &classification,
+                                 const int poly_level,
+                                 const int max_level,
+                                 int64_t *r_boundary_loops)
+{
+  const int level = std::min(poly_level, max_level);
+  bool grid = level > 0 && ELEM(mp.totloop, 3, 4);
+  int64_t boundary_loops = 0;
+  for (const MLoop &ml : loops.slice(mp.loopstart, mp.totloop)) {
+    const int edge_level = std::min(classification.edge_levels[ml.e], max_level);
+    grid = grid && edge_level == level;
+    boundary_loops += classification.segments[edge_level];
+  }
+  *r_boundary_loops = boundary_loops;
+  if (grid) {
+    return PolyFill::Grid;
+  }
+  return (boundary_loops > mp.totloop) ? PolyFill::Fan : PolyFill::Copy;
+}
+
+/** Limit all levels to `max_level`. */
+static void refine_clamp(const Mesh &mesh,
+                         const int max_level,
+                         RefineClassification &classification)
+{
+  for (int &level : classification.edge_levels) {
+    level = std::min(level, max_level);
+  }
+  for (int &level : classification.poly_levels) {
+    level = std::min(level, max_level);
+  }
+
+  const Span<MPoly> polys{mesh.mpoly, mesh.totpoly};
+  const Span<MLoop> loops{mesh.mloop, mesh.totloop};
+  classification.poly_fills.reinitialize(polys.size());
+  parallel_for(polys.index_range(), 1024, [&](IndexRange range) {
+    for (const int64_t i : range) {
+      int64_t boundary_loops;
+      const int poly_level = classification.poly_levels[i];
+      classification.poly_fills[i] = refine_poly_fill(
+          polys[i], loops, classification, poly_level, max_level, &boundary_loops);
+    }
+  });
+}
+
+/**
+ * Count the faces and loops the refined mesh would have with all levels limited to
+ * `max_level`, stops counting as soon as one exceeds its limit.
+ */
+static bool refine_fits_budget(const Mesh &mesh,
+                               const RefineClassification &classification,
+                               const int max_level,
+                               const int64_t max_faces)
+{
+  const Span<MPoly> polys{mesh.mpoly, mesh.totpoly};
+  const Span<MLoop> loops{mesh.mloop, mesh.totloop};
+  int64_t faces_num = 0;
+  int64_t loops_num = 0;
+  for (const int64_t i : polys.index_range()) {
+    const MPoly &mp = polys[i];
+    const int poly_level = classification.poly_levels[i];
+    int64_t boundary_loops;
+    switch (refine_poly_fill(mp, loops, classification, poly_level, max_level, &boundary_loops)) {
+      case PolyFill::Grid: {
+        const int64_t n = classification.segments[std::min(poly_level, max_level)];
+        faces_num += n * n;
+        loops_num += n * n * mp.totloop;
+        break;
+      }
+      case PolyFill::Fan:
+        faces_num += boundary_loops;
+        loops_num += boundary_loops * 3;
+        break;
+      case PolyFill::Copy:
+        faces_num += 1;
+        loops_num += mp.totloop;
+        break;
+    }
+    if (faces_num > max_faces || loops_num > INT_MAX) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Mesh Construction
+ * \{ */
+
+int64_t grid_inner_verts_num(const int totloop, const int64_t n)
+{
+  return (totloop == 4) ? (n - 1) * (n - 1) : (n - 1) * (n - 2) / 2;
+}
+
+int64_t grid_inner_edges_num(const int totloop, const int64_t n)
+{
+  return (totloop == 4) ? 2 * n * (n - 1) : 3 * n * (n - 1) / 2;
+}
+
+int64_t tri_row_offset(const int64_t first, const int64_t row)
+{
+  return row * first - row * (row - 1) / 2;
+}
+
+struct RefineBuilder {
+  const Mesh &src;
+  const RefineClassification &classification;
+  Mesh *dst = nullptr;
+
+  RefineBuilder(const Mesh &src, const RefineClassification &classification)
+      : src(src), classification(classification)
+  {
+  }
+
+  int dst_verts_num = 0;
+  int dst_edges_num = 0;
+  int dst_polys_num = 0;
+  int dst_loops_num = 0;
+
+  /** Index of the first new vertex and edge inserted on every source edge. */
+  Array<int> edge_vert_offsets;
+  Array<int> edge_edge_offsets;
+  /** Index of the first new element inside of every source face. */
+  Array<int> poly_vert_offsets;
+  Array<int> poly_edge_offsets;
+  Array<int> poly_poly_offsets;
+  Array<int> poly_loop_offsets;
+
+  /** Vertex at point `k` of the split edge, counting from vertex `v`. */
+  int edge_point(const int edge, const int v, int64_t k) const
+  {
+    const MEdge &me = src.medge[edge];
+    const int64_t segments = classification.edge_segments(edge);
+    if ((int)me.v1 != v) {
+      k = segments - k;
+    }
+    if (k == 0) {
+      return me.v1;
+    }
+    if (k == segments) {
+      return me.v2;
+    }
+    return edge_vert_offsets[edge] + (int)k - 1;
+  }
+
+  /** Edge of segment `k` of the split edge, counting from vertex `v`. */
+  int edge_segment(const int edge, const int v, int64_t k) const
+  {
+    if ((int)src.medge[edge].v1 != v) {
+      k = classification.edge_segments(edge) - 1 - k;
+    }
+    return edge_edge_offsets[edge] + (int)k;
+  }
+
+  void init_offsets()
+  {
+    const Span<MPoly> polys{src.mpoly, src.totpoly};
+    edge_vert_offsets.reinitialize(src.totedge);
+    edge_edge_offsets.reinitialize(src.totedge);
+    poly_vert_offsets.reinitialize(src.totpoly);
+    poly_edge_offsets.reinitialize(src.totpoly);
+    poly_poly_offsets.reinitialize(src.totpoly);
+    poly_loop_offsets.reinitialize(src.totpoly);
+
+    int verts_num = src.totvert;
+    int edges_num = 0;
+    for (const int i : IndexRange(src.totedge)) {
+      const int segments = (int)classification.edge_segments(i);
+      edge_vert_offsets[i] = verts_num;
+      edge_edge_offsets[i] = edges_num;
+      verts_num += segments - 1;
+      edges_num += segments;
+    }
+
+    int polys_num = 0;
+    int loops_num = 0;
+    for (const int i : polys.index_range()) {
+      const MPoly &mp = polys[i];
+      poly_vert_offsets[i] = verts_num;
+      poly_edge_offsets[i] = edges_num;
+      poly_poly_offsets[i] = polys_num;
+      poly_loop_offsets[i] = loops_num;
+      switch (classification.poly_fills[i]) {
+        case PolyFill::Grid: {
+          const int64_t n = classification.segments[classification.poly_levels[i]];
+          verts_num += (int)grid_inner_verts_num(mp.totloop, n);
+          edges_num += (int)grid_inner_edges_num(mp.totloop, n);
+          polys_num += (int)(n * n);
+          loops_num += (int)(n * n * mp.totloop);
+          break;
+        }
+        case PolyFill::Fan: {
+          int boundary_loops = 0;
+          for (const int j : IndexRange(mp.loopstart, mp.totloop)) {
+            boundary_loops += (int)classification.edge_segments(src.mloop[j].e);
+          }
+          verts_num += 1;
+          edges_num += boundary_loops;
+          polys_num += boundary_loops;
+          loops_num += boundary_loops * 3;
+          break;
+        }
+        case PolyFill::Copy:
+          polys_num += 1;
+          loops_num += mp.totloop;
+          break;
+      }
+    }
+    dst_verts_num = verts_num;
+    dst_edges_num = edges_num;
+    dst_polys_num = polys_num;
+    dst_loops_num = loops_num;
+  }
+
+  void set_interp_vert(const int dst_index, const int *src_verts, const float *weights, int count)
+  {
+    CustomData_interp(&src.vdata, &dst->vdata, src_verts, weights, NULL, count, dst_index);
+    MVert &mv = dst->mvert[dst_index];
+    zero_v3(mv.co);
+    for (int i = 0; i < count; i++) {
+      madd_v3_v3fl(mv.co, src.mvert[src_verts[i]].co, weights[i]);
+    }
+    mv.flag = 0;
+    mv.bweight = 0;
+  }
+
+  void set_inner_edge(const int dst_index, const int v1, const int v2)
+  {
+    MEdge &me = dst->medge[dst_index];
+    me.v1 = v1;
+    me.v2 = v2;
+    me.flag = ME_EDGEDRAW | ME_EDGERENDER;
+  }
+
+  void set_loop(const int dst_index,
+                const MPoly &mp,
+                const float *weights,
+                const int v,
+                const int e)
+  {
+    int src_loops[4];
+    for (int i = 0; i < mp.totloop; i++) {
+      src_loops[i] = mp.loopstart + i;
+    }
+    CustomData_interp(&src.ldata, &dst->ldata, src_loops, weights, NULL, mp.totloop, dst_index);
+    dst->mloop[dst_index].v = v;
+    dst->mloop[dst_index].e = e;
+  }
+
+  void build_edge(const int edge)
+  {
+    const MEdge &me = src.medge[edge];
+    const int64_t segments = classification.edge_segments(edge);
+    const int src_verts[2] = {(int)me.v1, (int)me.v2};
+    for (const int64_t k : IndexRange(1, segments - 1)) {
+      const float t = (float)k / (float)segments;
+      const float weights[2] = {1.0f - t, t};
+      set_interp_vert(edge_vert_offsets[edge] + (int)k - 1, src_verts, weights, 2);
+    }
+    for (const int64_t k : IndexRange(segments)) {
+      const int dst_index = edge_edge_offsets[edge] + (int)k;
+      CustomData_copy_data(&src.edata, &dst->edata, edge, dst_index, 1);
+      MEdge &me_dst = dst->medge[dst_index];
+      me_dst.v1 = edge_point(edge, me.v1, k);
+      me_dst.v2 = edge_point(edge, me.v1, k + 1);
+    }
+  }
+
+  void build_poly_boundary(const int poly)
+  {
+    const MPoly &mp = src.mpoly[poly];
+    const int loopstart = poly_loop_offsets[poly];
+    int loop = loopstart;
+    for (const int i : IndexRange(mp.totloop)) {
+      const MLoop &ml = src.mloop[mp.loopstart + i];
+      const int64_t segments = classification.edge_segments(ml.e);
+      const int src_loops[2] = {mp.loopstart + i, mp.loopstart + (i + 1) % mp.totloop};
+      for (const int64_t k : IndexRange(segments)) {
+        const float t = (float)k / (float)segments;
+        const float weights[2] = {1.0f - t, t};
+        CustomData_interp(&src.ldata, &dst->ldata, src_loops, weights, NULL, 2, loop);
+        dst->mloop[loop].v = edge_point(ml.e, ml.v, k);
+        dst->mloop[loop].e = edge_segment(ml.e, ml.v, k);
+        loop++;
+      }
+    }
+
+    const int dst_index = poly_poly_offsets[poly];
+    CustomData_copy_data(&src.pdata, &dst->pdata, poly, dst_index, 1);
+    dst->mpoly[dst_index].loopstart = loopstart;
+    dst->mpoly[dst_index].totloop = loop - loopstart;
+  }
+
+  /** Triangles from every pair of neighboring boundary points to a new vertex at the center. */
+  void build_poly_fan(const int poly)
+  {
+    const MPoly &mp = src.mpoly[poly];
+    const int center = poly_vert_offsets[poly];
+    const int inner_edges = poly_edge_offsets[poly];
+
+    /* The center vertex and its loops are the average of the face. */
+    Array<int, 16> src_verts(mp.totloop);
+    Array<int, 16> src_loops(mp.totloop);
+    Array<float, 16> center_weights(mp.totloop, 1.0f / (float)mp.totloop);
+    for (const int i : IndexRange(mp.totloop)) {
+      src_verts[i] = src.mloop[mp.loopstart + i].v;
+      src_loops[i] = mp.loopstart + i;
+    }
+    set_interp_vert(center, src_verts.data(), center_weights.data(), mp.totloop);
+
+    struct BoundaryPoint {
+      int v;
+      /* Boundary edge to the next point. */
+      int e;
+      /* Source loops and factor to interpolate loop data. */
+      int src_loops[2];
+      float t;
+    };
+    Vector<BoundaryPoint, 16> boundary;
+    for (const int i : IndexRange(mp.totloop)) {
+      const MLoop &ml = src.mloop[mp.loopstart + i];
+      const int64_t segments = classification.edge_segments(ml.e);
+      for (const int64_t k : IndexRange(segments)) {
+        boundary.append({edge_point(ml.e, ml.v, k),
+                         edge_segment(ml.e, ml.v, k),
+                         {mp.loopstart + i, mp.loopstart + (i + 1) % mp.totloop},
+                         (float)k / (float)segments});
+      }
+    }
+    const int boundary_num = (int)boundary.size();
+
+    for (const int k : boundary.index_range()) {
+      set_inner_edge(inner_edges + k, center, boundary[k].v);
+    }
+
+    auto set_boundary_loop = [&](const int dst_index, const BoundaryPoint &point, const int e) {
+      const float weights[2] = {1.0f - point.t, point.t};
+      CustomData_interp(&src.ldata, &dst->ldata, point.src_loops, weights, NULL, 2, dst_index);
+      dst->mloop[dst_index].v = point.v;
+      dst->mloop[dst_index].e = e;
+    };
+
+    int dst_poly = poly_poly_offsets[poly];
+    int loop = poly_loop_offsets[poly];
+    for (const int k : boundary.index_range()) {
+      const int k_next = (k + 1) % boundary_num;
+      CustomData_copy_data(&src.pdata, &dst->pdata, poly, dst_poly, 1);
+      dst->mpoly[dst_poly].loopstart = loop;
+      dst->mpoly[dst_poly].totloop = 3;
+      dst_poly++;
+
+      set_boundary_loop(loop++, boundary[k], boundary[k].e);
+      set_boundary_loop(loop++, boundary[k_next], inner_edges + k_next);
+      CustomData_interp(&src.ldata,
+                        &dst->ldata,
+                        src_loops.data(),
+                        center_weights.data(),
+                        NULL,
+                        mp.totloop,
+                        loop);
+      dst->mloop[loop].v = center;
+      dst->mloop[loop].e = inner_edges + k;
+      loop++;
+    }
+  }
+
+  void build_poly_quad(const int poly)
+  {
+    const MPoly &mp = src.mpoly[poly];
+    const MLoop *ml = &src.mloop[mp.loopstart];
+    const int c0 = ml[0].v, c1 = ml[1].v, c2 = ml[2].v, c3 = ml[3].v;
+    const int e0 = ml[0].e, e1 = ml[1].e, e2 = ml[2].e, e3 = ml[3].e;
+    const int64_t n = classification.segments[classification.poly_levels[poly]];
+    const int inner_verts = poly_vert_offsets[poly];
+    const int inner_edges = poly_edge_offsets[poly];
+    const int src_verts[4] = {c0, c1, c2, c3};
+
+    /* Grid point `a` along `c0 -> c1` and `b` along `c0 -> c3`. */
+    auto point = [&](const int64_t a, const int64_t b) -> int {
+      if (b == 0) {
+        return edge_point(e0, c0, a);
+      }
+      if (a == n) {
+        return edge_point(e1, c1, b);
+      }
+      if (b == n) {
+        return edge_point(e2, c3, a);
+      }
+      if (a == 0) {
+        return edge_point(e3, c0, b);
+      }
+      return inner_verts + (int)((b - 1) * (n - 1) + (a - 1));
+    };
+    /* Edge from `(a, b)` to `(a + 1, b)`. */
+    auto edge_u = [&](const int64_t a, const int64_t b) -> int {
+      if (b == 0) {
+        return edge_segment(e0, c0, a);
+      }
+      if (b == n) {
+        return edge_segment(e2, c3, a);
+      }
+      return inner_edges + (int)((b - 1) * n + a);
+    };
+    /* Edge from `(a, b)` to `(a, b + 1)`. */
+    auto edge_v = [&](const int64_t a, const int64_t b) -> int {
+      if (a == 0) {
+        return edge_segment(e3, c0, b);
+      }
+      if (a == n) {
+        return edge_segment(e1, c1, b);
+      }
+      return inner_edges + (int)(n * (n - 1) + (a - 1) * n + b);
+    };
+    auto bilinear = [&](const int64_t a, const int64_t b, float r_weights[4]) {
+      const float u = (float)a / (float)n;
+      const float v = (float)b / (float)n;
+      r_weights[0] = (1.0f - u) * (1.0f - v);
+      r_weights[1] = u * (1.0f - v);
+      r_weights[2] = u * v;
+      r_weights[3] = (1.0f - u) * v;
+    };
+
+    float weights[4];
+    for (const int64_t b : IndexRange(1, n - 1)) {
+      for (const int64_t a : IndexRange(1, n - 1)) {
+        bilinear(a, b, weights);
+        set_interp_vert(point(a, b), src_verts, weights, 4);
+      }
+    }
+    for (const int64_t b : IndexRange(1, n - 1)) {
+      for (const int64_t a : IndexRange(n)) {
+        set_inner_edge(edge_u(a, b), point(a, b), point(a + 1, b));
+      }
+    }
+    for (const int64_t a : IndexRange(1, n - 1)) {
+      for (const int64_t b : IndexRange(n)) {
+        set_inner_edge(edge_v(a, b), point(a, b), point(a, b + 1));
+      }
+    }
+
+    int dst_poly = poly_poly_offsets[poly];
+    int loop = poly_loop_offsets[poly];
+    for (const int64_t b : IndexRange(n)) {
+      for (const int64_t a : IndexRange(n)) {
+        CustomData_copy_data(&src.pdata, &dst->pdata, poly, dst_poly, 1);
+        dst->mpoly[dst_poly].loopstart = loop;
+        dst->mpoly[dst_poly].totloop = 4;
+        dst_poly++;
+
+        bilinear(a, b, weights);
+        set_loop(loop++, mp, weights, point(a, b), edge_u(a, b));
+        bilinear(a + 1, b, weights);
+        set_loop(loop++, mp, weights, point(a + 1, b), edge_v(a + 1, b));
+        bilinear(a + 1, b + 1, weights);
+        set_loop(loop++, mp, weights, point(a + 1, b + 1), edge_u(a, b + 1));
+        bilinear(a, b + 1, weights);
+        set_loop(loop++, mp, weights, point(a, b + 1), edge_v(a, b));
+      }
+    }
+  }
+
+  void build_poly_tri(const int poly)
+  {
+    const MPoly &mp = src.mpoly[poly];
+    const MLoop *ml = &src.mloop[mp.loopstart];
+    const int c0 = ml[0].v, c1 = ml[1].v;
+    const int e0 = ml[0].e, e1 = ml[1].e, e2 = ml[2].e;
+    const int64_t n = classification.segments[classification.poly_levels[poly]];
+    const int inner_verts = poly_vert_offsets[poly];
+    const int inner_edges = poly_edge_offsets[poly];
+    const int src_verts[3] = {(int)ml[0].v, (int)ml[1].v, (int)ml[2].v};
+    const int64_t edges_per_direction = n * (n - 1) / 2;
+
+    /* Lattice point `i` along `c0 -> c1` and `j` along `c0 -> c2`. */
+    auto point = [&](const int64_t i, const int64_t j) -> int {
+      if (j == 0) {
+        return edge_point(e0, c0, i);
+      }
+      if (i + j == n) {
+        return edge_point(e1, c1, j);
+      }
+      if (i == 0) {
+        return edge_point(e2, c0, j);
+      }
+      return inner_verts + (int)(tri_row_offset(n - 2, j - 1) + (i - 1));
+    };
+    /* Edge from `(i, j)` to `(i + 1, j)`. */
+    auto edge_a = [&](const int64_t i, const int64_t j) -> int {
+      if (j == 0) {
+        return edge_segment(e0, c0, i);
+      }
+      return inner_edges + (int)(tri_row_offset(n - 1, j - 1) + i);
+    };
+    /* Edge from `(i, j)` to `(i, j + 1)`. */
+    auto edge_b = [&](const int64_t i, const int64_t j) -> int {
+      if (i == 0) {
+        return edge_segment(e2, c0, j);
+      }
+      return inner_edges + (int)(edges_per_direction + tri_row_offset(n - 1, i - 1) + j);
+    };
+    /* Edge from `(i + 1, j)` to `(i, j + 1)`. */
+    auto edge_c = [&](const int64_t i, const int64_t j) -> int {
+      if (i + j == n - 1) {
+        return edge_segment(e1, c1, j);
+      }
+      return inner_edges + (int)(2 * edges_per_direction + tri_row_offset(n - 1, j) + i);
+    };
+    auto barycentric = [&](const int64_t i, const int64_t j, float r_weights[3]) {
+      r_weights[1] = (float)i / (float)n;
+      r_weights[2] = (float)j / (float)n;
+      r_weights[0] = 1.0f - r_weights[1] - r_weights[2];
+    };
+
+    float weights[3];
+    for (const int64_t j : IndexRange(1, n - 1)) {
+      for (int64_t i = 1; i + j < n; i++) {
+        barycentric(i, j, weights);
+        set_interp_vert(point(i, j), src_verts, weights, 3);
+      }
+    }
+    for (const int64_t j : IndexRange(n)) {
+      for (int64_t i = 0; i + j < n; i++) {
+        if (j > 0) {
+          set_inner_edge(edge_a(i, j), point(i, j), point(i + 1, j));
+        }
+        if (i > 0) {
+          set_inner_edge(edge_b(i, j), point(i, j), point(i, j + 1));
+        }
+        if (i + j < n - 1) {
+          set_inner_edge(edge_c(i, j), point(i + 1, j), point(i, j + 1));
+        }
+      }
+    }
+
+    int dst_poly = poly_poly_offsets[poly];
+    int loop = poly_loop_offsets[poly];
+    auto add_tri = [&](const int64_t i0,
+                       const int64_t j0,
+                       const int64_t i1,
+                       const int64_t j1,
+                       const int64_t i2,
+                       const int64_t j2,
+                       const int e01,
+                       const int e12,
+                       const int e20) {
+      CustomData_copy_data(&src.pdata, &dst->pdata, poly, dst_poly, 1);
+      dst->mpoly[dst_poly].loopstart = loop;
+      dst->mpoly[dst_poly].totloop = 3;
+      dst_poly++;
+
+      barycentric(i0, j0, weights);
+      set_loop(loop++, mp, weights, point(i0, j0), e01);
+      barycentric(i1, j1, weights);
+      set_loop(loop++, mp, weights, point(i1, j1), e12);
+      barycentric(i2, j2, weights);
+      set_loop(loop++, mp, weights, point(i2, j2), e20);
+    };
+    for (const int64_t j : IndexRange(n)) {
+      for (int64_t i = 0; i + j < n; i++) {
+        add_tri(i, j, i + 1, j, i, j + 1, edge_a(i, j), edge_c(i, j), edge_b(i, j));
+        if (i + j < n - 1) {
+          add_tri(i + 1,
+                  j,
+                  i + 1,
+                  j + 1,
+                  i,
+                  j + 1,
+                  edge_b(i + 1, j),
+                  edge_a(i, j + 1),
+                  edge_c(i, j));
+        }
+      }
+    }
+  }
+};
+
+Mesh *mesh_adaptive_refine(const Mesh &mesh,
+                           const float object_mat[4][4],
+                           const RefineParams &params)
+{
+  RefineClassification classification;
+  refine_classify(mesh, object_mat, params, classification);
+
+  /* Lower the maximum level until the result fits the budget. */
+  const int64_t max_faces = (params.max_faces > 0) ? params.max_faces : INT_MAX;
+  int max_level = params.iterations;
+  while (max_level > 0 && !refine_fits_budget(mesh, classification, max_level, max_faces)) {
+    max_level--;
+  }
+  refine_clamp(mesh, max_level, classification);
+
+  bool refined = false;
+  for (const int level : classification.edge_levels) {
+    refined |= level > 0;
+  }
+  if (!refined) {
+    return NULL;
+  }
+
+  RefineBuilder builder(mesh, classification);
+  builder.init_offsets();
+  Mesh *result = BKE_mesh_new_nomain_from_template(&mesh,
+                                                   builder.dst_verts_num,
+                                                   builder.dst_edges_num,
+                                                   0,
+                                                   builder.dst_loops_num,
+                                                   builder.dst_polys_num);
+  builder.dst = result;
+
+  /* Original vertices keep their indices. */
+  CustomData_copy_data(&mesh.vdata, &result->vdata, 0, 0, mesh.totvert);
+
+  parallel_for(IndexRange(mesh.totedge), 512, [&](IndexRange range) {
+    for (const int64_t i : range) {
+      builder.build_edge((int)i);
+    }
+  });
+  parallel_for(IndexRange(mesh.totpoly), 64, [&](IndexRange range) {
+    for (const int64_t i : range) {
+      switch (classification.poly_fills[i]) {
+        case PolyFill::Copy:
+          builder.build_poly_boundary((int)i);
+          break;
+        case PolyFill::Fan:
+          builder.build_poly_fan((int)i);
+          break;
+        case PolyFill::Grid:
+          if (mesh.mpoly[i].totloop == 4) {
+            builder.build_poly_quad((int)i);
+          }
+          else {
+            builder.build_poly_tri((int)i);
+          }
+          break;
+      }
+    }
+  });
+
+  /* Tag to recalculate normals later. */
+  result->runtime.cd_dirty_vert |= CD_MASK_NORMAL;
+
+  return result;
+}
+
+/** \} */
+
+}  // namespace blender::modifiers::conformal
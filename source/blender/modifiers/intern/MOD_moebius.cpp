@@ -2,14 +2,17 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "BLI_hash_mm2a.h"
 #include "BLI_math.h"
 #include "BLI_utildefines.h"
 #include "BLT_translation.h"
 
 #include "DNA_defaults.h"
+#include "DNA_hair_types.h"
 #include "DNA_mesh_types.h"
 #include "DNA_meshdata_types.h"
 #include "DNA_object_types.h"
+#include "DNA_pointcloud_types.h"
 #include "DNA_screen_types.h"
 
 #include "BKE_context.h"
@@ -27,99 +30,125 @@
 #include "bmesh.h"
 #include "bmesh_tools.h"
 
+#include "MOD_conformal.hh"
 #include "MOD_modifiertypes.h"
 #include "MOD_ui_common.h"
 #include "MOD_util.h"
 
-static void calc_moebius_transform(float hRot[4][4], float co[3], float p)
-{
-  float norm;
-  float h[4];
-  float radius;
-  int i;
-  float eps;
-  eps = 0.0000000000000001;
+using namespace blender;
+using namespace blender::modifiers::conformal;
 
-  radius = 1.0f;
+/* Points lifted onto the 3-sphere by the last evaluation, stored in #ModifierData.runtime.
+ * While only the control object rotates, the lift is reused and just projected again. */
+typedef struct MoebiusRuntimeData {
+  /* Hash of the inputs the lift depends on, see #moebius_lift_hash. */
+  uint lift_hash;
+  int verts_num;
+  /* Bounds of the input positions, for #moebius_transform_bounds. */
+  float input_min[3];
+  float input_max[3];
 
-  mul_v3_fl(co, 1.0f / radius);
-  norm = pow(co[0], p) + pow(co[1], p) + pow(co[2], p);
+  /* Four arrays of `verts_num` floats, see #moebius_lift_positions. */
+  float *lifted;
+} MoebiusRuntimeData;
 
-  mul_v3_v3fl(h, co, 2);
+static void freeRuntimeData(void *runtime_data_v)
+{
+  if (runtime_data_v == NULL) {
+    return;
+  }
+  MoebiusRuntimeData *runtime_data = (MoebiusRuntimeData *)runtime_data_v;
+  MEM_SAFE_FREE(runtime_data->lifted);
+  MEM_freeN(runtime_data);
+}
 
-  h[3] = norm - 1.0f;
+static MoebiusRuntimeData *moebius_ensure_runtime(MoebiusModifierData *mmd)
+{
+  MoebiusRuntimeData *runtime_data = (MoebiusRuntimeData *)mmd->modifier.runtime;
+  if (runtime_data == NULL) {
+    runtime_data = (MoebiusRuntimeData *)MEM_callocN(sizeof(*runtime_data), "moebius runtime");
+    mmd->modifier.runtime = runtime_data;
+  }
+  return runtime_data;
+}
 
-  mul_v4_fl(h, 1.0f / max_ff(1.0f + norm, eps));
-  mul_m4_v4(hRot, h);
-  copy_v3_v3(co, h);
-  mul_v3_fl(co, radius / max_ff(1.0f - h[3], eps));
+/* The lift depends on the object matrix, the origin, the norm power and the input positions, but
+ * not on the control object rotation. Hashing the positions avoids keeping a copy of them. */
+static uint moebius_lift_hash(const MoebiusTransform &transform,
+                              const float (*vertexCos)[3],
+                              const int numVerts)
+{
+  BLI_HashMurmur2A mm2;
+  BLI_hash_mm2a_init(&mm2, 0);
+  BLI_hash_mm2a_add(&mm2, (const uchar *)transform.object_mat, sizeof(float[4][4]));
+  BLI_hash_mm2a_add(&mm2, (const uchar *)transform.origin, sizeof(float[3]));
+  BLI_hash_mm2a_add(&mm2, (const uchar *)&transform.norm_power, sizeof(float));
+  BLI_hash_mm2a_add(&mm2, (const uchar *)vertexCos, sizeof(float[3]) * (size_t)numVerts);
+  return BLI_hash_mm2a_end(&mm2);
 }
 
-static void moebius_transform_verts(Object *control,
-                                    Object *originObject,
-                                    Object *target,
-                                    float (*vertexCos)[3],
-                                    int numVerts,
-                                    bool relocalize,
-                                    float norm_power)
+static void moebius_runtime_update(MoebiusRuntimeData *runtime_data,
+                                   const MoebiusTransform &transform,
+                                   const float (*vertexCos)[3],
+                                   const int numVerts,
+                                   const uint lift_hash)
 {
-  float imat[4];
-  float leftQ[4];
-  float rightQ[4];
-  float hRot[4][4];
-  float leftMat[4][4];
-  float rightMat[4][4];
-
-  float origin[3];
-  float transformedTargetPosition[3];
-  int a;
-
-  invert_m4_m4(target->imat, target->obmat);
-
-  mat4_to_quat(leftQ, control->obmat);
-  mat4_to_quat(rightQ, control->obmat);
-
-  leftMat[0][0] = leftMat[1][1] = leftMat[2][2] = leftMat[3][3] = leftQ[0];
-  leftMat[0][1] = leftMat[2][3] = -leftQ[1];
-  leftMat[0][2] = leftMat[3][1] = -leftQ[2];
-  leftMat[0][3] = leftMat[1][2] = -leftQ[3];
-  leftMat[2][1] = leftMat[3][0] = leftQ[3];
-  leftMat[1][3] = leftMat[2][0] = leftQ[2];
-  leftMat[1][0] = leftMat[3][2] = leftQ[1];
-
-  rightMat[0][0] = rightMat[1][1] = rightMat[2][2] = rightMat[3][3] = rightQ[0];
-  rightMat[0][1] = rightMat[3][2] = -rightQ[1];
-  rightMat[0][2] = rightMat[1][3] = -rightQ[2];
-  rightMat[0][3] = rightMat[2][1] = -rightQ[3];
-  rightMat[1][2] = rightMat[3][0] = rightQ[3];
-  rightMat[3][1] = rightMat[2][0] = rightQ[2];
-  rightMat[1][0] = rightMat[2][3] = rightQ[1];
-
-  mul_m4_m4m4(hRot, rightMat, leftMat);
-
-  if (relocalize) {
-    zero_v3(transformedTargetPosition);
-    calc_moebius_transform(hRot, transformedTargetPosition, norm_power);
+  if (runtime_data->lifted == NULL || runtime_data->verts_num != numVerts) {
+    MEM_SAFE_FREE(runtime_data->lifted);
+    runtime_data->lifted = (float *)MEM_malloc_arrayN(
+        (size_t)numVerts * 4, sizeof(float), __func__);
+    runtime_data->verts_num = numVerts;
   }
+  runtime_data->lift_hash = lift_hash;
 
-  if (originObject != NULL) {
-    copy_v3_v3(origin, originObject->obmat[3]);
+  INIT_MINMAX(runtime_data->input_min, runtime_data->input_max);
+  for (int i = 0; i < numVerts; i++) {
+    minmax_v3v3_v3(runtime_data->input_min, runtime_data->input_max, vertexCos[i]);
   }
-  else {
-    copy_v3_v3(origin, control->obmat[3]);
-  }
-  for (a = 0; a < numVerts; a++) {
-    mul_m4_v3(target->obmat, vertexCos[a]);
-    sub_v3_v3(vertexCos[a], origin);
 
-    calc_moebius_transform(hRot, vertexCos[a], norm_power);
+  moebius_lift_positions(transform,
+                         {reinterpret_cast<const float3 *>(vertexCos), numVerts},
+                         {runtime_data->lifted, (int64_t)numVerts * 4});
+}
 
-    add_v3_v3(vertexCos[a], origin);
-    mul_m4_v3(target->imat, vertexCos[a]);
+static void moebius_transform_init_from_modifier(MoebiusTransform *r_transform,
+                                                 const MoebiusModifierData *mmd,
+                                                 const Object *target)
+{
+  const Object *control = mmd->control;
+  const float *origin = (mmd->origin != NULL) ? mmd->origin->obmat[3] : control->obmat[3];
+  const bool relocalize = mmd->flags & eMoebiusModifierFlag_localize;
+
+  moebius_transform_init(
+      r_transform, target->obmat, control->obmat, origin, relocalize, mmd->norm_power);
+  r_transform->clamp_radius = mmd->clamp_radius;
+}
 
-    if (relocalize) {
-      sub_v3_v3(vertexCos[a], transformedTargetPosition);
-    }
+static void moebius_transform_verts(MoebiusModifierData *mmd,
+                                    const ModifierEvalContext *ctx,
+                                    float (*vertexCos)[3],
+                                    int numVerts)
+{
+  MoebiusTransform transform;
+  moebius_transform_init_from_modifier(&transform, mmd, ctx->object);
+
+  MoebiusRuntimeData *runtime_data = moebius_ensure_runtime(mmd);
+  const uint lift_hash = moebius_lift_hash(transform, vertexCos, numVerts);
+  if (runtime_data->lifted == NULL || runtime_data->verts_num != numVerts ||
+      runtime_data->lift_hash != lift_hash) {
+    moebius_runtime_update(runtime_data, transform, vertexCos, numVerts, lift_hash);
+  }
+
+  moebius_project_positions(transform,
+                            {runtime_data->lifted, (int64_t)numVerts * 4},
+                            {reinterpret_cast<float3 *>(vertexCos), numVerts});
+
+  /* While only the control object moves, the bounds don't need a pass over the vertices. */
+  float min[3], max[3];
+  if (numVerts > 0 &&
+      moebius_transform_bounds(
+          transform, runtime_data->input_min, runtime_data->input_max, min, max)) {
+    BKE_modifier_bounds_set(ctx, min, max);
   }
 }
 
@@ -130,13 +159,7 @@ static void deformVerts(ModifierData *md,
                         int numVerts)
 {
   MoebiusModifierData *mmd = (MoebiusModifierData *)md;
-  moebius_transform_verts(mmd->control,
-                          mmd->origin,
-                          ctx->object,
-                          vertexCos,
-                          numVerts,
-                          mmd->flags & eMoebiusModifierFlag_localize,
-                          mmd->norm_power);
+  moebius_transform_verts(mmd, ctx, vertexCos, numVerts);
 }
 
 static void deformVertsEM(ModifierData *md,
@@ -147,13 +170,29 @@ static void deformVertsEM(ModifierData *md,
                           int numVerts)
 {
   MoebiusModifierData *mmd = (MoebiusModifierData *)md;
-  moebius_transform_verts(mmd->control,
-                          mmd->origin,
-                          ctx->object,
-                          vertexCos,
-                          numVerts,
-                          mmd->flags & eMoebiusModifierFlag_localize,
-                          mmd->norm_power);
+  moebius_transform_verts(mmd, ctx, vertexCos, numVerts);
+}
+
+/* Point clouds and hair are transformed in place without the lift cache, which would hold two
+ * more copies of the positions for datasets that are usually much larger than meshes. */
+static PointCloud *modifyPointCloud(ModifierData *md,
+                                    const ModifierEvalContext *ctx,
+                                    PointCloud *pointcloud)
+{
+  MoebiusModifierData *mmd = (MoebiusModifierData *)md;
+  MoebiusTransform transform;
+  moebius_transform_init_from_modifier(&transform, mmd, ctx->object);
+  moebius_transform_positions(transform, pointcloud_positions_for_write(*pointcloud));
+  return pointcloud;
+}
+
+static Hair *modifyHair(ModifierData *md, const ModifierEvalContext *ctx, Hair *hair)
+{
+  MoebiusModifierData *mmd = (MoebiusModifierData *)md;
+  MoebiusTransform transform;
+  moebius_transform_init_from_modifier(&transform, mmd, ctx->object);
+  moebius_transform_positions(transform, hair_positions_for_write(*hair));
+  return hair;
 }
 
 /* Moebius Transform */
@@ -214,6 +253,7 @@ static void panel_draw(const bContext *UNUSED(C), Panel *panel)
   uiItemR(layout, ptr, "origin", 0, NULL, ICON_NONE);
   uiItemR(layout, ptr, "localize", 0, NULL, ICON_NONE);
   uiItemR(layout, ptr, "norm_power", 0, NULL, ICON_NONE);
+  uiItemR(layout, ptr, "clamp_radius", 0, NULL, ICON_NONE);
 
   modifier_panel_end(layout, ptr);
 }
@@ -240,8 +280,8 @@ ModifierTypeInfo modifierType_Moebius = {
     /* deformVertsEM */ deformVertsEM,
     /* deformMatricesEM */ NULL,
     /* modifyMesh */ NULL,
-    /* modifyHair */ NULL,
-    /* modifyPointCloud */ NULL,
+    /* modifyHair */ modifyHair,
+    /* modifyPointCloud */ modifyPointCloud,
     /* modifyVolume */ NULL,
 
     /* initData */ initData,
@@ -251,9 +291,10 @@ ModifierTypeInfo modifierType_Moebius = {
     /* updateDepsgraph */ updateDepsgraph,
     /* dependsOnTime */ NULL,
     /* dependsOnNormals */ NULL,
+    /* isDeformOnly */ NULL,
     /* foreachIDLink */ foreachIDLink,
     /* foreachTexLink */ NULL,
-    /* freeRuntimeData */ NULL,
+    /* freeRuntimeData */ freeRuntimeData,
     /* panelRegister */ panelRegister,
     /* blendWrite */ NULL,
     /* blendRead */ NULL,
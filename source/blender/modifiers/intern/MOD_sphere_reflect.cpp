@@ -7,9 +7,11 @@
 #include "BLT_translation.h"
 
 #include "DNA_defaults.h"
+#include "DNA_hair_types.h"
 #include "DNA_mesh_types.h"
 #include "DNA_meshdata_types.h"
 #include "DNA_object_types.h"
+#include "DNA_pointcloud_types.h"
 #include "DNA_screen_types.h"
 
 #include "BKE_context.h"
@@ -25,180 +27,125 @@
 
 #include "RNA_access.h"
 
-#include "bmesh.h"
-#include "bmesh_tools.h"
-
+#include "MOD_conformal.hh"
 #include "MOD_modifiertypes.h"
 #include "MOD_ui_common.h"
 extern "C" {
 #include "MOD_util.h"
 }
 
-#include "gatl/ga3c.hpp"
-using namespace ga3c;
+using namespace blender;
+using namespace blender::modifiers::conformal;
 
-auto sphere_of_object(Object *object)
+static void sphere_inversion_init_from_modifier(SphereInversion *r_inversion,
+                                                SphereReflectModifierData *smd,
+                                                Object *target)
 {
-  float o[3];
-  copy_v3_v3(o, object->obmat[3]);
+  /* The sphere is centered at the object origin, its radius is half the largest dimension. */
+  Object *sphere = smd->sphere;
   float size[3] = {1.0f, 1.0f, 1.0f};
-  float radius = 1.0f;
-  BKE_object_dimensions_get(object, size);
-  radius = max_fff(size[0], size[1], size[2]) * 0.5f;
-  auto p1 = point(o[0] + radius, o[1], o[2]);
-  auto p2 = point(o[0] - radius, o[1], o[2]);
-  auto p3 = point(o[0], o[1] + radius, o[2]);
-  auto p4 = point(o[0], o[1], o[2] + radius);
-  auto sphere = p1 ^ p2 ^ p3 ^ p4;
-  return sphere;
+  BKE_object_dimensions_get(sphere, size);
+  const float radius = max_fff(size[0], size[1], size[2]) * 0.5f;
+  sphere_inversion_init(r_inversion, target->obmat, sphere->obmat[3], radius);
+  r_inversion->clamp_radius = smd->clamp_radius;
 }
 
-static void bm_sphere_reflect(Object *sphereObject, Object *target, BMesh *bm)
+static void mesh_sphere_reflect(SphereReflectModifierData *smd, Object *target, Mesh *mesh)
 {
-  auto sphere = sphere_of_object(sphereObject);
-  int j;
-  double refCos[3];
-
-  BMVert *v;
-  BMIter iter;
-  BM_ITER_MESH (v, &iter, bm, BM_VERTS_OF_MESH) {
-    mul_m4_v3(target->obmat, v->co);
-    for (j = 0; j < 3; j++)
-      refCos[j] = (double)(v->co)[j];
-    auto p = point(refCos[0], refCos[1], refCos[2]);
-    auto ref = apply_even_versor(sphere, p);
-    auto v_ref = -ref / abs(ref | ni);
-    refCos[0] = v_ref | e1;
-    refCos[1] = v_ref | e2;
-    refCos[2] = v_ref | e3;
-    for (j = 0; j < 3; j++)
-      (v->co)[j] = (float)refCos[j];
-    mul_m4_v3(target->imat, v->co);
-  }
+  SphereInversion inversion;
+  sphere_inversion_init_from_modifier(&inversion, smd, target);
+  sphere_inversion_positions(
+      inversion, MutableSpan<float3>(reinterpret_cast<float3 *>(mesh->mvert), mesh->totvert));
 }
 
-static Mesh *adaptiveRefine(SphereReflectModifierData *smd,
-                            const ModifierEvalContext *ctx,
-                            Mesh *mesh)
+static Mesh *modifyMesh(ModifierData *md, const ModifierEvalContext *ctx, Mesh *mesh)
 {
-  Mesh *result;
-  BMesh *bm;
-  const struct BMeshCreateParams bm_create_params = {
-      .use_toolflags = true,
-  };
-  const struct BMeshFromMeshParams bm_from_mesh_params = {0};
-  bm = BKE_mesh_to_bmesh_ex(mesh, &bm_create_params, &bm_from_mesh_params);
+  SphereReflectModifierData *smd = (SphereReflectModifierData *)md;
+  Mesh *result = NULL;
 
   if (smd->flags & MOD_SPHERE_REFLECT_ADAPTIVE) {
-    BMOperator op;
-    BMOpSlot *slot_geom_inner;
-    BMElem **subdivided_elem_array;
-    BMVert *v;
-    BMFace *f;
-    BMEdge *e;
-    BMIter iter;
-    BMIter fiter;
-    BMIter eiter;
-    float max_distance = 1.0;
-    int num_close_verts = -1;
-    int cuts = smd->cuts;
-    int i;
-    float worldCo[3];
-    for (i = 0; i < smd->iterations; i++) {
-      // printf("iteration %i\n", i);
-      BM_mesh_elem_hflag_disable_all(bm, BM_EDGE, BM_ELEM_TAG, false);
-      max_distance = 1.0 * pow(1.0 / (float(cuts) + 1.0), i) / smd->falloff;
-
-      if (i == 0) {
-        num_close_verts = 0;
-        BM_ITER_MESH (v, &iter, bm, BM_VERTS_OF_MESH) {
-          copy_v3_v3(worldCo, v->co);
-          mul_m4_v3(ctx->object->obmat, worldCo);
-          if (len_v3v3(worldCo, smd->sphere->obmat[3]) < max_distance) {
-            num_close_verts += 1;
-            BM_ITER_ELEM (f, &fiter, v, BM_FACES_OF_VERT) {
-              BM_ITER_ELEM (e, &eiter, f, BM_EDGES_OF_FACE) {
-                BM_elem_flag_enable(e, BM_ELEM_TAG);
-              }
-            }
-          }
-        }
-      }
-      else if (num_close_verts == 0) {
-        // printf("num_close_verts == 0\n");
-        break;
-      }
-      else {
-        num_close_verts = 0;
-        slot_geom_inner = BMO_slot_get(op.slots_out, "geom_inner.out");
-        subdivided_elem_array = (BMElem **)slot_geom_inner->data.buf;
-        // printf("amount last subdivided %i\n", slot_geom_inner->len);
-        for (int j = 0; j < slot_geom_inner->len; j++) {
-          if (subdivided_elem_array[i]->head.htype == BM_VERT) {
-            // printf("checking BM_VERT %i\n", j);
-            v = (BMVert *)subdivided_elem_array[j];
-            copy_v3_v3(worldCo, v->co);
-            mul_m4_v3(ctx->object->obmat, worldCo);
-            if (len_v3v3(worldCo, smd->sphere->obmat[3]) < max_distance) {
-              num_close_verts += 1;
-              BM_ITER_ELEM (f, &fiter, v, BM_FACES_OF_VERT) {
-                BM_ITER_ELEM (e, &eiter, f, BM_EDGES_OF_FACE) {
-                  BM_elem_flag_enable(e, BM_ELEM_TAG);
-                }
-              }
-            }
-          }
-        }
-      }
-      BMO_op_initf(bm,
-                   &op,
-                   BMO_FLAG_DEFAULTS,
-                   "subdivide_edges edges=%he cuts=%i use_grid_fill=%b",
-                   BM_ELEM_TAG,
-                   cuts,
-                   true);
-      BMO_op_exec(bm, &op);
-    }
+    RefineParams params;
+    copy_v3_v3(params.center, smd->sphere->obmat[3]);
+    params.falloff = smd->falloff;
+    params.cuts = smd->cuts;
+    params.iterations = smd->iterations;
+    params.max_faces = smd->max_faces;
+    result = mesh_adaptive_refine(*mesh, ctx->object->obmat, params);
+  }
+  if (result == NULL) {
+    result = BKE_mesh_copy_for_eval(mesh, false);
   }
 
-  bm_sphere_reflect(smd->sphere, ctx->object, bm);
-  result = BKE_mesh_from_bmesh_for_eval_nomain(bm, NULL, mesh);
-  BM_mesh_free(bm);
+  mesh_sphere_reflect(smd, ctx->object, result);
+  result->runtime.cd_dirty_vert |= CD_MASK_NORMAL;
 
   return result;
 }
 
-static Mesh *modifyMesh(ModifierData *md, const ModifierEvalContext *ctx, Mesh *mesh)
+static void deformVerts(ModifierData *md,
+                        const ModifierEvalContext *ctx,
+                        Mesh *UNUSED(mesh),
+                        float (*vertexCos)[3],
+                        int numVerts)
 {
   SphereReflectModifierData *smd = (SphereReflectModifierData *)md;
-  Mesh *result;
-  if (!(result = adaptiveRefine(smd, ctx, mesh))) {
-    return mesh;
+  SphereInversion inversion;
+  sphere_inversion_init_from_modifier(&inversion, smd, ctx->object);
+
+  float input_min[3], input_max[3];
+  INIT_MINMAX(input_min, input_max);
+  for (int i = 0; i < numVerts; i++) {
+    minmax_v3v3_v3(input_min, input_max, vertexCos[i]);
   }
 
-  return result;
+  sphere_inversion_positions(inversion,
+                             MutableSpan<float3>(reinterpret_cast<float3 *>(vertexCos), numVerts));
+
+  float min[3], max[3];
+  if (numVerts > 0 && sphere_inversion_bounds(inversion, input_min, input_max, min, max)) {
+    BKE_modifier_bounds_set(ctx, min, max);
+  }
 }
 
-// static void deformVerts(ModifierData *md,
-//                         const ModifierEvalContext *ctx,
-//                         Mesh *mesh,
-//                         float (*vertexCos)[3],
-//                         int numVerts)
-// {
-//   SphereReflectModifierData *smd = (SphereReflectModifierData *)md;
-//   sphere_reflect(smd->sphere, ctx->object, vertexCos, numVerts);
-// }
+static void deformVertsEM(ModifierData *md,
+                          const ModifierEvalContext *ctx,
+                          struct BMEditMesh *UNUSED(editData),
+                          Mesh *mesh,
+                          float (*vertexCos)[3],
+                          int numVerts)
+{
+  deformVerts(md, ctx, mesh, vertexCos, numVerts);
+}
 
-// static void deformVertsEM(ModifierData *md,
-//                           const ModifierEvalContext *ctx,
-//                           struct BMEditMesh *editData,
-//                           Mesh *mesh,
-//                           float (*vertexCos)[3],
-//                           int numVerts)
-// {
-//   SphereReflectModifierData *smd = (SphereReflectModifierData *)md;
-//   sphere_reflect(smd->sphere, ctx->object, vertexCos, numVerts);
-// }
+/* Adaptive refinement only applies to meshes, points are always inverted in place. */
+static PointCloud *modifyPointCloud(ModifierData *md,
+                                    const ModifierEvalContext *ctx,
+                                    PointCloud *pointcloud)
+{
+  SphereReflectModifierData *smd = (SphereReflectModifierData *)md;
+  SphereInversion inversion;
+  sphere_inversion_init_from_modifier(&inversion, smd, ctx->object);
+  sphere_inversion_positions(inversion, pointcloud_positions_for_write(*pointcloud));
+  return pointcloud;
+}
+
+static Hair *modifyHair(ModifierData *md, const ModifierEvalContext *ctx, Hair *hair)
+{
+  SphereReflectModifierData *smd = (SphereReflectModifierData *)md;
+  SphereInversion inversion;
+  sphere_inversion_init_from_modifier(&inversion, smd, ctx->object);
+  sphere_inversion_positions(inversion, hair_positions_for_write(*hair));
+  return hair;
+}
+
+/* Without adaptive refinement only the vertices move, so the modifier can be evaluated with the
+ * deform-only modifiers instead of copying the mesh. */
+static bool isDeformOnly(ModifierData *md)
+{
+  SphereReflectModifierData *smd = (SphereReflectModifierData *)md;
+
+  return (smd->flags & MOD_SPHERE_REFLECT_ADAPTIVE) == 0;
+}
 
 /* SphereReflect Transform */
 static void initData(ModifierData *md)
@@ -208,6 +155,7 @@ static void initData(ModifierData *md)
   smd->iterations = 8;
   smd->cuts = 1;
   smd->falloff = 2.0;
+  smd->max_faces = 1000000;
 }
 
 // static void copyData(ModifierData *md, ModifierData *target)
@@ -255,6 +203,8 @@ static void panel_draw(const bContext *UNUSED(C), Panel *panel)
   uiItemR(layout, ptr, "cuts", 0, NULL, ICON_NONE);
   uiItemR(layout, ptr, "iterations", 0, NULL, ICON_NONE);
   uiItemR(layout, ptr, "falloff", 0, NULL, ICON_NONE);
+  uiItemR(layout, ptr, "max_faces", 0, NULL, ICON_NONE);
+  uiItemR(layout, ptr, "clamp_radius", 0, NULL, ICON_NONE);
 
   modifier_panel_end(layout, ptr);
 }
@@ -276,13 +226,13 @@ ModifierTypeInfo modifierType_SphereReflect = {
     /* icon */ NULL, /* TODO: Use correct icon. */
     /* copyData */ BKE_modifier_copydata_generic,
 
-    /* deformVerts */ NULL,
+    /* deformVerts */ deformVerts,
     /* deformMatrices */ NULL,
-    /* deformVertsEM */ NULL,
+    /* deformVertsEM */ deformVertsEM,
     /* deformMatricesEM */ NULL,
     /* modifyMesh */ modifyMesh,
-    /* modifyHair */ NULL,
-    /* modifyPointCloud */ NULL,
+    /* modifyHair */ modifyHair,
+    /* modifyPointCloud */ modifyPointCloud,
     /* modifyVolume */ NULL,
 
     /* initData */ initData,
@@ -292,6 +242,7 @@ ModifierTypeInfo modifierType_SphereReflect = {
     /* updateDepsgraph */ updateDepsgraph,
     /* dependsOnTime */ NULL,
     /* dependsOnNormals */ NULL,
+    /* isDeformOnly */ isDeformOnly,
     /* foreachIDLink */ foreachIDLink,
     /* foreachTexLink */ NULL,
     /* freeRuntimeData */ NULL,
@@ -0,0 +1,226 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+
+#include "BLI_array.hh"
+#include "BLI_map.hh"
+#include "BLI_math.h"
+
+#include "BKE_idtype.h"
+#include "BKE_lib_id.h"
+#include "BKE_mesh.h"
+
+#include "MOD_conformal.hh"
+
+namespace blender::modifiers::conformal::tests {
+
+class ConformalRefineTest : public testing::Test {
+ public:
+  static void SetUpTestCase()
+  {
+    BKE_idtype_init();
+  }
+
+  static Mesh *mesh_new(const Span<float3> positions, const Span<Span<int>> faces)
+  {
+    int loops_num = 0;
+    for (const Span<int> face : faces) {
+      loops_num += (int)face.size();
+    }
+    Mesh *mesh = BKE_mesh_new_nomain((int)positions.size(), 0, 0, loops_num, (int)faces.size());
+    for (const int64_t i : positions.index_range()) {
+      copy_v3_v3(mesh->mvert[i].co, positions[i]);
+    }
+    int loop = 0;
+    for (const int64_t i : faces.index_range()) {
+      mesh->mpoly[i].loopstart = loop;
+      mesh->mpoly[i].totloop = (int)faces[i].size();
+      for (const int v : faces[i]) {
+        mesh->mloop[loop++].v = v;
+      }
+    }
+    BKE_mesh_calc_edges(mesh, false, false);
+    return mesh;
+  }
+
+  static Mesh *cube_mesh_new()
+  {
+    const float3 positions[] = {{-1, -1, -1},
+                                {1, -1, -1},
+                                {1, 1, -1},
+                                {-1, 1, -1},
+                                {-1, -1, 1},
+                                {1, -1, 1},
+                                {1, 1, 1},
+                                {-1, 1, 1}};
+    const int faces[6][4] = {
+        {0, 3, 2, 1}, {4, 5, 6, 7}, {0, 1, 5, 4}, {1, 2, 6, 5}, {2, 3, 7, 6}, {3, 0, 4, 7}};
+    Array<Span<int>> face_spans(6);
+    for (const int i : IndexRange(6)) {
+      face_spans[i] = Span<int>(faces[i], 4);
+    }
+    return mesh_new(Span<float3>(positions, 8), face_spans);
+  }
+
+  static Mesh *octahedron_mesh_new()
+  {
+    const float3 positions[] = {
+        {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+    const int faces[8][3] = {
+        {0, 2, 4}, {2, 1, 4}, {1, 3, 4}, {3, 0, 4}, {2, 0, 5}, {1, 2, 5}, {3, 1, 5}, {0, 3, 5}};
+    Array<Span<int>> face_spans(8);
+    for (const int i : IndexRange(8)) {
+      face_spans[i] = Span<int>(faces[i], 3);
+    }
+    return mesh_new(Span<float3>(positions, 6), face_spans);
+  }
+
+  static float mesh_area(const Mesh &mesh)
+  {
+    float area = 0.0f;
+    for (const int i : IndexRange(mesh.totpoly)) {
+      const MPoly &mp = mesh.mpoly[i];
+      const float *co_first = mesh.mvert[mesh.mloop[mp.loopstart].v].co;
+      for (const int j : IndexRange(1, mp.totloop - 2)) {
+        area += area_tri_v3(co_first,
+                            mesh.mvert[mesh.mloop[mp.loopstart + j].v].co,
+                            mesh.mvert[mesh.mloop[mp.loopstart + j + 1].v].co);
+      }
+    }
+    return area;
+  }
+
+  /**
+   * Check that \a mesh is a closed manifold made of triangles and quads only: every edge is used
+   * by two faces in opposite directions and loops reference the edges between their vertices.
+   */
+  static void expect_closed_mesh(const Mesh &mesh)
+  {
+    Array<int> edge_users(mesh.totedge, 0);
+    Map<std::pair<int, int>, int> directed_edge_users;
+    for (const int i : IndexRange(mesh.totpoly)) {
+      const MPoly &mp = mesh.mpoly[i];
+      EXPECT_GE(mp.totloop, 3);
+      EXPECT_LE(mp.totloop, 4);
+      ASSERT_LE(mp.loopstart + mp.totloop, mesh.totloop);
+      for (const int j : IndexRange(mp.totloop)) {
+        const MLoop &ml = mesh.mloop[mp.loopstart + j];
+        const MLoop &ml_next = mesh.mloop[mp.loopstart + (j + 1) % mp.totloop];
+        ASSERT_LT(ml.v, (uint)mesh.totvert);
+        ASSERT_LT(ml.e, (uint)mesh.totedge);
+        const MEdge &me = mesh.medge[ml.e];
+        EXPECT_TRUE((me.v1 == ml.v && me.v2 == ml_next.v) ||
+                    (me.v2 == ml.v && me.v1 == ml_next.v));
+        edge_users[ml.e]++;
+        directed_edge_users.lookup_or_add({(int)ml.v, (int)ml_next.v}, 0)++;
+      }
+    }
+    for (const int users : edge_users) {
+      EXPECT_EQ(users, 2);
+    }
+    for (const int users : directed_edge_users.values()) {
+      EXPECT_EQ(users, 1);
+    }
+    /* Euler characteristic of a sphere. */
+    EXPECT_EQ(mesh.totvert - mesh.totedge + mesh.totpoly, 2);
+  }
+
+  static void test_refine(const Mesh &mesh, const float3 center, const RefineParams &params_base)
+  {
+    RefineParams params = params_base;
+    copy_v3_v3(params.center, center);
+    float object_mat[4][4];
+    unit_m4(object_mat);
+
+    Mesh *result = mesh_adaptive_refine(mesh, object_mat, params);
+    ASSERT_NE(result, nullptr);
+    EXPECT_GT(result->totpoly, mesh.totpoly);
+    expect_closed_mesh(*result);
+    EXPECT_NEAR(mesh_area(*result), mesh_area(mesh), mesh_area(mesh) * 1e-3f);
+    if (params.max_faces > 0) {
+      EXPECT_LE(result->totpoly, params.max_faces);
+    }
+    BKE_id_free(nullptr, result);
+  }
+};
+
+TEST(conformal_refine, GridCounts)
+{
+  for (const int64_t n : IndexRange(1, 8)) {
+    /* Euler characteristic of a disk: the inner elements and the `4 * n` or `3 * n` boundary
+     * vertices and edges with `n * n` faces. */
+    EXPECT_EQ(grid_inner_verts_num(4, n) + 4 * n - grid_inner_edges_num(4, n) - 4 * n + n * n, 1);
+    EXPECT_EQ(grid_inner_verts_num(3, n) + 3 * n - grid_inner_edges_num(3, n) - 3 * n + n * n, 1);
+    EXPECT_EQ(grid_inner_verts_num(4, n), (n - 1) * (n - 1));
+  }
+}
+
+TEST(conformal_refine, TriRowOffset)
+{
+  /* Inner vertices of a triangle grid, indexed by row, are numbered without gaps. */
+  for (const int64_t n : IndexRange(3, 8)) {
+    const int64_t verts_num = grid_inner_verts_num(3, n);
+    Array<int> users(verts_num, 0);
+    for (const int64_t j : IndexRange(1, n - 2)) {
+      for (const int64_t i : IndexRange(1, n - 1 - j)) {
+        const int64_t index = tri_row_offset(n - 2, j - 1) + i - 1;
+        ASSERT_GE(index, 0);
+        ASSERT_LT(index, verts_num);
+        users[index]++;
+      }
+    }
+    for (const int user : users) {
+      EXPECT_EQ(user, 1);
+    }
+  }
+}
+
+TEST_F(ConformalRefineTest, Cube)
+{
+  Mesh *mesh = cube_mesh_new();
+  for (const int cuts : IndexRange(1, 3)) {
+    for (const int iterations : IndexRange(1, 4)) {
+      const RefineParams params = {{0.0f, 0.0f, 0.0f}, 2.0f, cuts, iterations, 0};
+      /* Corner and off-center points give transitions between several levels. */
+      test_refine(*mesh, float3(1.0f, 1.0f, 1.0f), params);
+      test_refine(*mesh, float3(0.2f, 0.3f, 1.1f), params);
+    }
+  }
+  BKE_id_free(nullptr, mesh);
+}
+
+TEST_F(ConformalRefineTest, Octahedron)
+{
+  Mesh *mesh = octahedron_mesh_new();
+  for (const int cuts : IndexRange(1, 3)) {
+    for (const int iterations : IndexRange(1, 4)) {
+      const RefineParams params = {{0.0f, 0.0f, 0.0f}, 2.0f, cuts, iterations, 0};
+      test_refine(*mesh, float3(1.0f, 0.0f, 0.0f), params);
+      test_refine(*mesh, float3(0.3f, 0.3f, 0.5f), params);
+    }
+  }
+  BKE_id_free(nullptr, mesh);
+}
+
+TEST_F(ConformalRefineTest, MaxFaces)
+{
+  Mesh *mesh = cube_mesh_new();
+  const RefineParams params = {{0.0f, 0.0f, 0.0f}, 2.0f, 1, 12, 5000};
+  test_refine(*mesh, float3(1.0f, 1.0f, 1.0f), params);
+  BKE_id_free(nullptr, mesh);
+}
+
+TEST_F(ConformalRefineTest, FarCenter)
+{
+  Mesh *mesh = cube_mesh_new();
+  float object_mat[4][4];
+  unit_m4(object_mat);
+  const RefineParams params = {{100.0f, 0.0f, 0.0f}, 2.0f, 1, 4, 0};
+  EXPECT_EQ(mesh_adaptive_refine(*mesh, object_mat, params), nullptr);
+  BKE_id_free(nullptr, mesh);
+}
+
+}  // namespace blender::modifiers::conformal::tests
@@ -0,0 +1,471 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "BLI_array.hh"
+#include "BLI_math.h"
+#include "BLI_rand.hh"
+
+#include "MOD_conformal.hh"
+#include "MOD_conformal_kernels.hh"
+
+#include "gatl/ga3c.hpp"
+
+namespace blender::modifiers::conformal::tests {
+
+static Array<float3> random_positions(RandomNumberGenerator &rng, const int size)
+{
+  /* Random input data between -5 and 5. */
+  Array<float3> positions(size);
+  for (float3 &co : positions) {
+    co = float3(rng.get_float() - 0.5f, rng.get_float() - 0.5f, rng.get_float() - 0.5f) * 10.0f;
+  }
+  return positions;
+}
+
+/* Copy of the per-vertex transform of the Moebius modifier before the batched kernel. It
+ * computes the norm with double precision `pow` for all powers, so it is independent of the
+ * kernels that are tested. */
+static void moebius_reference_co(const float rotation[4][4], float co[3], const float p)
+{
+  const float eps = 0.0000000000000001;
+  float h[4];
+
+  const float norm = pow(co[0], p) + pow(co[1], p) + pow(co[2], p);
+  mul_v3_v3fl(h, co, 2);
+  h[3] = norm - 1.0f;
+
+  mul_v4_fl(h, 1.0f / max_ff(1.0f + norm, eps));
+  mul_m4_v4(rotation, h);
+  copy_v3_v3(co, h);
+  mul_v3_fl(co, 1.0f / max_ff(1.0f - h[3], eps));
+}
+
+/* Per-vertex evaluation as the Moebius modifier did it before the batched kernel. */
+static void moebius_reference(const float object_mat[4][4],
+                              const float control_mat[4][4],
+                              const float origin[3],
+                              const bool localize,
+                              const float norm_power,
+                              MutableSpan<float3> positions)
+{
+  float rotation[4][4];
+  float imat[4][4];
+  float offset[3] = {0.0f, 0.0f, 0.0f};
+
+  moebius_rotation_from_matrix(rotation, control_mat);
+  invert_m4_m4(imat, object_mat);
+  if (localize) {
+    moebius_reference_co(rotation, offset, norm_power);
+  }
+
+  for (float3 &co : positions) {
+    mul_m4_v3(object_mat, co);
+    sub_v3_v3(co, origin);
+    moebius_reference_co(rotation, co, norm_power);
+    add_v3_v3(co, origin);
+    mul_m4_v3(imat, co);
+    if (localize) {
+      sub_v3_v3(co, offset);
+    }
+  }
+}
+
+static void expect_positions_equal(Span<float3> a, Span<float3> b)
+{
+  ASSERT_EQ(a.size(), b.size());
+  for (const int64_t i : a.index_range()) {
+    EXPECT_EQ(a[i], b[i]) << "index " << i;
+  }
+}
+
+static void expect_positions_near(Span<float3> a, Span<float3> b, const float eps)
+{
+  ASSERT_EQ(a.size(), b.size());
+  for (const int64_t i : a.index_range()) {
+    EXPECT_V3_NEAR(a[i], b[i], eps);
+  }
+}
+
+/* Rounding differences of the reference are amplified near the pole, so compare relative to the
+ * magnitude of the result. */
+static void expect_positions_near_relative(Span<float3> a, Span<float3> b, const float eps)
+{
+  ASSERT_EQ(a.size(), b.size());
+  for (const int64_t i : a.index_range()) {
+    const float tolerance = eps * max_ff(1.0f, len_v3(b[i]));
+    EXPECT_V3_NEAR(a[i], b[i], tolerance);
+  }
+}
+
+static void test_moebius_against_reference(const bool localize, const float norm_power)
+{
+  RandomNumberGenerator rng;
+  const Array<float3> input = random_positions(rng, 10000);
+
+  float object_mat[4][4];
+  float control_mat[4][4];
+  const float object_loc[3] = {0.5f, -1.0f, 2.0f};
+  const float object_rot[3] = {0.3f, 0.1f, -0.7f};
+  const float object_size[3] = {1.0f, 2.0f, 0.5f};
+  const float control_loc[3] = {-2.0f, 0.25f, 1.0f};
+  const float control_rot[3] = {1.1f, -0.4f, 0.6f};
+  const float control_size[3] = {1.0f, 1.0f, 1.0f};
+  loc_eul_size_to_mat4(object_mat, object_loc, object_rot, object_size);
+  loc_eul_size_to_mat4(control_mat, control_loc, control_rot, control_size);
+
+  Array<float3> expected = input;
+  moebius_reference(object_mat, control_mat, control_mat[3], localize, norm_power, expected);
+
+  MoebiusTransform transform;
+  moebius_transform_init(
+      &transform, object_mat, control_mat, control_mat[3], localize, norm_power);
+  Array<float3> result = input;
+  moebius_transform_positions(transform, result);
+
+  expect_positions_near_relative(result, expected, 1e-5f);
+}
+
+TEST(conformal, MoebiusEuclideanNorm)
+{
+  test_moebius_against_reference(false, 2.0f);
+}
+
+TEST(conformal, MoebiusEuclideanNormLocalize)
+{
+  test_moebius_against_reference(true, 2.0f);
+}
+
+TEST(conformal, MoebiusIntegerNorm)
+{
+  test_moebius_against_reference(false, 4.0f);
+}
+
+TEST(conformal, MoebiusCachedLift)
+{
+  /* Projecting cached lifted points must give the same result as the fused kernel, also after
+   * the control object changed. */
+  RandomNumberGenerator rng;
+  const Array<float3> input = random_positions(rng, 1000);
+
+  float object_mat[4][4];
+  float control_mat[4][4];
+  const float origin[3] = {0.0f, 0.0f, 0.0f};
+  unit_m4(object_mat);
+  unit_m4(control_mat);
+
+  MoebiusTransform transform;
+  moebius_transform_init(&transform, object_mat, control_mat, origin, false, 3.0f);
+  Array<float> lifted(input.size() * 4);
+  moebius_lift_positions(transform, input, lifted);
+
+  const float control_rot[3] = {0.2f, 0.9f, -1.3f};
+  eul_to_mat4(control_mat, control_rot);
+  moebius_transform_init(&transform, object_mat, control_mat, origin, true, 3.0f);
+
+  Array<float3> expected = input;
+  moebius_transform_positions(transform, expected);
+  Array<float3> result(input.size());
+  moebius_project_positions(transform, lifted, result);
+
+  expect_positions_equal(result, expected);
+}
+
+TEST(conformal, MoebiusIdentityControl)
+{
+  /* An identity control rotation maps every point back onto itself. */
+  RandomNumberGenerator rng;
+  const Array<float3> input = random_positions(rng, 1000);
+
+  float object_mat[4][4];
+  float control_mat[4][4];
+  unit_m4(object_mat);
+  unit_m4(control_mat);
+
+  MoebiusTransform transform;
+  moebius_transform_init(&transform, object_mat, control_mat, control_mat[3], false, 2.0f);
+  Array<float3> result = input;
+  moebius_transform_positions(transform, result);
+
+  expect_positions_near(result, input, 1e-4f);
+}
+
+/* Per-vertex conformal sandwich product with the sphere blade, as Sphere Reflect did it before
+ * the closed form kernel. */
+static void sphere_inversion_reference(const float object_mat[4][4],
+                                       const float center[3],
+                                       const float radius,
+                                       MutableSpan<float3> positions)
+{
+  using namespace ga3c;
+
+  const double o[3] = {center[0], center[1], center[2]};
+  const double r = radius;
+  auto p1 = point(o[0] + r, o[1], o[2]);
+  auto p2 = point(o[0] - r, o[1], o[2]);
+  auto p3 = point(o[0], o[1] + r, o[2]);
+  auto p4 = point(o[0], o[1], o[2] + r);
+  auto sphere = p1 ^ p2 ^ p3 ^ p4;
+
+  float imat[4][4];
+  invert_m4_m4(imat, object_mat);
+  for (float3 &co : positions) {
+    mul_m4_v3(object_mat, co);
+    auto p = point((double)co.x, (double)co.y, (double)co.z);
+    auto ref = apply_even_versor(sphere, p);
+    auto v_ref = -ref / abs(ref | ni);
+    co.x = (float)(double)(v_ref | e1);
+    co.y = (float)(double)(v_ref | e2);
+    co.z = (float)(double)(v_ref | e3);
+    mul_m4_v3(imat, co);
+  }
+}
+
+TEST(conformal, SphereInversion)
+{
+  RandomNumberGenerator rng;
+  const Array<float3> input = random_positions(rng, 10000);
+
+  float object_mat[4][4];
+  const float object_loc[3] = {0.5f, -1.0f, 2.0f};
+  const float object_rot[3] = {0.3f, 0.1f, -0.7f};
+  const float object_size[3] = {1.0f, 2.0f, 0.5f};
+  loc_eul_size_to_mat4(object_mat, object_loc, object_rot, object_size);
+  const float center[3] = {-2.0f, 0.25f, 1.0f};
+  const float radius = 1.5f;
+
+  Array<float3> expected = input;
+  sphere_inversion_reference(object_mat, center, radius, expected);
+
+  SphereInversion inversion;
+  sphere_inversion_init(&inversion, object_mat, center, radius);
+  Array<float3> result = input;
+  sphere_inversion_positions(inversion, result);
+
+  for (const int64_t i : input.index_range()) {
+    /* The reference works in double precision, compare relative to the magnitude. */
+    const float eps = 1e-4f * std::max(1.0f, len_v3(expected[i]));
+    EXPECT_V3_NEAR(result[i], expected[i], eps);
+  }
+}
+
+TEST(conformal, SphereInversionInvolution)
+{
+  /* Inverting twice in the same sphere is the identity. */
+  RandomNumberGenerator rng;
+  const Array<float3> input = random_positions(rng, 1000);
+
+  float object_mat[4][4];
+  unit_m4(object_mat);
+  const float center[3] = {0.0f, 0.0f, 0.0f};
+
+  SphereInversion inversion;
+  sphere_inversion_init(&inversion, object_mat, center, 2.0f);
+  Array<float3> result = input;
+  sphere_inversion_positions(inversion, result);
+  sphere_inversion_positions(inversion, result);
+
+  for (const int64_t i : input.index_range()) {
+    const float eps = 1e-4f * std::max(1.0f, len_v3(input[i]));
+    EXPECT_V3_NEAR(result[i], input[i], eps);
+  }
+}
+
+static Array<float3> random_positions_in_box(RandomNumberGenerator &rng,
+                                             const float min[3],
+                                             const float max[3],
+                                             const int size)
+{
+  Array<float3> positions(size);
+  for (float3 &co : positions) {
+    for (int axis = 0; axis < 3; axis++) {
+      co[axis] = min[axis] + rng.get_float() * (max[axis] - min[axis]);
+    }
+  }
+  /* Include the corners, the bounds are tightest there. */
+  for (int i = 0; i < 8; i++) {
+    positions[i] = float3(
+        (i & 1) ? max[0] : min[0], (i & 2) ? max[1] : min[1], (i & 4) ? max[2] : min[2]);
+  }
+  return positions;
+}
+
+static void expect_positions_in_bounds(Span<float3> positions,
+                                       const float min[3],
+                                       const float max[3])
+{
+  for (const float3 &co : positions) {
+    for (int axis = 0; axis < 3; axis++) {
+      EXPECT_GE(co[axis], min[axis]);
+      EXPECT_LE(co[axis], max[axis]);
+    }
+  }
+}
+
+TEST(conformal, SphereInversionBounds)
+{
+  RandomNumberGenerator rng;
+  float object_mat[4][4];
+  const float object_loc[3] = {0.5f, -1.0f, 2.0f};
+  const float object_rot[3] = {0.3f, 0.1f, -0.7f};
+  const float object_size[3] = {1.0f, 2.0f, 0.5f};
+  loc_eul_size_to_mat4(object_mat, object_loc, object_rot, object_size);
+  const float center[3] = {-2.0f, 0.25f, 1.0f};
+
+  SphereInversion inversion;
+  sphere_inversion_init(&inversion, object_mat, center, 1.5f);
+
+  const float min[3] = {1.0f, 1.0f, -1.0f};
+  const float max[3] = {3.0f, 2.0f, 1.0f};
+  float r_min[3], r_max[3];
+  EXPECT_TRUE(sphere_inversion_bounds(inversion, min, max, r_min, r_max));
+
+  Array<float3> positions = random_positions_in_box(rng, min, max, 10000);
+  sphere_inversion_positions(inversion, positions);
+  expect_positions_in_bounds(positions, r_min, r_max);
+}
+
+TEST(conformal, SphereInversionBoundsClamp)
+{
+  /* A box around the center is mapped to everything outside of a ball, unless clamped. */
+  RandomNumberGenerator rng;
+  float object_mat[4][4];
+  unit_m4(object_mat);
+  const float center[3] = {0.0f, 0.0f, 0.0f};
+
+  SphereInversion inversion;
+  sphere_inversion_init(&inversion, object_mat, center, 1.0f);
+
+  const float min[3] = {-1.0f, -1.0f, -1.0f};
+  const float max[3] = {1.0f, 1.0f, 1.0f};
+  float r_min[3], r_max[3];
+  EXPECT_FALSE(sphere_inversion_bounds(inversion, min, max, r_min, r_max));
+
+  inversion.clamp_radius = 10.0f;
+  EXPECT_TRUE(sphere_inversion_bounds(inversion, min, max, r_min, r_max));
+
+  Array<float3> positions = random_positions_in_box(rng, min, max, 10000);
+  sphere_inversion_positions(inversion, positions);
+  expect_positions_in_bounds(positions, r_min, r_max);
+  for (const float3 &co : positions) {
+    EXPECT_LE(co.length(), 10.0f * (1.0f + 1e-6f));
+  }
+}
+
+TEST(conformal, MoebiusBounds)
+{
+  RandomNumberGenerator rng;
+  float object_mat[4][4];
+  float control_mat[4][4];
+  const float object_loc[3] = {0.5f, -1.0f, 2.0f};
+  const float object_rot[3] = {0.3f, 0.1f, -0.7f};
+  const float object_size[3] = {1.0f, 2.0f, 0.5f};
+  const float control_loc[3] = {-2.0f, 0.25f, 1.0f};
+  const float control_rot[3] = {0.4f, -0.2f, 0.3f};
+  const float control_size[3] = {1.0f, 1.0f, 1.0f};
+  loc_eul_size_to_mat4(object_mat, object_loc, object_rot, object_size);
+  loc_eul_size_to_mat4(control_mat, control_loc, control_rot, control_size);
+
+  for (const bool localize : {false, true}) {
+    MoebiusTransform transform;
+    moebius_transform_init(&transform, object_mat, control_mat, control_mat[3], localize, 2.0f);
+
+    const float min[3] = {-2.0f, 0.0f, -1.0f};
+    const float max[3] = {-1.5f, 0.5f, -0.5f};
+    float r_min[3], r_max[3];
+    EXPECT_TRUE(moebius_transform_bounds(transform, min, max, r_min, r_max));
+
+    Array<float3> positions = random_positions_in_box(rng, min, max, 10000);
+    moebius_transform_positions(transform, positions);
+    expect_positions_in_bounds(positions, r_min, r_max);
+  }
+}
+
+TEST(conformal, MoebiusBoundsClamp)
+{
+  /* The pole is sent to infinity, a box around it has no bounds unless clamped. */
+  RandomNumberGenerator rng;
+  float object_mat[4][4];
+  float control_mat[4][4];
+  unit_m4(object_mat);
+  const float control_rot[3] = {0.0f, 0.0f, 0.5f};
+  eul_to_mat4(control_mat, control_rot);
+
+  MoebiusTransform transform;
+  moebius_transform_init(&transform, object_mat, control_mat, control_mat[3], false, 2.0f);
+
+  const float min[3] = {-5.0f, -5.0f, -5.0f};
+  const float max[3] = {5.0f, 5.0f, 5.0f};
+  float r_min[3], r_max[3];
+  EXPECT_FALSE(moebius_transform_bounds(transform, min, max, r_min, r_max));
+
+  transform.clamp_radius = 20.0f;
+  EXPECT_TRUE(moebius_transform_bounds(transform, min, max, r_min, r_max));
+
+  Array<float3> positions = random_positions_in_box(rng, min, max, 10000);
+  moebius_transform_positions(transform, positions);
+  expect_positions_in_bounds(positions, r_min, r_max);
+  for (const float3 &co : positions) {
+    EXPECT_LE(co.length(), 20.0f * (1.0f + 1e-6f));
+  }
+
+  /* Other norms are not conformal, only the clamp radius bounds them. */
+  transform.norm_power = 4.0f;
+  transform.clamp_radius = 0.0f;
+  EXPECT_FALSE(moebius_transform_bounds(transform, min, max, r_min, r_max));
+}
+
+/* The kernels can be evaluated at compile time. */
+static_assert(kernels::point(1.0f, 2.0f, 2.0f).ni == 4.5f);
+static_assert(kernels::normalize_by_ni(kernels::Vector<float>{-2.0f, 0.0f, 0.0f, -4.0f, -0.5f})
+                  .e1 == 0.5f);
+
+TEST(conformal, KernelsMatchGatl)
+{
+  using namespace ga3c;
+
+  RandomNumberGenerator rng;
+  for (int iter = 0; iter < 100; iter++) {
+    const double o[3] = {
+        rng.get_double() * 4.0 - 2.0, rng.get_double() * 4.0 - 2.0, rng.get_double() * 4.0 - 2.0};
+    const double r = 0.5 + rng.get_double() * 2.0;
+    const double x[3] = {rng.get_double() * 10.0 - 5.0,
+                         rng.get_double() * 10.0 - 5.0,
+                         rng.get_double() * 10.0 - 5.0};
+
+    auto sphere = point(o[0] + r, o[1], o[2]) ^ point(o[0] - r, o[1], o[2]) ^
+                  point(o[0], o[1] + r, o[2]) ^ point(o[0], o[1], o[2] + r);
+    auto ref = apply_even_versor(sphere, point(x[0], x[1], x[2]));
+    auto v_ref = -ref / abs(ref | ni);
+
+    const kernels::Quadvector<double> k_sphere = kernels::sphere_from_points(
+        kernels::point(o[0] + r, o[1], o[2]),
+        kernels::point(o[0] - r, o[1], o[2]),
+        kernels::point(o[0], o[1] + r, o[2]),
+        kernels::point(o[0], o[1], o[2] + r));
+    const kernels::Vector<double> k_ref = kernels::apply_even_versor(
+        k_sphere, kernels::point(x[0], x[1], x[2]));
+    const kernels::Vector<double> k_v_ref = kernels::normalize_by_ni(k_ref);
+
+    /* Compare vectors through their inner products with the basis, `x . no = -x_ni` and
+     * `x . ni = -x_no`. */
+    auto expect_vector_near = [](const kernels::Vector<double> &a, const auto &b) {
+      const double eps = 1e-9 * std::max({1.0,
+                                          std::fabs(a.e1),
+                                          std::fabs(a.e2),
+                                          std::fabs(a.e3),
+                                          std::fabs(a.no),
+                                          std::fabs(a.ni)});
+      EXPECT_NEAR(a.e1, (double)(b | e1), eps);
+      EXPECT_NEAR(a.e2, (double)(b | e2), eps);
+      EXPECT_NEAR(a.e3, (double)(b | e3), eps);
+      EXPECT_NEAR(a.no, -(double)(b | ni), eps);
+      EXPECT_NEAR(a.ni, -(double)(b | no), eps);
+    };
+    expect_vector_near(kernels::dual(k_sphere), dual(sphere));
+    expect_vector_near(k_ref, ref);
+    expect_vector_near(k_v_ref, v_ref);
+  }
+}
+
+}  // namespace blender::modifiers::conformal::tests
@@ -0,0 +1,98 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <cmath>
+#include <iostream>
+
+#include "BLI_array.hh"
+#include "BLI_float3.hh"
+#include "BLI_rand.hh"
+#include "BLI_timeit.hh"
+
+#include "MOD_conformal_kernels.hh"
+
+#include "gatl/ga3c.hpp"
+
+namespace blender::modifiers::conformal::tests {
+
+/* Reflect every position in the sphere through four fixed points, the way the Sphere Reflect
+ * modifier used to do it with gatl, and compare against the specialized kernels. */
+
+static const int64_t points_num = 10000000;
+
+static const float sphere_points[4][3] = {
+    {1.0f, 0.0f, 0.0f}, {-0.5f, 1.0f, 0.25f}, {0.0f, -1.0f, 0.5f}, {0.25f, 0.5f, -1.0f}};
+
+static Array<float3> random_positions()
+{
+  Array<float3> positions(points_num);
+  RandomNumberGenerator rng(0);
+  for (float3 &position : positions) {
+    position = float3(rng.get_float(), rng.get_float(), rng.get_float()) * 4.0f -
+               float3(2.0f, 2.0f, 2.0f);
+  }
+  return positions;
+}
+
+static double reflect_gatl(Span<float3> positions)
+{
+  using namespace ga3c;
+  const float(*sp)[3] = sphere_points;
+  auto sphere = point((double)sp[0][0], (double)sp[0][1], (double)sp[0][2]) ^
+                point((double)sp[1][0], (double)sp[1][1], (double)sp[1][2]) ^
+                point((double)sp[2][0], (double)sp[2][1], (double)sp[2][2]) ^
+                point((double)sp[3][0], (double)sp[3][1], (double)sp[3][2]);
+
+  double checksum = 0.0;
+  for (const float3 &co : positions) {
+    auto ref = apply_even_versor(sphere, point((double)co.x, (double)co.y, (double)co.z));
+    const double scale = ref | ni;
+    auto v_ref = -ref / std::fabs(scale);
+    checksum += (double)(v_ref | e1) + (double)(v_ref | e2) + (double)(v_ref | e3);
+  }
+  return checksum;
+}
+
+template<typename T> static double reflect_kernels(Span<float3> positions)
+{
+  using namespace kernels;
+  const Quadvector<T> s = sphere_from_points(
+      point<T>(sphere_points[0][0], sphere_points[0][1], sphere_points[0][2]),
+      point<T>(sphere_points[1][0], sphere_points[1][1], sphere_points[1][2]),
+      point<T>(sphere_points[2][0], sphere_points[2][1], sphere_points[2][2]),
+      point<T>(sphere_points[3][0], sphere_points[3][1], sphere_points[3][2]));
+
+  double checksum = 0.0;
+  for (const float3 &position : positions) {
+    const Vector<T> ref = normalize_by_ni(
+        apply_even_versor(s, point<T>(position.x, position.y, position.z)));
+    checksum += double(ref.e1 + ref.e2 + ref.e3);
+  }
+  return checksum;
+}
+
+TEST(conformal_performance, SphereReflect10M)
+{
+  const Array<float3> positions = random_positions();
+
+  double checksum_gatl, checksum_double, checksum_float;
+  {
+    SCOPED_TIMER("gatl generic");
+    checksum_gatl = reflect_gatl(positions);
+  }
+  {
+    SCOPED_TIMER("kernels double");
+    checksum_double = reflect_kernels<double>(positions);
+  }
+  {
+    SCOPED_TIMER("kernels float");
+    checksum_float = reflect_kernels<float>(positions);
+  }
+  std::cout << "checksums: " << checksum_gatl << " " << checksum_double << " " << checksum_float
+            << "\n";
+
+  EXPECT_NEAR(checksum_double, checksum_gatl, std::fabs(checksum_gatl) * 1e-9);
+}
+
+}  // namespace blender::modifiers::conformal::tests
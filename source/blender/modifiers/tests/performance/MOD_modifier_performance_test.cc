@@ -0,0 +1,309 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <string>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_math.h"
+#include "BLI_threads.h"
+
+#include "DNA_genfile.h"
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_modifier_types.h"
+#include "DNA_object_types.h"
+#include "DNA_scene_types.h"
+
+#include "BKE_appdir.h"
+#include "BKE_blender.h"
+#include "BKE_global.h"
+#include "BKE_idtype.h"
+#include "BKE_image.h"
+#include "BKE_layer.h"
+#include "BKE_lib_id.h"
+#include "BKE_main.h"
+#include "BKE_mesh.h"
+#include "BKE_modifier.h"
+#include "BKE_node.h"
+#include "BKE_object.h"
+#include "BKE_scene.h"
+
+#include "DEG_depsgraph.h"
+#include "DEG_depsgraph_build.h"
+
+#include "IMB_imbuf.h"
+
+#include "RNA_define.h"
+
+#include "PIL_time.h"
+
+#include "CLG_log.h"
+
+/* Timings of modifier evaluation on synthetic grids. Besides the human readable table on stdout,
+ * every measurement is recorded as a test property, so running with
+ * `--gtest_output=json:results.json` gives results that can be compared between builds. */
+
+DEFINE_int32(modifier_perf_max_verts,
+             10000000,
+             "Largest synthetic mesh to evaluate modifiers on, in vertices.");
+DEFINE_int32(modifier_perf_repeat, 3, "Number of evaluations per modifier and mesh size.");
+
+namespace blender::modifiers::tests {
+
+static const int mesh_sizes[] = {10000, 100000, 1000000, 10000000};
+
+class ModifierPerformanceTest : public testing::Test {
+ protected:
+  Depsgraph *depsgraph_ = nullptr;
+  Object *target_ = nullptr;
+  Object *control_ = nullptr;
+  Object *sphere_ = nullptr;
+
+ public:
+  static void SetUpTestCase()
+  {
+    testing::Test::SetUpTestCase();
+
+    /* Same minimal initialization as the blend file loading tests. */
+    CLG_init();
+    BLI_threadapi_init();
+
+    DNA_sdna_current_init();
+    BKE_blender_globals_init();
+
+    BKE_idtype_init();
+    BKE_appdir_init();
+    IMB_init();
+    BKE_images_init();
+    BKE_modifier_init();
+    DEG_register_node_types();
+    RNA_init();
+    init_nodesystem();
+
+    G.background = true;
+    G.factory_startup = true;
+  }
+
+  static void TearDownTestCase()
+  {
+    BKE_blender_free();
+    RNA_exit();
+
+    DEG_free_node_types();
+    DNA_sdna_current_free();
+    BLI_threadapi_exit();
+
+    BKE_blender_atexit();
+
+    BKE_tempdir_session_purge();
+
+    CLG_exit();
+
+    testing::Test::TearDownTestCase();
+  }
+
+  void SetUp() override
+  {
+    Main *bmain = G.main;
+    Scene *scene = BKE_scene_add(bmain, "Scene");
+    depsgraph_ = DEG_graph_new(
+        bmain, scene, BKE_view_layer_default_view(scene), DAG_EVAL_VIEWPORT);
+    DEG_graph_build_from_view_layer(depsgraph_);
+    BKE_scene_graph_update_tagged(depsgraph_, bmain);
+
+    target_ = BKE_object_add_only_object(bmain, OB_MESH, "Target");
+    target_->data = BKE_mesh_add(bmain, "Target");
+
+    /* Moebius control, rotated so that the transformation is not the identity. */
+    control_ = BKE_object_add_only_object(bmain, OB_EMPTY, "Control");
+    const float control_loc[3] = {0.0f, 0.0f, 0.0f};
+    const float control_rot[3] = {0.3f, -0.5f, 0.8f};
+    const float control_size[3] = {1.0f, 1.0f, 1.0f};
+    loc_eul_size_to_mat4(control_->obmat, control_loc, control_rot, control_size);
+
+    /* Sphere Reflect uses half the largest dimension as radius, an empty mesh has a bounding box
+     * of size two, so the radius is the object scale. */
+    sphere_ = BKE_object_add_only_object(bmain, OB_MESH, "Sphere");
+    sphere_->data = BKE_mesh_add(bmain, "Sphere");
+    const float sphere_loc[3] = {0.25f, -0.5f, 1.0f};
+    const float sphere_rot[3] = {0.0f, 0.0f, 0.0f};
+    const float sphere_size[3] = {0.75f, 0.75f, 0.75f};
+    loc_eul_size_to_mat4(sphere_->obmat, sphere_loc, sphere_rot, sphere_size);
+  }
+
+  void TearDown() override
+  {
+    DEG_graph_free(depsgraph_);
+    depsgraph_ = nullptr;
+    /* The objects are freed with the main database. */
+  }
+
+  /* Grid of quads in the XY plane with a wave in Z, about \a verts_num vertices. */
+  static Mesh *create_grid_mesh(const int verts_num)
+  {
+    const int side = std::max(2, (int)std::sqrt((double)verts_num));
+    const int quads_num = (side - 1) * (side - 1);
+    Mesh *mesh = BKE_mesh_new_nomain(side * side, 0, 0, quads_num * 4, quads_num);
+
+    for (int y = 0; y < side; y++) {
+      for (int x = 0; x < side; x++) {
+        float *co = mesh->mvert[y * side + x].co;
+        co[0] = (float)x / (float)(side - 1) * 4.0f - 2.0f;
+        co[1] = (float)y / (float)(side - 1) * 4.0f - 2.0f;
+        co[2] = 0.1f * sinf(co[0] * 3.0f) * cosf(co[1] * 3.0f);
+      }
+    }
+
+    int poly_index = 0;
+    for (int y = 0; y < side - 1; y++) {
+      for (int x = 0; x < side - 1; x++) {
+        const int loopstart = poly_index * 4;
+        mesh->mpoly[poly_index].loopstart = loopstart;
+        mesh->mpoly[poly_index].totloop = 4;
+        mesh->mloop[loopstart + 0].v = y * side + x;
+        mesh->mloop[loopstart + 1].v = y * side + x + 1;
+        mesh->mloop[loopstart + 2].v = (y + 1) * side + x + 1;
+        mesh->mloop[loopstart + 3].v = (y + 1) * side + x;
+        poly_index++;
+      }
+    }
+
+    BKE_mesh_calc_edges(mesh, false, false);
+    return mesh;
+  }
+
+  /** Evaluate the modifier once, the way the modifier stack would, returns the time it took. */
+  static double evaluate(ModifierData *md, const ModifierEvalContext *ctx, Mesh *mesh)
+  {
+    const ModifierTypeInfo *mti = BKE_modifier_get_info((ModifierType)md->type);
+    double time;
+    if (BKE_modifier_is_deform_only(md)) {
+      int verts_num;
+      float(*vertex_cos)[3] = BKE_mesh_vert_coords_alloc(mesh, &verts_num);
+      const double start = PIL_check_seconds_timer();
+      mti->deformVerts(md, ctx, mesh, vertex_cos, verts_num);
+      time = PIL_check_seconds_timer() - start;
+      MEM_freeN(vertex_cos);
+    }
+    else {
+      const double start = PIL_check_seconds_timer();
+      Mesh *result = mti->modifyMesh(md, ctx, mesh);
+      time = PIL_check_seconds_timer() - start;
+      if (result != mesh) {
+        BKE_id_free(NULL, result);
+      }
+    }
+    return time;
+  }
+
+  /**
+   * Evaluate deform-only modifiers through `deformVerts`, others through `modifyMesh`. Prints and
+   * records the time of the first and the fastest evaluation for every mesh size up to
+   * \a max_verts. Every evaluation starts without runtime data, modifiers that cache data between
+   * evaluations are also timed with the cache of an identical evaluation.
+   */
+  void run(const char *name, ModifierData *md, const int max_verts)
+  {
+    const ModifierTypeInfo *mti = BKE_modifier_get_info((ModifierType)md->type);
+    const int repeat = std::max(1, FLAGS_modifier_perf_repeat);
+
+    ModifierEvalContext ctx = {depsgraph_, target_, (ModifierApplyFlag)0};
+
+    for (const int size : mesh_sizes) {
+      if (size > std::min(max_verts, (int)FLAGS_modifier_perf_max_verts)) {
+        break;
+      }
+      Mesh *mesh = create_grid_mesh(size);
+
+      double first_time = 0.0;
+      double best_time = 0.0;
+      double best_cached_time = 0.0;
+      for (int i = 0; i < repeat; i++) {
+        if (mti->freeRuntimeData) {
+          mti->freeRuntimeData(md->runtime);
+          md->runtime = NULL;
+        }
+        const double time = evaluate(md, &ctx, mesh);
+        first_time = (i == 0) ? time : first_time;
+        best_time = (i == 0) ? time : std::min(best_time, time);
+
+        if (mti->freeRuntimeData) {
+          const double cached_time = evaluate(md, &ctx, mesh);
+          best_cached_time = (i == 0) ? cached_time : std::min(best_cached_time, cached_time);
+        }
+      }
+
+      printf("%-24s %10d verts  first %10.3f ms  best %10.3f ms\n",
+             name,
+             mesh->totvert,
+             first_time * 1000.0,
+             best_time * 1000.0);
+      const std::string key = std::string(name) + "_" + std::to_string(size);
+      RecordProperty(key + "_first_ms", std::to_string(first_time * 1000.0));
+      RecordProperty(key + "_best_ms", std::to_string(best_time * 1000.0));
+      if (mti->freeRuntimeData) {
+        printf("%-24s %10d verts  cached               best %10.3f ms\n",
+               name,
+               mesh->totvert,
+               best_cached_time * 1000.0);
+        RecordProperty(key + "_best_cached_ms", std::to_string(best_cached_time * 1000.0));
+      }
+
+      BKE_id_free(NULL, mesh);
+    }
+
+    BKE_modifier_free(md);
+  }
+};
+
+TEST_F(ModifierPerformanceTest, Moebius)
+{
+  MoebiusModifierData *mmd = (MoebiusModifierData *)BKE_modifier_new(eModifierType_Moebius);
+  mmd->control = control_;
+  run("moebius", &mmd->modifier, INT_MAX);
+}
+
+TEST_F(ModifierPerformanceTest, SphereReflect)
+{
+  SphereReflectModifierData *smd = (SphereReflectModifierData *)BKE_modifier_new(
+      eModifierType_SphereReflect);
+  smd->sphere = sphere_;
+  run("sphere_reflect", &smd->modifier, INT_MAX);
+}
+
+TEST_F(ModifierPerformanceTest, SphereReflectAdaptive)
+{
+  SphereReflectModifierData *smd = (SphereReflectModifierData *)BKE_modifier_new(
+      eModifierType_SphereReflect);
+  smd->sphere = sphere_;
+  smd->flags |= MOD_SPHERE_REFLECT_ADAPTIVE;
+  smd->iterations = 3;
+  run("sphere_reflect_adaptive", &smd->modifier, 1000000);
+}
+
+TEST_F(ModifierPerformanceTest, Array)
+{
+  ArrayModifierData *amd = (ArrayModifierData *)BKE_modifier_new(eModifierType_Array);
+  amd->count = 4;
+  run("array", &amd->modifier, 1000000);
+}
+
+TEST_F(ModifierPerformanceTest, Subsurf)
+{
+  SubsurfModifierData *smd = (SubsurfModifierData *)BKE_modifier_new(eModifierType_Subsurf);
+  smd->levels = 1;
+  run("subsurf", &smd->modifier, 1000000);
+}
+
+TEST_F(ModifierPerformanceTest, Solidify)
+{
+  SolidifyModifierData *smd = (SolidifyModifierData *)BKE_modifier_new(eModifierType_Solidify);
+  run("solidify", &smd->modifier, 1000000);
+}
+
+}  // namespace blender::modifiers::tests
@@ -27,6 +27,8 @@ void register_node_type_fn_group_instance_id(void);
 void register_node_type_fn_combine_strings(void);
 void register_node_type_fn_object_transforms(void);
 void register_node_type_fn_random_float(void);
+void register_node_type_fn_sphere_inversion(void);
+void register_node_type_fn_plane_reflection(void);
 
 #ifdef __cplusplus
 }
@@ -265,6 +265,8 @@ DefNode(FunctionNode, FN_NODE_GROUP_INSTANCE_ID, 0,             "GROUP_INSTANCE_
 DefNode(FunctionNode, FN_NODE_COMBINE_STRINGS, 0,               "COMBINE_STRINGS", CombineStrings, "Combine Strings", "")
 DefNode(FunctionNode, FN_NODE_OBJECT_TRANSFORMS, 0,             "OBJECT_TRANSFORMS", ObjectTransforms, "Object Transforms", "")
 DefNode(FunctionNode, FN_NODE_RANDOM_FLOAT, 0,                  "RANDOM_FLOAT", RandomFloat, "Random Float", "")
+DefNode(FunctionNode, FN_NODE_SPHERE_INVERSION, 0,              "SPHERE_INVERSION", SphereInversion, "Sphere Inversion", "")
+DefNode(FunctionNode, FN_NODE_PLANE_REFLECTION, 0,              "PLANE_REFLECTION", PlaneReflection, "Plane Reflection", "")
 
 
 /* undefine macros */
@@ -0,0 +1,70 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "FN_multi_function_conformal.hh"
+
+#include "node_function_util.hh"
+
+static bNodeSocketTemplate fn_node_plane_reflection_in[] = {
+    {SOCK_VECTOR, N_("Vector"), 0.0f, 0.0f, 0.0f, 0.0f, -10000.0f, 10000.0f, PROP_NONE},
+    {SOCK_VECTOR, N_("Normal"), 0.0f, 0.0f, 1.0f, 0.0f, -1.0f, 1.0f, PROP_DIRECTION},
+    {SOCK_FLOAT, N_("Distance"), 0.0f, 0.0f, 0.0f, 0.0f, -10000.0f, 10000.0f, PROP_NONE},
+    {-1, ""},
+};
+
+static bNodeSocketTemplate fn_node_plane_reflection_out[] = {
+    {SOCK_VECTOR, N_("Vector")},
+    {-1, ""},
+};
+
+/**
+ * Like the sphere inversion node, this expands into the conformal reflection chain. The plane is
+ * given by its normal and its distance to the origin along the normal.
+ */
+static void fn_node_plane_reflection_expand_in_mf_network(
+    blender::nodes::NodeMFNetworkBuilder &builder)
+{
+  static blender::fn::ConformalMF_PointEmbed embed_fn;
+  static blender::fn::ConformalMF_Plane plane_fn;
+  static blender::fn::ConformalMF_Sandwich sandwich_fn;
+  static blender::fn::ConformalMF_ExtractPoint extract_fn;
+
+  blender::fn::MFNetwork &network = builder.network();
+  blender::fn::MFFunctionNode &embed_node = network.add_function(embed_fn);
+  blender::fn::MFFunctionNode &plane_node = network.add_function(plane_fn);
+  blender::fn::MFFunctionNode &sandwich_node = network.add_function(sandwich_fn);
+  blender::fn::MFFunctionNode &extract_node = network.add_function(extract_fn);
+  network.add_link(plane_node.output(0), sandwich_node.input(0));
+  network.add_link(embed_node.output(0), sandwich_node.input(1));
+  network.add_link(sandwich_node.output(0), extract_node.input(0));
+
+  const blender::nodes::DNode &dnode = builder.dnode();
+  blender::nodes::MFNetworkTreeMap &network_map = builder.network_map();
+  network_map.add(dnode.input(0, "Vector"), embed_node.input(0));
+  network_map.add(dnode.input(1, "Normal"), plane_node.input(0));
+  network_map.add(dnode.input(2, "Distance"), plane_node.input(1));
+  network_map.add(dnode.output(0, "Vector"), extract_node.output(0));
+}
+
+void register_node_type_fn_plane_reflection()
+{
+  static bNodeType ntype;
+
+  fn_node_type_base(&ntype, FN_NODE_PLANE_REFLECTION, "Plane Reflection", 0, 0);
+  node_type_socket_templates(&ntype, fn_node_plane_reflection_in, fn_node_plane_reflection_out);
+  ntype.expand_in_mf_network = fn_node_plane_reflection_expand_in_mf_network;
+  nodeRegisterType(&ntype);
+}
@@ -0,0 +1,70 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "FN_multi_function_conformal.hh"
+
+#include "node_function_util.hh"
+
+static bNodeSocketTemplate fn_node_sphere_inversion_in[] = {
+    {SOCK_VECTOR, N_("Vector"), 0.0f, 0.0f, 0.0f, 0.0f, -10000.0f, 10000.0f, PROP_NONE},
+    {SOCK_VECTOR, N_("Center"), 0.0f, 0.0f, 0.0f, 0.0f, -10000.0f, 10000.0f, PROP_NONE},
+    {SOCK_FLOAT, N_("Radius"), 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 10000.0f, PROP_UNSIGNED},
+    {-1, ""},
+};
+
+static bNodeSocketTemplate fn_node_sphere_inversion_out[] = {
+    {SOCK_VECTOR, N_("Vector")},
+    {-1, ""},
+};
+
+/**
+ * There is no socket type for conformal vectors, so the node expands into the whole chain of
+ * embedding the point, reflecting it in the sphere and extracting the result.
+ */
+static void fn_node_sphere_inversion_expand_in_mf_network(
+    blender::nodes::NodeMFNetworkBuilder &builder)
+{
+  static blender::fn::ConformalMF_PointEmbed embed_fn;
+  static blender::fn::ConformalMF_Sphere sphere_fn;
+  static blender::fn::ConformalMF_Sandwich sandwich_fn;
+  static blender::fn::ConformalMF_ExtractPoint extract_fn;
+
+  blender::fn::MFNetwork &network = builder.network();
+  blender::fn::MFFunctionNode &embed_node = network.add_function(embed_fn);
+  blender::fn::MFFunctionNode &sphere_node = network.add_function(sphere_fn);
+  blender::fn::MFFunctionNode &sandwich_node = network.add_function(sandwich_fn);
+  blender::fn::MFFunctionNode &extract_node = network.add_function(extract_fn);
+  network.add_link(sphere_node.output(0), sandwich_node.input(0));
+  network.add_link(embed_node.output(0), sandwich_node.input(1));
+  network.add_link(sandwich_node.output(0), extract_node.input(0));
+
+  const blender::nodes::DNode &dnode = builder.dnode();
+  blender::nodes::MFNetworkTreeMap &network_map = builder.network_map();
+  network_map.add(dnode.input(0, "Vector"), embed_node.input(0));
+  network_map.add(dnode.input(1, "Center"), sphere_node.input(0));
+  network_map.add(dnode.input(2, "Radius"), sphere_node.input(1));
+  network_map.add(dnode.output(0, "Vector"), extract_node.output(0));
+}
+
+void register_node_type_fn_sphere_inversion()
+{
+  static bNodeType ntype;
+
+  fn_node_type_base(&ntype, FN_NODE_SPHERE_INVERSION, "Sphere Inversion", 0, 0);
+  node_type_socket_templates(&ntype, fn_node_sphere_inversion_in, fn_node_sphere_inversion_out);
+  ntype.expand_in_mf_network = fn_node_sphere_inversion_expand_in_mf_network;
+  nodeRegisterType(&ntype);
+}
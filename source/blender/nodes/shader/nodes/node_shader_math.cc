@@ -166,7 +166,8 @@ static const blender::fn::MultiFunction &get_base_multi_function(
       return fn;
     }
     case NODE_MATH_DIVIDE: {
-      static blender::fn::CustomMF_SI_SI_SO<float, float, float> fn{"Divide", safe_divide};
+      static blender::fn::CustomMF_SI_SI_SO<float, float, float> fn{
+          "Divide", [](float a, float b) { return safe_divide(a, b); }};
       return fn;
     }
     case NODE_MATH_MULTIPLY_ADD: {
@@ -176,23 +177,28 @@ static const blender::fn::MultiFunction &get_base_multi_function(
     }
 
     case NODE_MATH_POWER: {
-      static blender::fn::CustomMF_SI_SI_SO<float, float, float> fn{"Power", safe_powf};
+      static blender::fn::CustomMF_SI_SI_SO<float, float, float> fn{
+          "Power", [](float a, float b) { return safe_powf(a, b); }};
       return fn;
     }
     case NODE_MATH_LOGARITHM: {
-      static blender::fn::CustomMF_SI_SI_SO<float, float, float> fn{"Logarithm", safe_logf};
+      static blender::fn::CustomMF_SI_SI_SO<float, float, float> fn{
+          "Logarithm", [](float a, float b) { return safe_logf(a, b); }};
       return fn;
     }
     case NODE_MATH_EXPONENT: {
-      static blender::fn::CustomMF_SI_SO<float, float> fn{"Exponent", expf};
+      static blender::fn::CustomMF_SI_SO<float, float> fn{"Exponent",
+                                                          [](float a) { return expf(a); }};
       return fn;
     }
     case NODE_MATH_SQRT: {
-      static blender::fn::CustomMF_SI_SO<float, float> fn{"Sqrt", safe_sqrtf};
+      static blender::fn::CustomMF_SI_SO<float, float> fn{"Sqrt",
+                                                          [](float a) { return safe_sqrtf(a); }};
       return fn;
     }
     case NODE_MATH_INV_SQRT: {
-      static blender::fn::CustomMF_SI_SO<float, float> fn{"Inverse Sqrt", safe_inverse_sqrtf};
+      static blender::fn::CustomMF_SI_SO<float, float> fn{
+          "Inverse Sqrt", [](float a) { return safe_inverse_sqrtf(a); }};
       return fn;
     };
     case NODE_MATH_ABSOLUTE: {
@@ -322,11 +328,13 @@ static const blender::fn::MultiFunction &get_base_multi_function(
       return fn;
     }
     case NODE_MATH_ARCSINE: {
-      static blender::fn::CustomMF_SI_SO<float, float> fn{"Arc Sine", safe_asinf};
+      static blender::fn::CustomMF_SI_SO<float, float> fn{"Arc Sine",
+                                                          [](float a) { return safe_asinf(a); }};
       return fn;
     }
     case NODE_MATH_ARCCOSINE: {
-      static blender::fn::CustomMF_SI_SO<float, float> fn{"Arc Cosine", safe_acosf};
+      static blender::fn::CustomMF_SI_SO<float, float> fn{
+          "Arc Cosine", [](float a) { return safe_acosf(a); }};
       return fn;
     }
     case NODE_MATH_ARCTANGENT: {
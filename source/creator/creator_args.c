@@ -40,11 +40,13 @@
 #  include "BLI_string.h"
 #  include "BLI_string_utf8.h"
 #  include "BLI_system.h"
+#  include "BLI_task.h"
 #  include "BLI_threads.h"
 #  include "BLI_utildefines.h"
 
 #  include "BLO_readfile.h" /* only for BLO_has_bfile_extension */
 
+#  include "BKE_blender.h"
 #  include "BKE_blender_version.h"
 #  include "BKE_context.h"
 
@@ -598,6 +600,7 @@ static int arg_handle_print_help(int UNUSED(argc), const char **UNUSED(argv), vo
   BLI_argsPrintArgDoc(ba, "--debug-depsgraph-no-threads");
   BLI_argsPrintArgDoc(ba, "--debug-depsgraph-time");
   BLI_argsPrintArgDoc(ba, "--debug-depsgraph-pretty");
+  BLI_argsPrintArgDoc(ba, "--debug-task-profile");
   BLI_argsPrintArgDoc(ba, "--debug-gpu");
   BLI_argsPrintArgDoc(ba, "--debug-gpumem");
   BLI_argsPrintArgDoc(ba, "--debug-gpu-shaders");
@@ -770,6 +773,42 @@ static int arg_handle_debug_exit_on_error(int UNUSED(argc),
   return 0;
 }
 
+/* Trace written on exit by #arg_handle_debug_task_profile_set. */
+static char debug_task_profile_filepath[FILE_MAX];
+
+static void debug_task_profile_atexit(void *UNUSED(user_data))
+{
+  if (BLI_task_profile_write_chrome_trace(debug_task_profile_filepath)) {
+    printf("Task profile written to '%s'\n", debug_task_profile_filepath);
+  }
+  else {
+    printf("Error: could not write task profile to '%s'\n", debug_task_profile_filepath);
+  }
+}
+
+static const char arg_handle_debug_task_profile_set_doc[] =
+    "<filepath>\n"
+    "\tRecord every task and parallel range chunk run by the task scheduler,\n"
+    "\tand write them to <filepath> as Chrome trace JSON on exit.";
+static int arg_handle_debug_task_profile_set(int argc, const char **argv, void *UNUSED(data))
+{
+  const char *arg_id = "--debug-task-profile";
+  if (argc > 1) {
+    const bool is_registered = (debug_task_profile_filepath[0] != '\0');
+    BLI_strncpy(debug_task_profile_filepath, argv[1], sizeof(debug_task_profile_filepath));
+    BLI_path_abs_from_cwd(debug_task_profile_filepath, sizeof(debug_task_profile_filepath));
+    if (!is_registered) {
+      BKE_blender_atexit_register(debug_task_profile_atexit, NULL);
+    }
+    BLI_task_profile_enable(true);
+    return 1;
+  }
+  else {
+    printf("\nError: you must specify a filepath after '%s'.\n", arg_id);
+    return 0;
+  }
+}
+
 static const char arg_handle_background_mode_set_doc[] =
     "\n\t"
     "Run in background (often used for UI-less rendering).";
@@ -2234,6 +2273,7 @@ void main_args_setup(bContext *C, bArgs *ba)
               CB_EX(arg_handle_debug_mode_generic_set, gpumem),
               (void *)G_DEBUG_GPU_FORCE_WORKAROUNDS);
   BLI_argsAdd(ba, NULL, "--debug-exit-on-error", CB(arg_handle_debug_exit_on_error), NULL);
+  BLI_argsAdd(ba, NULL, "--debug-task-profile", CB(arg_handle_debug_task_profile_set), NULL);
 
   BLI_argsAdd(ba, NULL, "--verbose", CB(arg_handle_verbosity_set), NULL);
 